@@ -0,0 +1,371 @@
+#!/usr/bin/python
+#
+# Copyright (c) Ivan Marti-Vidal 2015-2022, University of Valencia (Spain)
+#       and Geoffrey Crew 2015-2022, Massachusetts Institute of Technology
+#
+# Throughput benchmarks of PolConvert, on the synthetic data of pcsynth.py.
+#
+# It calls the compiled modules (_PolConvert, _PolGainSolve) directly,
+# with the arguments that polconvert_standalone.py (or polconvert_CASA.py,
+# for the ALMA mode) would give them, so neither CASA nor a correlator
+# setup are needed.  The data are copied into a work directory before
+# each run (the conversion overwrites them), and the copy is not timed.
+#
+'''
+pcbench.py -- time PolConvert and the cross-polarization gain solver
+'''
+
+from __future__ import absolute_import
+from __future__ import print_function
+import argparse
+import glob
+import os
+import pickle as pk
+import shutil
+import struct
+import sys
+import time
+import numpy as np
+
+# The available benchmarks (in the order they are run; the ALMA mode
+# ones must go first, since _PolConvert can not be set back to it):
+BENCHMARKS = ['alma', 'ktl', 'swin', 'fits', 'solve']
+
+def parseOptions():
+    '''
+    Times the conversion of the synthetic data written by pcsynth.py
+    and the stages of the cross-polarization gain solver.  The benchmarks
+    are: alma (SWIN files, ALMA mode, i.e. with the synthetic gains and
+    D-terms), ktl (as alma, writing the K-matrix timeline, and then
+    converting again from it), swin (SWIN files, non-ALMA mode), fits
+    (FITS-IDI file, non-ALMA mode) and solve (SWIN conversion writing the
+    fringe files, then ReadData, DoGFF and GetChi2 on them).  For each
+    stage, the best time of all the runs is reported, with the visibilities
+    and MB (of the data files that the stage reads) processed per second.
+    '''
+    des = parseOptions.__doc__
+    epi =  'Typical use: pcsynth.py -o DATA ; pcbench.py -d DATA. '
+    epi += 'The modules are taken from the --moddir directory (i.e., '
+    epi += 'after "python setup.py build_ext --inplace").  Note that '
+    epi += 'the header indices (in WORK/POLCONVERT.INDEX) are removed '
+    epi += 'before each run, unless --keepindex is given.'
+    use = '%(prog)s [options]'
+    parser = argparse.ArgumentParser(epilog=epi, description=des, usage=use)
+    parser.add_argument('-d', '--data', dest='data',
+        default='pcbench.data', metavar='DIR',
+        help='directory with the data of pcsynth.py')
+    parser.add_argument('-m', '--moddir', dest='moddir',
+        default=os.path.dirname(os.path.dirname(os.path.abspath(__file__))),
+        metavar='DIR',
+        help='directory with the compiled modules (default: the source tree)')
+    parser.add_argument('-w', '--work', dest='work',
+        default='', metavar='DIR',
+        help='work directory (default: DATA/work)')
+    parser.add_argument('-b', '--bench', dest='bench',
+        default=','.join(BENCHMARKS), metavar='LIST',
+        help='comma-separated list of benchmarks (default: %s)' %
+        ','.join(BENCHMARKS))
+    parser.add_argument('-r', '--runs', dest='runs',
+        default=3, metavar='INT', type=int,
+        help='number of runs of each benchmark (default 3)')
+    parser.add_argument('-n', '--nchi2', dest='nchi2',
+        default=20, metavar='INT', type=int,
+        help='number of GetChi2 calls per run (default 20)')
+    parser.add_argument('-p', '--npix', dest='npix',
+        default=-1, metavar='INT', type=int,
+        help='npix of DoGFF (default -1, as in polconvert)')
+    parser.add_argument('-k', '--keepindex', dest='keepindex',
+        default=False, action='store_true',
+        help='keep the header index files between runs')
+    parser.add_argument('-s', '--stages', dest='stages',
+        default=False, action='store_true',
+        help='also report the time of each stage of the conversions '
+        '(of their best run), with _PolConvert.setTiming')
+    parser.add_argument('-v', '--verbose', dest='verb',
+        default=False, action='store_true',
+        help='show the output of the modules (otherwise, it goes '
+        'to WORK/pcbench.out)')
+    return parser.parse_args()
+
+
+class Quiet(object):
+    '''
+    Sends the stdout/stderr of the modules (C++ included) to a file.
+    '''
+    def __init__(self, o):
+        self.verb = o.verb
+        self.name = os.path.join(o.work, 'pcbench.out')
+    def __enter__(self):
+        if self.verb:
+            return self
+        sys.stdout.flush()
+        sys.stderr.flush()
+        self.out = open(self.name, 'a')
+        self.saved = [os.dup(1), os.dup(2)]
+        os.dup2(self.out.fileno(), 1)
+        os.dup2(self.out.fileno(), 2)
+        return self
+    def __exit__(self, *args):
+        if self.verb:
+            return False
+        sys.stdout.flush()
+        sys.stderr.flush()
+        os.dup2(self.saved[0], 1)
+        os.dup2(self.saved[1], 2)
+        os.close(self.saved[0])
+        os.close(self.saved[1])
+        self.out.close()
+        return False
+
+
+def report(stage, times, nvis, nbytes):
+    '''
+    One line of results (best time of the runs).
+    '''
+    best = min(times)
+    print('%-28s %9.3f s  %12.4g vis/s  %9.2f MB/s   (mean %.3f s, %i runs)' %
+        (stage, best, nvis/best, nbytes/best/1.e6, np.mean(times), len(times)))
+    sys.stdout.flush()
+
+
+def reportStages(stats):
+    '''
+    Time of each stage of a conversion (as returned with setTiming).
+    '''
+    secs, calls = stats['seconds'], stats['calls']
+    for name in sorted(secs, key=lambda n: -secs[n]):
+        if calls[name]:
+            print('    %-24s %9.3f s  %5.1f%%  (%i calls)' % (name, secs[name],
+                100.*secs[name]/max(stats['total'], 1.e-9), calls[name]))
+    print('    %s' % ', '.join(['%s %i' % (c, stats['counts'][c])
+        for c in sorted(stats['counts'])]))
+    sys.stdout.flush()
+
+
+def freshCopy(o, names):
+    '''
+    Copies the data files into the work directory (keeping their times,
+    so that the header indices of previous runs remain valid).
+    '''
+    out = []
+    for name in names:
+        dest = os.path.join(o.work, name)
+        if not os.path.exists(os.path.dirname(dest)):
+            os.makedirs(os.path.dirname(dest))
+        shutil.copy2(os.path.join(o.data, name), dest)
+        if not o.keepindex:
+            for idx in glob.glob(os.path.join(o.work, 'POLCONVERT.INDEX',
+                    os.path.basename(name) + '.*.pcidx')):
+                os.remove(idx)
+        out.append(dest)
+    return out
+
+
+def polconvertArgs(setup, files, isSWIN, ALMAstuff=[], plot=False, doSolve=-1.0):
+    '''
+    Arguments of _PolConvert.PolConvert (as in polconvert_standalone.py).
+    '''
+    nALMA = setup['nlin']
+    doIF = list(range(1, setup['nif']+1))
+    nfiles = len(files) if isSWIN else 1
+    PrioriGains = [[[np.ones(setup['nchan'], dtype=np.complex64, order='C')
+        for j in doIF] for i in range(nALMA)] for f in range(nfiles)]
+    if isSWIN:
+        metadata = [np.array(fr, dtype=np.float64, order='C')
+            for fr in setup['freqs']] + [float(setup['mjd0'])]
+        OUTPUT = files
+    else:
+        metadata = []
+        OUTPUT = files[0]
+    plRan = np.array([0.0, 10.0]) if plot else np.array([0.0, 0.0])
+    Ran = np.array([0.0, 1.0e20])
+    isLinear = [np.zeros(1, dtype=bool) for i in range(nALMA)]
+    UseAutoCorrs = np.zeros(nALMA, dtype=np.int32, order='C')
+    plIF = doIF if plot else []
+    return (nALMA, plIF, -1, doIF, 0, 0, [False for i in range(nALMA)],
+        OUTPUT, setup['linAnts'], plRan, Ran, False, doSolve, True, False,
+        PrioriGains, metadata, setup['soucoords'], setup['antcoords'],
+        setup['antmounts'], isLinear, -1, UseAutoCorrs, False, False,
+        'PolConvert.bench.log', ALMAstuff)
+
+
+def runPolConvert(o, PC, stage, setup, names, isSWIN, nvis, **kw):
+    '''
+    Times PolConvert on fresh copies of the data files.
+    '''
+    nbytes = sum([os.path.getsize(os.path.join(o.data, f)) for f in names])
+    times = []
+    stats = None
+    for run in range(o.runs):
+        files = freshCopy(o, names)
+        args = polconvertArgs(setup, files, isSWIN, **kw)
+        with Quiet(o):
+            t0 = time.time()
+            didit = PC.PolConvert(*args)
+            t1 = time.time()
+        if isinstance(didit, tuple):
+            didit, runstats = didit
+            if not times or t1 - t0 < min(times):
+                stats = runstats
+        if didit != 0:
+            print('ERROR: PolConvert returned %i (see %s)' %
+                (didit, os.path.join(o.work, 'pcbench.out')))
+            return False
+        times.append(t1 - t0)
+    report(stage, times, nvis, nbytes)
+    if stats:
+        reportStages(stats)
+    return True
+
+
+# Header of each record of the OTHERS.FRINGE files, as PolConvert writes
+# it (time, antennas and parangs), before the 4 products of each channel:
+OTHERSHEAD = struct.calcsize('=diidd')
+
+
+def fringeVis(PS, IF):
+    '''
+    Number of visibilities (and bytes) in the fringe files of an IF. The
+    number of channels is read from the header of each file; the records
+    of POLCONVERT.FRINGE have the layout given by _PolGainSolve (PS).
+    '''
+    file1 = 'POLCONVERT.FRINGE/OTHERS.FRINGE_IF%i' % IF
+    file2 = 'POLCONVERT.FRINGE/POLCONVERT.FRINGE_IF%i' % IF
+    size1 = os.path.getsize(file1)
+    size2 = os.path.getsize(file2)
+    cplx = np.dtype(np.complex64).itemsize
+    # OTHERS.FRINGE: nchan and the frequencies of the channels.
+    with open(file1, 'rb') as f:
+        nchan1, = struct.unpack('=i', f.read(struct.calcsize('=i')))
+    head1 = struct.calcsize('=i') + nchan1*np.dtype(np.float64).itemsize
+    # POLCONVERT.FRINGE: nchan and isParang.
+    with open(file2, 'rb') as f:
+        nchan2, isParang = struct.unpack('=ib', f.read(struct.calcsize('=ib')))
+    head2 = struct.calcsize('=ib')
+    nvis = (size1 - head1)//(OTHERSHEAD + 4*cplx*nchan1) \
+        + (size2 - head2)//(PS.FRINGEHEAD + PS.FRINGENVIS*cplx*nchan2)
+    return file1, file2, nvis, size1 + size2
+
+
+def runSolver(o, PS, setup):
+    '''
+    Times ReadData, DoGFF and GetChi2 (one solver per run) on the fringe
+    files of the last conversion.
+    '''
+    doIF = list(range(1, setup['nif']+1))
+    calAnts = list(range(1, setup['nant']+1))
+    refAnt = setup['nlin']+1 if setup['nlin'] < setup['nant'] else 1
+    rateAnts = [a for a in calAnts if a != refAnt]
+    fitAnts = list(setup['linAnts'])
+    fringe = [fringeVis(PS, IF) for IF in doIF]
+    nvis = sum([f[2] for f in fringe])
+    nbytes = sum([f[3] for f in fringe])
+    Npar = 2*len(fitAnts)
+    p0 = np.array([1.0, 0.0]*len(fitAnts))
+    feedRot = np.zeros(setup['nant'], dtype=np.float64, order='C')
+    times = {'read': [], 'gff': [], 'chi2': []}
+    for run in range(o.runs):
+        with Quiet(o):
+            S = PS.GainSolver()
+            S.PolGainSolve(1.0, 1.e9, [1, 1], np.array(calAnts, dtype=np.int32),
+                np.array(setup['linAnts'], dtype=np.int32),
+                [np.zeros(0, dtype=np.int32), np.zeros(0, dtype=np.int32)],
+                'PolGainSolve.bench.log')
+            t0 = time.time()
+            for i, IF in enumerate(doIF):
+                if S.ReadData(IF, fringe[i][0], fringe[i][1], 0.0) != 0:
+                    print('ERROR: ReadData failed for IF %i' % IF)
+                    return False
+            t1 = time.time()
+            for scan in range(S.GetNScan(doIF[0])):
+                S.DoGFF(rateAnts, o.npix, True, scan, 5.0)
+            t2 = time.time()
+            S.SetFit(Npar, doIF, fitAnts, 1, 0, [1., 0., 0., 0.], 0, feedRot)
+            t3 = time.time()
+            for k in range(o.nchi2):
+                S.GetChi2(p0, -1.0, 0, setup['nchan'], 0, True)
+            t4 = time.time()
+            S.FreeData()
+            del S
+        times['read'].append(t1 - t0)
+        times['gff'].append(t2 - t1)
+        times['chi2'].append((t4 - t3)/max(o.nchi2, 1))
+    report('ReadData (all IFs)', times['read'], nvis, nbytes)
+    report('DoGFF (all scans)', times['gff'], nvis, nbytes)
+    report('GetChi2 (per call)', times['chi2'], nvis, nbytes)
+    return True
+
+
+def benchmark(o):
+    '''
+    Runs the selected benchmarks.
+    '''
+    sys.path.insert(0, os.path.abspath(o.moddir))
+    import _PolConvert as PC
+
+    o.data = os.path.abspath(o.data)
+    o.work = os.path.abspath(o.work or os.path.join(o.data, 'work'))
+    if not os.path.exists(o.work):
+        os.makedirs(o.work)
+    with open(os.path.join(o.data, 'bench.setup.pck'), 'rb') as f:
+        setup = pk.load(f)
+    with open(os.path.join(o.data, 'bench.almastuff.pck'), 'rb') as f:
+        ALMAstuff = pk.load(f)
+    os.chdir(o.work)
+    for dirnam in ['POLCONVERT.FRINGE']:
+        if not os.path.exists(dirnam):
+            os.mkdir(dirnam)
+    if o.stages:
+        with Quiet(o):
+            PC.setTiming(1)
+
+    todo = [b for b in BENCHMARKS if b in o.bench.split(',')]
+    nbas = setup['nant']*(setup['nant']+1)//2
+    nvis = nbas*setup['nint']*setup['nif']
+    print('Data: %i antennas (%i linear), %i IFs x %i channels, %i integrations; %i visibilities' %
+        (setup['nant'], setup['nlin'], setup['nif'], setup['nchan'], setup['nint'], nvis))
+    print('%-28s %11s  %18s  %14s' % ('Stage', 'best', 'rate', 'throughput'))
+
+    if 'alma' in todo and setup['swinfiles']:
+        runPolConvert(o, PC, 'PolConvert SWIN (ALMA)', setup,
+            setup['swinfiles'], True, nvis, ALMAstuff=ALMAstuff)
+
+    if 'ktl' in todo and setup['swinfiles']:
+        ktl = os.path.join(o.work, 'bench.pcktl')
+        with Quiet(o):
+            PC.setKTimeline(1, ktl)
+        if runPolConvert(o, PC, 'PolConvert SWIN (K out)', setup,
+            setup['swinfiles'], True, nvis, ALMAstuff=ALMAstuff):
+            with Quiet(o):
+                PC.setKTimeline(2, ktl)
+            runPolConvert(o, PC, 'PolConvert SWIN (K in)', setup,
+                setup['swinfiles'], True, nvis, ALMAstuff=ALMAstuff)
+        with Quiet(o):
+            PC.setKTimeline(0, '')
+
+    with Quiet(o):
+        PC.setPCMode(0)
+
+    if 'swin' in todo and setup['swinfiles']:
+        runPolConvert(o, PC, 'PolConvert SWIN', setup,
+            setup['swinfiles'], True, nvis)
+
+    if 'fits' in todo and setup['idi']:
+        runPolConvert(o, PC, 'PolConvert FITS-IDI', setup,
+            [setup['idi']], False, nvis)
+
+    if 'solve' in todo and setup['swinfiles']:
+        if runPolConvert(o, PC, 'PolConvert SWIN (fringes)', setup,
+            setup['swinfiles'], True, nvis, plot=True, doSolve=0.0):
+            import _PolGainSolve as PS
+            runSolver(o, PS, setup)
+
+
+if __name__ == '__main__':
+    opts = parseOptions()
+    benchmark(opts)
+    sys.exit(0)
+
+#
+# eof
+#
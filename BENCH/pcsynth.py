@@ -0,0 +1,464 @@
+#!/usr/bin/python
+#
+# Copyright (c) Ivan Marti-Vidal 2015-2022, University of Valencia (Spain)
+#       and Geoffrey Crew 2015-2022, Massachusetts Institute of Technology
+#
+# Synthetic data for the PolConvert benchmarks (see pcbench.py).
+#
+# It writes a DiFX (SWIN) directory and a FITS-IDI file with the same
+# visibilities, plus the metadata that PolConvert takes as arguments
+# (frequencies, antenna and source coordinates, mounts) and, optionally,
+# synthetic ALMA gain and D-term arrays in the ALMAstuff layout (i.e., as
+# built by polconvert_CASA.py).  Only numpy is needed (the FITS-IDI file
+# is written by hand, so neither astropy nor CASA are required).
+#
+'''
+pcsynth.py -- generate synthetic SWIN/FITS-IDI data for pcbench.py
+'''
+
+from __future__ import absolute_import
+from __future__ import print_function
+import argparse
+import os
+import pickle as pk
+import sys
+import numpy as np
+
+# Same codes as in polconvert_standalone.py
+MntCodes = {'AZ':0, 'EQ':1, 'OB':2, 'XY':3, 'NR':4, 'NL':5}
+
+# DiFX SWIN record sync word and header version
+SWINSYNC = -16711936    # 0xFF00FF00
+SWINVERSION = 1
+
+
+def parseOptions():
+    '''
+    Writes a synthetic observation (one source, one correlator setup)
+    in the formats that PolConvert converts: a directory of DiFX SWIN
+    files (bench.difx) and a FITS-IDI file (bench.idi).  The metadata
+    that PolConvert needs are saved in bench.setup.pck and the ALMA
+    calibration (gains and D-terms, for the phased-array mode) in
+    bench.almastuff.pck.  The first --nlin antennas have linear feeds.
+    '''
+    des = parseOptions.__doc__
+    epi =  'The output directory is then given to pcbench.py, which '
+    epi += 'times PolConvert and the cross-polarization gain solver '
+    epi += 'on these data.'
+    use = '%(prog)s [options]'
+    parser = argparse.ArgumentParser(epilog=epi, description=des, usage=use)
+    parser.add_argument('-o', '--output', dest='output',
+        default='pcbench.data', metavar='DIR',
+        help='output directory (created if needed)')
+    parser.add_argument('-a', '--nant', dest='nant',
+        default=6, metavar='INT', type=int,
+        help='number of antennas (default 6)')
+    parser.add_argument('-l', '--nlin', dest='nlin',
+        default=1, metavar='INT', type=int,
+        help='number of linear-pol antennas, i.e. the first ones (default 1)')
+    parser.add_argument('-i', '--nif', dest='nif',
+        default=4, metavar='INT', type=int,
+        help='number of IFs (default 4)')
+    parser.add_argument('-c', '--nchan', dest='nchan',
+        default=64, metavar='INT', type=int,
+        help='number of channels per IF (default 64)')
+    parser.add_argument('-t', '--nint', dest='nint',
+        default=300, metavar='INT', type=int,
+        help='number of integrations (default 300)')
+    parser.add_argument('-d', '--tint', dest='tint',
+        default=2.0, metavar='SECS', type=float,
+        help='integration time, in seconds (default 2)')
+    parser.add_argument('-f', '--nfiles', dest='nfiles',
+        default=4, metavar='INT', type=int,
+        help='number of SWIN files (default 4)')
+    parser.add_argument('-s', '--nsum', dest='nsum',
+        default=8, metavar='INT', type=int,
+        help='number of antennas in the phased array (default 8)')
+    parser.add_argument('-g', '--ngain', dest='ngain',
+        default=2, metavar='INT', type=int,
+        help='number of ALMA gain tables (default 2)')
+    parser.add_argument('-G', '--gaindt', dest='gaindt',
+        default=30.0, metavar='SECS', type=float,
+        help='time between ALMA gain solutions (default 30)')
+    parser.add_argument('-C', '--gainchan', dest='gainchan',
+        default=128, metavar='INT', type=int,
+        help='number of channels of the ALMA gains (default 128)')
+    parser.add_argument('-r', '--seed', dest='seed',
+        default=1, metavar='INT', type=int,
+        help='random seed (default 1)')
+    parser.add_argument('--noswin', dest='swin',
+        default=True, action='store_false',
+        help='do not write the SWIN files')
+    parser.add_argument('--nofits', dest='fits',
+        default=True, action='store_false',
+        help='do not write the FITS-IDI file')
+    return parser.parse_args()
+
+
+def makeSetup(nant=6, nlin=1, nif=4, nchan=64, nint=300, tint=2.0,
+    nfiles=4, seed=1):
+    '''
+    Observation metadata, in the same form as the PolConvert arguments.
+    Times are MJD seconds (as in the CASA tables).
+    '''
+    rng = np.random.default_rng(seed)
+    setup = {'nant':nant, 'nlin':nlin, 'nif':nif, 'nchan':nchan,
+        'nint':nint, 'tint':tint, 'nfiles':nfiles, 'seed':seed}
+    setup['mjd0'] = 59000
+    setup['linAnts'] = list(range(1, nlin+1))
+    # Antennas on the Earth surface (the first one at the ALMA site):
+    lat = np.radians(np.concatenate([[-23.03], rng.uniform(-30., 60., nant-1)]))
+    lon = np.radians(np.concatenate([[-67.75], rng.uniform(-120., 30., nant-1)]))
+    R = 6.371e6
+    setup['antcoords'] = np.array(np.transpose([R*np.cos(lat)*np.cos(lon),
+        R*np.cos(lat)*np.sin(lon), R*np.sin(lat)]), dtype=np.float64, order='C')
+    setup['antmounts'] = np.zeros(nant, dtype=np.int32) + MntCodes['AZ']
+    setup['soucoords'] = [np.array([1.2]), np.array([-0.3])]
+    # IFs of 64 MHz (USB) at 86 GHz:
+    bw = 64.e6
+    setup['freqs'] = [86.e9 + i*bw + np.arange(nchan)*bw/nchan for i in range(nif)]
+    setup['chanbw'] = bw/nchan
+    setup['t0'] = setup['mjd0']*86400. + 3600.
+    setup['times'] = setup['t0'] + np.arange(nint)*tint
+    return setup
+
+
+def baselines(nant):
+    '''
+    DiFX baseline order (autocorrelations included).
+    '''
+    return [(a1, a2) for a1 in range(1, nant+1) for a2 in range(a1, nant+1)]
+
+
+def uvwArray(setup, t, bas):
+    '''
+    Approximate (u,v,w) of each baseline (in meters) at time t.
+    '''
+    H = 2.*np.pi*(t/86164.0905) - setup['soucoords'][0][0]
+    dec = setup['soucoords'][1][0]
+    xyz = setup['antcoords']
+    out = np.zeros((len(bas), 3))
+    for b, (a1, a2) in enumerate(bas):
+        B = xyz[a2-1] - xyz[a1-1]
+        out[b, 0] = B[0]*np.sin(H) + B[1]*np.cos(H)
+        out[b, 1] = -np.sin(dec)*(B[0]*np.cos(H) - B[1]*np.sin(H)) + np.cos(dec)*B[2]
+        out[b, 2] = np.cos(dec)*(B[0]*np.cos(H) - B[1]*np.sin(H)) + np.sin(dec)*B[2]
+    return out
+
+
+def visBlock(rng, shape):
+    '''
+    Visibilities for the 4 pol. products (last-but-one axis), with
+    unit parallel hands and some noise.
+    '''
+    vis = (rng.normal(size=shape) + 1.j*rng.normal(size=shape))*0.2
+    vis[..., 0, :] += 1.0
+    vis[..., 3, :] += 1.0
+    return vis.astype(np.complex64)
+
+
+def writeSWIN(setup, outdir):
+    '''
+    Writes the SWIN files (one record per baseline, IF and pol. product,
+    in DiFX order) and returns their names.
+    '''
+    rng = np.random.default_rng(setup['seed'] + 1)
+    nchan = setup['nchan']
+    nif = setup['nif']
+    bas = baselines(setup['nant'])
+    pols = [['R', 'L'] for i in range(setup['nant'])]
+    for a in setup['linAnts']:
+        pols[a-1] = ['X', 'Y']
+    rec = np.dtype([('sync', '<i4'), ('version', '<i4'), ('baseline', '<i4'),
+        ('mjd', '<i4'), ('seconds', '<f8'), ('config', '<i4'),
+        ('source', '<i4'), ('freq', '<i4'), ('pols', 'S2'),
+        ('pulsarbin', '<i4'), ('weight', '<f8'), ('uvw', '<f8', (3,)),
+        ('vis', '<c8', (nchan,))])
+    block = np.zeros((len(bas), nif, 4), dtype=rec)
+    block['sync'] = SWINSYNC
+    block['version'] = SWINVERSION
+    block['mjd'] = setup['mjd0']
+    block['weight'] = 1.0
+    for b, (a1, a2) in enumerate(bas):
+        block['baseline'][b] = a1*256 + a2
+        for p, (p1, p2) in enumerate([(0, 0), (0, 1), (1, 0), (1, 1)]):
+            block['pols'][b, :, p] = (pols[a1-1][p1] + pols[a2-1][p2]).encode()
+    for i in range(nif):
+        block['freq'][:, i, :] = i
+
+    difx = os.path.join(outdir, 'bench.difx')
+    if not os.path.exists(difx):
+        os.makedirs(difx)
+    names = []
+    chunks = np.array_split(np.arange(setup['nint']), setup['nfiles'])
+    for chunk in chunks:
+        if len(chunk) == 0:
+            continue
+        secs = setup['times'][chunk[0]] - setup['mjd0']*86400.
+        name = os.path.join(difx, 'DIFX_%05d_%06d.s0000.b0000' %
+            (setup['mjd0'], int(secs)))
+        with open(name, 'wb') as f:
+            for it in chunk:
+                t = setup['times'][it]
+                block['seconds'] = t - setup['mjd0']*86400.
+                block['uvw'] = uvwArray(setup, t, bas)[:, np.newaxis, np.newaxis, :]
+                block['vis'] = visBlock(rng, (len(bas), nif, 4, nchan))
+                block.tofile(f)
+        names.append(os.path.relpath(name, outdir))
+    return names
+
+
+def fitsCard(key, value=None, comment=''):
+    '''
+    One 80-character FITS header card.
+    '''
+    if value is None:
+        return key.ljust(80)
+    if isinstance(value, bool):
+        val = ('T' if value else 'F').rjust(20)
+    elif isinstance(value, (int, np.integer)):
+        val = str(int(value)).rjust(20)
+    elif isinstance(value, (float, np.floating)):
+        val = ('%.15E' % value).rjust(20)
+    else:
+        val = "'%s'" % str(value).ljust(8)
+    card = '%-8s= %s' % (key, val)
+    if comment:
+        card += ' / ' + comment
+    return card[:80].ljust(80)
+
+
+def fitsHeader(cards, f):
+    '''
+    Writes the cards (and END), padded to a 2880-byte block.
+    '''
+    head = ''.join(cards) + fitsCard('END')
+    head += ' '*((-len(head)) % 2880)
+    f.write(head.encode('ascii'))
+
+
+def fitsBinTable(f, extname, columns, nrows, keywords, rows):
+    '''
+    Writes a binary-table HDU. The columns are (TTYPE, TFORM, numpy type,
+    shape, TDIM) and rows is an iterable of structured arrays (big-endian)
+    with the table rows, in order.
+    '''
+    dtype = np.dtype([(c[0], c[2], c[3]) for c in columns])
+    cards = [fitsCard('XTENSION', 'BINTABLE'), fitsCard('BITPIX', 8),
+        fitsCard('NAXIS', 2), fitsCard('NAXIS1', dtype.itemsize),
+        fitsCard('NAXIS2', nrows), fitsCard('PCOUNT', 0),
+        fitsCard('GCOUNT', 1), fitsCard('TFIELDS', len(columns))]
+    for i, c in enumerate(columns):
+        cards.append(fitsCard('TTYPE%i' % (i+1), c[0]))
+        cards.append(fitsCard('TFORM%i' % (i+1), c[1]))
+        if c[4]:
+            cards.append(fitsCard('TDIM%i' % (i+1), c[4]))
+    cards.append(fitsCard('EXTNAME', extname))
+    cards += [fitsCard(k, v) for k, v in keywords]
+    fitsHeader(cards, f)
+    size = 0
+    for block in rows:
+        np.asarray(block, dtype=dtype).tofile(f)
+        size += block.nbytes
+    f.write(b'\0'*((-size) % 2880))
+    return dtype
+
+
+def writeFITS(setup, outdir):
+    '''
+    Writes a FITS-IDI file with the same visibilities as the SWIN files
+    (one row per baseline and integration, with all the IFs as bands).
+    '''
+    rng = np.random.default_rng(setup['seed'] + 1)
+    nchan = setup['nchan']
+    nif = setup['nif']
+    nant = setup['nant']
+    bas = baselines(nant)
+    name = os.path.join(outdir, 'bench.idi')
+    reffreq = setup['freqs'][0][0]
+    common = [('OBSCODE', 'PCBENCH'), ('NO_STKD', 4), ('STK_1', -1),
+        ('NO_BAND', nif), ('NO_CHAN', nchan), ('REF_FREQ', reffreq),
+        ('CHAN_BW', setup['chanbw']), ('REF_PIXL', 1.0), ('TABREV', 1)]
+
+    with open(name, 'wb') as f:
+        fitsHeader([fitsCard('SIMPLE', True), fitsCard('BITPIX', 8),
+            fitsCard('NAXIS', 0), fitsCard('EXTEND', True),
+            fitsCard('GROUPS', True), fitsCard('GCOUNT', 0),
+            fitsCard('PCOUNT', 0)], f)
+
+        # ARRAY_GEOMETRY:
+        cols = [('ANNAME', '8A', 'S8', (), ''), ('STABXYZ', '3D', '>f8', (3,), ''),
+            ('NOSTA', '1J', '>i4', (), ''), ('MNTSTA', '1J', '>i4', (), '')]
+        tab = np.zeros(nant, dtype=[(c[0], c[2], c[3]) for c in cols])
+        tab['ANNAME'] = [('A%02d' % (a+1)).encode() for a in range(nant)]
+        tab['STABXYZ'] = setup['antcoords']
+        tab['NOSTA'] = np.arange(1, nant+1)
+        tab['MNTSTA'] = setup['antmounts']
+        fitsBinTable(f, 'ARRAY_GEOMETRY', cols, nant,
+            common + [('ARRNAM', 'PCBENCH'), ('FRAME', 'GEOCENTRIC')], [tab])
+
+        # ANTENNA:
+        cols = [('ANNAME', '8A', 'S8', (), ''), ('ANTENNA_NO', '1J', '>i4', (), ''),
+            ('ARRAY', '1J', '>i4', (), ''), ('FREQID', '1J', '>i4', (), '')]
+        tab = np.zeros(nant, dtype=[(c[0], c[2], c[3]) for c in cols])
+        tab['ANNAME'] = [('A%02d' % (a+1)).encode() for a in range(nant)]
+        tab['ANTENNA_NO'] = np.arange(1, nant+1)
+        tab['ARRAY'] = 1
+        tab['FREQID'] = 1
+        fitsBinTable(f, 'ANTENNA', cols, nant, common, [tab])
+
+        # FREQUENCY:
+        cols = [('FREQID', '1J', '>i4', (), ''),
+            ('BANDFREQ', '%iD' % nif, '>f8', (nif,), ''),
+            ('CH_WIDTH', '%iE' % nif, '>f4', (nif,), ''),
+            ('TOTAL_BANDWIDTH', '%iE' % nif, '>f4', (nif,), ''),
+            ('SIDEBAND', '%iJ' % nif, '>i4', (nif,), '')]
+        tab = np.zeros(1, dtype=[(c[0], c[2], c[3]) for c in cols])
+        tab['FREQID'] = 1
+        tab['BANDFREQ'] = [fr[0] - reffreq for fr in setup['freqs']]
+        tab['CH_WIDTH'] = setup['chanbw']
+        tab['TOTAL_BANDWIDTH'] = setup['chanbw']*nchan
+        tab['SIDEBAND'] = 1
+        fitsBinTable(f, 'FREQUENCY', cols, 1, common, [tab])
+
+        # SOURCE:
+        cols = [('SOURCE_ID', '1J', '>i4', (), ''), ('SOURCE', '16A', 'S16', (), ''),
+            ('RAEPO', '1D', '>f8', (), ''), ('DECEPO', '1D', '>f8', (), '')]
+        tab = np.zeros(1, dtype=[(c[0], c[2], c[3]) for c in cols])
+        tab['SOURCE_ID'] = 1
+        tab['SOURCE'] = b'BENCH'
+        tab['RAEPO'] = np.degrees(setup['soucoords'][0][0])
+        tab['DECEPO'] = np.degrees(setup['soucoords'][1][0])
+        fitsBinTable(f, 'SOURCE', cols, 1, common, [tab])
+
+        # UV_DATA (written one integration at a time):
+        cols = [('UU---SIN', '1E', '>f4', (), ''), ('VV---SIN', '1E', '>f4', (), ''),
+            ('WW---SIN', '1E', '>f4', (), ''), ('DATE', '1D', '>f8', (), ''),
+            ('TIME', '1D', '>f8', (), ''), ('BASELINE', '1J', '>i4', (), ''),
+            ('ARRAY', '1J', '>i4', (), ''), ('SOURCE_ID', '1J', '>i4', (), ''),
+            ('FREQID', '1J', '>i4', (), ''), ('INTTIM', '1E', '>f4', (), ''),
+            ('FLUX', '%iE' % (3*4*nchan*nif), '>f4', (nif, nchan, 4, 3),
+             '(3,4,%i,%i,1,1)' % (nchan, nif))]
+        jd0 = 2400000.5 + setup['mjd0']
+        block = np.zeros(len(bas), dtype=[(c[0], c[2], c[3]) for c in cols])
+        block['BASELINE'] = [a1*256 + a2 for (a1, a2) in bas]
+        block['ARRAY'] = 1
+        block['SOURCE_ID'] = 1
+        block['FREQID'] = 1
+        block['INTTIM'] = setup['tint']
+        block['DATE'] = jd0
+        block['FLUX'][..., 2] = 1.0
+
+        def rows():
+            for t in setup['times']:
+                uvw = uvwArray(setup, t, bas)/2.99792458e8
+                block['UU---SIN'] = uvw[:, 0]
+                block['VV---SIN'] = uvw[:, 1]
+                block['WW---SIN'] = uvw[:, 2]
+                block['TIME'] = t/86400. - setup['mjd0']
+                vis = visBlock(rng, (len(bas), nif, 4, nchan))
+                # FITS-IDI order of the products is RR, LL, RL, LR:
+                vis = vis[:, :, [0, 3, 1, 2], :]
+                block['FLUX'][..., 0] = np.moveaxis(vis.real, -1, -2)
+                block['FLUX'][..., 1] = np.moveaxis(vis.imag, -1, -2)
+                yield block
+
+        keys = common + [('NMATRIX', 1), ('MAXIS', 6), ('MAXIS1', 3),
+            ('CTYPE1', 'COMPLEX'), ('CDELT1', 1.0), ('CRPIX1', 1.0),
+            ('CRVAL1', 1.0), ('MAXIS2', 4), ('CTYPE2', 'STOKES'),
+            ('CDELT2', -1.0), ('CRPIX2', 1.0), ('CRVAL2', -1.0),
+            ('MAXIS3', nchan), ('CTYPE3', 'FREQ'), ('CDELT3', setup['chanbw']),
+            ('CRPIX3', 1.0), ('CRVAL3', reffreq), ('MAXIS4', nif),
+            ('CTYPE4', 'BAND'), ('CDELT4', 1.0), ('CRPIX4', 1.0),
+            ('CRVAL4', 1.0), ('MAXIS5', 1), ('CTYPE5', 'RA'),
+            ('CDELT5', 0.0), ('CRPIX5', 1.0), ('CRVAL5', 0.0),
+            ('MAXIS6', 1), ('CTYPE6', 'DEC'), ('CDELT6', 0.0),
+            ('CRPIX6', 1.0), ('CRVAL6', 0.0)]
+        fitsBinTable(f, 'UV_DATA', cols, len(bas)*setup['nint'], keys, rows())
+
+    return os.path.relpath(name, outdir)
+
+
+def makeALMAstuff(setup, nsum=8, ngain=2, gaindt=30.0, gainchan=128):
+    '''
+    Synthetic ALMA calibration in the ALMAstuff layout of polconvert_CASA.py:
+    [ngain, NSUM, kind, gaindata, dtdata, allantidx, nphtimes, antimes,
+     refants, asdmtimes, timeranges, isLinear], with one entry per
+    linear-pol antenna. All the phased antennas are in the sum for the
+    whole observation (one ASDM scan per SWIN file).
+    '''
+    rng = np.random.default_rng(setup['seed'] + 2)
+    nlin = setup['nlin']
+    t0 = setup['times'][0] - 60.
+    t1 = setup['times'][-1] + 60.
+    gtimes = np.arange(t0, t1 + gaindt, gaindt)
+    nt = len(gtimes)
+    f0 = setup['freqs'][0][0]
+    f1 = setup['freqs'][-1][-1]
+    gfreqs = np.linspace(f0 - 1.e6, f1 + 1.e6, gainchan)
+
+    ngainArr = [ngain for i in range(nlin)]
+    NSUM = [nsum for i in range(nlin)]
+    kind = [[0 for j in range(ngain)] for i in range(nlin)]
+    isLinear = [np.ones(ngain, dtype=bool) for i in range(nlin)]
+
+    gaindata = []
+    dtdata = []
+    for i in range(nlin):
+        gaindata.append([])
+        for j in range(ngain):
+            gaindata[-1].append([np.copy(gfreqs)])
+            for ant in range(nsum):
+                gaindata[-1][j].append([
+                    np.copy(gtimes),
+                    1.0 + 0.05*rng.normal(size=(gainchan, nt)),
+                    np.cumsum(0.05*rng.normal(size=(gainchan, nt)), axis=1),
+                    1.0 + 0.05*rng.normal(size=(gainchan, nt)),
+                    np.cumsum(0.05*rng.normal(size=(gainchan, nt)), axis=1),
+                    np.zeros((gainchan, nt), dtype=bool)])
+        dtdata.append([np.copy(gfreqs)])
+        for ant in range(nsum):
+            dtdata[-1].append([0.02*rng.normal(size=(gainchan, 1)) for k in range(4)]
+                + [np.zeros((gainchan, 1), dtype=bool)])
+
+    allantidx = list(range(nsum))
+    antimes = [np.array([[0., 0.], [t0, t1]]) for a in range(nsum)]
+    nphtimes = [len(ant) for ant in antimes]
+    edges = np.array_split(setup['times'], max(setup['nfiles'], 1))
+    time0 = np.array([e[0] - 1.0 for e in edges if len(e) > 0])
+    time1 = np.array([e[-1] + 1.0 for e in edges if len(e) > 0])
+    refants = np.zeros(len(time0), dtype=np.int32)
+    timeranges = np.zeros((0, 2))
+
+    return [ngainArr, NSUM, kind, gaindata, dtdata, allantidx,
+        nphtimes, antimes, refants, [time0, time1], timeranges, isLinear]
+
+
+def generate(o):
+    '''
+    Writes all the data sets into o.output.
+    '''
+    if not os.path.exists(o.output):
+        os.makedirs(o.output)
+    setup = makeSetup(nant=o.nant, nlin=o.nlin, nif=o.nif, nchan=o.nchan,
+        nint=o.nint, tint=o.tint, nfiles=o.nfiles, seed=o.seed)
+    setup['swinfiles'] = writeSWIN(setup, o.output) if o.swin else []
+    setup['idi'] = writeFITS(setup, o.output) if o.fits else ''
+    with open(os.path.join(o.output, 'bench.setup.pck'), 'wb') as f:
+        pk.dump(setup, f)
+    with open(os.path.join(o.output, 'bench.almastuff.pck'), 'wb') as f:
+        pk.dump(makeALMAstuff(setup, nsum=o.nsum, ngain=o.ngain,
+            gaindt=o.gaindt, gainchan=o.gainchan), f)
+    nvis = len(baselines(o.nant))*o.nint*o.nif
+    print('Wrote %i visibilities (%i antennas, %i IFs, %i channels) in %s' %
+        (nvis, o.nant, o.nif, o.nchan, o.output))
+
+
+if __name__ == '__main__':
+    opts = parseOptions()
+    generate(opts)
+    sys.exit(0)
+
+#
+# eof
+#
@@ -26,12 +26,92 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include <iostream>  
 #include <fstream>
 #include <cstring>
+#include <stdlib.h>
+#include <thread>
+#include <mutex>
+#include <vector>
 #include "./CalTable.h"
 #define PI 3.141592653589793
 #define TWOPI 6.283185307179586
 #include <complex>
 
-CalTable::~CalTable() {};
+
+
+// Index of the channel that fillGapsAnt (Nchan>1) would leave in auxI
+// after filling time tidx of one antenna, from the flags alone:
+static long gapIndex(const bool *flg, long Nt, long Nc, long tidx, long auxI){
+
+  long chan, first, last;
+
+// If all channels are flagged, the channels below auxI are filled first
+// (and unflagged), so the last one of them is used after that:
+  for (first=0; first<Nc; first++){if (!flg[first*Nt+tidx]){break;};};
+  if (first==Nc){return (auxI>0) ? auxI-1 : auxI;};
+  for (last=Nc-1; last>=0; last--){if (!flg[last*Nt+tidx]){break;};};
+
+  auxI = last;
+  for (chan=first+1; chan<last; chan++){
+    if (flg[chan*Nt+tidx] && !flg[(chan-1)*Nt+tidx]){auxI = chan-1;};
+  };
+  return auxI;
+
+};
+
+
+static bool allFlagged(const bool *flg, long Nt, long Nc, long tidx){
+  long chan;
+  for (chan=0; chan<Nc; chan++){if (!flg[chan*Nt+tidx]){return false;};};
+  return true;
+};
+
+
+static bool anyFlag(const bool *flg, long n){
+  long i;
+  for (i=0; i<n; i++){if (flg[i]){return true;};};
+  return false;
+};
+
+
+
+
+CalTable::~CalTable() {
+
+  int i, k;
+  if (Nants<0){return;};
+
+// A copy only owns its mapping and cursor:
+  if (isClone){
+    for (i=0; i<Nants; i++){
+      delete[] bufferGain[0][i];
+      delete[] bufferGain[1][i];
+    };
+    delete[] bufferGain[0];
+    delete[] bufferGain[1];
+    delete[] firstTime;
+    delete[] preKt;
+    delete[] pret0;
+    delete[] pret1;
+    delete[] K0;
+    delete[] I0;
+    delete[] I1;
+    delete[] InterpAmp[0];
+    return;
+  };
+
+  for (i=0; i<Nants; i++){
+    for (k=0; k<2; k++){
+      delete[] GainAmp[k][i];
+      delete[] GainPhase[k][i];
+    };
+    delete[] GainBlock[i];
+  };
+  for (k=0; k<2; k++){
+    delete[] GainAmp[k];
+    delete[] GainPhase[k];
+  };
+  delete[] GainBlock;
+
+};
 
 
 
@@ -49,13 +129,62 @@ CalTable::CalTable(int kind, FILE *logF){
   Time = new double*[1];
   Time[0] = new double[1]; Time[0][0] = 1.0;
   Verbose = false;
+  isClone = false;
+};
+
+
+
+// Copy of a table, with its own mapping and interpolation cursor. The 
+// cursor starts as if the table had been interpolated at an earlier time
+// (as in a serial conversion that reaches the times of the copy), so the 
+// copy only reports the gain changes within its own times:
+CalTable::CalTable(CalTable &parent, FILE *logF){
+
+  long auxI;
+
+  *this = parent;
+  logFile = logF;
+  isClone = true;
+  gainChanged = true;
+  currTime = HUGE_VAL;
+
+  if (Nants<0){return;};
+
+  firstTime = new bool[Nants];
+  preKt = new double[Nants];
+  pret0 = new long[Nants];
+  pret1 = new long[Nants];
+  bufferGain[0] = new std::complex<float>*[Nants];
+  bufferGain[1] = new std::complex<float>*[Nants];
+
+  for (auxI=0; auxI<Nants; auxI++) {
+    firstTime[auxI] = true;
+    pret0[auxI] = 0;
+    pret1[auxI] = 0;
+    preKt[auxI] = 1.0;
+    bufferGain[0][auxI] = new std::complex<float>[MSChan];
+    bufferGain[1][auxI] = new std::complex<float>[MSChan];
+  };
+
+  K0 = new double[MSChan];
+  I0 = new long[MSChan];
+  I1 = new long[MSChan];
+  std::memcpy(K0,parent.K0,sizeof(double)*MSChan);
+  std::memcpy(I0,parent.I0,sizeof(long)*MSChan);
+  std::memcpy(I1,parent.I1,sizeof(long)*MSChan);
+  InterpAmp[0] = new double[4*MSChan];
+  InterpAmp[1] = &InterpAmp[0][MSChan];
+  InterpPhase[0] = &InterpAmp[0][2*MSChan];
+  InterpPhase[1] = &InterpAmp[0][3*MSChan];
+
 };
 
 
 // Constructor for normal calibration table.
 CalTable::CalTable(int kind, double **R1, double **P1,double **R2,double **P2, 
                    double *freqs, double **times, int Na, long *Nt, long Nc, 
-                   bool **flag, bool islinear, FILE *logF, bool verbose)
+                   bool **flag, bool islinear, FILE *logF, bool verbose,
+                   bool wrap)
 {
 
 
@@ -67,6 +196,7 @@ CalTable::CalTable(int kind, double **R1, double **P1,double **R2,double **P2,
   logFile = logF ;
 
   Verbose = verbose;
+  isClone = false;
 
   isLinear = islinear;      
 //      isTsys = istsys;
@@ -99,13 +229,14 @@ CalTable::CalTable(int kind, double **R1, double **P1,double **R2,double **P2,
 
 
 
-  long i, j, k, auxI;
+  long i, j, auxI, nTot;
   JDRange[1] = 0.0;
   JDRange[0] = 1.e20;
   GainAmp[0] = new double**[Nants];
   GainAmp[1] = new double**[Nants];
   GainPhase[0] = new double**[Nants];
   GainPhase[1] = new double**[Nants];
+  GainBlock = new double*[Nants];
   for (i=0; i<Nants; i++){
     if (Time[i][0]<JDRange[0]){JDRange[0] = Time[i][0];};
     if (Time[i][Ntimes[i]-1]>JDRange[1]){JDRange[1] = Time[i][Ntimes[i]-1];};
@@ -113,17 +244,30 @@ CalTable::CalTable(int kind, double **R1, double **P1,double **R2,double **P2,
     GainAmp[1][i] = new double*[Nchan];
     GainPhase[0][i] = new double*[Nchan];
     GainPhase[1][i] = new double*[Nchan];
-    for (j=0; j<Nchan; j++) {
-      GainAmp[0][i][j] = new double[Ntimes[i]];
-      GainAmp[1][i][j] = new double[Ntimes[i]];
-      GainPhase[0][i][j] = new double[Ntimes[i]];
-      GainPhase[1][i][j] = new double[Ntimes[i]];
-      for (k=0; k<Ntimes[i]; k++){
-        auxI = j*Ntimes[i]+k; 
-        GainAmp[0][i][j][k] = R1[i][auxI];
-        GainAmp[1][i][j][k] = R2[i][auxI];
-        GainPhase[0][i][j][k] = P1[i][auxI];
-        GainPhase[1][i][j][k] = P2[i][auxI];
+
+// The gains are stored as [channel][time], like the input arrays. A copy
+// (one block per antenna) is only needed if the buffers are not wrapped, or
+// if fillGaps will change them:
+    nTot = Nchan*Ntimes[i];
+    if (wrap && !anyFlag(flags[i], nTot)){
+      GainBlock[i] = NULL;
+      for (j=0; j<Nchan; j++) {
+        GainAmp[0][i][j] = &R1[i][j*Ntimes[i]];
+        GainAmp[1][i][j] = &R2[i][j*Ntimes[i]];
+        GainPhase[0][i][j] = &P1[i][j*Ntimes[i]];
+        GainPhase[1][i][j] = &P2[i][j*Ntimes[i]];
+      };
+    } else {
+      GainBlock[i] = new double[4*nTot];
+      std::memcpy(&GainBlock[i][0],R1[i],sizeof(double)*nTot);
+      std::memcpy(&GainBlock[i][nTot],R2[i],sizeof(double)*nTot);
+      std::memcpy(&GainBlock[i][2*nTot],P1[i],sizeof(double)*nTot);
+      std::memcpy(&GainBlock[i][3*nTot],P2[i],sizeof(double)*nTot);
+      for (j=0; j<Nchan; j++) {
+        GainAmp[0][i][j] = &GainBlock[i][j*Ntimes[i]];
+        GainAmp[1][i][j] = &GainBlock[i][nTot + j*Ntimes[i]];
+        GainPhase[0][i][j] = &GainBlock[i][2*nTot + j*Ntimes[i]];
+        GainPhase[1][i][j] = &GainBlock[i][3*nTot + j*Ntimes[i]];
       };
     };
   };
@@ -156,6 +300,10 @@ CalTable::CalTable(int kind, double **R1, double **P1,double **R2,double **P2,
   K0 = new double[Nchan];
   I0 = new long[Nchan];
   I1 = new long[Nchan];
+  InterpAmp[0] = new double[4*Nchan];
+  InterpAmp[1] = &InterpAmp[0][Nchan];
+  InterpPhase[0] = &InterpAmp[0][2*Nchan];
+  InterpPhase[1] = &InterpAmp[0][3*Nchan];
 
   MSChan = Nchan;
   for (auxI = 0; auxI<Nchan; auxI++) {
@@ -175,17 +323,28 @@ bool CalTable::isBandpass() {
 
 
 
-// Interpolate failed frequency channels of each antenna and for each time:
+// Interpolate failed frequency channels of each antenna and for each time.
+// The antennas are filled in parallel. A first (serial) pass over the flags
+// finds, for each antenna, the state that the sequential filling would
+// have when reaching it (the leading times with all channels flagged, and
+// the last channel index used), so the result does not depend on the
+// number of threads. Antennas without flags are not touched (so wrapped
+// buffers are only read):
 void CalTable::fillGaps() {
 
-  int ant; 
-  long tidx, chan, index;
-  long auxI, auxI2;
-  double frchan;
-  bool firstflag = false; 
-  bool allflagged = true;
+  int ant, ii, nThreads, nextAnt;
+  long tidx, auxI;
+  bool lead;
+  char *nThr;
+  long *nLead = new long[Nants];
+  long *carryI = new long[Nants];
+  bool *doAnt = new bool[Nants];
+  std::string *antLog = new std::string[Nants];
+  std::vector<std::thread> Fillers;
+  std::mutex FillMutex;
 
  auxI = -1; // If all channels are flagged, no interpolation is done.
+ lead = true;
 
 /*
 //////////////////////
@@ -203,16 +362,102 @@ fclose(gainFile);
 //////////////////////
 */
 
+  for (ant=0; ant<Nants; ant++) {
+    doAnt[ant] = anyFlag(flags[ant], Ntimes[ant]*Nchan);
+    nLead[ant] = 0; carryI[ant] = auxI;
+    if (Nchan>1) {
+      for (tidx=0; tidx<Ntimes[ant]; tidx++) {
+        if (lead && allFlagged(flags[ant], Ntimes[ant], Nchan, tidx)) {
+          nLead[ant] += 1; auxI = Nchan-1;
+        } else {
+          lead = false;
+          auxI = gapIndex(flags[ant], Ntimes[ant], Nchan, tidx, auxI);
+        };
+      };
+    };
+  };
+
+  nThreads = (int) std::thread::hardware_concurrency();
+  nThr = getenv("POLCONVERT_THREADS");
+  if (nThr != NULL && atoi(nThr)>0){nThreads = atoi(nThr);};
+  if (nThreads > MAXFILLTHREADS){nThreads = MAXFILLTHREADS;};
+  if (nThreads > Nants){nThreads = Nants;};
+  if (nThreads < 1){nThreads = 1;};
+
+  nextAnt = 0;
+  for (ii=0; ii<nThreads; ii++){
+    Fillers.push_back(std::thread([&](){
+      int myAnt;
+      while (true){
+        {
+          std::lock_guard<std::mutex> lock(FillMutex);
+          if (nextAnt>=Nants){return;};
+          myAnt = nextAnt; nextAnt ++;
+        };
+        if (doAnt[myAnt]){
+          fillGapsAnt(myAnt, nLead[myAnt], carryI[myAnt], antLog[myAnt]);
+        };
+      };
+    }));
+  };
+  for (ii=0; ii<nThreads; ii++){Fillers[ii].join();};
+
+// Warnings, in the order of the antennas:
+  for (ant=0; ant<Nants; ant++) {
+    if (antLog[ant].length()>0){
+      fprintf(logFile,"%s",antLog[ant].c_str());
+      fflush(logFile);
+    };
+  };
+
+  delete[] nLead;
+  delete[] carryI;
+  delete[] doAnt;
+  delete[] antLog;
+
+/*
+//////////////////////
+// DEBUGGING CODE
+FILE *gainFile2 = fopen("GAINS.ASSESS","ab");
+fwrite(&Nchan,sizeof(int),1,gainFile2);
+   for (chan=0; chan<Nchan; chan++) {
+       fwrite(&GainAmp[0][0][chan][0],sizeof(double),1,gainFile2); 
+       fwrite(&GainAmp[1][0][chan][0],sizeof(double),1,gainFile2); 
+       fwrite(&GainPhase[0][0][chan][0],sizeof(double),1,gainFile2); 
+       fwrite(&GainPhase[1][0][chan][0],sizeof(double),1,gainFile2); 
+       fwrite(&flags[0][chan*Ntimes[0]+0],sizeof(bool),1,gainFile2);
+   };
+fclose(gainFile2);
+//////////////////////
+*/
+
+return;
+};
+
+
+
+
+// Fills the gaps of one antenna. nLead is the number of its first times
+// that are filled as "all channels flagged" (only if Nchan>1) and auxI is
+// the last channel index used before this antenna. The warnings are
+// written to log:
+void CalTable::fillGapsAnt(int ant, long nLead, long auxI, std::string &log) {
+
+  long tidx, chan, index;
+  long auxI2;
+  double frchan;
+  bool firstflag = false; 
+  bool allflagged = true;
+  char msg[512];
+
  if (Nchan==1){
-   for (ant=0; ant<Nants; ant++) {
      allflagged = true;
      for (tidx=0; tidx<Ntimes[ant]; tidx++) { if(!flags[ant][tidx]){allflagged=false;break;};};
      if (allflagged){
-       sprintf(message,"\nWARNING: ALMA ANTENNA #%i HAS ALL ITS TIMES FLAGGED!\n",ant);
-       fprintf(logFile,"%s",message);
-       sprintf(message,"SETTING ITS GAIN TO ZERO. CHECK RESULTS CAREFULLY!\n\n");
-       fprintf(logFile,"%s",message);
-       fflush(logFile);
+       sprintf(msg,"\nWARNING: ALMA ANTENNA #%i HAS ALL ITS TIMES FLAGGED!\n",ant);
+       log += msg;
+       sprintf(msg,"SETTING ITS GAIN TO ZERO. CHECK RESULTS CAREFULLY!\n\n");
+       log += msg;
        for (tidx=0; tidx<Ntimes[ant]; tidx++) {
          if(isDterm){
            GainAmp[0][ant][0][tidx] = 0.0;
@@ -274,28 +519,21 @@ fclose(gainFile);
      };
    };
   };
-  };
-
-
 
 
 
   if (Nchan>1) {
-    for (ant=0; ant<Nants; ant++) {
       for (tidx=0; tidx<Ntimes[ant]; tidx++) {
 
         index = tidx;   // REVISAR
 
-        for (chan=0; chan<Nchan; chan ++) {
-          if(!flags[ant][chan*Ntimes[ant]+index]){allflagged=false;};            // REVISAR
-        };
+        allflagged = (tidx < nLead);
 
        if (allflagged){
-         sprintf(message,"\nWARNING: ALMA ANTENNA #%i HAS ALL CHANNELS FLAGGED AT TIME #%li\n",ant,tidx);
-         fprintf(logFile,"%s",message);
-         sprintf(message,"SETTING ITS GAIN TO DUMMY. CHECK RESULTS CAREFULLY!\n\n");
-         fprintf(logFile,"%s",message);
-         fflush(logFile);
+         sprintf(msg,"\nWARNING: ALMA ANTENNA #%i HAS ALL CHANNELS FLAGGED AT TIME #%li\n",ant,tidx);
+         log += msg;
+         sprintf(msg,"SETTING ITS GAIN TO DUMMY. CHECK RESULTS CAREFULLY!\n\n");
+         log += msg;
          for (chan=0; chan<Nchan; chan ++) {
            if(isDterm){
              GainAmp[0][ant][chan][tidx] = 0.0;
@@ -366,26 +604,7 @@ fclose(gainFile);
 
  };
  };
- };
 
-
-/*
-//////////////////////
-// DEBUGGING CODE
-FILE *gainFile2 = fopen("GAINS.ASSESS","ab");
-fwrite(&Nchan,sizeof(int),1,gainFile2);
-   for (chan=0; chan<Nchan; chan++) {
-       fwrite(&GainAmp[0][0][chan][0],sizeof(double),1,gainFile2); 
-       fwrite(&GainAmp[1][0][chan][0],sizeof(double),1,gainFile2); 
-       fwrite(&GainPhase[0][0][chan][0],sizeof(double),1,gainFile2); 
-       fwrite(&GainPhase[1][0][chan][0],sizeof(double),1,gainFile2); 
-       fwrite(&flags[0][chan*Ntimes[0]+0],sizeof(bool),1,gainFile2);
-   };
-fclose(gainFile2);
-//////////////////////
-*/
-
-return;
 };
 
 
@@ -450,6 +669,7 @@ void CalTable::setMapping(long mschan, double *freqs)
   delete[] K0;
   delete[] I0;
   delete[] I1;
+  delete[] InterpAmp[0];
 
 
   for (i=0; i<Nants; i++) {
@@ -467,6 +687,10 @@ void CalTable::setMapping(long mschan, double *freqs)
   K0 = new double[mschan];
   I0 = new long[mschan];
   I1 = new long[mschan];
+  InterpAmp[0] = new double[4*mschan];
+  InterpAmp[1] = &InterpAmp[0][mschan];
+  InterpPhase[0] = &InterpAmp[0][2*mschan];
+  InterpPhase[1] = &InterpAmp[0][3*mschan];
 
   MSChan = mschan;
   double mmod;
@@ -612,11 +836,89 @@ bool CalTable::setInterpolationTime(double itime) {
  -------------------
 */
 
+// Complex gains amp*exp(i*phase) for n channels (amp==NULL means unit
+// amplitude). The phase is reduced to [-pi/4, pi/4] (in double), and sin
+// and cos are then evaluated with single-precision polynomials (Cephes
+// sinf/cosf), without branches, so that the loop is vectorized. The
+// error is at the float rounding level of the gains:
+static void polarBlock(long n, const double * __restrict__ amp,
+                       const double * __restrict__ phase,
+                       std::complex<float> *out){
+
+  static const double TWOOVERPI = 0.6366197723675814;
+  static const double PIO2A = 1.5707963267341256;   // pi/2 = PIO2A+PIO2B
+  static const double PIO2B = 6.077100506506192e-11;
+  static const double ROUNDER = 6755399441055744.0; // 1.5*2^52
+
+  float * __restrict__ re = reinterpret_cast<float*>(out);
+  long i;
+  double q, r;
+  int iq;
+  float x, x2, s, c, sw, sgc, sgs;
+
+  for (i=0; i<n; i++) {
+    q = (phase[i]*TWOOVERPI + ROUNDER) - ROUNDER;
+    r = (phase[i] - q*PIO2A) - q*PIO2B;
+    iq = (int) q;
+
+    x = (float) r; x2 = x*x;
+    s = x + x*x2*(-1.6666654611e-1f + x2*(8.3321608736e-3f + x2*(-1.9515295891e-4f)));
+    c = 1.0f - 0.5f*x2 + x2*x2*(4.166664568298827e-2f + x2*(-1.388731625493765e-3f + x2*2.443315711809948e-5f));
+
+// Quadrant: swap sin and cos for odd iq, and set the signs:
+    sw = (float) (iq & 1);
+    sgc = 1.0f - (float) (((iq+1) & 2));
+    sgs = 1.0f - (float) (iq & 2);
+    re[2*i] = sgc*(c + sw*(s - c));
+    re[2*i+1] = sgs*(s + sw*(c - s));
+  };
+
+  if (amp != NULL) {
+    for (i=0; i<n; i++) {
+      re[2*i] *= (float) amp[i];
+      re[2*i+1] *= (float) amp[i];
+    };
+  };
+
+};
+
+
+
+// Delay gains exp(i*2pi*tau*nu) at the channel centres nu = nu0+(i+0.5)*dnu
+// (GHz), for a delay (tau, ns) that is the same in all channels. The phasor
+// is advanced by a constant rotation, and set again from the exact phase
+// every DELAYBLOCK channels (so the rounding errors do not accumulate):
+static void delayRotate(long n, double tau, double nu0, double dnu,
+                        std::complex<float> *out){
+
+  static const long DELAYBLOCK = 64;
+  long i, j, iend;
+  double re, im, aux;
+  double rotRe = cos(TWOPI*tau*dnu);
+  double rotIm = sin(TWOPI*tau*dnu);
+
+  for (i=0; i<n; i += DELAYBLOCK) {
+    aux = TWOPI*tau*(((double)i + 0.5)*dnu + nu0);
+    re = cos(aux); im = sin(aux);
+    iend = (i+DELAYBLOCK < n) ? i+DELAYBLOCK : n;
+    for (j=i; j<iend; j++) {
+      out[j] = std::complex<float>((float) re, (float) im);
+      aux = re*rotRe - im*rotIm;
+      im = re*rotIm + im*rotRe;
+      re = aux;
+    };
+  };
+
+};
+
+
+
+
 void CalTable::applyInterpolation(int iant, int mode, std::complex<float> *gain[2]) {
 
   long i;
+  int k;
   long ti0, ti1;
-  double auxD;
   double Kt, Kt2;
 
   double auxF0, auxF1, auxF2, auxF3, auxT0, auxT1, auxT2, auxT3;
@@ -678,28 +980,43 @@ void CalTable::applyInterpolation(int iant, int mode, std::complex<float> *gain[
      };
 
 
+     InterpAmp[0][i] = auxF0;
+     InterpAmp[1][i] = auxF1;
+     InterpPhase[0][i] = auxF2;
+     InterpPhase[1][i] = auxF3;
+
+  };
+
+
+// Convert to complex gains (one pass per polarization):
+  for (k=0; k<2; k++) {
+
        if (isDelay){
-         auxD = TWOPI*(((double)i + 0.5)*deltaNu+deltaNu0);
-         bufferGain[0][iant][i] = (std::complex<float>) std::polar(1.0,auxF0*auxD);
-         bufferGain[1][iant][i] = (std::complex<float>) std::polar(1.0,auxF1*auxD);
+         for (i=1; i<MSChan; i++) {
+           if (InterpAmp[k][i] != InterpAmp[k][0]) {break;};
+         };
+         if (i==MSChan) {
+           delayRotate(MSChan, InterpAmp[k][0], deltaNu0, deltaNu, bufferGain[k][iant]);
+         } else {
+           for (i=0; i<MSChan; i++) {
+             InterpPhase[k][i] = InterpAmp[k][i]*TWOPI*(((double)i + 0.5)*deltaNu+deltaNu0);
+           };
+           polarBlock(MSChan, NULL, InterpPhase[k], bufferGain[k][iant]);
+         };
        } else if (isTsys) {
-         bufferGain[0][iant][i].real(1./sqrt(auxF0));
-         bufferGain[0][iant][i].imag(0.0);
-         bufferGain[1][iant][i].real(1./sqrt(auxF1));
-         bufferGain[1][iant][i].imag(0.0);
+         for (i=0; i<MSChan; i++) {
+           bufferGain[k][iant][i].real(1./sqrt(InterpAmp[k][i]));
+           bufferGain[k][iant][i].imag(0.0);
+         };
        } else if (isDterm) {
-         bufferGain[0][iant][i].real(auxF0);
-         bufferGain[0][iant][i].imag(auxF2);
-         bufferGain[1][iant][i].real(auxF1);
-         bufferGain[1][iant][i].imag(auxF3);
+         for (i=0; i<MSChan; i++) {
+           bufferGain[k][iant][i].real(InterpAmp[k][i]);
+           bufferGain[k][iant][i].imag(InterpPhase[k][i]);
+         };
        } else {
-         bufferGain[0][iant][i] = (std::complex<float>) std::polar(auxF0,auxF2);
-         bufferGain[1][iant][i] = (std::complex<float>) std::polar(auxF1,auxF3);
+         polarBlock(MSChan, InterpAmp[k], InterpPhase[k], bufferGain[k][iant]);
        };
 
-        
-
-
   };
 
   };  // Comes from if(gainChanged)
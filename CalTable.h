@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 
 #include <sys/types.h>
 #include <iostream>
+#include <string>
 #include <complex> 
 
 /* Class to read a calibration table and interpolate
@@ -34,8 +35,16 @@ class CalTable {
   // Constructor for dummy table:
      CalTable(int kind, FILE *logF);
 
-  // Consturctor for APP tables:
-     CalTable(int kind, double **R1,double **I1,double **R2,double **I2, double *freqs, double **times, int Na, long *Nt, long Nc, bool **flag, bool islinear, FILE *logF, bool verbose);
+  // Consturctor for APP tables. If wrap is true, the gain arrays (R1, I1,
+  // R2, I2) are used in place (so they must exist while the table is used),
+  // and only the antennas with flagged gains are copied:
+     CalTable(int kind, double **R1,double **I1,double **R2,double **I2, double *freqs, double **times, int Na, long *Nt, long Nc, bool **flag, bool islinear, FILE *logF, bool verbose, bool wrap=false);
+
+  // Copy that shares the gains of the parent table (which must exist while 
+  // the copy is used), but has its own frequency mapping and interpolation
+  // cursor (e.g., for another conversion thread). Its first interpolation
+  // only reports a change if the gains depend on time. It logs to logF:
+     CalTable(CalTable &parent, FILE *logF);
      ~CalTable();
      int getNant();
      long getNchan();
@@ -78,7 +87,9 @@ class CalTable {
      FILE *logFile;
      char message[512];
      void fillGaps();  // Fills flagged gains with interpolated values.
+     void fillGapsAnt(int ant, long nLead, long auxI, std::string &log);
      static const int Nmax = 256; // Maximum number of antennas.
+     static const int MAXFILLTHREADS = 64;
      std::string name;
      int Nants;
      long *Ntimes;
@@ -86,6 +97,7 @@ class CalTable {
      bool SignFreq, success;
      double ***GainAmp[2];
      double ***GainPhase[2];
+     double **GainBlock;  // Copied gains of each antenna (NULL if wrapped).
      bool **flags, *firstTime;
      double *BuffPhase[2];
      double *BuffAmp[2];
@@ -99,8 +111,10 @@ class CalTable {
      long MSChan;
      double *preKt;
      long *pret0, *pret1;
-     bool isDelay, gainChanged, isLinear, isDterm, isTsys, Verbose;
+     bool isDelay, gainChanged, isLinear, isDterm, isTsys, Verbose, isClone;
      double deltaNu0, deltaNu;
+     double *InterpAmp[2];  // Gains interpolated at the MS channels,
+     double *InterpPhase[2];  // before the conversion to complex.
      std::complex<float>** bufferGain[2];
 };
 
@@ -38,9 +38,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 
 DataIO::~DataIO() {
 
+  if (PACache != nullptr){delete[] PACache;};
+
 };
 
-DataIO::DataIO() { printf("\nCreating VLBI data structure"); nautos=0;};
+DataIO::DataIO() { printf("\nCreating VLBI data structure"); nautos=0; PACache=nullptr; Timer=nullptr;};
 
 
 // SELF-EXPLANATORY FUNCTIONS:
@@ -76,70 +78,109 @@ cplx32f DataIO::getAmpRatio(int ant, int spw, int chan){
 
 
 
-void DataIO::getParAng(int sidx, int Ant1, int Ant2, 
-        double*UVW, double &MJD, double &P1, double &P2){
+void DataIO::geometryKey(IndexCache &Index){
+
+  Index.addKey(&Geometry->NtotAnt, sizeof(int));
+  Index.addKey(&Geometry->NtotSou, sizeof(int));
+  Index.addKey(Geometry->SinDec, Geometry->NtotSou*sizeof(double));
+  Index.addKey(Geometry->CosDec, Geometry->NtotSou*sizeof(double));
+  Index.addKey(Geometry->RA, Geometry->NtotSou*sizeof(double));
+  Index.addKey(Geometry->AntLon, Geometry->NtotAnt*sizeof(double));
+  Index.addKey(Geometry->Lat, Geometry->NtotAnt*sizeof(double));
+  Index.addKey(Geometry->Mount, Geometry->NtotAnt*sizeof(int));
+
+};
 
-double GMST;
-double CT1, CT2, HAng, H1, H2, Elev1, Elev2;
 
-Elev1 = 0.0; Elev2 = 0.0;
 
-double days = MJD/86400.;
-double t = (days-51544.0)/36525.;
-double Hh = days - floor(days);
-double GMsec = 24110.54841 + 8640184.812866*t + 0.093104*t*t - 0.0000062*t*t*t;
-GMST = (GMsec/86400. + Hh)*2.*3.1415926535;
 
+void DataIO::getParAng(int sidx, int Ant1, int Ant2, 
+        double*UVW, double &MJD, double &P1, double &P2){
+
+int Ants[2] = {Ant1, Ant2};
+double P[2];
 
 // Dummy value if this is an autocorrelation:
 //if (Ant1==Ant2){P1 = -1.e9; P2 = -1.e9; return;};
 
 
+if(sidx>=0 && Ant1>=0 && Ant2>=0 && sidx<Geometry->NtotSou && Ant1<Geometry->NtotAnt && Ant2<Geometry->NtotAnt){
 
-if(sidx<Geometry->NtotSou && Ant1<Geometry->NtotAnt && Ant2<Geometry->NtotAnt){
+  getParAngs(sidx,2,Ants,MJD,P);
+  P1 = P[0];
+  P2 = P[1];
 
-  CT1 = Geometry->CosDec[sidx]*tan(Geometry->Lat[Ant1]);
-  CT2 = Geometry->CosDec[sidx]*tan(Geometry->Lat[Ant2]);
+} else {
 
+  P1 = 0.0;
+  P2 = 0.0;
 
-  HAng = GMST - Geometry->RA[sidx];
-  H1 = HAng + Geometry->AntLon[Ant1];
-  H2 = HAng + Geometry->AntLon[Ant2];
+};
 
-  if (Geometry->Mount[Ant1] > 3){
-  Elev1 = asin(sin(Geometry->Lat[Ant1])*Geometry->SinDec[sidx]+cos(Geometry->Lat[Ant1])*Geometry->CosDec[sidx]*cos(H1));};
+};
 
-  if (Geometry->Mount[Ant2] > 3){
-  Elev2 = asin(sin(Geometry->Lat[Ant2])*Geometry->SinDec[sidx]+cos(Geometry->Lat[Ant2])*Geometry->CosDec[sidx]*cos(H2));};
- 
 
-  switch (Geometry->Mount[Ant1]){
-  case 0:  P1 = atan2(sin(H1), CT1 - Geometry->SinDec[sidx]*cos(H1)); break; // ALT-AZ
-  case 1: P1 = 0.; break; // EQ
-  case 2: P1 = 0.; break; // ORBITAL (NO WAY!)
-  case 3: P1 = atan2(cos(H1), Geometry->SinDec[sidx]*sin(H1)); break; // X-Y (E-W?)
-  case 4: P1 = atan2(sin(H1), CT1 - Geometry->SinDec[sidx]*cos(H1)) + Elev1; break; // NA-R
-  case 5: P1 = atan2(sin(H1), CT1 - Geometry->SinDec[sidx]*cos(H1)) - Elev1; break; // NA-L
-  default: P1 = 0.;
 
-  };
 
-  switch (Geometry->Mount[Ant2]){
-  case 0:  P2 = atan2(sin(H2), CT2 - Geometry->SinDec[sidx]*cos(H2));  break; // ALT-AZ
-  case 1: P2 = 0.;  break; // EQ
-  case 2: P2 = 0.;  break; // ORBITAL (NO WAY!)
-  case 3: P2 = atan2(cos(H2), Geometry->SinDec[sidx]*sin(H2));  break; // X-Y (E-W?)
-  case 4: P2 = atan2(sin(H2), CT2 - Geometry->SinDec[sidx]*cos(H2)) + Elev2;  break; // NA-R
-  case 5: P2 = atan2(sin(H2), CT2 - Geometry->SinDec[sidx]*cos(H2)) - Elev2;  break; // NA-L
-  default: P2 = 0.;
+void DataIO::getParAngs(int sidx, int nAnt, int *Ants, double MJD, double *P){
 
+int i, ant;
+double HAng, H, CT, Elev;
+ParAngCache *Ant;
+
+// Precompute the trigonometry of the antenna latitudes:
+if (PACache == nullptr){
+  PACache = new ParAngCache[Geometry->NtotAnt];
+  for (i=0; i<Geometry->NtotAnt; i++){
+    PACache[i].TanLat = tan(Geometry->Lat[i]);
+    PACache[i].SinLat = sin(Geometry->Lat[i]);
+    PACache[i].CosLat = cos(Geometry->Lat[i]);
+    PACache[i].sidx = -1;
   };
+  PACacheMJD = -1.0;
+};
 
+// GMST is the same for all the antennas:
+if (MJD != PACacheMJD){
+  double days = MJD/86400.;
+  double t = (days-51544.0)/36525.;
+  double Hh = days - floor(days);
+  double GMsec = 24110.54841 + 8640184.812866*t + 0.093104*t*t - 0.0000062*t*t*t;
+  PACacheGMST = (GMsec/86400. + Hh)*2.*3.1415926535;
+  PACacheMJD = MJD;
+};
 
-} else {
+HAng = PACacheGMST - Geometry->RA[sidx];
 
-  P1 = 0.0;
-  P2 = 0.0;
+
+for (i=0; i<nAnt; i++){
+
+  ant = Ants[i];
+  Ant = &PACache[ant];
+
+  if (Ant->sidx == sidx && Ant->MJD == MJD){P[i] = Ant->P; continue;};
+
+  CT = Geometry->CosDec[sidx]*Ant->TanLat;
+  H = HAng + Geometry->AntLon[ant];
+
+  Elev = 0.0;
+  if (Geometry->Mount[ant] > 3){
+  Elev = asin(Ant->SinLat*Geometry->SinDec[sidx]+Ant->CosLat*Geometry->CosDec[sidx]*cos(H));};
+
+  switch (Geometry->Mount[ant]){
+  case 0:  P[i] = atan2(sin(H), CT - Geometry->SinDec[sidx]*cos(H)); break; // ALT-AZ
+  case 1: P[i] = 0.; break; // EQ
+  case 2: P[i] = 0.; break; // ORBITAL (NO WAY!)
+  case 3: P[i] = atan2(cos(H), Geometry->SinDec[sidx]*sin(H)); break; // X-Y (E-W?)
+  case 4: P[i] = atan2(sin(H), CT - Geometry->SinDec[sidx]*cos(H)) + Elev; break; // NA-R
+  case 5: P[i] = atan2(sin(H), CT - Geometry->SinDec[sidx]*cos(H)) - Elev; break; // NA-L
+  default: P[i] = 0.;
+
+  };
+
+  Ant->sidx = sidx;
+  Ant->MJD = MJD;
+  Ant->P = P[i];
 
 };
 
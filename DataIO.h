@@ -29,6 +29,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include <math.h>
 #include <complex>
 #include "fitsio.h"
+#include "IndexCache.h"
+#include "Timing.h"
 
 #ifndef __DATAIO_H__
 #define __DATAIO_H__
@@ -58,16 +60,23 @@ int **BasNum;
 } ArrayGeometry;
 
 
+// Running sums of the autocorrelation amplitudes of one antenna and IF
+// (index 0 for XX and 1 for YY):
 typedef struct {
-    int AntIdx;
-    int IF;
-    int Pol;
-    double JD;
-    double *AC;
-    
+    double N[2];
+    double *AC[2];
 } AutoCorrelation;
 
 
+// Per-antenna trigonometry of the latitude and the last parallactic
+// angle computed for the antenna (for time MJD and source sidx):
+typedef struct {
+    double TanLat, SinLat, CosLat;
+    double MJD, P;
+    int sidx;
+} ParAngCache;
+
+
 //   int NtotAnt, NtotSou;
 //  double *BaseLine[3], *SinDec, *CosDec, *AntLon, *TanLat, **BasNum;
 //   double *ParAngs[2];
@@ -97,6 +106,14 @@ class DataIO {
 // Compute parallactic angle.
   void getParAng(int sidx, int Ant1, int Ant2, double*UVW, double &MJD, double &P1, double &P2);
 
+// Compute the parallactic angles of nAnt antennas (for one source and time).
+// The last value of each antenna is cached, so the visibilities of all the
+// baselines in one integration only compute it once:
+  void getParAngs(int sidx, int nAnt, int *Ants, double MJD, double *P);
+
+// Add the array geometry (used for the parangs) to the key of an index file:
+  void geometryKey(IndexCache &Index);
+
 // Estimate amplitude ratios from the autocorrelations:
   std::complex<float> getAmpRatio(int ant, int spw, int chan);
   
@@ -139,11 +156,13 @@ class DataIO {
    static const int MAXIF = 256;
    FreqSetup *Freqs;
    ArrayGeometry *Geometry;
-   AutoCorrelation *AutoCorrs;
+   AutoCorrelation **AutoCorrs;
    float ***averAutocorrs;
    double *Freqvals[MAXIF], *doRange, *JDTimes;
    int *Basels, *Freqids, *an1, *an2, *linAnts, *field; //, *sour;
    double *ParAng[2];
+   ParAngCache *PACache;
+   double PACacheMJD, PACacheGMST;
    double *UVDist;
    int NLinAnt, NIFs, Nband, status, Nants, Nfreqs, currFreq;
    long NLinVis, Nvis, currVis, *indexes;
@@ -153,6 +172,9 @@ class DataIO {
    int nautos;
    double day0;
 
+// Stage timers and counters (owned by the caller):
+   Timing *Timer;
+
 
 };
 
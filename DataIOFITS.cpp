@@ -72,10 +72,11 @@ to exist already (it will not make a new one).
 */
 DataIOFITS::DataIOFITS(std::string outputfile, int NlinAnt, int *LinAnt, 
          double *Range, bool Overwrite, bool doConj, bool doSave, int saveSource, 
-         ArrayGeometry *Geom, bool doPar, FILE *logF) {
+         ArrayGeometry *Geom, bool doPar, FILE *logF, Timing *timer) {
 
 
   logFile = logF ;
+  Timer = timer;
   doWriteCirc = doSave;
   doParang = doPar;
   int i, j, k;
@@ -121,8 +122,9 @@ DataIOFITS::DataIOFITS(std::string outputfile, int NlinAnt, int *LinAnt,
 ////////////////////////////////////
 // OPEN FILES, READ DATA, AND FIND OUT
 // ALL THE VISIBILITIES TO BE CORRECTED
+  Timer->start(Timing::HEADER);
   readInput(outputfile,saveSource);
-  if (!success){return;};
+  if (!success){Timer->stop(Timing::HEADER); return;};
 
   openOutFile(outputfile, Overwrite);
 
@@ -131,6 +133,8 @@ DataIOFITS::DataIOFITS(std::string outputfile, int NlinAnt, int *LinAnt,
     fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
     saveCirculars(outputfile);
   };
+  Timer->stop(Timing::HEADER);
+  Timer->count(Timing::RECORDS,Nvis);
 
 
 //  Prepare memory for average autocorrs:
@@ -544,7 +548,22 @@ void DataIOFITS::readInput(std::string inputfile, int saveSource) {
   NVis2Save = 0;
 
 
-  for (il=0;il<Nvis;il++){
+// Use the index of a previous run, if valid:
+  IndexCache Index(inputfile, logFile);
+  Index.addKey(&NLinAnt, sizeof(int));
+  Index.addKey(linAnts, NLinAnt*sizeof(int));
+  Index.addKey(doRange, 2*sizeof(double));
+  Index.addKey(&saveSource, sizeof(int));
+  Index.addKey(&Nvis, sizeof(long));
+  geometryKey(Index);
+  bool fromIndex = Index.openRead() && loadIndex(Index);
+  if (fromIndex){
+    sprintf(message,"Read %li mixed-pol visibilities from index.\n",NLinVis);
+    fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
+  };
+
+
+  for (il=0;il<Nvis && !fromIndex;il++){
 
 // READ CURRENT VISIBIITY METADATA:
     fits_read_col(fptr, TINT, ii, il+1, 1, 1, NULL, &Basels[il], &auxI, &status);
@@ -627,7 +646,10 @@ void DataIOFITS::readInput(std::string inputfile, int saveSource) {
 
 
 // Reference day for AIPS:
-  day0 = Dates[0];
+  if (!fromIndex){
+    day0 = Dates[0];
+    saveIndex(Index);
+  };
 
   fits_close_file(fptr, &status);
   if (status){
@@ -647,6 +669,76 @@ return;
 
 
 
+// Save (or load) the results of the loop over the visibilities in readInput:
+void DataIOFITS::saveIndex(IndexCache &Index){
+
+  if (!Index.openWrite()){return;};
+
+  Index.write(&NLinVis, sizeof(long));
+  Index.write(&NVis2Save, sizeof(long));
+  Index.write(&day0, sizeof(double));
+  Index.write(Basels, Nvis*sizeof(int));
+  Index.write(Times, Nvis*sizeof(double));
+  Index.write(an1, NLinVis*sizeof(int));
+  Index.write(an2, NLinVis*sizeof(int));
+  Index.write(field, NLinVis*sizeof(int));
+  Index.write(indexes, NLinVis*sizeof(long));
+  Index.write(JDTimes, NLinVis*sizeof(double));
+  Index.write(ParAng[0], NLinVis*sizeof(double));
+  Index.write(ParAng[1], NLinVis*sizeof(double));
+  Index.write(UVDist, NLinVis*sizeof(double));
+  Index.write(is1orig, NLinVis*sizeof(bool));
+  Index.write(is2orig, NLinVis*sizeof(bool));
+  Index.write(Vis2Save, NVis2Save*sizeof(long));
+
+  Index.close();
+
+};
+
+
+
+bool DataIOFITS::loadIndex(IndexCache &Index){
+
+  bool isOK;
+
+  isOK = Index.read(&NLinVis, sizeof(long));
+  isOK = isOK && Index.read(&NVis2Save, sizeof(long));
+  isOK = isOK && NLinVis>=0 && NLinVis<=Nvis && NVis2Save>=0 && NVis2Save<=Nvis;
+  isOK = isOK && Index.read(&day0, sizeof(double));
+  isOK = isOK && Index.read(Basels, Nvis*sizeof(int));
+  isOK = isOK && Index.read(Times, Nvis*sizeof(double));
+  isOK = isOK && Index.read(an1, NLinVis*sizeof(int));
+  isOK = isOK && Index.read(an2, NLinVis*sizeof(int));
+  isOK = isOK && Index.read(field, NLinVis*sizeof(int));
+  isOK = isOK && Index.read(indexes, NLinVis*sizeof(long));
+  isOK = isOK && Index.read(JDTimes, NLinVis*sizeof(double));
+  isOK = isOK && Index.read(ParAng[0], NLinVis*sizeof(double));
+  isOK = isOK && Index.read(ParAng[1], NLinVis*sizeof(double));
+  isOK = isOK && Index.read(UVDist, NLinVis*sizeof(double));
+  isOK = isOK && Index.read(is1orig, NLinVis*sizeof(bool));
+  isOK = isOK && Index.read(is2orig, NLinVis*sizeof(bool));
+  isOK = isOK && Index.read(Vis2Save, NVis2Save*sizeof(long));
+
+  Index.close();
+
+  if (!isOK){
+    NLinVis = 0; NVis2Save = 0;
+    for (long il=0; il<2*Nvis; il++){
+      is1orig[il]=false;  is2orig[il]=false;
+    };
+  };
+
+  return isOK;
+
+};
+
+
+
+
+
+
+
+
 // SET IF TO CHANGE:
 bool DataIOFITS::setCurrentIF(int i){
 
@@ -751,6 +843,8 @@ bool DataIOFITS::getNextMixedVis(double &JDTime, int &antenna, int &otherAnt, bo
 
   if (NLinVis==0){return false;};
 
+  Timer->start(Timing::READ);
+
   while (true) {
     
     curridx = indexes[currVis];
@@ -813,6 +907,9 @@ bool DataIOFITS::getNextMixedVis(double &JDTime, int &antenna, int &otherAnt, bo
   };
 
 
+  if (found){Timer->count(Timing::BYTESREAD,dsize*Nentry*sizeof(float));};
+  Timer->stop(Timing::READ);
+
   if (status){
     sprintf(message,"\n\nPROBLEM ACCESSING VISIBILITY DATA!  ERR: %i\n\n",status);
     fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
@@ -844,7 +941,10 @@ bool DataIOFITS::setCurrentMixedVis() {
    };
 ////////////////////
 
+   Timer->start(Timing::WRITE);
    fits_write_col(ofile, TFLOAT, Flux, curridx+1, dsize*jump+1, dsize*Nentry, currentData, &status); 
+   Timer->stop(Timing::WRITE);
+   Timer->count(Timing::BYTESWRITTEN,dsize*Nentry*sizeof(float));
 
    if (status){
      sprintf(message,"\n\nPROBLEM WRITING VISIBILITY DATA!  ERR: %i\n\n",status);
@@ -872,6 +972,8 @@ void DataIOFITS::applyMatrix(std::complex<float> *M[2][2], bool swap,
   long k, a11, a12, a21, a22, ca11, ca12, ca21, ca22 ;
   std::complex<float>  auxVis;
 
+  Timer->start(Timing::APPLY);
+
   for (k=0; k<Freqs[currFreq].Nchan; k++) {
 
     a11 = k*4;
@@ -910,10 +1012,29 @@ void DataIOFITS::applyMatrix(std::complex<float> *M[2][2], bool swap,
       };
 
     };
+ };
+
+  Timer->stop(Timing::APPLY);
+
+
+// Write the plot (or solve) file:
+  int zero = 0;
 
-   int zero = 0;
+  if (print && canPlot) {
 
-   if (print && canPlot) {
+  Timer->start(Timing::PLOT);
+
+  for (k=0; k<Freqs[currFreq].Nchan; k++) {
+
+    a11 = k*4;
+    a22 = a11+1;
+    a12 = a11+2;
+    a21 = a11+3;
+
+    ca11 = k*4;
+    ca22 = ca11+1;
+    ca12 = ca11+2;
+    ca21 = ca11+3;
 
      if (currConj){
      if (k==0){
@@ -973,8 +1094,12 @@ void DataIOFITS::applyMatrix(std::complex<float> *M[2][2], bool swap,
      fwrite(&auxVis,sizeof(std::complex<float>),1,plotFile);
      };
 
-   };
  };
 
+  Timer->stop(Timing::PLOT);
+  Timer->count(Timing::PLOTRECORDS,1);
+
+  };
+
 };
 
@@ -42,7 +42,7 @@ class DataIOFITS: public DataIO {
 
    ~DataIOFITS();
 
-   DataIOFITS(std::string outputfile, int Nant, int *Ants, double *doRange, bool Overwrite, bool doConj, bool doSolve, int saveSource, ArrayGeometry *Geom, bool doPar, FILE *logF);
+   DataIOFITS(std::string outputfile, int Nant, int *Ants, double *doRange, bool Overwrite, bool doConj, bool doSolve, int saveSource, ArrayGeometry *Geom, bool doPar, FILE *logF, Timing *timer);
 
    bool setCurrentIF(int i);
 
@@ -81,6 +81,10 @@ class DataIOFITS: public DataIO {
     void openOutFile(std::string outputfile, bool Overwrite);   
     void saveCirculars(std::string inputfile);   
 
+// Sidecar index (metadata and parangs of the mixed-pol visibilities):
+    bool loadIndex(IndexCache &Index);
+    void saveIndex(IndexCache &Index);
+
     fitsfile *fptr, *ofile; 
     FILE *logFile ;
     long *Vis2Save;
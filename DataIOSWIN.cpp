@@ -26,7 +26,31 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include <string.h>
 #include <math.h>
 #include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <thread>
+#include <condition_variable>
+#include <vector>
 #include "./DataIOSWIN.h"
+#include "./SlidingMedian.h"
+
+
+// Pol labels (as coded in the Flags of the records):
+static const char POLCHARS[] = "RLXY";
+
+
+// Resize an array with realloc. On failure, the old array is kept (so
+// that it can still be freed) and false is returned:
+template <typename T> static bool resizeArray(T *&Array, long size){
+  T *aux = (T *) realloc(Array, size*sizeof(T));
+  if (aux == nullptr){return false;};
+  Array = aux;
+  return true;
+};
 
 
 
@@ -36,30 +60,27 @@ DataIOSWIN::~DataIOSWIN() {
 
   int i, j; 
   
-  free(Records);
-  free(ParAng[0]);
-  free(ParAng[1]);
-  free(is1orig);
-  free(is2orig);
-  free(is1);
-  free(is2);
-  free(UVDist);
-  for (i=0; i<nautos; i++){
-    delete[] AutoCorrs[i].AC;
-  };
-  free(AutoCorrs);
+  stopPipeline();
+  closeDirect();
+  freeRecords();
+  for (i=0; i<NLinAnt; i++){
+    for (j=0; j<Nfreqs; j++){
+      delete[] AutoCorrs[i][j].AC[0];
+      delete[] AutoCorrs[i][j].AC[1];
+    };
+    delete[] AutoCorrs[i];
+  };
+  delete[] AutoCorrs;
+  delete[] swinNames;
   
   delete[] linAnts;
   delete[] NAV;
   delete[] Freqs;
-  delete[] is1;
-  delete[] is2;
-  delete[] UVDist;
 
   for (i=0; i<4; i++){
-    delete[] currentVis[i];
-    delete[] bufferVis[i];
-    delete[] auxVis[i];
+    delete[] Main.currentVis[i];
+    delete[] Main.bufferVis[i];
+    delete[] Main.auxVis[i];
   };
 
   for(i=0; i<NLinAnt;i++){
@@ -80,7 +101,7 @@ DataIOSWIN::DataIOSWIN(int nfiledifx, std::string* difxfiles, int NlinAnt,
 	 int *IF2Conv, int IFoffset, int Afilt, int *NchanAC, 
          double **FreqVal, bool Overwrite, bool doTest, bool doSolve, 
          int saveSource, double jd0, ArrayGeometry *Geom, bool doPar, 
-	 FILE *logF) {
+	 FILE *logF, Timing *timer) {
 
 
   doWriteCirc = doSolve;
@@ -94,10 +115,10 @@ DataIOSWIN::DataIOSWIN(int nfiledifx, std::string* difxfiles, int NlinAnt,
 
   doParang = doPar;
   logFile = logF;
+  Timer = timer;
   Geometry = Geom;
 
 
-  isTwoLinear = false;
   success = true;
   NLinAnt = NlinAnt;
   linAnts = new int[NlinAnt];
@@ -109,16 +130,19 @@ DataIOSWIN::DataIOSWIN(int nfiledifx, std::string* difxfiles, int NlinAnt,
     NAV[i] = NchanAC[i];
   };
 
-  AutoCorrs = (AutoCorrelation *) malloc(RECBUFFER*sizeof(AutoCorrelation));
-  Records = (Record *) malloc(RECBUFFER*sizeof(Record)); 
-  is1orig =  (bool *) malloc(RECBUFFER*sizeof(bool)); 
-  is2orig = (bool *) malloc(RECBUFFER*sizeof(bool)); 
-  ParAng[0] = (double *) malloc(RECBUFFER*sizeof(double));  
-  ParAng[1] = (double *) malloc(RECBUFFER*sizeof(double)); 
-  UVDist = (double *) malloc(RECBUFFER*sizeof(double));
+// The parangs and UV distances are kept in the (packed) records:
+  ParAng[0] = nullptr; ParAng[1] = nullptr; UVDist = nullptr;
 
-  is1 = new bool[RECBUFFER];
-  is2 = new bool[RECBUFFER];
+// The linear-pol flags are kept in the (packed) records:
+  is1 = nullptr; is2 = nullptr; is1orig = nullptr; is2orig = nullptr;
+
+  Records = nullptr; RecSpill = -1; nRecSpill = 0;
+  RecBases = nullptr; RecFiles = nullptr; RecTimes = nullptr;
+  nRecBases = 0; nRecTimes = 0;
+
+  RecMemory = RECMEMORY;
+  char *recMem = getenv("POLCONVERT_RECMEM");
+  if (recMem != NULL && atol(recMem)>0){RecMemory = atol(recMem)*1024L*1024L;};
 
   day0 = jd0 ;
   // set true in setCurrentIF() to capture some first time stuff
@@ -129,12 +153,17 @@ DataIOSWIN::DataIOSWIN(int nfiledifx, std::string* difxfiles, int NlinAnt,
 
   doRange = Range;
 
-  isAutoCorr = false;
+  scanRec = 0;
+  isPipelined = false; PipeStop = false; WriterDone = false; ReadDone = false;
+  ReadStarted = false;
+  PipeFailed = false;
+  PipeDepth = 0; PipeFiles = nullptr; ReadRing = nullptr; WriteRing = nullptr;
+  ReadHead = 0; ReadTail = 0; WriteHead = 0; WriteTail = 0;
 
 
 // READ FREQUENCIES FOR ALL IFs:
   Nfreqs = nIF;
-  int MaxNChan = 0;
+  MaxNChan = 0;
   Freqs = new FreqSetup[Nfreqs];
   for(i=0;i<nIF;i++){
     if (nChan[i]>MaxNChan){MaxNChan = nChan[i];};
@@ -147,18 +176,40 @@ DataIOSWIN::DataIOSWIN(int nfiledifx, std::string* difxfiles, int NlinAnt,
   };
 
 
+// Autocorrelation sums (filled in while reading the header). Note that 
+// they are indexed with the antenna id (minus one), as in getAmpRatio:
+  AutoCorrs = new AutoCorrelation*[NLinAnt];
+  for(i=0;i<NLinAnt;i++){
+    AutoCorrs[i] = new AutoCorrelation[Nfreqs];
+    for(j=0;j<Nfreqs;j++){
+      AutoCorrs[i][j].N[0] = 0.; AutoCorrs[i][j].N[1] = 0.;
+      AutoCorrs[i][j].AC[0] = new double[nChan[j]];
+      AutoCorrs[i][j].AC[1] = new double[nChan[j]];
+      memset(AutoCorrs[i][j].AC[0],0,nChan[j]*sizeof(double));
+      memset(AutoCorrs[i][j].AC[1],0,nChan[j]*sizeof(double));
+    };
+  };
+
+
   for (i=0; i<4; i++){
-    currentVis[i] = new std::complex<float>[MaxNChan+1];
-    bufferVis[i] = new std::complex<float>[MaxNChan+1];
-    auxVis[i] = new std::complex<float>[MaxNChan+1];
+    Main.currentVis[i] = new std::complex<float>[MaxNChan+1];
+    Main.bufferVis[i] = new std::complex<float>[MaxNChan+1];
+    Main.auxVis[i] = new std::complex<float>[MaxNChan+1];
   };
+  Main.isAutoCorr = false; Main.isTwoLinear = false; Main.isBlock = false;
+  Main.V.Rec = 0; Main.V.CanPlot = false; Main.V.Conj = false;
+  for (i=0; i<4; i++){Main.V.Entries[i] = -1;};
+  Main.Timer = Timer;
 
   isOverWrite = Overwrite ;
 
   openOutFiles(difxfiles);
 
   printf("\nReading header.\n");fflush(stdout);
+  Timer->start(Timing::HEADER);
   readHeader(doTest,saveSource);
+  Timer->stop(Timing::HEADER);
+  Timer->count(Timing::RECORDS,nrec);
   printf("DONE.\n");fflush(stdout);
 
   
@@ -168,7 +219,11 @@ DataIOSWIN::DataIOSWIN(int nfiledifx, std::string* difxfiles, int NlinAnt,
     averAutocorrs[i] = new float*[Nfreqs];
     for(j=0; j<Nfreqs; j++){averAutocorrs[i][j] = new float[Freqs[j].Nchan];};    
   };
+  Timer->start(Timing::AUTOCORR);
   averageAutocorrs();
+  Timer->stop(Timing::AUTOCORR);
+
+  if (success){startPipeline();};
   
 };
 
@@ -177,85 +232,73 @@ DataIOSWIN::DataIOSWIN(int nfiledifx, std::string* difxfiles, int NlinAnt,
 
 
 
-double getMedian(double *X, int n0, int N){
-
-  int i,j,Nmed;
-  double Aux;
+// Median of a window of N values, as taken for the autocorrelations
+// (for odd N, the mean of the two values below and at the center).
+// Median has been reset to N/2:
+double getMedian(SlidingMedian &Median, int N){
 
-  if(N==1){return X[n0];};
-
-  double *Sorted = new double[N];
-  for(i=0; i<N; i++){Sorted[i] = X[i+n0];};
-
-  for(i=0;i<N-1;i++){
-    for(j=i+1; j<N; j++){
-      if(Sorted[i]>Sorted[j]){Aux = Sorted[i]; Sorted[i]=Sorted[j]; Sorted[j] = Aux;};
-    };	    
-  };	  
+  if(N==1){return Median.upper();};
 
   if(N%2){
-    Nmed = N/2 -1; 
-    return (Sorted[Nmed] + Sorted[Nmed+1])/2.;
+    return (Median.lower() + Median.upper())/2.;
   } else {
-    Nmed = (N+1)/2 -1;
-    return Sorted[Nmed];
-  };	  
+    return Median.lower();
+  };
 
-};	
+};
 
 
 
 
 void DataIOSWIN::averageAutocorrs(){
   
-   int i, j, k,l, l2, NHf;
-   double Nx, Ny;
-   double *TempX, *TempY;
+   int i, j, l, l2, NHf, lEdge, lLast;
+   double Nx, Ny, Med;
+   double *TempX, *SumX, *SumY;
+   SlidingMedian Median(0);
    
    for(i=0;i<NLinAnt;i++){    
 	   
      for(j=0; j<Nfreqs; j++){	    
 	     
        TempX = new double[Freqs[j].Nchan]; 
-       TempY = new double[Freqs[j].Nchan]; 
-       for(k=0; k<Freqs[j].Nchan; k++){
-	 TempX[k] = 0.0; TempY[k] = 0.0;      
-       };
-       Nx = 0. ; Ny = 0.;
-       for(k=0; k<nautos;k++){
-         if(AutoCorrs[k].AntIdx == i && AutoCorrs[k].IF == j){
-           if (AutoCorrs[k].Pol == 1){
-	      Nx += 1.;	   
-              for(l=0; l<Freqs[j].Nchan; l++){		      
-		 TempX[l] += AutoCorrs[k].AC[l]; 
-	      };
-	   };    
-           if (AutoCorrs[k].Pol == 2){
-              Ny += 1.;		   
-              for(l=0; l<Freqs[j].Nchan; l++){		   	    
-		TempY[l] += AutoCorrs[k].AC[l]; 
-	      };
-	   };   
-         
-	 };
-                   
-       };
+       SumX = AutoCorrs[i][j].AC[0];
+       SumY = AutoCorrs[i][j].AC[1];
+       Nx = AutoCorrs[i][j].N[0];
+       Ny = AutoCorrs[i][j].N[1];
        
-       if(NAV[i]>0 && Nx > 0. && Ny > 0.){
+       if(NAV[i]>0 && NAV[i]<Freqs[j].Nchan && Nx > 0. && Ny > 0.){
        	   NHf = NAV[i]/2;
 
            for(l=0; l<Freqs[j].Nchan; l++){
-             TempX[l] = std::sqrt(TempY[l]/TempX[l]*Nx/Ny);
+             TempX[l] = std::sqrt(SumY[l]/SumX[l]*Nx/Ny);
            };
-	   for(l=0; l< NHf; l++){
-	     averAutocorrs[i][j][l] = getMedian(TempX,0,NAV[i]);
-             l2 = Freqs[j].Nchan - l -1;
-	     averAutocorrs[i][j][l2] = getMedian(TempX,Freqs[j].Nchan-NAV[i]-1,NAV[i]);
-	   };
 
-	   for(l=NHf; l< Freqs[j].Nchan - NHf; l++){
-	     l2 = l - NHf;   
-	     averAutocorrs[i][j][l] = getMedian(TempX,l2,NAV[i]);
+// Slide the window (starting at channel l2) across the IF. The edge 
+// channels take the medians of the first window and of the one 
+// starting at Nchan-NAV-1:
+           lEdge = Freqs[j].Nchan - NAV[i] - 1;
+           lLast = Freqs[j].Nchan - 2*NHf - 1;
+           if (lEdge > lLast){lLast = lEdge;};
+
+           Median.reset(NAV[i]/2);
+           for(l=0; l<NAV[i]; l++){Median.add(TempX[l]);};
+
+           for(l2=0; l2<=lLast; l2++){
+             if (l2>0){
+               Median.remove(TempX[l2-1]);
+               Median.add(TempX[l2+NAV[i]-1]);
+             };
+             Med = getMedian(Median,NAV[i]);
+
+             if (l2==0){
+               for(l=0; l< NHf; l++){averAutocorrs[i][j][l] = Med;};
+             };
+             if (l2==lEdge){
+               for(l=0; l< NHf; l++){averAutocorrs[i][j][Freqs[j].Nchan - l -1] = Med;};
+             };
+             l = l2 + NHf;
+             if (l < Freqs[j].Nchan - NHf){averAutocorrs[i][j][l] = Med;};
 	   };
        } else {
            for(l=0; l<Freqs[j].Nchan; l++){
@@ -263,7 +306,6 @@ void DataIOSWIN::averageAutocorrs(){
            };
        };
        delete[] TempX;
-       delete[] TempY;
      };    
    };
     
@@ -279,9 +321,384 @@ void DataIOSWIN::averageAutocorrs(){
 
 
 
+// Access to the packed records:
+long DataIOSWIN::recByteIni(long rec){
+  return RecBases[Records[rec].Base] + (long) Records[rec].Offset;
+};
+
+long DataIOSWIN::recByteEnd(long rec){
+  return recByteIni(rec) + (Freqs[Records[rec].freqIndex].Nchan)*sizeof(cplx32f);
+};
+
+int DataIOSWIN::recFile(long rec){
+  return RecFiles[Records[rec].Base];
+};
+
+double DataIOSWIN::recTime(long rec){
+  return RecTimes[Records[rec].TimeIdx];
+};
+
+char DataIOSWIN::recPol(long rec, int i){
+  return POLCHARS[(Records[rec].Flags >> (2*i)) & 3];
+};
+
+bool DataIOSWIN::recFlag(long rec, unsigned char flag){
+  return (Records[rec].Flags & flag) != 0;
+};
+
+void DataIOSWIN::setRecFlag(long rec, unsigned char flag, bool value){
+  if (value){Records[rec].Flags |= flag;} else {Records[rec].Flags &= ~flag;};
+};
+
+
+
+
+// Grow the records to newSize. Beyond RecMemory, the records are moved to 
+// a temporary file in the working directory (unlinked right away, so it 
+// disappears with the process) that is mapped in memory:
+bool DataIOSWIN::growRecords(long newSize){
+
+  Record *newRecords;
+  size_t newBytes = newSize*sizeof(Record);
+
+  if (RecSpill<0 && (long) newBytes <= RecMemory){
+    newRecords = (Record *) realloc(Records, newBytes);
+    if (newRecords == NULL){return false;};
+    Records = newRecords;
+    return true;
+  };
+
+  if (RecSpill<0){
+    char spillName[] = "POLCONVERT_RECORDS_XXXXXX";
+    RecSpill = mkstemp(spillName);
+    if (RecSpill<0){return false;};
+    unlink(spillName);
+    sprintf(message,"\n Record index is larger than %li MB. Moving it to disk.\n",RecMemory/(1024*1024));
+    fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
+  };
+
+  if (ftruncate(RecSpill, newBytes) != 0){return false;};
+  newRecords = (Record *) mmap(NULL, newBytes, PROT_READ | PROT_WRITE, MAP_SHARED, RecSpill, 0);
+  if (newRecords == MAP_FAILED){return false;};
+
+  if (nRecSpill>0){
+    munmap(Records, nRecSpill*sizeof(Record));
+  } else if (Records != NULL){
+    memcpy(newRecords, Records, nrec*sizeof(Record));
+    free(Records);
+  };
+
+  Records = newRecords;
+  nRecSpill = newSize;
+  return true;
+
+};
+
+
+
+void DataIOSWIN::freeRecords(){
+
+  if (RecSpill>=0){
+    if (nRecSpill>0){munmap(Records, nRecSpill*sizeof(Record));};
+    close(RecSpill);
+  } else {
+    free(Records);
+  };
+  Records = nullptr; RecSpill = -1; nRecSpill = 0;
+
+  free(RecBases); free(RecFiles); free(RecTimes);
+  RecBases = nullptr; RecFiles = nullptr; RecTimes = nullptr;
+  nRecBases = 0; nRecTimes = 0;
+
+};
+
+
+
+
+
+// Parameters that the records of a SWIN file depend on:
+void DataIOSWIN::indexKey(IndexCache &Index){
+
+  int i, recSize = sizeof(Record);
+
+  Index.addKey(&recSize, sizeof(int));
+  Index.addKey(&NLinAnt, sizeof(int));
+  Index.addKey(linAnts, NLinAnt*sizeof(int));
+  Index.addKey(&nDoIF, sizeof(int));
+  Index.addKey(DoIF, nDoIF*sizeof(int));
+  Index.addKey(&IFOffset, sizeof(int));
+  Index.addKey(doRange, 2*sizeof(double));
+  Index.addKey(&day0, sizeof(double));
+  Index.addKey(&Nfreqs, sizeof(int));
+  for (i=0; i<Nfreqs; i++){
+    Index.addKey(&Freqs[i].Nchan, sizeof(int));
+  };
+
+  geometryKey(Index);
+
+};
+
+
+
+// Save the records of a file (their parangs are recomputed when the 
+// records are appended):
+void DataIOSWIN::saveIndex(IndexCache &Index, SWINFile &File){
+
+  int i, j;
+
+  if (!Index.openWrite()){return;};
+
+  Index.write(&File.nrec, sizeof(long));
+  Index.write(&File.nBases, sizeof(long));
+  Index.write(&File.nTimes, sizeof(long));
+  Index.write(&File.nAutos, sizeof(long));
+
+  Index.write(File.Records, File.nrec*sizeof(Record));
+  Index.write(File.Bases, File.nBases*sizeof(long));
+  Index.write(File.Times, File.nTimes*sizeof(double));
+
+  for (i=0; i<NLinAnt; i++){
+    for (j=0; j<Nfreqs; j++){
+      Index.write(File.AutoCorrs[i][j].N, 2*sizeof(double));
+      Index.write(File.AutoCorrs[i][j].AC[0], Freqs[j].Nchan*sizeof(double));
+      Index.write(File.AutoCorrs[i][j].AC[1], Freqs[j].Nchan*sizeof(double));
+    };
+  };
+
+  Index.close();
+
+};
+
+
+
+// Read the records of file fileIdx from its index. If the records 
+// are to be converted, the pol labels are also written to the file 
+// (as it would be done while reading the header):
+bool DataIOSWIN::loadIndex(IndexCache &Index, int fileIdx, bool doTest, SWINFile &File){
+
+  long rec, polpos;
+  int i, j, k;
+  bool isOK;
+  char pol[2];
+
+  isOK = Index.read(&File.nrec, sizeof(long));
+  isOK = isOK && Index.read(&File.nBases, sizeof(long));
+  isOK = isOK && Index.read(&File.nTimes, sizeof(long));
+  isOK = isOK && Index.read(&File.nAutos, sizeof(long));
+  isOK = isOK && File.nrec>=0 && File.nTimes>=0 && File.nBases>=0 && File.nBases<=65536;
+
+  if (isOK && File.nrec > File.RecSize){
+    isOK = resizeArray(File.Records, File.nrec);
+    if (isOK){File.RecSize = File.nrec;};
+  };
+  if (isOK && File.nBases > File.BaseSize){
+    isOK = resizeArray(File.Bases, File.nBases);
+    if (isOK){File.BaseSize = File.nBases;};
+  };
+  if (isOK && File.nTimes > File.TimeSize){
+    isOK = resizeArray(File.Times, File.nTimes);
+    if (isOK){File.TimeSize = File.nTimes;};
+  };
+
+  isOK = isOK && Index.read(File.Records, File.nrec*sizeof(Record));
+  isOK = isOK && Index.read(File.Bases, File.nBases*sizeof(long));
+  isOK = isOK && Index.read(File.Times, File.nTimes*sizeof(double));
+
+  for (i=0; i<NLinAnt; i++){
+    for (j=0; j<Nfreqs; j++){
+      isOK = isOK && Index.read(File.AutoCorrs[i][j].N, 2*sizeof(double));
+      isOK = isOK && Index.read(File.AutoCorrs[i][j].AC[0], Freqs[j].Nchan*sizeof(double));
+      isOK = isOK && Index.read(File.AutoCorrs[i][j].AC[1], Freqs[j].Nchan*sizeof(double));
+    };
+  };
+
+  for (rec=0; isOK && rec<File.nrec; rec++){
+    isOK = File.Records[rec].Base < File.nBases && File.Records[rec].TimeIdx < File.nTimes && 
+           File.Records[rec].freqIndex < Nfreqs;
+  };
+
+  Index.close();
+
+  if (!isOK){
+    File.nrec = 0; File.nBases = 0; File.nTimes = 0; File.nAutos = 0;
+    for (i=0; i<NLinAnt; i++){
+      for (j=0; j<Nfreqs; j++){
+        File.AutoCorrs[i][j].N[0] = 0.; File.AutoCorrs[i][j].N[1] = 0.;
+        memset(File.AutoCorrs[i][j].AC[0],0,Freqs[j].Nchan*sizeof(double));
+        memset(File.AutoCorrs[i][j].AC[1],0,Freqs[j].Nchan*sizeof(double));
+      };
+    };
+    return false;
+  };
+
+// Overwrite pol label entries in SWIN file (they are before the 
+// pulsar bin, the weight and the UVW):
+  if (!doTest){
+    for (rec=0; rec<File.nrec; rec++){
+      for (k=0; k<2; k++){
+        pol[k] = POLCHARS[(File.Records[rec].Flags >> (2*k)) & 3];
+        if(pol[k]=='X'){pol[k]='R';} else if(pol[k]=='Y'){pol[k]='L';};
+      };
+      polpos = File.Bases[File.Records[rec].Base] + (long) File.Records[rec].Offset 
+               - 4*sizeof(double) - sizeof(int) - 2*sizeof(char);
+      newdifx[fileIdx].seekp(polpos, newdifx[fileIdx].beg);
+      newdifx[fileIdx].write(pol, 2*sizeof(char));
+    };
+    newdifx[fileIdx].flush();
+    newdifx[fileIdx].clear();
+  };
+
+  return true;
+
+};
+
+
+
+void DataIOSWIN::newFile(SWINFile &File){
+
+  int i, j;
+
+  File.RecSize = RECBUFFER; File.BaseSize = 1; File.TimeSize = RECBUFFER;
+  File.Records = (Record *) malloc(File.RecSize*sizeof(Record));
+  File.Bases = (long *) malloc(File.BaseSize*sizeof(long));
+  File.Times = (double *) malloc(File.TimeSize*sizeof(double));
+  File.nrec = 0; File.nBases = 0; File.nTimes = 0; File.nAutos = 0;
+  File.success = File.Records && File.Bases && File.Times;
+
+  File.AutoCorrs = new AutoCorrelation*[NLinAnt];
+  for (i=0; i<NLinAnt; i++){
+    File.AutoCorrs[i] = new AutoCorrelation[Nfreqs];
+    for (j=0; j<Nfreqs; j++){
+      File.AutoCorrs[i][j].N[0] = 0.; File.AutoCorrs[i][j].N[1] = 0.;
+      File.AutoCorrs[i][j].AC[0] = new double[Freqs[j].Nchan];
+      File.AutoCorrs[i][j].AC[1] = new double[Freqs[j].Nchan];
+      memset(File.AutoCorrs[i][j].AC[0],0,Freqs[j].Nchan*sizeof(double));
+      memset(File.AutoCorrs[i][j].AC[1],0,Freqs[j].Nchan*sizeof(double));
+    };
+  };
+
+};
+
+
+
+void DataIOSWIN::freeFile(SWINFile &File){
+
+  int i, j;
+
+  free(File.Records); free(File.Bases); free(File.Times);
+  File.Records = nullptr; File.Bases = nullptr; File.Times = nullptr;
+
+  if (File.AutoCorrs != nullptr){
+    for (i=0; i<NLinAnt; i++){
+      for (j=0; j<Nfreqs; j++){
+        delete[] File.AutoCorrs[i][j].AC[0];
+        delete[] File.AutoCorrs[i][j].AC[1];
+      };
+      delete[] File.AutoCorrs[i];
+    };
+    delete[] File.AutoCorrs;
+    File.AutoCorrs = nullptr;
+  };
+
+};
+
+
+
+// Append the records of a file to the index (adding the offsets of its
+// bases and times), compute their parangs and add its autocorrelations:
+bool DataIOSWIN::appendFile(int fileIdx, SWINFile &File){
+
+  long rec;
+  int i, j, k, l;
+  double Time, PA1, PA2;
+
+  if (nRecBases + File.nBases > 65536){
+    sprintf(message,"\nERROR! Too many files (or 4GB spans) to index!\n"); 
+    printLog(message);
+    return false;
+  };
+
+// Make room for the new records:
+  if (nrec + File.nrec > RecSize){
+    RecSize = ((nrec + File.nrec)/RECBUFFER + 1)*RECBUFFER;
+    if (!growRecords(RecSize)){return false;};
+  };
+  if (nRecBases + File.nBases > BaseSize){
+    BaseSize = nRecBases + File.nBases + nfiles;
+    if (!resizeArray(RecBases, BaseSize) || !resizeArray(RecFiles, BaseSize)){
+      sprintf(message,"\nERROR! Could not allocate memory for the bases of the index!\n");
+      printLog(message);
+      return false;
+    };
+  };
+  if (nRecTimes + File.nTimes > TimeSize){
+    TimeSize = ((nRecTimes + File.nTimes)/RECBUFFER + 1)*RECBUFFER;
+    if (!resizeArray(RecTimes, TimeSize)){
+      sprintf(message,"\nERROR! Could not allocate memory for the times of the index!\n");
+      printLog(message);
+      return false;
+    };
+  };
+
+  memcpy(Records + nrec, File.Records, File.nrec*sizeof(Record));
+  memcpy(RecBases + nRecBases, File.Bases, File.nBases*sizeof(long));
+  memcpy(RecTimes + nRecTimes, File.Times, File.nTimes*sizeof(double));
+  for (i=0; i<File.nBases; i++){RecFiles[nRecBases+i] = fileIdx;};
+
+  for (rec=nrec; rec<nrec+File.nrec; rec++){
+    Records[rec].Base += nRecBases; Records[rec].TimeIdx += nRecTimes;
+
+// Derive the parallactic angles:
+    Time = recTime(rec);
+    getParAng(Records[rec].Source, Records[rec].Antennas[0]-1, Records[rec].Antennas[1]-1,
+              nullptr, Time, PA1, PA2);
+    Records[rec].ParAng[0] = (float) PA1; Records[rec].ParAng[1] = (float) PA2;
+  };
+
+  nrec += File.nrec;
+  nRecBases += File.nBases;
+  nRecTimes += File.nTimes;
+
+  for (i=0; i<NLinAnt; i++){
+    for (j=0; j<Nfreqs; j++){
+      for (k=0; k<2; k++){
+        AutoCorrs[i][j].N[k] += File.AutoCorrs[i][j].N[k];
+        for (l=0; l<Freqs[j].Nchan; l++){
+          AutoCorrs[i][j].AC[k][l] += File.AutoCorrs[i][j].AC[k][l];
+        };
+      };
+    };
+  };
+
+  nautos += File.nAutos;
+
+  return true;
+
+};
+
+
+
+void DataIOSWIN::printLog(const char *msg){
+  std::lock_guard<std::mutex> lock(LogMutex);
+  fprintf(logFile,"%s",msg); std::cout<<msg; fflush(logFile);
+};
+
+
+
+
+
 void DataIOSWIN::finish(){
 
   int auxI;
+
+// Pending writes of the pipelined mode:
+  if (isPipelined){
+    Timer->start(Timing::WRITE);
+    stopPipeline();
+    Timer->stop(Timing::WRITE);
+  };
+  closeDirect();
+
   for (auxI=0; auxI<nfiles; auxI++) {
      newdifx[auxI].close();
      if (!isOverWrite){olddifx[auxI].close();};
@@ -301,6 +718,7 @@ void DataIOSWIN::openOutFiles(std::string* difxfiles) {
 
   olddifx = new std::ifstream[nfiles];
   newdifx = new std::fstream[nfiles];
+  swinNames = new std::string[nfiles];
 
   long begin, end;
   filesizes = new long[nfiles];
@@ -323,8 +741,10 @@ void DataIOSWIN::openOutFiles(std::string* difxfiles) {
      newdifx[auxI].close();
      newdifx[auxI].open((SEP+difxfiles[auxI]).c_str(), std::ios::out | std::ios::binary | std::ios::in);
      olddifx[auxI].clear();
+     swinNames[auxI] = SEP+difxfiles[auxI];
    } else {
      newdifx[auxI].open((difxfiles[auxI]).c_str(), std::ios::out | std::ios::binary | std::ios::in);
+     swinNames[auxI] = difxfiles[auxI];
    };
 
  };
@@ -345,10 +765,21 @@ bool DataIOSWIN::setCurrentIF(int i){
 
   debugNewIF = true;  
 
+// The reader of the previous IF (if any) must be done with the records:
+  stopReader();
+
+  ReadStarted = false;
+  IFGroups.clear(); BlockStart.clear();
+
   currFreq = i;
   currVis = 0;
-  memcpy(is1, is1orig, nrec*sizeof(bool));
-  memcpy(is2, is2orig, nrec*sizeof(bool));
+  scanRec = 0;
+  long rec;
+  for (rec=0; rec<nrec; rec++){
+    setRecFlag(rec, RECIS1, isLinAnt[Records[rec].Antennas[0]]);
+    setRecFlag(rec, RECIS2, isLinAnt[Records[rec].Antennas[1]]);
+  };
+
   return success;
 };
 
@@ -358,16 +789,14 @@ bool DataIOSWIN::setCurrentIF(int i){
 
 void DataIOSWIN::readHeader(bool doTest, int saveSource) {
 
-  long loc, beg, end, polpos;
-  int basel, fridx, cfidx, mjd, sidx, ii, jj;
-  double secs, daytemp, daytemp2;
-  double *UVW = new double[3];
-  int UVWsize = 3*sizeof(double);
-  char *pol = new char[2];
-  double AuxPA1, AuxPA2;
-
-  bool isInIF = false;
-  int isIFidx = 0;
+  int ii, jj, auxI, nThreads, nextFile, nAppended;
+  long heldBytes, fileBytes;
+  char *nThr;
+  SWINFile *Files;
+  bool *isRead;
+  std::vector<std::thread> Readers;
+  std::mutex ReadMutex;
+  std::condition_variable ReadCond;
 
 // AUXILIARY BINARY FILES TO STORE CIRCULAR VISIBILITIES:
   FILE **circFile = new FILE*[nDoIF];
@@ -403,32 +832,28 @@ void DataIOSWIN::readHeader(bool doTest, int saveSource) {
 
   success = true;
 
-  free(AutoCorrs);
-  free(Records);
-  free(ParAng[0]);
-  free(ParAng[1]);
-  free(UVDist);
-  free(is1orig);
-  free(is2orig);
-  delete is1;
-  delete is2;
+  freeRecords();
+  if (!growRecords(RECBUFFER)){success = false;};
+  RecBases = (long *) malloc(nfiles*sizeof(long));
+  RecFiles = (int *) malloc(nfiles*sizeof(int));
+  RecTimes = (double *) malloc(RECBUFFER*sizeof(double));
+  if (RecBases==nullptr || RecFiles==nullptr || RecTimes==nullptr){
+    sprintf(message,"\nERROR! Could not allocate memory for the index!\n");
+    printLog(message);
+    success = false;
+  };
+  RecSize = RECBUFFER;
+  BaseSize = nfiles;
+  TimeSize = RECBUFFER;
+
+  for (ii=0; ii<256; ii++){isLinAnt[ii] = false;};
+  for (ii=0; ii<NLinAnt; ii++){
+    if (linAnts[ii]>=0 && linAnts[ii]<256){isLinAnt[linAnts[ii]] = true;};
+  };
 
-  
-  
-  AutoCorrs = (AutoCorrelation *) malloc(RECBUFFER*sizeof(AutoCorrelation));
-  Records = (Record *) malloc(RECBUFFER*sizeof(Record)); 
-  is1orig =  (bool *) malloc(RECBUFFER*sizeof(bool)); 
-  is2orig = (bool *) malloc(RECBUFFER*sizeof(bool));  
-  ParAng[0] = (double *) malloc(RECBUFFER*sizeof(double));  
-  ParAng[1] = (double *) malloc(RECBUFFER*sizeof(double));  
-  UVDist = (double *) malloc(RECBUFFER*sizeof(double));  
 
   nautos = 0;
   nrec = 0;
-  long CURRSIZE = RECBUFFER;
-  long AUTOSIZE = RECBUFFER;
-  int ant1, ant2, auxI, auxJ;
-  double auxD;
 //Assume binary index (i.e., DiFX version >= 2.0):
   sprintf(message,"\nThere are %i IFs.",Nfreqs);
   fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
@@ -436,96 +861,258 @@ void DataIOSWIN::readHeader(bool doTest, int saveSource) {
   sprintf(message,"\n\n Searching for visibilities with mixed (or linear) polarization.\n\n");
   fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
 
-  long bperp;
-  long RecordSize = 5*sizeof(int) + 2*sizeof(double) + 2*sizeof(char) + endhead;
 
-  for (auxI=0; auxI<nfiles; auxI++) {
+// The files are read in parallel, unless the auxiliary files (that are
+// written in the order of the visibilities) are needed:
+  nThreads = 1;
+  if (!doWriteCirc && nfiles>1){
+    nThreads = (int) std::thread::hardware_concurrency();
+    nThr = getenv("POLCONVERT_THREADS");
+    if (nThr != NULL && atoi(nThr)>0){nThreads = atoi(nThr);};
+    if (nThreads > MAXREADTHREADS){nThreads = MAXREADTHREADS;};
+    if (nThreads > nfiles){nThreads = nfiles;};
+    if (nThreads < 1){nThreads = 1;};
+  };
 
-    loc = 8;
+  Files = new SWINFile[nfiles];
+  isRead = new bool[nfiles];
+  for (auxI=0; auxI<nfiles; auxI++){
+    Files[auxI].Records = nullptr;
+    Files[auxI].Bases = nullptr; Files[auxI].Times = nullptr; 
+    Files[auxI].AutoCorrs = nullptr; isRead[auxI] = false;
+  };
 
-// Bits per percentage:
-    bperp = filesizes[auxI]/100; if(bperp==0){bperp=1;};
 
-    sprintf(message,"\n\nReading file %i of %i (size %li MB)\n",auxI+1,nfiles,filesizes[auxI]/(1024*1024));
-    fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
+  if (nThreads==1){
 
-    while(!newdifx[auxI].eof()) {
+    for (auxI=0; success && auxI<nfiles; auxI++){
+      readFile(auxI, doTest, saveSource, Files[auxI], circFile, autoCorrs);
+      success = Files[auxI].success && appendFile(auxI, Files[auxI]);
+      freeFile(Files[auxI]);
+    };
 
-     newdifx[auxI].seekg(loc,newdifx[auxI].beg);
-     newdifx[auxI].read(reinterpret_cast<char*>(&basel), sizeof(int));
-     newdifx[auxI].read(reinterpret_cast<char*>(&mjd), sizeof(int));
-     newdifx[auxI].read(reinterpret_cast<char*>(&secs), sizeof(double));
-     newdifx[auxI].read(reinterpret_cast<char*>(&cfidx), sizeof(int));
-     newdifx[auxI].read(reinterpret_cast<char*>(&sidx), sizeof(int));
-     newdifx[auxI].read(reinterpret_cast<char*>(&fridx), sizeof(int));
-     polpos = newdifx[auxI].tellg();
-     newdifx[auxI].read(pol, 2*sizeof(char));
-     newdifx[auxI].ignore(sizeof(int)+sizeof(double)); // Pulsar bin + Weight
-     newdifx[auxI].read(reinterpret_cast<char*>(UVW), UVWsize);
+  } else {
 
-// OBSOLETE! Now, source ids in SWIN are self-consistent among 
-// (concatenated) scans:
-    // sidx += auxI;
+    sprintf(message,"\n Reading %i files with %i threads.\n",nfiles,nThreads);
+    fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
 
-////////////////
-// WHAT IS THE DIFFERENCE BETWEEN CFIDX AND FRIDX !!!!!!!!
-////////////////
+// Each reader takes the next file to read (nextFile = nfiles stops them).
+// The records of a file stay in memory until all the previous files are
+// appended, so a reader waits if it would get more than nThreads files
+// ahead of the appended ones, or if the files already read (but not yet
+// appended) take more than RecMemory bytes:
+    nextFile = 0; nAppended = 0; heldBytes = 0;
+    for (ii=0; ii<nThreads; ii++){
+      Readers.push_back(std::thread([&](){
+        int fileIdx;
+        while (true){
+          {
+            std::unique_lock<std::mutex> lock(ReadMutex);
+            ReadCond.wait(lock, [&](){return nextFile>=nfiles || 
+              (nextFile < nAppended + nThreads && heldBytes <= RecMemory);});
+            if (nextFile>=nfiles){return;};
+            fileIdx = nextFile; nextFile ++;
+          };
+          readFile(fileIdx, doTest, saveSource, Files[fileIdx], circFile, autoCorrs);
+          {
+            std::lock_guard<std::mutex> lock(ReadMutex);
+            isRead[fileIdx] = true;
+            heldBytes += Files[fileIdx].RecSize*sizeof(Record) + 
+                         Files[fileIdx].BaseSize*sizeof(long) + 
+                         Files[fileIdx].TimeSize*sizeof(double);
+          };
+          ReadCond.notify_all();
+        };
+      }));
+    };
 
+// The files are appended as soon as they (and all the previous ones) are read:
+    for (auxI=0; success && auxI<nfiles; auxI++){
+      {
+        std::unique_lock<std::mutex> lock(ReadMutex);
+        ReadCond.wait(lock, [&](){return isRead[auxI];});
+        fileBytes = Files[auxI].RecSize*sizeof(Record) + 
+                    Files[auxI].BaseSize*sizeof(long) + 
+                    Files[auxI].TimeSize*sizeof(double);
+      };
+      success = Files[auxI].success && appendFile(auxI, Files[auxI]);
+      freeFile(Files[auxI]);
+      {
+        std::lock_guard<std::mutex> lock(ReadMutex);
+        nAppended = auxI + 1; heldBytes -= fileBytes;
+        if (!success){nextFile = nfiles;};
+      };
+      ReadCond.notify_all();
+    };
 
-    beg = newdifx[auxI].tellg(); 
+    for (ii=0; ii<nThreads; ii++){Readers[ii].join();};
+    for (auxI=0; auxI<nfiles; auxI++){freeFile(Files[auxI]);};
 
+  };
 
-    isInIF = false;
-    for(auxJ=0;auxJ<nDoIF;auxJ++){
-      if (fridx==DoIF[auxJ] || fridx==DoIF[auxJ]+IFOffset){isInIF=true; isIFidx = auxJ; fridx = DoIF[auxJ]; break;};
-    };
+  delete[] Files;
+  delete[] isRead;
 
 
-    if (beg>0) {
+// day0 is JD (not MJD):
+  if (success){
+    day0 += 2400000.5 ;
+    sprintf(message,"day0 is %lf", day0);
+    fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
+  };
 
-      end = beg + (Freqs[fridx].Nchan)*sizeof(cplx32f);
-      loc = end + 2*sizeof(int); // Control word and header version
+// Case of error in reading files:
+  if (!success){
+    freeRecords();
+    nrec = 0;
+  };
 
-// RE-ALLOCATE MEMORY IF BUFFER IS FULL:
-      if (nrec == CURRSIZE) {
-        CURRSIZE += RECBUFFER; 
-        Records = (Record*) realloc(Records, CURRSIZE*sizeof(Record));
-        if(!Records){
-           success = false; 
-           goto FREE;
-        };
-        is1orig = (bool*) realloc(is1orig, CURRSIZE*sizeof(bool));
-        if(!is1orig){
-           success = false; 
-           goto FREE;
-        };
-        is2orig = (bool*) realloc(is2orig, CURRSIZE*sizeof(bool));
-        if(!is2orig){
-          success = false; 
-          goto FREE;
-        };
-        ParAng[0] = (double *) realloc(ParAng[0], CURRSIZE*sizeof(double));
-        ParAng[1] = (double *) realloc(ParAng[1], CURRSIZE*sizeof(double));
-        UVDist = (double *) realloc(UVDist, CURRSIZE*sizeof(double));
-        if(!ParAng[0] || !ParAng[1]){
-          success = false; 
-          goto FREE;
-        };
-      };
 
-// Check if we are in the time window:
-      secs /= 86400.;
-      daytemp = ((double) mjd) + secs - day0;
+// CLOSE AUXILIARY BINARY FILES:
+  if (doWriteCirc){
+    for (ii=0; ii<nDoIF; ii++){
+      fclose(circFile[ii]);
+      fclose(autoCorrs[ii]);
+    };
+  };
 
-      if(isInIF && daytemp>=doRange[0] && daytemp<=doRange[1]){
 
-// Check if a linear-feed antenna is in the baseline:
-        ant1 = basel / 256;
-        ant2 = basel % 256;
-        is1orig[nrec] = false ; is2orig[nrec] = false;
+  delete[] circFile;
+
+  if (nrec==0) {
+    sprintf(message,"\n NO VALID DATA FOUND!"); 
+    fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
+    success = false;
+  } else {
+    NLinVis = nrec/4;
+    sprintf(message,"\n %li records indexed (%li MB%s).\n",nrec,
+       (long) (nrec*sizeof(Record))/(1024*1024),(RecSpill>=0)?", on disk":"");
+    fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
+  };
+
+};
+
+
+
+
+
+// Read the records of file fileIdx into File. This may run in a reader
+// thread (if doWriteCirc is false), so it only uses its own buffers and 
+// the stream of the file:
+void DataIOSWIN::readFile(int fileIdx, bool doTest, int saveSource, SWINFile &File,
+         FILE **circFile, FILE **autoCorrs) {
+
+  long loc, beg, end, polpos;
+  int basel, fridx, mjd, sidx, jj;
+  double secs, daytemp, daytemp2;
+  double UVW[3];
+  char pol[2];
+  char head[SWINHEADSIZE];
+  SWINRecordHeader H;
+  double AuxPA1, AuxPA2;
+  char msg[512];
+
+  bool isInIF = false;
+  int isIFidx = 0;
+
+  int ant1, ant2, auxJ, maxNchan;
+  double auxD;
+  bool isLin1, isLin2;
+  unsigned char polCode[2];
+  const char *polIdx;
+  std::complex<float> *fileVis[4];
+  std::fstream &difx = newdifx[fileIdx];
+
+  newFile(File);
+  if (!File.success){return;};
+
+// Use the index of a previous run, if valid (the circular visibilities 
+// and the autocorrelations are written to the auxiliary files while 
+// scanning, so the index is not used when solving):
+  IndexCache Index(swinNames[fileIdx], logFile);
+  indexKey(Index);
+  if (!doWriteCirc && Index.openRead() && loadIndex(Index, fileIdx, doTest, File)){
+    sprintf(msg,"\n\nFile %i of %i: read %li records from index\n",fileIdx+1,nfiles,File.nrec);
+    printLog(msg);
+    return;
+  };
+
+  sprintf(msg,"\n\nReading file %i of %i (size %li MB)\n",fileIdx+1,nfiles,filesizes[fileIdx]/(1024*1024));
+  printLog(msg);
+
+  maxNchan = 0;
+  for (jj=0; jj<Nfreqs; jj++){
+    if (Freqs[jj].Nchan > maxNchan){maxNchan = Freqs[jj].Nchan;};
+  };
+  for (jj=0; jj<4; jj++){
+    fileVis[jj] = new std::complex<float>[maxNchan+1];
+  };
+
+  loc = 0;
+
+  while(!difx.eof()) {
+
+     difx.seekg(loc,difx.beg);
+     difx.read(head, SWINHEADSIZE);
+     if (difx.gcount() < SWINHEADSIZE){break;}; // End of file.
+     if (!parseSWINHeader(head, H)){
+       sprintf(msg,"\nERROR! No SWIN sync word at byte %li of file %i\n",loc,fileIdx);
+       printLog(msg);
+       File.success = false;
+       break;
+     };
+     basel = H.Baseline; mjd = H.MJD; secs = H.Seconds;
+     sidx = H.Source; fridx = H.Freq; pol[0] = H.Pol[0]; pol[1] = H.Pol[1];
+     UVW[0] = H.UVW[0]; UVW[1] = H.UVW[1]; UVW[2] = H.UVW[2];
+     polpos = loc + SWINPOL;
+
+// OBSOLETE! Now, source ids in SWIN are self-consistent among 
+// (concatenated) scans:
+    // sidx += fileIdx;
+
+////////////////
+// WHAT IS THE DIFFERENCE BETWEEN CFIDX AND FRIDX !!!!!!!!
+////////////////
+
+
+    beg = loc + SWINHEADSIZE; 
+
+
+    isInIF = false;
+    for(auxJ=0;auxJ<nDoIF;auxJ++){
+      if (fridx==DoIF[auxJ] || fridx==DoIF[auxJ]+IFOffset){isInIF=true; isIFidx = auxJ; fridx = DoIF[auxJ]; break;};
+    };
+
+
+    if (beg>0) {
+
+      end = beg + (Freqs[fridx].Nchan)*sizeof(cplx32f);
+      loc = end; // Next sync word.
+
+// RE-ALLOCATE MEMORY IF BUFFER IS FULL:
+      if (File.nrec == File.RecSize) {
+        if (!resizeArray(File.Records, File.RecSize + RECBUFFER)){
+          sprintf(msg,"\nERROR! Could not allocate memory for the records of file %i\n",fileIdx);
+          printLog(msg);
+          File.success = false; 
+          break;
+        };
+        File.RecSize += RECBUFFER; 
+      };
+
+// Check if we are in the time window:
+      secs /= 86400.;
+      daytemp = ((double) mjd) + secs - day0;
+
+      if(isInIF && daytemp>=doRange[0] && daytemp<=doRange[1]){
+
+// Check if a linear-feed antenna is in the baseline:
+        ant1 = basel / 256;
+        ant2 = basel % 256;
+        isLin1 = false ; isLin2 = false;
         for (auxJ=0;auxJ<NLinAnt;auxJ++){
           if(ant1 == linAnts[auxJ]){
-            is1orig[nrec] = true;
+            isLin1 = true;
             if (pol[0] == 'R' || pol[0]=='X'){
                pol[0] = 'X';} 
             else {
@@ -533,7 +1120,7 @@ void DataIOSWIN::readHeader(bool doTest, int saveSource) {
             };
           };
           if(ant2 == linAnts[auxJ]){
-            is2orig[nrec] = true;
+            isLin2 = true;
             if (pol[1] == 'R' || pol[1]=='X'){
                pol[1] = 'X';} 
             else {
@@ -542,34 +1129,31 @@ void DataIOSWIN::readHeader(bool doTest, int saveSource) {
           };
         };
 
-// Derive the parallactic angles:
+// Derive the parallactic angles (for the auxiliary files; the parangs 
+// of the records are computed when they are appended):
         daytemp2 = (daytemp + day0)*86400.;
-        getParAng(sidx,ant1-1,ant2-1,UVW,daytemp2,AuxPA1,AuxPA2);
+        if (doWriteCirc){
+          getParAng(sidx,ant1-1,ant2-1,UVW,daytemp2,AuxPA1,AuxPA2);
+        };
  
 // Read auto-correlations:
         if (ant1==ant2){
           auxD = 0.0;
-          newdifx[auxI].seekg(beg,newdifx[auxI].beg);
-          newdifx[auxI].read(reinterpret_cast<char*>(currentVis[0]),end-beg);      
+          difx.seekg(beg,difx.beg);
+          difx.read(reinterpret_cast<char*>(fileVis[0]),end-beg);      
           auxJ = -1;
           if( (pol[0]=='R' || pol[0]=='X') && (pol[1]=='R' || pol[1]=='X')){auxJ=1;};
           if( (pol[0]=='L' || pol[0]=='Y') && (pol[1]=='L' || pol[1]=='Y')){auxJ=2;};
       
           if (auxJ>0){
-            AutoCorrs[nautos].AntIdx = ant1-1;
-            AutoCorrs[nautos].IF = fridx;
-            AutoCorrs[nautos].JD = daytemp;
-            AutoCorrs[nautos].Pol = auxJ;
-            AutoCorrs[nautos].AC = new double[Freqs[fridx].Nchan];
-            for (auxJ=1; auxJ<Freqs[fridx].Nchan-1; auxJ++){
-              AutoCorrs[nautos].AC[auxJ] = std::abs(currentVis[0][auxJ]);
-            };
-	    nautos += 1;
-      // Reallocate memory, if needed:
-            if (nautos==AUTOSIZE){
-              AUTOSIZE += RECBUFFER; 
-              AutoCorrs = (AutoCorrelation*) realloc(AutoCorrs, AUTOSIZE*sizeof(AutoCorrelation));
+      // Add to the running sums (the edge channels are not used):
+            if (ant1>0 && ant1<=NLinAnt){
+              File.AutoCorrs[ant1-1][fridx].N[auxJ-1] += 1.;
+              for (jj=1; jj<Freqs[fridx].Nchan-1; jj++){
+                File.AutoCorrs[ant1-1][fridx].AC[auxJ-1][jj] += std::abs(fileVis[0][jj]);
+              };
             };
+	    File.nAutos += 1;
         
             if(doWriteCirc){
               fwrite(&ant1,sizeof(int),1,autoCorrs[isIFidx]);
@@ -584,13 +1168,13 @@ void DataIOSWIN::readHeader(bool doTest, int saveSource) {
       
 // Write circular visibilities (assume standard pol. ordering):
        if ((saveSource<0 || sidx == saveSource) && 
-           doWriteCirc && (!is1orig[nrec] && !is2orig[nrec]) && 
+           doWriteCirc && (!isLin1 && !isLin2) && 
            (pol[0] == 'R' || pol[0]=='X') && (pol[1] == 'R' || pol[1]=='X')){
 
 
            for (auxJ=0; auxJ<4; auxJ++){    
-             newdifx[auxI].seekg(beg + (RecordSize + (Freqs[fridx].Nchan)*sizeof(cplx32f))*auxJ, newdifx[auxI].beg);
-             newdifx[auxI].read(reinterpret_cast<char*>(currentVis[auxJ]),end-beg);
+             difx.seekg(beg + (SWINHEADSIZE + (Freqs[fridx].Nchan)*sizeof(cplx32f))*auxJ, difx.beg);
+             difx.read(reinterpret_cast<char*>(fileVis[auxJ]),end-beg);
            };
 
            fwrite(&daytemp2,sizeof(double),1,circFile[isIFidx]);
@@ -600,106 +1184,96 @@ void DataIOSWIN::readHeader(bool doTest, int saveSource) {
            fwrite(&AuxPA2,sizeof(double),1,circFile[isIFidx]);
 
            for (auxJ=0;auxJ<Freqs[fridx].Nchan;auxJ++){
-             fwrite(&currentVis[0][auxJ],sizeof(std::complex<float>),1,circFile[isIFidx]);
-             fwrite(&currentVis[2][auxJ],sizeof(std::complex<float>),1,circFile[isIFidx]);
-             fwrite(&currentVis[3][auxJ],sizeof(std::complex<float>),1,circFile[isIFidx]);
-             fwrite(&currentVis[1][auxJ],sizeof(std::complex<float>),1,circFile[isIFidx]);
+             fwrite(&fileVis[0][auxJ],sizeof(std::complex<float>),1,circFile[isIFidx]);
+             fwrite(&fileVis[2][auxJ],sizeof(std::complex<float>),1,circFile[isIFidx]);
+             fwrite(&fileVis[3][auxJ],sizeof(std::complex<float>),1,circFile[isIFidx]);
+             fwrite(&fileVis[1][auxJ],sizeof(std::complex<float>),1,circFile[isIFidx]);
           };
        };
 
 
 // Read entry metadata:
 
-       if (is1orig[nrec] || is2orig[nrec]) {
-
-         Records[nrec].Baseline = basel;
-         Records[nrec].Source = sidx;
-         Records[nrec].fileNumber = auxI;
-         Records[nrec].Time = daytemp2; 
-         Records[nrec].notUsed = true;
-         Records[nrec].Antennas[0] = ant1;
-         Records[nrec].Antennas[1] = ant2;
-         Records[nrec].byteIni = beg;
-         Records[nrec].byteEnd = end;
-         Records[nrec].Pol[0] = pol[0];
-         Records[nrec].Pol[1] = pol[1];
-         Records[nrec].freqIndex = fridx;
+       if (isLin1 || isLin2) {
 
-// Derive the parallactic angles:
-         ParAng[0][nrec] = AuxPA1 ; ParAng[1][nrec] = AuxPA2;
-         UVDist[nrec] = UVW[0]*UVW[0] + UVW[1]*UVW[1];
+         for (auxJ=0; auxJ<2; auxJ++){
+           polIdx = (const char *) memchr(POLCHARS, pol[auxJ], 4);
+           polCode[auxJ] = (polIdx==NULL)?4:(unsigned char)(polIdx - POLCHARS);
+         };
+
+         if (ant1>255 || sidx<0 || sidx>65535 || polCode[0]>3 || polCode[1]>3){
+           sprintf(msg,"\nERROR! Cannot index record (baseline %i, source %i, pols %c%c)\n",
+              basel, sidx, pol[0], pol[1]); 
+           printLog(msg);
+           File.success = false;
+           break;
+         };
+
+// New base for each 4GB span:
+         if (File.nBases==0 || beg - File.Bases[File.nBases-1] > 4294967295L){
+           if (File.nBases == File.BaseSize){
+             if (!resizeArray(File.Bases, File.BaseSize + 1)){
+               sprintf(msg,"\nERROR! Could not allocate memory for the bases of file %i\n",fileIdx);
+               printLog(msg);
+               File.success = false;
+               break;
+             };
+             File.BaseSize += 1;
+           };
+           File.Bases[File.nBases] = beg;
+           File.nBases ++;
+         };
+
+         if (File.nTimes==0 || File.Times[File.nTimes-1] != daytemp2){
+           if (File.nTimes == File.TimeSize){
+             if (!resizeArray(File.Times, File.TimeSize + RECBUFFER)){
+               sprintf(msg,"\nERROR! Could not allocate memory for the times of file %i\n",fileIdx);
+               printLog(msg);
+               File.success = false;
+               break;
+             };
+             File.TimeSize += RECBUFFER;
+           };
+           File.Times[File.nTimes] = daytemp2;
+           File.nTimes ++;
+         };
+
+         File.Records[File.nrec].Offset = (unsigned int) (beg - File.Bases[File.nBases-1]);
+         File.Records[File.nrec].Base = (unsigned short) (File.nBases-1);
+         File.Records[File.nrec].TimeIdx = (unsigned int) (File.nTimes-1);
+         File.Records[File.nrec].Source = (unsigned short) sidx;
+         File.Records[File.nrec].Antennas[0] = (unsigned char) ant1;
+         File.Records[File.nrec].Antennas[1] = (unsigned char) ant2;
+         File.Records[File.nrec].freqIndex = (unsigned char) fridx;
+         File.Records[File.nrec].Flags = polCode[0] | (polCode[1] << 2) | RECNOTUSED;
+         if (isLin1){File.Records[File.nrec].Flags |= RECIS1;};
+         if (isLin2){File.Records[File.nrec].Flags |= RECIS2;};
+
+         File.Records[File.nrec].UVDist = (float) (UVW[0]*UVW[0] + UVW[1]*UVW[1]);
 
 /////////
 // Overwrite pol label entry in SWIN file:
          if(!doTest){
            if(pol[0]=='X'){pol[0]='R';} else if(pol[0]=='Y'){pol[0]='L';};
            if(pol[1]=='X'){pol[1]='R';} else if(pol[1]=='Y'){pol[1]='L';};
-           newdifx[auxI].seekp(polpos, newdifx[auxI].beg);
-           newdifx[auxI].write(reinterpret_cast<char*>(pol),2*sizeof(char));
+           difx.seekp(polpos, difx.beg);
+           difx.write(reinterpret_cast<char*>(pol),2*sizeof(char));
          };
 /////////
-         nrec ++;
+         File.nrec ++;
        };
      };
    };
   };
 
 
+  for (jj=0; jj<4; jj++){delete[] fileVis[jj];};
 
 // Rewind:
-  newdifx[auxI].clear();
-  newdifx[auxI].seekg(0,newdifx[auxI].beg);
-
-
-
-
- };
+  difx.clear();
+  difx.seekg(0,difx.beg);
 
-
-// day0 is JD (not MJD):
-  day0 += 2400000.5 ;
-  sprintf(message,"day0 is %lf", day0);
-  fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
-
-// Case of error in reading files:
-FREE:
-  if (!success){
-    free(Records);
-    free(ParAng[0]);
-    free(ParAng[1]);
-    free(is1orig);
-    free(is2orig);
-    free(is1);
-    free(is2);
-    free(UVDist);
-    Records = nullptr; ParAng[0]=nullptr; ParAng[1]=nullptr;
-    is1orig=nullptr; is2orig=nullptr; UVDist=nullptr;
-  };
-
-
-// CLOSE AUXILIARY BINARY FILES:
-  if (doWriteCirc){
-    for (ii=0; ii<nDoIF; ii++){
-      fclose(circFile[ii]);
-      fclose(autoCorrs[ii]);
-    };
-  };
-
-
-  delete[] circFile;
-
-  if (nrec==0) {
-    sprintf(message,"\n NO VALID DATA FOUND!"); 
-    fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
-    success = false;
-  } else {
-// Allocate memory for booleans:
-    NLinVis = nrec/4;
-    is1 = new bool[nrec];
-    is2 = new bool[nrec];
-  };
-
-  delete[] pol;
+  if (File.success){saveIndex(Index, File);};
 
 };
 
@@ -710,18 +1284,23 @@ FREE:
 
 
 
-bool DataIOSWIN::getNextMixedVis(double &JDTime, int &antenna, int &otherAnt, bool &conj, int &calField) {
-
+// Search of the next group of products (and classification of them).
+// Warnings are kept in G.Log (this may run in the reader thread):
+void DataIOSWIN::findNextGroup(MixedGroup &G) {
 
-  long rec, rec1, k;
-  int basel, idx, fnum, field;
-  double time;
+  long rec, rec1;
+  int basel, idx, field = 0;
+  unsigned char ant1, ant2;
+  double time = 0.0;
   long indices[4];
-  bool complete;
+  bool complete = true, conj;
+  char msg[512];
 
   for (idx=0; idx<4; idx++) indices[idx] = -1;
 
-  if (NLinVis==0){return false;};
+  G.Found = false;
+  G.Log.clear();
+  G.Bytes = 0;
 
 ///////////////////
 // BEWARE WHETHER currFreq IS ZERO-BASED!!!!!
@@ -729,46 +1308,52 @@ bool DataIOSWIN::getNextMixedVis(double &JDTime, int &antenna, int &otherAnt, bo
 
 
 // Find the four correlation products:
-    canPlot=false;
+    G.V.CanPlot = false;
 
 // Note that autocorrs are read, converted and written twice;
 // once for ref and once for rem (one of which is conjugated
 // for the conversion).  The logic here goes through all the
 // records (indexed by rec) to find the first unused visibility
 // and then looks for all the matches by baseline, time and
-// frequency (indexed by rec1).  The logic variables is1 and is2
-// are copies of is1orig and is2orig which are true if the ant
-// at one or the other end of the baseline is in the linear-feed
-// list and are reset to false once conversion happens (?).
+// frequency (indexed by rec1).  The RECIS1 and RECIS2 record flags
+// are reset (in setCurrentIF) to true if the ant at one or the other 
+// end of the baseline is in the linear-feed list and are reset to
+// false once conversion happens (?).
 //
 // isTwoLinear means both antennas are linear-feed
 // complete true means otherwise
+//
+// Records are only marked as used during an IF, so the search starts
+// at the first unused record found in the previous call (scanRec).
 
     while(true){
 
       idx = 0;
-      for (rec=0; rec<nrec; rec++) {
-        if (Records[rec].notUsed && (Records[rec].freqIndex==currFreq)) {
+      for (rec=scanRec; rec<nrec; rec++) {
+        if (recFlag(rec,RECNOTUSED) && (Records[rec].freqIndex==currFreq)) {
+          scanRec = rec;
           indices[idx] = rec;
-          complete = !(is1[rec] && is2[rec]) ; 
-          if(!complete){isTwoLinear=true;};
+          complete = !(recFlag(rec,RECIS1) && recFlag(rec,RECIS2)) ; 
 
           if (complete){
-            canPlot = true;
-            Records[rec].notUsed = false;}; // since used as idx==0
+            G.V.CanPlot = true;
+            setRecFlag(rec,RECNOTUSED,false);}; // since used as idx==0
 
           idx ++;
-          basel = Records[rec].Baseline;
-          time = Records[rec].Time;
+          ant1 = Records[rec].Antennas[0];
+          ant2 = Records[rec].Antennas[1];
+          basel = 256*ant1 + ant2;
+          time = recTime(rec);
           field = Records[rec].Source;
-          currVis = rec;
+          G.V.Rec = rec;
           for (rec1=rec+1; rec1<nrec; rec1++) {
-              if (Records[rec1].Baseline==basel && 
-                  Records[rec1].Time==time && 
+              if (Records[rec1].Antennas[0]==ant1 && 
+                  Records[rec1].Antennas[1]==ant2 && 
+                  recTime(rec1)==time && 
                   Records[rec1].freqIndex==currFreq) {
                   indices[idx] = rec1; idx ++;
                   if (complete){
-                    Records[rec1].notUsed = false;};
+                    setRecFlag(rec1,RECNOTUSED,false);};
                   if (idx==4) {break;}; // since we have 4 products
               };
            }; 
@@ -784,19 +1369,19 @@ bool DataIOSWIN::getNextMixedVis(double &JDTime, int &antenna, int &otherAnt, bo
 // If not all the 4 products are found, report a warning:
 // FIXME: actually this prints what exists, not what is missing,
 // and in the case of Autocorrs, well, sometimes only 2 products exist
-      convisok = true;
+      G.V.ConvisOK = true;
       if (idx==0) {
-        return false;}
+        return;}
       else if (idx <4) {
 
-        sprintf(message,"WARNING: Missing: Baseline: %08x - Time: %f sec: ",
-           basel,time - Records[0].Time); 
-        fprintf(logFile,"%s",message); fflush(logFile);
+        sprintf(msg,"WARNING: Missing: Baseline: %08x - Time: %f sec: ",
+           basel,time - recTime(0)); 
+        G.Log += msg;
 
         for (rec=0; rec<idx; rec++) {
-          sprintf(message,"%c%c ",
-              Records[indices[rec]].Pol[0],Records[indices[rec]].Pol[1]);
-          fprintf(logFile,"%s",message); fflush(logFile);
+          sprintf(msg,"%c%c ",
+              recPol(indices[rec],0),recPol(indices[rec],1));
+          G.Log += msg;
         };
 
         if(idx==2){
@@ -804,9 +1389,9 @@ bool DataIOSWIN::getNextMixedVis(double &JDTime, int &antenna, int &otherAnt, bo
         };
         if(idx==1){
           indices[1] = -1; indices[2] = -1; indices[3] = -1; 
-	  convisok = false;
-          sprintf(message,"\n ERROR! ONLY ONE LINEAR POLARIZATION CHANNEL WILL NOT WORK!!");
-          fprintf(logFile,"%s",message); fflush(logFile);
+	  G.V.ConvisOK = false;
+          sprintf(msg,"\n ERROR! ONLY ONE LINEAR POLARIZATION CHANNEL WILL NOT WORK!!");
+          G.Log += msg;
           break;
         };
 
@@ -820,74 +1405,135 @@ bool DataIOSWIN::getNextMixedVis(double &JDTime, int &antenna, int &otherAnt, bo
 
 
 // Classify the correlation products:
-    if (is1[indices[0]]){is1[indices[0]]=false; conj = true;} else {is2[indices[0]]=false; conj=false;};
+    if (recFlag(indices[0],RECIS1)){setRecFlag(indices[0],RECIS1,false); conj = true;} else {setRecFlag(indices[0],RECIS2,false); conj=false;};
 
     if (idx<4){
-      sprintf(message," CONJ: %i (%s %ld)\n",conj,convisok?"ok":"ERROR",currVis);
-      fprintf(logFile,"%s",message); fflush(logFile);
+      sprintf(msg," CONJ: %i (%s %ld)\n",conj,G.V.ConvisOK?"ok":"ERROR",G.V.Rec);
+      G.Log += msg;
     };
 
     int i = conj?0:1;
-    antenna = conj?Records[indices[0]].Antennas[0]:Records[indices[0]].Antennas[1];
-    otherAnt = conj?Records[indices[0]].Antennas[1]:Records[indices[0]].Antennas[0];
+    G.V.Antenna = conj?Records[indices[0]].Antennas[0]:Records[indices[0]].Antennas[1];
+    G.V.OtherAnt = conj?Records[indices[0]].Antennas[1]:Records[indices[0]].Antennas[0];
 
     char p1, p2;
-    currEntries[currFreq][0] = -1;
-    currEntries[currFreq][1] = -1;
-    currEntries[currFreq][2] = -1;
-    currEntries[currFreq][3] = -1;
+    G.V.Entries[0] = -1;
+    G.V.Entries[1] = -1;
+    G.V.Entries[2] = -1;
+    G.V.Entries[3] = -1;
 
     for (rec = 0; rec < 4; rec++) {
 
       if (indices[rec]>=0){
-        p1 = Records[indices[rec]].Pol[i];
-        p2 = Records[indices[rec]].Pol[1-i];
+        p1 = recPol(indices[rec],i);
+        p2 = recPol(indices[rec],1-i);
 // All pol. products must have consistent booleans (for sanity)
-        is1[indices[rec]] = is1[indices[0]];
-        is2[indices[rec]] = is2[indices[0]];
+        setRecFlag(indices[rec],RECIS1,recFlag(indices[0],RECIS1));
+        setRecFlag(indices[rec],RECIS2,recFlag(indices[0],RECIS2));
         if ((p1=='X' || p1=='R') && (p2=='R' || p2=='X')) {
-          currEntries[currFreq][0] = indices[rec];}
+          G.V.Entries[0] = indices[rec];}
         else if ((p1=='Y'||p1=='L') && (p2=='R' || p2=='X')) {
-          currEntries[currFreq][3] = indices[rec];}
+          G.V.Entries[3] = indices[rec];}
         else if ((p1=='X'||p1=='R') && (p2=='L' || p2=='Y')) {
-          currEntries[currFreq][2] = indices[rec];}
+          G.V.Entries[2] = indices[rec];}
         else if ((p1=='Y'||p1=='L') && (p2=='L' || p2=='Y')) {
-          currEntries[currFreq][1] = indices[rec];
+          G.V.Entries[1] = indices[rec];
         };
       };
     };
 
+    G.Found = true;
+    G.V.Complete = complete;
+    G.V.Conj = conj;
+    G.V.Time = time;
+    G.V.Field = field;
 
-// Get the data and return them:
-    for (i=0; i<4; i++) {
-      if (currEntries[currFreq][i]>=0){
-        rec = currEntries[currFreq][i];
-        fnum = Records[rec].fileNumber;
-        newdifx[fnum].seekg(Records[rec].byteIni, newdifx[fnum].beg);
-        newdifx[fnum].sync();
-        newdifx[fnum].read(reinterpret_cast<char*>(currentVis[i]),Records[rec].byteEnd-Records[rec].byteIni);
-      } else {
-        // nuke values that would have been overwritten by the missing data
-        for (k=0; k<Freqs[currFreq].Nchan; k++) {
-          currentVis[i][k] = (std::complex<float>)0;
-        };
-      };
+};
+
+
+
+
+// Reads (or writes) size bytes at offset, retrying the partial transfers:
+static bool readAt(int fd, char *buff, long size, long offset){
+
+  ssize_t done;
+
+  while (size > 0){
+    done = pread(fd, buff, size, offset);
+    if (done < 0 && errno == EINTR){continue;};
+    if (done <= 0){return false;};
+    buff += done; size -= done; offset += done;
+  };
+  return true;
+
+};
+
+
+static bool writeAt(int fd, struct iovec *iov, int n, long offset){
+
+  ssize_t done;
+
+  while (n > 0){
+    done = pwritev(fd, iov, n, offset);
+    if (done < 0 && errno == EINTR){continue;};
+    if (done <= 0){return false;};
+    offset += done;
+    while (n > 0 && (size_t) done >= iov->iov_len){done -= iov->iov_len; iov++; n--;};
+    if (n > 0){
+      iov->iov_base = (char *) iov->iov_base + done;
+      iov->iov_len -= done;
     };
+  };
+  return true;
+
+};
+
+
+
+
+// Warnings of the search of a group (and some info of the first group
+// of each IF). Only used in the main thread:
+void DataIOSWIN::logGroup(MixedGroup &G) {
+
+  if (G.Log.size()>0){
+    fprintf(logFile,"%s",G.Log.c_str()); fflush(logFile);
+  };
+
+  if (G.Found && debugNewIF) {    // share information
+     sprintf(message, "  source %d JDTime %lf RelTime %lf conj = %d\n",
+       G.V.Field, G.V.Time, G.V.Time - recTime(0), G.V.Conj);
+     fprintf(logFile,"%s",message); fflush(logFile);
+     debugNewIF = false;
+  };   
+
+};
+
+
+
+
+// Sets the current visibility of a state from a group (its data being 
+// already in S.currentVis):
+void DataIOSWIN::useGroup(VisState &S, MixedVis &V, long bytes) {
 
+  long k;
+
+  S.V = V;
+  if (!V.Complete){S.isTwoLinear=true;};
+  S.Timer->count(Timing::BYTESREAD,bytes);
 
 
 // Case of auto-correlations (in the 2nd round of conversion):
 // Recover the fringe after the 1st round (since sometimes the 
 // file is not flushed properly, so we need an "aux" variable):
 // The auxVis values are captured at the end of applyMatrix
-    isAutoCorr = antenna == otherAnt;
-    if (complete) {
-      if (isAutoCorr || isTwoLinear){
+    S.isAutoCorr = V.Antenna == V.OtherAnt;
+    if (V.Complete) {
+      if (S.isAutoCorr || S.isTwoLinear){
         for (k=0;k<Freqs[currFreq].Nchan; k++) {
-          currentVis[3][k] = auxVis[3][k];
-          currentVis[2][k] = auxVis[2][k];
-          currentVis[0][k] = auxVis[0][k];
-          currentVis[1][k] = auxVis[1][k];
+          S.currentVis[3][k] = S.auxVis[3][k];
+          S.currentVis[2][k] = S.auxVis[2][k];
+          S.currentVis[0][k] = S.auxVis[0][k];
+          S.currentVis[1][k] = S.auxVis[1][k];
         };
       };
     }; 
@@ -896,11 +1542,11 @@ bool DataIOSWIN::getNextMixedVis(double &JDTime, int &antenna, int &otherAnt, bo
 
 
 
-    if (isAutoCorr && !complete){
+    if (S.isAutoCorr && !V.Complete){
 // 1st round of autocorrs. Zero the cross-terms (XY and YX):
         for (k=0;k<Freqs[currFreq].Nchan; k++) {
-          currentVis[2][k] = 0.0;
-          currentVis[3][k] = 0.0;
+          S.currentVis[2][k] = 0.0;
+          S.currentVis[3][k] = 0.0;
         };
     };
 
@@ -914,39 +1560,125 @@ else if (isAutoCorr) {
         };
     };
 */
-   calField = field; 
-   JDTime = time;
-   currConj = conj ;
 
+};
 
-   if (debugNewIF) {    // share information
-      sprintf(message, "  source %d JDTime %lf RelTime %lf conj = %d\n",
-        field, time, time - Records[0].Time, conj);
-      fprintf(logFile,"%s",message); fflush(logFile);
-      debugNewIF = false;
-   };   
 
+
+
+bool DataIOSWIN::getNextMixedVis(double &JDTime, int &antenna, int &otherAnt, bool &conj, int &calField) {
+
+  long rec, k;
+  int i, fnum;
+  MixedGroup *G;
+  MixedGroup Group;
+  std::complex<float> *aux;
+
+  if (NLinVis==0){return false;};
+
+  Timer->start(Timing::READ);
+
+  if (isPipelined){
+
+    if (!ReadStarted){startReader();};
+
+// Take the next group from the reader thread (its data are swapped 
+// with currentVis, so the ring gets the old buffers):
+    if (ReadDone){Timer->stop(Timing::READ); return false;};
+    {
+      std::unique_lock<std::mutex> lock(PipeMutex);
+      ReadCond.wait(lock, [this]{return ReadTail>ReadHead;});
+    }
+    G = &ReadRing[ReadHead%PipeDepth];
+    logGroup(*G);
+    if (G->Found){
+      for (i=0; i<4; i++){
+        aux = Main.currentVis[i]; Main.currentVis[i] = G->Data[i]; G->Data[i] = aux;
+      };
+      useGroup(Main, G->V, G->Bytes);
+    };
+
+// The slot is reused by the reader once it is released:
+    Group.Found = G->Found; Group.V = G->V;
+    {
+      std::lock_guard<std::mutex> lock(PipeMutex);
+      ReadHead += 1;
+      if (!Group.Found){ReadDone = true;};
+    }
+    ReadCond.notify_all();
+    G = &Group;
+
+    if (PipeFailed){
+      success = false;
+      sprintf(message,"\nERROR! COULD NOT READ (OR WRITE) THE SWIN FILES!\n");
+      fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
+    };
+
+  } else {
+
+    G = &Group;
+    findNextGroup(*G);
+    logGroup(*G);
+
+// Get the data:
+    if (G->Found){
+      for (i=0; i<4; i++) {
+        if (G->V.Entries[i]>=0){
+          rec = G->V.Entries[i];
+          fnum = recFile(rec);
+          newdifx[fnum].seekg(recByteIni(rec), newdifx[fnum].beg);
+          newdifx[fnum].sync();
+          newdifx[fnum].read(reinterpret_cast<char*>(Main.currentVis[i]),recByteEnd(rec)-recByteIni(rec));
+          G->Bytes += recByteEnd(rec)-recByteIni(rec);
+        } else {
+          // nuke values that would have been overwritten by the missing data
+          for (k=0; k<Freqs[currFreq].Nchan; k++) {
+            Main.currentVis[i][k] = (std::complex<float>)0;
+          };
+        };
+      };
+      useGroup(Main, G->V, G->Bytes);
+    };
+
+  };
+
+  if (!G->Found){
+    Timer->stop(Timing::READ);
+    return false;
+  };
+
+  currVis = G->V.Rec;
+  currConj = G->V.Conj;
+  calField = G->V.Field; 
+  JDTime = G->V.Time;
+  conj = G->V.Conj;
+  antenna = G->V.Antenna;
+  otherAnt = G->V.OtherAnt;
+
+  Timer->stop(Timing::READ);
  
-   return true;
+  return true;
 
 };
 
 
 
 
-int DataIOSWIN::getFileNumber(){
+int DataIOSWIN::getFileNumber(){return getFileNumber(Main);};
+
+int DataIOSWIN::getFileNumber(VisState &S){
 //  printf("Entering FileNum: %i\n",currFreq);fflush(stdout);
   long rec; int fnum;
   int i;
   for(i=0;i<4;i++){
-    rec = currEntries[currFreq][i];
+    rec = S.V.Entries[i];
     if(rec>=0){break;};
   };
 
 //    printf("REC: %ld\n",rec);fflush(stdout);
 
   if(rec>=0){
-    fnum = Records[rec].fileNumber;
+    fnum = recFile(rec);
   } else {fnum = 0;};
 
  // printf("FNUM: %i\n",fnum);fflush(stdout);
@@ -957,29 +1689,47 @@ int DataIOSWIN::getFileNumber(){
 
 
 
+bool DataIOSWIN::setCurrentMixedVis(){return setCurrentMixedVis(Main);};
 
-bool DataIOSWIN::setCurrentMixedVis() { 
+bool DataIOSWIN::setCurrentMixedVis(VisState &S) { 
 
-  long rec;
+  long rec, size;
   int i, k, l, fnum = 0;
+  struct iovec Vec;
 
-      if (isAutoCorr){
+      if (S.isAutoCorr){
        int TotMedianWindow = 2*AutoCorrMedianFilter+1;
        float *auxMedian = new float[TotMedianWindow];
+       SlidingMedian Median(AutoCorrMedianFilter+1);
 
 // 2nd round of autocorrs -> apply median filter.
+// auxMedian keeps the value that each channel of the window has in Median.
+// Notice that the filtered channels enter the windows of the next ones 
+// (i.e., the filter is applied in place).
         if(AutoCorrMedianFilter>0 && AutoCorrMedianFilter<Freqs[currFreq].Nchan){
-          for (k=0;k<AutoCorrMedianFilter;k++){bufferVis[2][k] = 0.0; bufferVis[3][k]=0.0;};
-          for (k=Freqs[currFreq].Nchan-AutoCorrMedianFilter;k<Freqs[currFreq].Nchan;k++){bufferVis[2][k] = 0.0; bufferVis[3][k]=0.0;};
+          for (k=0;k<AutoCorrMedianFilter;k++){S.bufferVis[2][k] = 0.0; S.bufferVis[3][k]=0.0;};
+          for (k=Freqs[currFreq].Nchan-AutoCorrMedianFilter;k<Freqs[currFreq].Nchan;k++){S.bufferVis[2][k] = 0.0; S.bufferVis[3][k]=0.0;};
+
+          for (l=0; l<TotMedianWindow-1 && l<Freqs[currFreq].Nchan; l++){
+             auxMedian[l] = (std::abs(S.bufferVis[0][l])+std::abs(S.bufferVis[1][l]))/2.;
+             Median.add(auxMedian[l]);
+          };
 
           for (k=AutoCorrMedianFilter;k<Freqs[currFreq].Nchan-AutoCorrMedianFilter; k++) {
-             for(l=0;l<TotMedianWindow;l++){
-                auxMedian[l] = (std::abs(bufferVis[0][k-AutoCorrMedianFilter+l])+std::abs(bufferVis[1][k-AutoCorrMedianFilter+l]))/2.;
-             };
-             std::sort(auxMedian,auxMedian+TotMedianWindow);
-             bufferVis[0][k] = auxMedian[AutoCorrMedianFilter];
-             bufferVis[1][k] = bufferVis[0][k];
-             bufferVis[2][k] = 0.0; bufferVis[3][k]=0.0;
+             l = (k+AutoCorrMedianFilter)%TotMedianWindow;
+             auxMedian[l] = (std::abs(S.bufferVis[0][k+AutoCorrMedianFilter])+std::abs(S.bufferVis[1][k+AutoCorrMedianFilter]))/2.;
+             Median.add(auxMedian[l]);
+
+             S.bufferVis[0][k] = Median.lower();
+             S.bufferVis[1][k] = S.bufferVis[0][k];
+             S.bufferVis[2][k] = 0.0; S.bufferVis[3][k]=0.0;
+
+// Update the filtered channel and drop the first one of the window:
+             l = k%TotMedianWindow;
+             Median.remove(auxMedian[l]);
+             auxMedian[l] = (std::abs(S.bufferVis[0][k])+std::abs(S.bufferVis[1][k]))/2.;
+             Median.add(auxMedian[l]);
+             Median.remove(auxMedian[(k-AutoCorrMedianFilter)%TotMedianWindow]);
           };
         };
         delete[] auxMedian;
@@ -987,55 +1737,644 @@ bool DataIOSWIN::setCurrentMixedVis() {
 
 // Write:
 
+  S.Timer->start(Timing::WRITE);
+
+  if (S.isBlock){
+    for (i=0; i<4; i++) {
+      if (S.V.Entries[i]>=0){
+        rec = S.V.Entries[i];
+        size = recByteEnd(rec)-recByteIni(rec);
+        Vec.iov_base = S.bufferVis[i]; Vec.iov_len = size;
+        if (!writeAt(PipeFiles[recFile(rec)], &Vec, 1, recByteIni(rec))){PipeFailed = true;};
+        S.Timer->count(Timing::BYTESWRITTEN,size);
+      };
+    };
+    S.Timer->stop(Timing::WRITE);
+    return true;
+  };
+
+  if (isPipelined){
+    queueWrite(S, false);
+    S.Timer->stop(Timing::WRITE);
+    return true;
+  };
 
   for (i=0; i<4; i++) {
-    if (currEntries[currFreq][i]>=0){
-      rec = currEntries[currFreq][i];
-      fnum = Records[rec].fileNumber;
-      newdifx[fnum].seekp(Records[rec].byteIni, newdifx[fnum].beg);
-      newdifx[fnum].write(reinterpret_cast<char*>(bufferVis[i]),Records[rec].byteEnd-Records[rec].byteIni);
+    if (S.V.Entries[i]>=0){
+      rec = S.V.Entries[i];
+      fnum = recFile(rec);
+      newdifx[fnum].seekp(recByteIni(rec), newdifx[fnum].beg);
+      newdifx[fnum].write(reinterpret_cast<char*>(S.bufferVis[i]),recByteEnd(rec)-recByteIni(rec));
       newdifx[fnum].flush();
       newdifx[fnum].clear();
+      S.Timer->count(Timing::BYTESWRITTEN,recByteEnd(rec)-recByteIni(rec));
     };
   };
 
+  S.Timer->stop(Timing::WRITE);
+
   return true;
 };
 
 
 
 
-void DataIOSWIN::zeroWeight(){
+void DataIOSWIN::zeroWeight(){zeroWeight(Main);};
 
+void DataIOSWIN::zeroWeight(VisState &S){
+
+  static const double ZEROWEIGHT = 0.0;
   long rec;
   int i, fnum = 0;
   double zero = 0.0;
+  struct iovec Vec;
 
 // Write:
 
+  S.Timer->start(Timing::WRITE);
+
+  if (S.isBlock){
+    for (i=0; i<4; i++) {
+      if (S.V.Entries[i]>=0){
+        rec = S.V.Entries[i];
+        Vec.iov_base = const_cast<double*>(&ZEROWEIGHT); Vec.iov_len = sizeof(double);
+        if (!writeAt(PipeFiles[recFile(rec)], &Vec, 1, recByteIni(rec) - 4*sizeof(double))){
+          PipeFailed = true;
+        };
+        S.Timer->count(Timing::BYTESWRITTEN,sizeof(double));
+      };
+    };
+    S.Timer->stop(Timing::WRITE);
+    return;
+  };
+
+  if (isPipelined){
+    queueWrite(S, true);
+    S.Timer->stop(Timing::WRITE);
+    return;
+  };
+
   for (i=0; i<4; i++) {
-    if (currEntries[currFreq][i]>=0){
-      rec = currEntries[currFreq][i];
-      fnum = Records[rec].fileNumber;
-      newdifx[fnum].seekp(Records[rec].byteIni - 4*sizeof(double), newdifx[fnum].beg);
+    if (S.V.Entries[i]>=0){
+      rec = S.V.Entries[i];
+      fnum = recFile(rec);
+      newdifx[fnum].seekp(recByteIni(rec) - 4*sizeof(double), newdifx[fnum].beg);
       newdifx[fnum].write(reinterpret_cast<char*>(&zero),sizeof(double));
       newdifx[fnum].flush();
+      S.Timer->count(Timing::BYTESWRITTEN,sizeof(double));
     };
   };
 
   newdifx[fnum].clear();
+
+  S.Timer->stop(Timing::WRITE);
 };
 
 
 
 
 
+///////////////////////
+// PIPELINED MODE:
+
+
+// Starts the writer thread (and allocates the queues). The pipeline is
+// not used if any SWIN file cannot be opened for direct I/O:
+void DataIOSWIN::startPipeline(){
+
+  int i, j;
+  long groupSize;
+  char *pipeDepth;
+
+// With only one core, the threads would just compete with the conversion:
+  PipeDepth = std::thread::hardware_concurrency() > 1 ? PIPEDEPTH : 0;
+  pipeDepth = getenv("POLCONVERT_PIPELINE");
+  if (pipeDepth != NULL){PipeDepth = atoi(pipeDepth);};
+  if (PipeDepth <= 0 || NLinVis==0){return;};
+
+// A group in each queue takes 2x4 visibility buffers:
+  groupSize = 8*((long) MaxNChan+1)*sizeof(std::complex<float>);
+  if (PipeDepth > PIPEMEMORY/groupSize){PipeDepth = (int) (PIPEMEMORY/groupSize);};
+  if (PipeDepth < 2){PipeDepth = 2;};
+
+  if (!openDirect()){
+    sprintf(message,"Will not use the pipelined mode.\n");
+    fprintf(logFile,"%s",message); fflush(logFile);
+    return;
+  };
+
+  ReadRing = new MixedGroup[PipeDepth];
+  WriteRing = new PendingWrite[PipeDepth];
+  for (i=0; i<PipeDepth; i++){
+    for (j=0; j<4; j++){
+      ReadRing[i].Data[j] = new std::complex<float>[MaxNChan+1];
+      WriteRing[i].Buffer[j] = new std::complex<float>[MaxNChan+1];
+    };
+  };
+
+  ReadHead = 0; ReadTail = 0; WriteHead = 0; WriteTail = 0;
+  PipeStop = false; WriterDone = false; ReadDone = false; PipeFailed = false;
+  isPipelined = true;
+  Writer = std::thread(&DataIOSWIN::writeBehind, this);
+
+  sprintf(message,"\nPipelined read/write of the SWIN files (%i groups per queue).\n",PipeDepth);
+  fprintf(logFile,"%s",message); fflush(logFile);
+
+};
+
+
+
+
+// Waits for all the pending writes and frees the queues:
+void DataIOSWIN::stopPipeline(){
+
+  int i, j;
+
+  if (!isPipelined){return;};
+
+  stopReader();
+
+  {
+    std::lock_guard<std::mutex> lock(PipeMutex);
+    WriterDone = true;
+  }
+  WriteCond.notify_all();
+  if (Writer.joinable()){Writer.join();};
+
+  for (i=0; i<PipeDepth; i++){
+    for (j=0; j<4; j++){
+      delete[] ReadRing[i].Data[j];
+      delete[] WriteRing[i].Buffer[j];
+    };
+  };
+  delete[] ReadRing; ReadRing = nullptr;
+  delete[] WriteRing; WriteRing = nullptr;
+
+  isPipelined = false;
+
+};
+
+
+
+
+// Descriptors for the reads and writes of the threads (pread/pwrite 
+// are thread-safe, unlike the streams):
+bool DataIOSWIN::openDirect(){
+
+  int i, j;
+
+  if (PipeFiles != nullptr){return true;};
+
+// The streams may still have buffered data (e.g., the pol. labels):
+  PipeFiles = new int[nfiles];
+  for (i=0; i<nfiles; i++){
+    newdifx[i].flush();
+    PipeFiles[i] = open(swinNames[i].c_str(), O_RDWR);
+    if (PipeFiles[i] < 0){
+      for (j=0; j<i; j++){close(PipeFiles[j]);};
+      delete[] PipeFiles; PipeFiles = nullptr;
+      sprintf(message,"\nWARNING: Cannot open %s for direct I/O.\n",
+              swinNames[i].c_str());
+      fprintf(logFile,"%s",message); fflush(logFile);
+      return false;
+    };
+  };
+
+  return true;
+
+};
+
+
+void DataIOSWIN::closeDirect(){
+
+  int i;
+
+  if (PipeFiles == nullptr){return;};
+
+  for (i=0; i<nfiles; i++){
+    if (close(PipeFiles[i]) != 0){PipeFailed = true;};
+  };
+  delete[] PipeFiles; PipeFiles = nullptr;
+
+  if (PipeFailed){
+    success = false;
+    sprintf(message,"\nERROR! COULD NOT READ (OR WRITE) THE SWIN FILES!\n");
+    fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
+  };
+
+};
+
+
+
+
+// Reads the products of a group (the missing ones are zeroed):
+void DataIOSWIN::readDirect(MixedVis &V, std::complex<float> **Data, long &bytes){
+
+  long rec, size, k;
+  int i;
+
+  bytes = 0;
+  for (i=0; i<4; i++){
+    if (V.Entries[i]>=0){
+      rec = V.Entries[i];
+      size = recByteEnd(rec)-recByteIni(rec);
+      if (!readAt(PipeFiles[recFile(rec)], reinterpret_cast<char*>(Data[i]),
+                  size, recByteIni(rec))){PipeFailed = true;};
+      bytes += size;
+    } else {
+      // nuke values that would have been overwritten by the missing data
+      for (k=0; k<Freqs[currFreq].Nchan; k++){
+        Data[i][k] = (std::complex<float>)0;
+      };
+    };
+  };
+
+};
+
+
+
+
+// The reader works on one IF (it is restarted by setCurrentIF):
+void DataIOSWIN::startReader(){
+
+  ReadHead = 0; ReadTail = 0;
+  PipeStop = false; ReadDone = false; ReadStarted = true;
+  Reader = std::thread(&DataIOSWIN::prefetch, this);
+
+};
+
+
+void DataIOSWIN::stopReader(){
+
+  if (!Reader.joinable()){return;};
+
+  {
+    std::lock_guard<std::mutex> lock(PipeMutex);
+    PipeStop = true;
+  }
+  ReadCond.notify_all();
+  Reader.join();
+
+  ReadHead = 0; ReadTail = 0;
+  PipeStop = false;
+
+};
+
+
+
+
+// Reader thread. Finds the groups of the current IF and reads their data,
+// as long as there is room in the ring. The last group has Found=false:
+void DataIOSWIN::prefetch(){
+
+  MixedGroup *G;
+
+  while (true){
+
+    {
+      std::unique_lock<std::mutex> lock(PipeMutex);
+      ReadCond.wait(lock, [this]{return PipeStop || ReadTail-ReadHead < PipeDepth;});
+      if (PipeStop){return;};
+      G = &ReadRing[ReadTail%PipeDepth];
+    }
+
+    findNextGroup(*G);
+
+    if (G->Found){readDirect(G->V, G->Data, G->Bytes);};
+
+    {
+      std::lock_guard<std::mutex> lock(PipeMutex);
+      ReadTail += 1;
+    }
+    ReadCond.notify_all();
+
+    if (!G->Found){return;};
+
+  };
+
+};
+
+
+
+
+// Copies the converted data (or the zero weights) of the current 
+// visibility to the write queue (waits if the queue is full):
+void DataIOSWIN::queueWrite(VisState &S, bool weights){
+
+  static const double ZEROWEIGHT = 0.0;
+  long rec;
+  int i;
+  PendingWrite *W;
+
+  {
+    std::unique_lock<std::mutex> lock(PipeMutex);
+    WriteCond.wait(lock, [this]{return WriteTail-WriteHead < PipeDepth;});
+    W = &WriteRing[WriteTail%PipeDepth];
+  }
+
+  for (i=0; i<4; i++){
+    W->Size[i] = 0;
+    if (S.V.Entries[i]>=0){
+      rec = S.V.Entries[i];
+      W->File[i] = recFile(rec);
+      if (weights){
+        W->Offset[i] = recByteIni(rec) - 4*sizeof(double);
+        W->Size[i] = sizeof(double);
+        W->Data[i] = reinterpret_cast<const char*>(&ZEROWEIGHT);
+      } else {
+        W->Offset[i] = recByteIni(rec);
+        W->Size[i] = recByteEnd(rec)-recByteIni(rec);
+        memcpy(W->Buffer[i], S.bufferVis[i], W->Size[i]);
+        W->Data[i] = reinterpret_cast<const char*>(W->Buffer[i]);
+      };
+      S.Timer->count(Timing::BYTESWRITTEN,W->Size[i]);
+    };
+  };
+
+  {
+    std::lock_guard<std::mutex> lock(PipeMutex);
+    WriteTail += 1;
+  }
+  WriteCond.notify_all();
+
+};
+
+
+
+
+// One write of the writer thread (Order is its position in the queue):
+typedef struct {int File; long Offset, Size, Order; const char *Data;} WritePiece;
+
+
+// Writer thread. Takes all the pending groups, sorts their writes by file
+// and offset (keeping only the last write of each position) and merges 
+// the contiguous ones into one system call:
+void DataIOSWIN::writeBehind(){
+
+  long first, last, j;
+  int i;
+  size_t p, q, n;
+  std::vector<WritePiece> Pieces;
+  std::vector<struct iovec> Iov;
+  WritePiece Piece;
+  struct iovec Vec;
+
+  while (true){
+
+    {
+      std::unique_lock<std::mutex> lock(PipeMutex);
+      WriteCond.wait(lock, [this]{return WriterDone || WriteTail > WriteHead;});
+      if (WriteTail == WriteHead){return;};
+      first = WriteHead; last = WriteTail;
+    }
+
+    Pieces.clear();
+    for (j=first; j<last; j++){
+      PendingWrite &W = WriteRing[j%PipeDepth];
+      for (i=0; i<4; i++){
+        if (W.Size[i]>0){
+          Piece.File = W.File[i]; Piece.Offset = W.Offset[i];
+          Piece.Size = W.Size[i]; Piece.Order = 4*j+i; Piece.Data = W.Data[i];
+          Pieces.push_back(Piece);
+        };
+      };
+    };
+
+    std::sort(Pieces.begin(), Pieces.end(), [](const WritePiece &a, const WritePiece &b){
+      if (a.File != b.File){return a.File < b.File;};
+      if (a.Offset != b.Offset){return a.Offset < b.Offset;};
+      return a.Order < b.Order;});
+
+// Drop the writes that are overwritten later (e.g., the 1st round of 
+// the autocorrelations):
+    n = 0;
+    for (p=0; p<Pieces.size(); p++){
+      if (n>0 && Pieces[n-1].File == Pieces[p].File && Pieces[n-1].Offset == Pieces[p].Offset){
+        Pieces[n-1] = Pieces[p];
+      } else {
+        Pieces[n] = Pieces[p]; n += 1;
+      };
+    };
+
+    for (p=0; p<n; p=q){
+      Iov.clear();
+      q = p;
+      do {
+        Vec.iov_base = const_cast<char*>(Pieces[q].Data);
+        Vec.iov_len = Pieces[q].Size;
+        Iov.push_back(Vec);
+        q += 1;
+      } while (q<n && Iov.size()<IOV_MAX && Pieces[q].File == Pieces[p].File &&
+               Pieces[q].Offset == Pieces[q-1].Offset + Pieces[q-1].Size);
+      if (!writeAt(PipeFiles[Pieces[p].File], &Iov[0], (int) Iov.size(), Pieces[p].Offset)){
+        PipeFailed = true;
+      };
+    };
+
+    {
+      std::lock_guard<std::mutex> lock(PipeMutex);
+      WriteHead = last;
+    }
+    WriteCond.notify_all();
+
+  };
+
+};
+
+
+
+
+
+
+///////////////////////
+// PARALLEL CONVERSION (OF TIME BLOCKS OF AN IF):
+
+
+int DataIOSWIN::splitIF(int nBlocks){
+
+  MixedGroup G;
+  long n, k;
+  int b;
+
+  IFGroups.clear(); BlockStart.clear();
+  if (NLinVis==0 || ReadStarted || nBlocks<1 || !openDirect()){return 0;};
+
+// Same search as in getNextMixedVis (the warnings are printed here):
+  while (true){
+    findNextGroup(G);
+    logGroup(G);
+    if (!G.Found){break;};
+    IFGroups.push_back(G.V);
+  };
+
+// The blocks start at a change of time:
+  n = IFGroups.size();
+  BlockStart.push_back(0);
+  for (b=1; b<nBlocks; b++){
+    k = std::max(n*b/nBlocks, BlockStart.back()+1);
+    while (k<n && IFGroups[k].Time == IFGroups[k-1].Time){k++;};
+    if (k>=n){break;};
+    BlockStart.push_back(k);
+  };
+  BlockStart.push_back(n);
+
+  return (int) BlockStart.size()-1;
+
+};
+
+
+
+
+VisState *DataIOSWIN::newState(Timing *timer){
+
+  int i;
+  VisState *S = new VisState;
+
+  for (i=0; i<4; i++){
+    S->currentVis[i] = new std::complex<float>[MaxNChan+1];
+    S->bufferVis[i] = new std::complex<float>[MaxNChan+1];
+    S->auxVis[i] = new std::complex<float>[MaxNChan+1];
+    S->V.Entries[i] = -1;
+  };
+  S->V.Rec = 0;
+  S->isAutoCorr = false; S->isTwoLinear = false; S->isBlock = true;
+  S->Next = 0; S->End = 0;
+  S->Timer = timer;
+
+  return S;
+
+};
+
+
+void DataIOSWIN::freeState(VisState *S){
+
+  int i;
+
+  for (i=0; i<4; i++){
+    delete[] S->currentVis[i];
+    delete[] S->bufferVis[i];
+    delete[] S->auxVis[i];
+  };
+  delete S;
+
+};
+
+
+
+
+bool DataIOSWIN::setBlock(VisState &S, int block){
+
+  long k;
+  int i;
+
+  if (block<0 || block >= (int) BlockStart.size()-1){return false;};
+
+  S.Next = BlockStart[block];
+  S.End = BlockStart[block+1];
+  S.isAutoCorr = false; S.isTwoLinear = false;
+  for (i=0; i<4; i++){
+    for (k=0; k<=MaxNChan; k++){S.auxVis[i][k] = (std::complex<float>)0.0;};
+  };
+
+  return true;
+
+};
+
+
+
+
+void DataIOSWIN::getTimesBefore(int block, int antenna, std::vector<double> &Times, 
+                                std::vector<int> &Files){
+
+  long k;
+  int i, fnum;
+
+  Times.clear(); Files.clear();
+  if (block<0 || block >= (int) BlockStart.size()){return;};
+
+  for (k=0; k<BlockStart[block]; k++){
+    if (IFGroups[k].Antenna == antenna && (Times.empty() || Times.back() != IFGroups[k].Time)){
+// As in getFileNumber:
+      fnum = 0;
+      for (i=0; i<4; i++){
+        if (IFGroups[k].Entries[i]>=0){fnum = recFile(IFGroups[k].Entries[i]); break;};
+      };
+      Times.push_back(IFGroups[k].Time);
+      Files.push_back(fnum);
+    };
+  };
+
+};
+
+
+
+
+bool DataIOSWIN::getNextMixedVis(VisState &S, double &JDTime, int &antenna, int &otherAnt, bool &conj, int &calField){
+
+  long bytes;
+
+  if (S.Next >= S.End){return false;};
+
+  S.Timer->start(Timing::READ);
+
+  MixedVis &V = IFGroups[S.Next];
+  S.Next += 1;
+  readDirect(V, S.currentVis, bytes);
+  useGroup(S, V, bytes);
+
+  calField = V.Field;
+  JDTime = V.Time;
+  conj = V.Conj;
+  antenna = V.Antenna;
+  otherAnt = V.OtherAnt;
+
+  S.Timer->stop(Timing::READ);
+
+  return true;
+
+};
+
+
+
+
+bool DataIOSWIN::endBlocks(){
+
+  IFGroups.clear(); BlockStart.clear();
+
+  if (PipeFailed){
+    success = false;
+    sprintf(message,"\nERROR! COULD NOT READ (OR WRITE) THE SWIN FILES!\n");
+    fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
+  };
+
+  return !PipeFailed;
+
+};
+
+
+bool DataIOSWIN::ioFailed(){return PipeFailed;};
+
+void DataIOSWIN::setIOFailed(){PipeFailed = true;};
+
+
+
+
+
+
 void DataIOSWIN::applyMatrix(std::complex<float> *M[2][2], bool swap, 
                bool print, int thisAnt, FILE *plotFile) {
+  applyMatrix(Main, M, swap, print, thisAnt, plotFile);
+};
+
+
+void DataIOSWIN::applyMatrix(VisState &S, std::complex<float> *M[2][2], bool swap, 
+               bool print, int thisAnt, FILE *plotFile) {
  
   long k, a11, a12, a21, a22, ca11, ca12, ca21, ca22;
   std::complex<float>  auxVisApply;
   int i;
+  int plotFnum, plotAnts[2];
+  double plotTime, plotPA[2], plotUV;
 
   a11 = 0;
   a22 = 1;
@@ -1049,83 +2388,123 @@ void DataIOSWIN::applyMatrix(std::complex<float> *M[2][2], bool swap,
 
 
 
+  S.Timer->start(Timing::APPLY);
+
   for (k=0; k<Freqs[currFreq].Nchan; k++) {
 
-   if (currConj) {
-      bufferVis[ca11][k] = M[0][0][k]*currentVis[a11][k]+M[0][1][k]*currentVis[a21][k];
-      bufferVis[ca12][k] = M[0][0][k]*currentVis[a12][k]+M[0][1][k]*currentVis[a22][k];
-      bufferVis[ca21][k] = M[1][0][k]*currentVis[a11][k]+M[1][1][k]*currentVis[a21][k];
-      bufferVis[ca22][k] = M[1][0][k]*currentVis[a12][k]+M[1][1][k]*currentVis[a22][k];
-      if (doParang && ParAng[0][currVis]>-1.e8){
-        auxVisApply = std::polar((float)1.,(float)ParAng[0][currVis]);
-        bufferVis[ca11][k] *= auxVisApply;
-        bufferVis[ca12][k] *= auxVisApply;
-        bufferVis[ca21][k] /= auxVisApply;
-        bufferVis[ca22][k] /= auxVisApply;
+   if (S.V.Conj) {
+      S.bufferVis[ca11][k] = M[0][0][k]*S.currentVis[a11][k]+M[0][1][k]*S.currentVis[a21][k];
+      S.bufferVis[ca12][k] = M[0][0][k]*S.currentVis[a12][k]+M[0][1][k]*S.currentVis[a22][k];
+      S.bufferVis[ca21][k] = M[1][0][k]*S.currentVis[a11][k]+M[1][1][k]*S.currentVis[a21][k];
+      S.bufferVis[ca22][k] = M[1][0][k]*S.currentVis[a12][k]+M[1][1][k]*S.currentVis[a22][k];
+      if (doParang && Records[S.V.Rec].ParAng[0]>-1.e8){
+        auxVisApply = std::polar((float)1.,Records[S.V.Rec].ParAng[0]);
+        S.bufferVis[ca11][k] *= auxVisApply;
+        S.bufferVis[ca12][k] *= auxVisApply;
+        S.bufferVis[ca21][k] /= auxVisApply;
+        S.bufferVis[ca22][k] /= auxVisApply;
       };
    } else {
-      bufferVis[ca11][k] = std::conj(M[0][0][k])*currentVis[a11][k]+std::conj(M[0][1][k])*currentVis[a12][k];
-      bufferVis[ca12][k] = std::conj(M[1][0][k])*currentVis[a11][k]+std::conj(M[1][1][k])*currentVis[a12][k];
-      bufferVis[ca21][k] = std::conj(M[0][0][k])*currentVis[a21][k]+std::conj(M[0][1][k])*currentVis[a22][k];
-      bufferVis[ca22][k] = std::conj(M[1][0][k])*currentVis[a21][k]+std::conj(M[1][1][k])*currentVis[a22][k];
-      if (doParang && ParAng[1][currVis]>-1.e8){
-        auxVisApply = std::polar((float)1.,(float)ParAng[1][currVis]);
-        bufferVis[ca11][k] /= auxVisApply;
-        bufferVis[ca12][k] *= auxVisApply;
-        bufferVis[ca21][k] /= auxVisApply;
-        bufferVis[ca22][k] *= auxVisApply;
+      S.bufferVis[ca11][k] = std::conj(M[0][0][k])*S.currentVis[a11][k]+std::conj(M[0][1][k])*S.currentVis[a12][k];
+      S.bufferVis[ca12][k] = std::conj(M[1][0][k])*S.currentVis[a11][k]+std::conj(M[1][1][k])*S.currentVis[a12][k];
+      S.bufferVis[ca21][k] = std::conj(M[0][0][k])*S.currentVis[a21][k]+std::conj(M[0][1][k])*S.currentVis[a22][k];
+      S.bufferVis[ca22][k] = std::conj(M[1][0][k])*S.currentVis[a21][k]+std::conj(M[1][1][k])*S.currentVis[a22][k];
+      if (doParang && Records[S.V.Rec].ParAng[1]>-1.e8){
+        auxVisApply = std::polar((float)1.,Records[S.V.Rec].ParAng[1]);
+        S.bufferVis[ca11][k] /= auxVisApply;
+        S.bufferVis[ca12][k] *= auxVisApply;
+        S.bufferVis[ca21][k] /= auxVisApply;
+        S.bufferVis[ca22][k] *= auxVisApply;
       };
    };
+  };  // end of for loop
+
+
+
+///////////////////////////////////
+// UPDATE THE AUXILIAR VISIBILITIES (I.E. FOR AUTOCORRS WITH MISSING CROSS-POLS):
 
 
-   if (print && canPlot) {
-     if (currConj){
+ for (i=0; i<4; i++) {
+  if (S.V.Entries[i]<0 || S.isAutoCorr || S.isTwoLinear ) {
+   if (!S.V.CanPlot){ // Case of auto-correlations (2nd round of conversion):   
+    for(k=0;k<Freqs[currFreq].Nchan; k++) {
+      S.auxVis[i][k] = S.bufferVis[i][k];
+    };
+   } else {
+    for(k=0;k<Freqs[currFreq].Nchan; k++) {
+      S.auxVis[i][k] = (std::complex<float>)0.0;
+    };
+    if(i==3){S.isTwoLinear=false;};
+   };
+  }; 
+ };
+///////////////////////////////////
+
+  S.Timer->stop(Timing::APPLY);
+
+
+// Write the plot (or solve) file:
+  if (print && S.V.CanPlot) {
+
+  S.Timer->start(Timing::PLOT);
+
+  for (k=0; k<Freqs[currFreq].Nchan; k++) {
+     if (S.V.Conj){
      if (k==0){
-       fwrite(&Records[currVis].fileNumber,sizeof(int),1,plotFile);
-       fwrite(&Records[currVis].Time,sizeof(double),1,plotFile);
-       fwrite(&Records[currVis].Antennas[0],sizeof(int),1,plotFile);
-       fwrite(&Records[currVis].Antennas[1],sizeof(int),1,plotFile);
-       fwrite(&ParAng[0][currVis],sizeof(double),1,plotFile);
-       fwrite(&ParAng[1][currVis],sizeof(double),1,plotFile);
-       fwrite(&UVDist[currVis],sizeof(double),1,plotFile);
+       plotFnum = recFile(S.V.Rec); plotTime = recTime(S.V.Rec);
+       plotAnts[0] = Records[S.V.Rec].Antennas[0]; plotAnts[1] = Records[S.V.Rec].Antennas[1];
+       plotPA[0] = Records[S.V.Rec].ParAng[0]; plotPA[1] = Records[S.V.Rec].ParAng[1];
+       plotUV = Records[S.V.Rec].UVDist;
+       fwrite(&plotFnum,sizeof(int),1,plotFile);
+       fwrite(&plotTime,sizeof(double),1,plotFile);
+       fwrite(&plotAnts[0],sizeof(int),1,plotFile);
+       fwrite(&plotAnts[1],sizeof(int),1,plotFile);
+       fwrite(&plotPA[0],sizeof(double),1,plotFile);
+       fwrite(&plotPA[1],sizeof(double),1,plotFile);
+       fwrite(&plotUV,sizeof(double),1,plotFile);
      };
-     fwrite(&currentVis[a11][k],sizeof(std::complex<float>),1,plotFile);
-     fwrite(&currentVis[a12][k],sizeof(std::complex<float>),1,plotFile);
-     fwrite(&currentVis[a21][k],sizeof(std::complex<float>),1,plotFile);
-     fwrite(&currentVis[a22][k],sizeof(std::complex<float>),1,plotFile);
-     fwrite(&bufferVis[ca11][k],sizeof(std::complex<float>),1,plotFile);
-     fwrite(&bufferVis[ca12][k],sizeof(std::complex<float>),1,plotFile);
-     fwrite(&bufferVis[ca21][k],sizeof(std::complex<float>),1,plotFile);
-     fwrite(&bufferVis[ca22][k],sizeof(std::complex<float>),1,plotFile);
+     fwrite(&S.currentVis[a11][k],sizeof(std::complex<float>),1,plotFile);
+     fwrite(&S.currentVis[a12][k],sizeof(std::complex<float>),1,plotFile);
+     fwrite(&S.currentVis[a21][k],sizeof(std::complex<float>),1,plotFile);
+     fwrite(&S.currentVis[a22][k],sizeof(std::complex<float>),1,plotFile);
+     fwrite(&S.bufferVis[ca11][k],sizeof(std::complex<float>),1,plotFile);
+     fwrite(&S.bufferVis[ca12][k],sizeof(std::complex<float>),1,plotFile);
+     fwrite(&S.bufferVis[ca21][k],sizeof(std::complex<float>),1,plotFile);
+     fwrite(&S.bufferVis[ca22][k],sizeof(std::complex<float>),1,plotFile);
      fwrite(&M[0][0][k],sizeof(std::complex<float>),1,plotFile);
      fwrite(&M[0][1][k],sizeof(std::complex<float>),1,plotFile);
      fwrite(&M[1][0][k],sizeof(std::complex<float>),1,plotFile);
      fwrite(&M[1][1][k],sizeof(std::complex<float>),1,plotFile);
      } else {
      if (k==0){
-       fwrite(&Records[currVis].fileNumber,sizeof(int),1,plotFile);
-       fwrite(&Records[currVis].Time,sizeof(double),1,plotFile);
-       fwrite(&Records[currVis].Antennas[1],sizeof(int),1,plotFile);
-       fwrite(&Records[currVis].Antennas[0],sizeof(int),1,plotFile);
-       fwrite(&ParAng[1][currVis],sizeof(double),1,plotFile);
-       fwrite(&ParAng[0][currVis],sizeof(double),1,plotFile);
-       fwrite(&UVDist[currVis],sizeof(double),1,plotFile);
+       plotFnum = recFile(S.V.Rec); plotTime = recTime(S.V.Rec);
+       plotAnts[0] = Records[S.V.Rec].Antennas[0]; plotAnts[1] = Records[S.V.Rec].Antennas[1];
+       plotPA[0] = Records[S.V.Rec].ParAng[0]; plotPA[1] = Records[S.V.Rec].ParAng[1];
+       plotUV = Records[S.V.Rec].UVDist;
+       fwrite(&plotFnum,sizeof(int),1,plotFile);
+       fwrite(&plotTime,sizeof(double),1,plotFile);
+       fwrite(&plotAnts[1],sizeof(int),1,plotFile);
+       fwrite(&plotAnts[0],sizeof(int),1,plotFile);
+       fwrite(&plotPA[1],sizeof(double),1,plotFile);
+       fwrite(&plotPA[0],sizeof(double),1,plotFile);
+       fwrite(&plotUV,sizeof(double),1,plotFile);
      };
-     auxVisApply = std::conj(currentVis[a11][k]);
+     auxVisApply = std::conj(S.currentVis[a11][k]);
      fwrite(&auxVisApply,sizeof(std::complex<float>),1,plotFile);
-     auxVisApply = std::conj(currentVis[a21][k]);
+     auxVisApply = std::conj(S.currentVis[a21][k]);
      fwrite(&auxVisApply,sizeof(std::complex<float>),1,plotFile);
-     auxVisApply = std::conj(currentVis[a12][k]);
+     auxVisApply = std::conj(S.currentVis[a12][k]);
      fwrite(&auxVisApply,sizeof(std::complex<float>),1,plotFile);
-     auxVisApply = std::conj(currentVis[a22][k]);
+     auxVisApply = std::conj(S.currentVis[a22][k]);
      fwrite(&auxVisApply,sizeof(std::complex<float>),1,plotFile);
-     auxVisApply = std::conj(bufferVis[ca11][k]);
+     auxVisApply = std::conj(S.bufferVis[ca11][k]);
      fwrite(&auxVisApply,sizeof(std::complex<float>),1,plotFile);
-     auxVisApply = std::conj(bufferVis[ca21][k]);
+     auxVisApply = std::conj(S.bufferVis[ca21][k]);
      fwrite(&auxVisApply,sizeof(std::complex<float>),1,plotFile);
-     auxVisApply = std::conj(bufferVis[ca12][k]);
+     auxVisApply = std::conj(S.bufferVis[ca12][k]);
      fwrite(&auxVisApply,sizeof(std::complex<float>),1,plotFile);
-     auxVisApply = std::conj(bufferVis[ca22][k]);
+     auxVisApply = std::conj(S.bufferVis[ca22][k]);
      fwrite(&auxVisApply,sizeof(std::complex<float>),1,plotFile);
      auxVisApply = std::conj(M[0][0][k]);
      fwrite(&auxVisApply,sizeof(std::complex<float>),1,plotFile);
@@ -1137,30 +2516,13 @@ void DataIOSWIN::applyMatrix(std::complex<float> *M[2][2], bool swap,
      fwrite(&auxVisApply,sizeof(std::complex<float>),1,plotFile);
      };
 
-   };  // end of print && canPlot
   };  // end of for loop
 
+  S.Timer->stop(Timing::PLOT);
+  S.Timer->count(Timing::PLOTRECORDS,1);
 
+  };  // end of print && S.V.CanPlot
 
-///////////////////////////////////
-// UPDATE THE AUXILIAR VISIBILITIES (I.E. FOR AUTOCORRS WITH MISSING CROSS-POLS):
-
-
- for (i=0; i<4; i++) {
-  if (currEntries[currFreq][i]<0 || isAutoCorr || isTwoLinear ) {
-   if (!canPlot){ // Case of auto-correlations (2nd round of conversion):   
-    for(k=0;k<Freqs[currFreq].Nchan; k++) {
-      auxVis[i][k] = bufferVis[i][k];
-    };
-   } else {
-    for(k=0;k<Freqs[currFreq].Nchan; k++) {
-      auxVis[i][k] = (std::complex<float>)0.0;
-    };
-    if(i==3){isTwoLinear=false;};
-   };
-  }; 
- };
-///////////////////////////////////
 
 
 //  if(isAutoCorr){printf("B: %i  | %.3e %.3e  |  %.3e %.3e  |  %.3e %.3e  | %.3e %.3e \n",canPlot,bufferVis[0][10].real(),bufferVis[0][10].imag(),bufferVis[1][10].real(),bufferVis[1][10].imag(),bufferVis[2][10].real(),bufferVis[2][10].imag(),bufferVis[3][10].real(),bufferVis[3][10].imag()); fflush(stdout);};
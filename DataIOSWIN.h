@@ -28,21 +28,94 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include <fstream>
 #include <math.h>
 #include <complex>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
 #include "DataIO.h"
+#include "IndexCache.h"
+#include "SWINFormat.h"
 
 
 
+/* Packed record index (28 bytes per record). The byte offset is given
+   w.r.t. a base (i.e., file number and offset of a 4GB span of that file)
+   and the time is an index in a table of (unique) times. The Flags keep 
+   the two pol labels (2 bits each, as indices in "RLXY") and the bits 
+   RECNOTUSED, RECIS1 and RECIS2. The end of the record is given by the 
+   number of channels of the IF. The parangs and the (squared) UV distance
+   are kept here too, in single precision, so that they are moved to disk
+   with the rest of the index. */
 typedef struct {
- int fileNumber;
- int Source;
+ unsigned int Offset;
+ unsigned int TimeIdx;
+ unsigned short Base;
+ unsigned short Source;
+ unsigned char Antennas[2];
+ unsigned char freqIndex;
+ unsigned char Flags;
+ float ParAng[2];
+ float UVDist;} Record;
+
+
+/* Records (with their bases and times) and autocorrelation sums of one
+   SWIN file, before they are appended to the record index.
+   The bases and times of the records are counted from those of the file
+   (the bases being its 4GB spans). The files can be read in parallel. */
+typedef struct {
+ Record *Records;
+ long *Bases;
+ double *Times;
+ long nrec, nBases, nTimes, nAutos;
+ long RecSize, BaseSize, TimeSize;
+ AutoCorrelation **AutoCorrs;
+ bool success;} SWINFile;
+
+
+/* Group of (up to) four correlation products of a baseline and time, as
+   found by the search of getNextMixedVis. Rec is the record of the group
+   (for the parangs and plots) and Complete is false in the 1st round of
+   the autocorrelations and of the baselines between linear-pol antennas. */
+typedef struct {
+ long Entries[4], Rec;
  double Time;
- char Pol[2];
- bool notUsed;
- int Antennas[2];
- int Baseline;
- int freqIndex;
- long byteIni;
- long byteEnd;} Record;
+ int Antenna, OtherAnt, Field;
+ bool Complete, CanPlot, Conj, ConvisOK;} MixedVis;
+
+
+/* A group, with its visibilities. In the pipelined mode, the groups are 
+   found and read in advance by another thread, so the warnings of the 
+   search are kept in Log until the group is used. */
+typedef struct {
+ MixedVis V;
+ bool Found;
+ long Bytes;
+ std::string Log;
+ std::complex<float> *Data[4];} MixedGroup;
+
+
+/* State of the conversion of the current visibility: the data read, the
+   converted data and the 1st-round visibilities (auxVis) of the 
+   autocorrelations and lin-lin baselines. The serial conversion uses one
+   state (Main); each thread of the parallel conversion has its own, with
+   the range of groups of its time block (Next, End) and its own Timer. */
+typedef struct {
+ std::complex<float> *currentVis[4], *bufferVis[4], *auxVis[4];
+ MixedVis V;
+ bool isAutoCorr, isTwoLinear, isBlock;
+ long Next, End;
+ Timing *Timer;} VisState;
+
+
+/* Converted visibilities (or zeroed weights) of a group, waiting to be 
+   written in the pipelined mode. Size is zero for the missing products. */
+typedef struct {
+ int File[4];
+ long Offset[4], Size[4];
+ const char *Data[4];
+ std::complex<float> *Buffer[4];} PendingWrite;
 
 
 
@@ -55,7 +128,7 @@ class DataIOSWIN: public DataIO {
 
    ~DataIOSWIN();
 
-   DataIOSWIN(int nSWIN, std::string* outputfiles, int Nant, int *Ants, double *doRange, int nIF, int *nChan, int nIF2Conv, int *IF2Conv, int IFoffset, int Afilt, int *nChanACorr, double **Freqs, bool Overwrite, bool doTest, bool doSolve, int saveSource, double jd0, ArrayGeometry *Geom, bool doPar, FILE *logF);
+   DataIOSWIN(int nSWIN, std::string* outputfiles, int Nant, int *Ants, double *doRange, int nIF, int *nChan, int nIF2Conv, int *IF2Conv, int IFoffset, int Afilt, int *nChanACorr, double **Freqs, bool Overwrite, bool doTest, bool doSolve, int saveSource, double jd0, ArrayGeometry *Geom, bool doPar, FILE *logF, Timing *timer);
 
    bool setCurrentIF(int i);
 
@@ -92,17 +165,120 @@ class DataIOSWIN: public DataIO {
 // Close all files.
    void finish();
 
+
+/* Parallel conversion of the current IF. The mixed-pol groups are found
+   (in the same order as with getNextMixedVis) and split into, at most,
+   nBlocks contiguous time blocks. The groups of a time (e.g., the two 
+   rounds of an autocorrelation) are never split. Returns the number of 
+   blocks (0 if the SWIN files cannot be read and written directly): */
+   int splitIF(int nBlocks);
+
+// Each thread converts a block with its own state, using the functions
+// below as their counterparts of the serial conversion:
+   VisState *newState(Timing *timer);
+   void freeState(VisState *S);
+   bool setBlock(VisState &S, int block);
+// Times of the groups of an antenna before the start of a block (once
+// each, in order) and their file numbers, to find the state of the 
+// serial conversion there:
+   void getTimesBefore(int block, int antenna, std::vector<double> &Times, std::vector<int> &Files);
+   bool getNextMixedVis(VisState &S, double &JDTime, int &antenna, int &otherAnt, bool &conj, int &calField);
+   int getFileNumber(VisState &S);
+   void applyMatrix(VisState &S, std::complex<float> *M[2][2], bool swap, bool print, int thisAnt, FILE *plotFile);
+   bool setCurrentMixedVis(VisState &S);
+   void zeroWeight(VisState &S);
+
+// Returns false if a read (or write) of the blocks failed:
+   bool endBlocks();
+
+// For the blocks converted in other processes (their I/O errors are not
+// seen by this object): ioFailed tells whether a read (or write) failed 
+// and setIOFailed records the error of another process:
+   bool ioFailed();
+   void setIOFailed();
+
   private:
 
    void openOutFiles(std::string* difxfiles);
    void readHeader(bool doTest, int saveSource);
 
+// Access to the packed records:
+   long recByteIni(long rec);
+   long recByteEnd(long rec);
+   int recFile(long rec);
+   double recTime(long rec);
+   char recPol(long rec, int i);
+   bool recFlag(long rec, unsigned char flag);
+   void setRecFlag(long rec, unsigned char flag, bool value);
+
+// (Re)allocate the records. If they take more than RecMemory bytes, 
+// they are moved to a (memory-mapped) temporary file:
+   bool growRecords(long newSize);
+   void freeRecords();
+
+// Read the records of a SWIN file (from its index, if valid) and append
+// them to the record index (computing their parangs). Several files may
+// be read at once, but they are appended in order:
+   void readFile(int fileIdx, bool doTest, int saveSource, SWINFile &File, FILE **circFile, FILE **autoCorrs);
+   bool appendFile(int fileIdx, SWINFile &File);
+   void newFile(SWINFile &File);
+   void freeFile(SWINFile &File);
+
+// Sidecar index of each SWIN file (records, UV distances and autocorr sums):
+   void indexKey(IndexCache &Index);
+   bool loadIndex(IndexCache &Index, int fileIdx, bool doTest, SWINFile &File);
+   void saveIndex(IndexCache &Index, SWINFile &File);
+
+// Thread-safe version of the log messages:
+   void printLog(const char *msg);
+
+// Search of the next group of products of the current IF (sets the
+// record flags), its warnings, and use of the group (once its data
+// are in S.currentVis):
+   void findNextGroup(MixedGroup &G);
+   void logGroup(MixedGroup &G);
+   void useGroup(VisState &S, MixedVis &V, long bytes);
+
+// Reads (or writes) with the direct (thread-safe) descriptors of the files:
+   bool openDirect();
+   void closeDirect();
+   void readDirect(MixedVis &V, std::complex<float> **Data, long &bytes);
+
+// Pipelined mode. A reader thread finds the groups of the current IF and
+// reads their visibilities ahead of the conversion (in a ring of groups)
+// and a writer thread writes the converted data, merging the writes of 
+// the pending groups (sorted by file and offset). Both queues have
+// PipeDepth groups, so the memory used is bounded. The reader starts
+// with the first getNextMixedVis of the IF (so it is not used if the IF
+// is converted in blocks):
+   void startPipeline();
+   void stopPipeline();
+   void startReader();
+   void stopReader();
+   void prefetch();
+   void writeBehind();
+   void queueWrite(VisState &S, bool weights);
+
 ////////
 // Only used for SWIN files. Not used here
     static const long RECBUFFER = 1024*1024;
     static const int NFRDATA = 8;
     static const int NCFDATA = 2;
-    static const long endhead = sizeof(int) + 4*sizeof(double); // Useless info at the headers end.
+    static const unsigned char RECNOTUSED = 16;
+    static const unsigned char RECIS1 = 32;
+    static const unsigned char RECIS2 = 64;
+// Default memory for the records (can be set, in MB, with the 
+// POLCONVERT_RECMEM environment variable):
+    static const long RECMEMORY = 4096L*1024*1024;
+// Number of files read at once (by default, the number of cores). It 
+// can be set with the POLCONVERT_THREADS environment variable:
+    static const int MAXREADTHREADS = 64;
+// Groups kept in each queue of the pipelined mode (can be set with the 
+// POLCONVERT_PIPELINE environment variable; zero disables the pipeline,
+// which is also the default for single-core machines).
+// The queues never take more than PIPEMEMORY bytes:
+    static const int PIPEDEPTH = 64;
+    static const long PIPEMEMORY = 512L*1024*1024;
 
 ////////
 
@@ -116,13 +292,40 @@ class DataIOSWIN: public DataIO {
     int nfiles;
     std::ifstream *olddifx;
     std::fstream *newdifx;
-    bool isOverWrite, doWriteCirc, canPlot, isAutoCorr, isTwoLinear, doParang;
-    bool debugNewIF, convisok;
-    long currEntries[MAXIF][4], nrec;
+    bool isOverWrite, doWriteCirc, doParang;
+    bool debugNewIF;
+    long nrec;
     long *filesizes;
-    std::complex<float> *currentVis[4] ;
-    std::complex<float> *bufferVis[4] ;
-    std::complex<float> *auxVis[4] ;
+    std::string *swinNames;
+    VisState Main;
+    int MaxNChan;
 
     Record *Records ;
+    long *RecBases, RecMemory, nRecSpill;
+    int *RecFiles, nRecBases, RecSpill;
+    double *RecTimes;
+    long nRecTimes;
+// Allocated sizes of the records, bases and times:
+    long RecSize, BaseSize, TimeSize;
+    bool isLinAnt[256];
+    std::mutex LogMutex;
+
+// First record that may be unused (in the current IF):
+    long scanRec;
+
+// Groups of the current IF (and first group of each block) in the
+// parallel conversion:
+    std::vector<MixedVis> IFGroups;
+    std::vector<long> BlockStart;
+
+// Pipelined mode:
+    bool isPipelined, PipeStop, WriterDone, ReadDone, ReadStarted;
+    std::atomic<bool> PipeFailed;
+    int PipeDepth, *PipeFiles;
+    MixedGroup *ReadRing;
+    PendingWrite *WriteRing;
+    long ReadHead, ReadTail, WriteHead, WriteTail;
+    std::thread Reader, Writer;
+    std::mutex PipeMutex;
+    std::condition_variable ReadCond, WriteCond;
 };
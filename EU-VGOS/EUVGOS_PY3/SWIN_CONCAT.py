@@ -22,6 +22,11 @@ import numpy as np
 import struct as stk
 import os, sys, glob
 
+try:
+    from PolConvert import _SWINReader as SR
+except ImportError:
+    SR = None
+
 
 __version__ = "1.0b (28 Oct 2022)"
 
@@ -334,6 +339,15 @@ def swinConcat(SWINs=[], concatName=""):
             filenameOut = filenameOut[0]
             filenameIn = filenameIn[0]
 
+        ## Native (memory-mapped) renumbering, if available:
+        if SR is not None:
+            print("Renumbering %s" % os.path.basename(filenameIn))
+            NVIS = SR.Renumber(filenameIn, filenameOut, [], TELDIC, SOUDIC, 0)
+            if NVIS < 0:
+                raise Exception("Failed to renumber %s (error %i)\n" % (filenameIn, NVIS))
+            print(" %i visibilities\n" % NVIS)
+            continue
+
         ENTRY_SIZE = 66 + 8 * (NCHAN + 1)
 
         VIS_SIZE = (os.path.getsize(filenameIn) - 8) // ENTRY_SIZE
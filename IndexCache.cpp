@@ -0,0 +1,229 @@
+/* INDEXCACHE - sidecar index files for the PolConvert data readers
+
+             Copyright (C) 2013-2022  Ivan Marti-Vidal
+             Nordic Node of EU ALMA Regional Center (Onsala, Sweden)
+             Max-Planck-Institut fuer Radioastronomie (Bonn, Germany)
+             University of Valencia (Spain)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "./IndexCache.h"
+
+
+static const char INDEXMAGIC[8] = {'P','C','I','D','X',0,0,0};
+
+const char *IndexCache::INDEXDIR = "POLCONVERT.INDEX";
+
+
+
+// FNV-1a hash:
+void IndexCache::hash(unsigned long long &h, const void *data, size_t size){
+  const unsigned char *bytes = (const unsigned char *) data;
+  size_t i;
+  for (i=0; i<size; i++){
+    h ^= bytes[i];
+    h *= 1099511628211ULL;
+  };
+};
+
+
+
+IndexCache::IndexCache(std::string dataFile, FILE *logF){
+
+  struct stat dataStat;
+  unsigned char *buffer;
+  size_t nread;
+  FILE *dataF;
+  unsigned long long fileHash;
+  size_t slash;
+  char hashName[32];
+
+  logFile = logF;
+  file = NULL;
+  isWriting = false;
+  isOK = false;
+
+  keyHash = 14695981039346656037ULL;
+  dataHash = 14695981039346656037ULL;
+  dataSize = 0; dataTime[0] = 0; dataTime[1] = 0;
+
+  isEnabled = getenv("POLCONVERT_NOINDEX") == NULL;
+  if (!isEnabled){return;};
+
+// Identify the data file:
+  if (stat(dataFile.c_str(), &dataStat) != 0){isEnabled = false; return;};
+  dataSize = (unsigned long long) dataStat.st_size;
+#ifdef __APPLE__
+  dataTime[0] = (long long) dataStat.st_mtimespec.tv_sec;
+  dataTime[1] = (long long) dataStat.st_mtimespec.tv_nsec;
+#else
+  dataTime[0] = (long long) dataStat.st_mtim.tv_sec;
+  dataTime[1] = (long long) dataStat.st_mtim.tv_nsec;
+#endif
+
+  dataF = fopen(dataFile.c_str(),"rb");
+  if (dataF == NULL){isEnabled = false; return;};
+  buffer = new unsigned char[HASHBYTES];
+  nread = fread(buffer, 1, HASHBYTES, dataF);
+  hash(dataHash, buffer, nread);
+  delete[] buffer;
+  fclose(dataF);
+
+// Name of the index (the process id makes the temporary file unique):
+  fileHash = dataHash;
+  hash(fileHash, &dataSize, sizeof(dataSize));
+  hash(fileHash, dataTime, 2*sizeof(long long));
+  sprintf(hashName, ".%016llx.pcidx", fileHash);
+  slash = dataFile.find_last_of('/');
+  indexName = std::string(INDEXDIR) + "/" 
+            + ((slash == std::string::npos) ? dataFile : dataFile.substr(slash+1)) + hashName;
+  tempName = indexName + "." + std::to_string((long) getpid()) + ".tmp";
+
+};
+
+
+
+IndexCache::~IndexCache(){
+  if (file != NULL){
+    fclose(file);
+    if (isWriting){unlink(tempName.c_str());};
+  };
+};
+
+
+
+void IndexCache::addKey(const void *data, size_t size){
+  hash(keyHash, data, size);
+};
+
+
+
+bool IndexCache::openRead(){
+
+  char magic[8];
+  int version;
+  unsigned long long auxH[3];
+  long long auxT[2];
+
+  if (!isEnabled || file != NULL){return false;};
+
+  file = fopen(indexName.c_str(),"rb");
+  if (file == NULL){return false;};
+  isWriting = false;
+
+  isOK = fread(magic,sizeof(char),8,file)==8 && memcmp(magic,INDEXMAGIC,8)==0;
+  isOK = isOK && fread(&version,sizeof(int),1,file)==1 && version==VERSION;
+  isOK = isOK && fread(auxH,sizeof(unsigned long long),3,file)==3;
+  isOK = isOK && fread(auxT,sizeof(long long),2,file)==2;
+  isOK = isOK && auxH[0]==dataSize && auxH[1]==dataHash && auxH[2]==keyHash;
+  isOK = isOK && auxT[0]==dataTime[0] && auxT[1]==dataTime[1];
+
+  if (!isOK){
+    fclose(file); file = NULL;
+    sprintf(message,"\n Index %s is outdated. Will re-read the file.\n",indexName.c_str());
+    fprintf(logFile,"%s",message); fflush(logFile);
+  };
+
+  return isOK;
+
+};
+
+
+
+bool IndexCache::openWrite(){
+
+  int version = VERSION;
+  unsigned long long auxH[3] = {dataSize, dataHash, keyHash};
+
+  if (!isEnabled || file != NULL){return false;};
+
+  mkdir(INDEXDIR, 0755);
+  file = fopen(tempName.c_str(),"wb");
+  if (file == NULL){return false;};
+  isWriting = true;
+
+  isOK = fwrite(INDEXMAGIC,sizeof(char),8,file)==8;
+  isOK = isOK && fwrite(&version,sizeof(int),1,file)==1;
+  isOK = isOK && fwrite(auxH,sizeof(unsigned long long),3,file)==3;
+  isOK = isOK && fwrite(dataTime,sizeof(long long),2,file)==2;
+
+  return isOK;
+
+};
+
+
+
+bool IndexCache::read(void *data, size_t size){
+
+  unsigned long long blockSize;
+
+  if (file == NULL || isWriting || !isOK){return false;};
+
+  isOK = fread(&blockSize,sizeof(unsigned long long),1,file)==1 && blockSize==size;
+  isOK = isOK && (size==0 || fread(data,1,size,file)==size);
+
+  return isOK;
+
+};
+
+
+
+bool IndexCache::write(const void *data, size_t size){
+
+  unsigned long long blockSize = size;
+
+  if (file == NULL || !isWriting || !isOK){return false;};
+
+  isOK = fwrite(&blockSize,sizeof(unsigned long long),1,file)==1;
+  isOK = isOK && (size==0 || fwrite(data,1,size,file)==size);
+
+  return isOK;
+
+};
+
+
+
+bool IndexCache::close(){
+
+  bool result = isOK;
+
+  if (file == NULL){return false;};
+
+  if (isWriting){
+    result = (fclose(file)==0) && result;
+    file = NULL;
+    if (result){result = rename(tempName.c_str(),indexName.c_str())==0;};
+    if (!result){
+      unlink(tempName.c_str());
+      sprintf(message,"\n Could not write index %s\n",indexName.c_str());
+      fprintf(logFile,"%s",message); fflush(logFile);
+    };
+  } else {
+    fclose(file);
+    file = NULL;
+  };
+
+  return result;
+
+};
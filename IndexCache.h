@@ -0,0 +1,78 @@
+/* INDEXCACHE - cached index files for the PolConvert data readers
+
+             Copyright (C) 2013-2022  Ivan Marti-Vidal
+             Nordic Node of EU ALMA Regional Center (Onsala, Sweden)
+             Max-Planck-Institut fuer Radioastronomie (Bonn, Germany)
+             University of Valencia (Spain)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <string>
+
+#ifndef __INDEXCACHE_H__
+#define __INDEXCACHE_H__
+
+
+/* Class to save (and load) the metadata that a data reader derives from
+   a data file. The index files are kept in the POLCONVERT.INDEX directory
+   (in the working directory, as the other outputs of PolConvert), named
+   after the data file and a hash of its size, modification time and first
+   bytes. So they are never mixed with the data (e.g., with the DIFX_* 
+   files of a SWIN directory) and they remain valid for a copy of the data
+   that keeps its times (e.g., the output of a new PolConvert run). The 
+   index is valid only for the same data file and for the same key (i.e., 
+   the parameters given with addKey). The data file is checked when the 
+   object is created, so it should be created before the reader modifies 
+   the file. The contents are a sequence of
+   blocks, that must be read in the same order (and with the same sizes)
+   as they were written. Setting the POLCONVERT_NOINDEX environment
+   variable disables the index files. */
+class IndexCache {
+  public:
+    IndexCache(std::string dataFile, FILE *logF);
+    ~IndexCache();
+
+    void addKey(const void *data, size_t size);
+
+// Returns false if there is no valid index:
+    bool openRead();
+    bool openWrite();
+
+    bool read(void *data, size_t size);
+    bool write(const void *data, size_t size);
+
+// When writing, the index file is only created if all writes succeeded:
+    bool close();
+
+  private:
+    static const int VERSION = 2;
+    static const long HASHBYTES = 65536;
+    static const char *INDEXDIR;
+    void hash(unsigned long long &h, const void *data, size_t size);
+
+    std::string indexName, tempName;
+    FILE *file, *logFile;
+    bool isEnabled, isWriting, isOK;
+    unsigned long long keyHash, dataHash, dataSize;
+    long long dataTime[2];
+    char message[512];
+};
+
+#endif
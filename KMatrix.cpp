@@ -0,0 +1,202 @@
+/* KMATRIX - calibration and conversion matrix of the phased antennas
+
+             Copyright (C) 2013-2022  Ivan Marti-Vidal
+             Nordic Node of EU ALMA Regional Center (Onsala, Sweden)
+             Max-Planck-Institut fuer Radioastronomie (Bonn, Germany)
+             University of Valencia (Spain)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <complex>
+#include <cmath>
+#include "./KMatrix.h"
+
+
+static const float ONEOVERSQRT2 = 0.7071067811;
+
+
+
+KMatrix::KMatrix(int maxNchan){
+
+  int i, j;
+  MaxNchan = maxNchan;
+  Work = new float[8*MaxNchan];
+  for (i=0; i<2; i++){
+    for (j=0; j<2; j++){
+      Kre[i][j] = &Work[(4*i+2*j)*MaxNchan];
+      Kim[i][j] = &Work[(4*i+2*j+1)*MaxNchan];
+    };
+  };
+
+};
+
+
+KMatrix::~KMatrix(){
+  delete[] Work;
+};
+
+
+
+
+// Add the K matrix of one antenna to the sums (the complex numbers of
+// G and D are re,im pairs):
+static void addAntenna(int nchan,
+      const float * __restrict__ G0, const float * __restrict__ G1,
+      const float * __restrict__ D0, const float * __restrict__ D1,
+      float * __restrict__ K00r, float * __restrict__ K00i,
+      float * __restrict__ K01r, float * __restrict__ K01i,
+      float * __restrict__ K10r, float * __restrict__ K10i,
+      float * __restrict__ K11r, float * __restrict__ K11i){
+
+  int j;
+  for (j=0; j<nchan; j++){
+    K00r[j] += G0[2*j]; K00i[j] += G0[2*j+1];
+    K11r[j] += G1[2*j]; K11i[j] += G1[2*j+1];
+    K01r[j] += D0[2*j]*G0[2*j] - D0[2*j+1]*G0[2*j+1];
+    K01i[j] += D0[2*j]*G0[2*j+1] + D0[2*j+1]*G0[2*j];
+    K10r[j] += D1[2*j]*G1[2*j] - D1[2*j+1]*G1[2*j+1];
+    K10i[j] += D1[2*j]*G1[2*j+1] + D1[2*j+1]*G1[2*j];
+  };
+
+};
+
+
+
+
+// Average, correct the X/Y phase, invert and multiply by the hybrid (H).
+// The squared amplitudes of the diagonal of the inverse are left in K00r
+// and K11r:
+static void invertAll(int nchan, float auxD, const float * __restrict__ R,
+      const float H[2][2][2],
+      float * __restrict__ K00r, const float * __restrict__ K00i,
+      const float * __restrict__ K01r, const float * __restrict__ K01i,
+      const float * __restrict__ K10r, const float * __restrict__ K10i,
+      float * __restrict__ K11r, const float * __restrict__ K11i,
+      float * __restrict__ O00, float * __restrict__ O01,
+      float * __restrict__ O10, float * __restrict__ O11){
+
+  int j;
+  float k00r, k00i, k01r, k01i, k10r, k10i, k11r, k11i, ar, ai, br, bi;
+  float detr, deti, aux;
+  float i00r, i00i, i01r, i01i, i10r, i10i, i11r, i11i;
+
+  for (j=0; j<nchan; j++){
+
+    k00r = K00r[j]/auxD; k00i = K00i[j]/auxD;
+    k10r = K10r[j]/auxD; k10i = K10i[j]/auxD;
+    ar = K01r[j]/auxD; ai = K01i[j]/auxD;
+    br = K11r[j]/auxD; bi = K11i[j]/auxD;
+
+// Correct the phase offset at the reference antenna:
+    k01r = ar*R[2*j] - ai*R[2*j+1]; k01i = ar*R[2*j+1] + ai*R[2*j];
+    k11r = br*R[2*j] - bi*R[2*j+1]; k11i = br*R[2*j+1] + bi*R[2*j];
+
+// Inverse of the determinant:
+    detr = (k00r*k11r - k00i*k11i) - (k01r*k10r - k01i*k10i);
+    deti = (k00r*k11i + k00i*k11r) - (k01r*k10i + k01i*k10r);
+    aux = 1.0/(detr*detr + deti*deti);
+    detr *= aux; deti *= -aux;
+
+// Inverse of K matrix.
+// BEWARE THAT THIS MUST BE IN ACCORDANCE TO THE DEFINITION OF Dx AND Dy!!!
+    i00r = k11r*detr - k11i*deti; i00i = k11r*deti + k11i*detr;
+    i11r = k00r*detr - k00i*deti; i11i = k00r*deti + k00i*detr;
+    i01r = k01i*deti - k01r*detr; i01i = -k01r*deti - k01i*detr;
+    i10r = k10i*deti - k10r*detr; i10i = -k10r*deti - k10i*detr;
+
+    K00r[j] = i00r*i00r + i00i*i00i;
+    K11r[j] = i11r*i11r + i11i*i11i;
+
+// Multiply by conversion (hybrid) matrix:
+    O00[2*j] = ((i00r*H[0][0][0] - i00i*H[0][0][1]) + (i10r*H[0][1][0] - i10i*H[0][1][1]))*ONEOVERSQRT2;
+    O00[2*j+1] = ((i00r*H[0][0][1] + i00i*H[0][0][0]) + (i10r*H[0][1][1] + i10i*H[0][1][0]))*ONEOVERSQRT2;
+    O01[2*j] = ((i01r*H[0][0][0] - i01i*H[0][0][1]) + (i11r*H[0][1][0] - i11i*H[0][1][1]))*ONEOVERSQRT2;
+    O01[2*j+1] = ((i01r*H[0][0][1] + i01i*H[0][0][0]) + (i11r*H[0][1][1] + i11i*H[0][1][0]))*ONEOVERSQRT2;
+    O10[2*j] = ((i00r*H[1][0][0] - i00i*H[1][0][1]) + (i10r*H[1][1][0] - i10i*H[1][1][1]))*ONEOVERSQRT2;
+    O10[2*j+1] = ((i00r*H[1][0][1] + i00i*H[1][0][0]) + (i10r*H[1][1][1] + i10i*H[1][1][0]))*ONEOVERSQRT2;
+    O11[2*j] = ((i01r*H[1][0][0] - i01i*H[1][0][1]) + (i11r*H[1][1][0] - i11i*H[1][1][1]))*ONEOVERSQRT2;
+    O11[2*j+1] = ((i01r*H[1][0][1] + i01i*H[1][0][0]) + (i11r*H[1][1][1] + i11i*H[1][1][0]))*ONEOVERSQRT2;
+
+  };
+
+};
+
+
+
+
+float KMatrix::build(std::complex<float> ***AnG, std::complex<float> ***AnDt,
+                     bool *Weight, int nAnt, int nchan,
+                     std::complex<float> *gainRatio, std::complex<float> Hyb[2][2],
+                     std::complex<float> *Ktotal[2][2], bool doNorm,
+                     float NormFac[2], bool verbose){
+
+  int i, j, k;
+  float auxD = 0.0;
+  float H[2][2][2];
+  std::complex<float> K01, K11;
+
+  for (i=0; i<2; i++){
+    for (j=0; j<2; j++){
+      H[i][j][0] = Hyb[i][j].real(); H[i][j][1] = Hyb[i][j].imag();
+      for (k=0; k<nchan; k++){Kre[i][j][k] = 0.0; Kim[i][j][k] = 0.0;};
+    };
+  };
+
+// ADD-UP ALL GAINS (BUT ONLY IF ANTENNA WAS USED IN THE PHASING):
+  for (i=0; i<nAnt; i++){
+    if (Weight[i]){
+      auxD += 1.0;
+      addAntenna(nchan, reinterpret_cast<float *>(AnG[i][0]),
+                 reinterpret_cast<float *>(AnG[i][1]),
+                 reinterpret_cast<float *>(AnDt[i][0]),
+                 reinterpret_cast<float *>(AnDt[i][1]),
+                 Kre[0][0], Kim[0][0], Kre[0][1], Kim[0][1],
+                 Kre[1][0], Kim[1][0], Kre[1][1], Kim[1][1]);
+    };
+  };
+
+  if (verbose && nchan>0){
+    K01 = std::complex<float>(Kre[0][1][0],Kim[0][1][0])/auxD*gainRatio[0];
+    K11 = std::complex<float>(Kre[1][1][0],Kim[1][1][0])/auxD*gainRatio[0];
+    printf("gainRatio (j=0): %.3e %.3e\n", gainRatio[0].real(), gainRatio[0].imag());
+    printf("Ktot00: %.3e %.3e\n", Kre[0][0][0]/auxD, Kim[0][0][0]/auxD);
+    printf("Ktot01: %.3e %.3e\n", K01.real(), K01.imag());
+    printf("Ktot10: %.3e %.3e\n", Kre[1][0][0]/auxD, Kim[1][0][0]/auxD);
+    printf("Ktot11: %.3e %.3e\n", K11.real(), K11.imag());
+    printf("Not flagged\n");
+  };
+
+  invertAll(nchan, auxD, reinterpret_cast<float *>(gainRatio), H,
+            Kre[0][0], Kim[0][0], Kre[0][1], Kim[0][1],
+            Kre[1][0], Kim[1][0], Kre[1][1], Kim[1][1],
+            reinterpret_cast<float *>(Ktotal[0][0]), reinterpret_cast<float *>(Ktotal[0][1]),
+            reinterpret_cast<float *>(Ktotal[1][0]), reinterpret_cast<float *>(Ktotal[1][1]));
+
+  NormFac[0] = 0.0; NormFac[1] = 0.0;
+  if (doNorm){
+    for (j=0; j<nchan; j++){
+      NormFac[0] += std::sqrt(Kre[0][0][j]);
+      NormFac[1] += std::sqrt(Kre[1][1][j]);
+    };
+  };
+
+  return auxD;
+
+};
@@ -0,0 +1,67 @@
+/* KMATRIX - calibration and conversion matrix of the phased antennas
+
+             Copyright (C) 2013-2022  Ivan Marti-Vidal
+             Nordic Node of EU ALMA Regional Center (Onsala, Sweden)
+             Max-Planck-Institut fuer Radioastronomie (Bonn, Germany)
+             University of Valencia (Spain)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+#include <sys/types.h>
+#include <complex>
+
+#ifndef __KMATRIX_H__
+#define __KMATRIX_H__
+
+
+/* Class to build the matrix (Ktotal) that calibrates and converts the
+   visibilities of a phased array, for all the channels of an IF at once.
+   The gains (G) and D-terms (D) of the phased antennas are averaged as
+
+          | G0      D0*G0 |
+     K = <|               |>
+          | D1*G1   G1    |
+
+   then the right column is multiplied by the gain ratio (X/Y phase at the
+   reference antenna), and the inverse of K is multiplied by the hybrid
+   matrix. The average is kept as separate real and imaginary planes (so
+   that the loops over channels are vectorized), and there are no arrays
+   per antenna besides the gains and D-terms. */
+class KMatrix {
+  public:
+    KMatrix(int maxNchan);
+    ~KMatrix();
+
+// AnG and AnDt are indexed as [antenna][pol][channel]. Only the antennas
+// with Weight are used (there must be at least one). Ktotal gets the four
+// planes ([row][column][channel]) and NormFac the sums (over channels) of
+// the amplitudes of the diagonal of the inverse (only if doNorm).
+// Returns the number of phased antennas:
+    float build(std::complex<float> ***AnG, std::complex<float> ***AnDt,
+                bool *Weight, int nAnt, int nchan,
+                std::complex<float> *gainRatio, std::complex<float> Hyb[2][2],
+                std::complex<float> *Ktotal[2][2], bool doNorm,
+                float NormFac[2], bool verbose);
+
+  private:
+    int MaxNchan;
+    float *Work;
+    float *Kre[2][2], *Kim[2][2];
+};
+
+#endif
@@ -0,0 +1,250 @@
+/* KTIMELINE - file with the conversion matrices of a PolConvert run
+
+             Copyright (C) 2013-2022  Ivan Marti-Vidal
+             Nordic Node of EU ALMA Regional Center (Onsala, Sweden)
+             Max-Planck-Institut fuer Radioastronomie (Bonn, Germany)
+             University of Valencia (Spain)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "./KTimeline.h"
+
+
+static const char KTLMAGIC[8] = {'P','C','K','T','L',0,0,0};
+
+// Header of each entry (followed by the 4*nchan matrix elements):
+struct KTLHeader {int file; int IF; int ant; int nchan; int phased; double time;};
+
+
+
+KTimeline::KTimeline(std::string fileName, bool writing, FILE *logF){
+
+  int version = VERSION;
+
+  this->fileName = fileName;
+  logFile = logF;
+  isWriting = writing;
+  nEntries = 0;
+  isOK = false;
+
+  if (isWriting){
+    file = fopen(fileName.c_str(),"wb");
+    if (file != NULL){
+      isOK = fwrite(KTLMAGIC,sizeof(char),8,file)==8;
+      isOK = isOK && fwrite(&version,sizeof(int),1,file)==1;
+    };
+  } else {
+    file = fopen(fileName.c_str(),"rb");
+    if (file != NULL){
+      isOK = readAll();
+      fclose(file); file = NULL;
+    };
+  };
+
+  if (!isOK){
+    sprintf(message,"\nERROR: could not %s the K-matrix timeline %s\n",
+            isWriting ? "create" : "read", fileName.c_str());
+  } else if (isWriting){
+    sprintf(message,"\nWriting the K-matrix timeline %s\n",fileName.c_str());
+  } else {
+    sprintf(message,"\nRead %li matrices from the K-matrix timeline %s\n",
+            nEntries, fileName.c_str());
+  };
+  fprintf(logFile,"%s",message); fflush(logFile);
+
+};
+
+
+KTimeline::~KTimeline(){
+  if (file != NULL){close();};
+};
+
+
+bool KTimeline::succeed(){return isOK;};
+
+long KTimeline::getNEntries(){return nEntries;};
+
+
+
+
+// Loads all the entries, sorted by time for each file, IF and antenna (entries
+// with the same time keep the order of the file). The writer checks that 
+// they come in order, so the sort only matters for files written otherwise:
+bool KTimeline::readAll(){
+
+  char magic[8];
+  int version;
+  KTLHeader head;
+  Entry entry;
+  std::map<Key, std::vector<Entry> >::iterator it;
+
+  if (fread(magic,sizeof(char),8,file)!=8 || memcmp(magic,KTLMAGIC,8)!=0){return false;};
+  if (fread(&version,sizeof(int),1,file)!=1 || version!=VERSION){return false;};
+
+  while (fread(&head,sizeof(KTLHeader),1,file)==1){
+    if (head.nchan<0){return false;};
+    entry.time = head.time;
+    entry.lastAdded = head.time;
+    entry.nchan = head.nchan;
+    entry.phased = head.phased!=0;
+    entry.offset = Data.size();
+    Data.resize(Data.size() + 4*((size_t) head.nchan));
+    if (fread(&Data[entry.offset],sizeof(std::complex<float>),4*head.nchan,file)
+        != 4*((size_t) head.nchan)){return false;};
+    Entries[Key(head.file,head.IF,head.ant)].push_back(entry);
+    nEntries += 1;
+  };
+
+  for (it=Entries.begin(); it!=Entries.end(); it++){
+    std::stable_sort(it->second.begin(), it->second.end(),
+        [](const Entry &a, const Entry &b){return a.time < b.time;});
+  };
+
+  return feof(file)!=0;
+
+};
+
+
+
+
+// Only the last entry of each file, IF and antenna is kept in memory (to
+// find out whether the matrix has changed). Skipping an unchanged matrix
+// is only valid if the times of each file, IF and antenna come in order
+// (as in the serial conversion), so an earlier time invalidates the file:
+void KTimeline::add(int fileIdx, int IF, int ant, double time, bool phased, int nchan,
+                    std::complex<float> *K[2][2]){
+
+  KTLHeader head;
+  Entry *last;
+  std::vector<Entry> &slot = Entries[Key(fileIdx,IF,ant)];
+  int i, j;
+  bool changed;
+
+  if (file == NULL || !isWriting || !isOK){return;};
+
+  if (slot.empty()){
+    slot.resize(1);
+    last = &slot[0];
+    last->nchan = nchan;
+    last->offset = Data.size();
+    Data.resize(Data.size() + 4*((size_t) nchan));
+    changed = true;
+  } else {
+    last = &slot[0];
+    if (time < last->lastAdded){
+      sprintf(message,"\nERROR: time %.8f of file %i, IF %i, antenna %i is before the last one (%.8f) in the K-matrix timeline!\n",
+              time, fileIdx, IF+1, ant, last->lastAdded);
+      fprintf(logFile,"%s",message); fflush(logFile);
+      isOK = false;
+      return;
+    };
+    changed = last->nchan != nchan || last->phased != phased;
+    if (last->nchan != nchan){  // Should not happen (IF is in the key).
+      last->nchan = nchan;
+      last->offset = Data.size();
+      Data.resize(Data.size() + 4*((size_t) nchan));
+    };
+    for (i=0; i<2 && !changed; i++){
+      for (j=0; j<2 && !changed; j++){
+        changed = memcmp(&Data[last->offset + (2*i+j)*nchan], K[i][j],
+                         sizeof(std::complex<float>)*nchan)!=0;
+      };
+    };
+  };
+
+  last->lastAdded = time;
+  if (!changed){return;};
+
+  last->time = time;
+  last->phased = phased;
+  for (i=0; i<2; i++){
+    for (j=0; j<2; j++){
+      memcpy(&Data[last->offset + (2*i+j)*nchan], K[i][j],
+             sizeof(std::complex<float>)*nchan);
+    };
+  };
+
+  head.file = fileIdx; head.IF = IF; head.ant = ant; head.nchan = nchan;
+  head.phased = phased ? 1 : 0; head.time = time;
+  isOK = fwrite(&head,sizeof(KTLHeader),1,file)==1;
+  isOK = isOK && fwrite(&Data[last->offset],sizeof(std::complex<float>),4*nchan,file)
+                 == 4*((size_t) nchan);
+  nEntries += 1;
+
+};
+
+
+
+
+bool KTimeline::get(int fileIdx, int IF, int ant, double time, int nchan,
+                    std::complex<float> *K[2][2], bool &phased){
+
+  std::map<Key, std::vector<Entry> >::iterator it;
+  std::vector<Entry>::iterator next;
+  Entry target;
+  int i, j;
+
+  if (isWriting || !isOK){return false;};
+
+  it = Entries.find(Key(fileIdx,IF,ant));
+  if (it == Entries.end()){return false;};
+
+// First entry after time (the one before it is the valid one):
+  target.time = time;
+  next = std::upper_bound(it->second.begin(), it->second.end(), target,
+        [](const Entry &a, const Entry &b){return a.time < b.time;});
+  if (next == it->second.begin()){return false;};
+  next--;
+  if (next->nchan != nchan){return false;};
+
+  phased = next->phased;
+  for (i=0; i<2; i++){
+    for (j=0; j<2; j++){
+      memcpy(K[i][j], &Data[next->offset + (2*i+j)*nchan],
+             sizeof(std::complex<float>)*nchan);
+    };
+  };
+  return true;
+
+};
+
+
+
+
+bool KTimeline::close(){
+
+  bool result = isOK;
+
+  if (file == NULL){return false;};
+  result = (fclose(file)==0) && result;
+  file = NULL;
+
+// A partial timeline would give wrong matrices to the times after it:
+  if (!result){remove(fileName.c_str());};
+
+  sprintf(message,"\nK-matrix timeline %s: %li matrices%s\n",fileName.c_str(),
+          nEntries, result ? "." : " (ERROR! THE FILE IS REMOVED)");
+  fprintf(logFile,"%s",message); fflush(logFile);
+
+  return result;
+
+};
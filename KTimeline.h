@@ -0,0 +1,86 @@
+/* KTIMELINE - file with the conversion matrices of a PolConvert run
+
+             Copyright (C) 2013-2022  Ivan Marti-Vidal
+             Nordic Node of EU ALMA Regional Center (Onsala, Sweden)
+             Max-Planck-Institut fuer Radioastronomie (Bonn, Germany)
+             University of Valencia (Spain)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <complex>
+
+#ifndef __KTIMELINE_H__
+#define __KTIMELINE_H__
+
+
+/* Class to save (and load) the final matrices (Ktotal) that PolConvert
+   applies to the visibilities of each linear-pol antenna, so that the
+   same data can be converted again without the calibration tables.
+   A new entry (file, IF, antenna, time, phased flag and the four planes
+   of Ktotal) is written only when the matrix of that file, IF and antenna
+   changes, so the file is a timeline of matrices. The data file is in the
+   key because Ktotal includes its a-priori gains. When read, the matrix 
+   of a visibility is the one of the last entry at (or before) its time. */
+class KTimeline {
+  public:
+    KTimeline(std::string fileName, bool writing, FILE *logF);
+    ~KTimeline();
+
+// Returns false if the file could not be opened (or read):
+    bool succeed();
+
+// Writing. fileIdx is the index of the data file, IF the DiFX IF index
+// and ant the DiFX antenna number. The times of each file, IF and antenna
+// must not decrease (otherwise, the timeline is not valid and close 
+// removes it):
+    void add(int fileIdx, int IF, int ant, double time, bool phased, int nchan,
+             std::complex<float> *K[2][2]);
+
+// Reading. Returns false if there is no matrix for the file, IF, antenna
+// and time (or if nchan is different):
+    bool get(int fileIdx, int IF, int ant, double time, int nchan,
+             std::complex<float> *K[2][2], bool &phased);
+
+    long getNEntries();
+
+// When writing, returns false if any write failed:
+    bool close();
+
+  private:
+    static const int VERSION = 2;
+// (lastAdded is the last time given to add, when writing):
+    struct Entry {double time, lastAdded; int nchan; bool phased; size_t offset;};
+    typedef std::tuple<int, int, int> Key;  // File, IF and antenna.
+    bool readAll();
+
+    std::string fileName;
+    FILE *file, *logFile;
+    bool isWriting, isOK;
+    long nEntries;
+    std::map<Key, std::vector<Entry> > Entries;
+    std::vector<std::complex<float> > Data;
+    char message[512];
+};
+
+#endif
@@ -162,9 +162,30 @@ def SCAN_SCANNER(EXPNAME='', DIFX_DIR='',SNRCut = 10.0, DOIF = [],
 # Read visibilities and metadata:
     DIFXFile = glob.glob('%s.difx/DIFX*'%dd[:-5])[0]
     if VERB: print('  Reading', DIFXFile)
-    frfile = open(DIFXFile,"rb")
 
-    while True:
+# Use the (mmapped) SWIN reader module, if available:
+    try:
+      import _SWINReader as SR
+      RESULT = SR.ReadHeaders(DIFXFile,[Nchan.get(i,0) for i in range(NIF)],
+                              [],list(DOIF),[],[])
+    except ImportError:
+      RESULT = -1
+
+    if isinstance(RESULT,tuple):
+      Mapped, HEADS = RESULT
+      for IF in DOIF:
+        H = HEADS[HEADS['FREQ']==IF]
+        BAS[IF] = list(H['BASELINE'])
+        MJD[IF] = list(H['MJD'])
+        SEC[IF] = list(H['SECONDS'])
+        POL1[IF] = [pp[:1].decode() for pp in H['POL']]
+        POL2[IF] = [pp[1:].decode() for pp in H['POL']]
+        VISIB[IF] = SR.GetMatrix(Mapped,H)
+      frfile = None
+    else:
+      frfile = open(DIFXFile,"rb")
+
+    while frfile is not None:
        buff = frfile.read(74)
        if not buff:
           break
@@ -193,7 +214,7 @@ def SCAN_SCANNER(EXPNAME='', DIFX_DIR='',SNRCut = 10.0, DOIF = [],
       SEC[i] = np.array(SEC[i],dtype=np.float64)
       POL1[i] = np.array(POL1[i])
       POL2[i] = np.array(POL2[i])
-      VISIB[i] = np.array(VISIB[i],dtype=np.complex64)
+      VISIB[i] = np.asarray(VISIB[i],dtype=np.complex64)
 
 
 ## Dummy initial values for min/max SNRs per antenna:
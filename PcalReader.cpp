@@ -0,0 +1,210 @@
+/* PCALREADER - fast scanner of DiFX phasecal files for XPCal and XPCalMF
+
+             Copyright (C) 2018-2022  Ivan Marti-Vidal
+             Centro Astronomico de Yebes (Spain)
+             University of Valencia (Spain)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "./PcalReader.h"
+
+
+
+PcalReader::PcalReader(std::string pcalFile){
+
+  struct stat info;
+  long nread, n;
+  int fd;
+
+  Data = nullptr; Size = 0; isMapped = false;
+  Next = nullptr; Pos = nullptr; End = nullptr; Tok = nullptr; TokLen = 0;
+
+  fd = open(pcalFile.c_str(), O_RDONLY);
+  if (fd < 0){return;};
+
+  if (fstat(fd, &info) != 0){close(fd); return;};
+  Size = (long) info.st_size;
+
+// Map the whole file. If that fails (or the file is empty), read it:
+  if (Size > 0){
+    Data = (char *) mmap(NULL, Size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (Data == MAP_FAILED){
+      Data = nullptr;
+    } else {
+      isMapped = true;
+      madvise(Data, Size, MADV_SEQUENTIAL);
+    };
+  };
+
+  if (!isMapped){
+    Data = (char *) malloc(Size > 0 ? Size : 1);
+    nread = 0;
+    while (nread < Size){
+      n = read(fd, Data + nread, Size - nread);
+      if (n <= 0){break;};
+      nread += n;
+    };
+    Size = nread;
+  };
+
+  close(fd);
+
+  Next = Data;
+
+};
+
+
+
+PcalReader::~PcalReader(){
+
+  if (isMapped){munmap(Data, Size);} else if (Data != nullptr){free(Data);};
+
+};
+
+
+
+bool PcalReader::isOpen(){return Data != nullptr;};
+
+
+
+
+bool PcalReader::nextLine(){
+
+  const char *DataEnd = Data + Size;
+  const char *Eol;
+
+  if (Data == nullptr){return false;};
+
+  while (Next < DataEnd){
+    Eol = (const char *) memchr(Next, '\n', DataEnd - Next);
+    if (Eol == nullptr){Eol = DataEnd;};
+    Pos = Next; End = Eol;
+    Next = (Eol < DataEnd) ? Eol + 1 : DataEnd;
+    if (End - Pos > 10 && Pos[0] != '#'){return true;};
+  };
+
+  Pos = DataEnd; End = DataEnd;
+  return false;
+
+};
+
+
+
+
+// Next whitespace-separated field (as read by ">>" from a stream):
+bool PcalReader::readField(const char *&Field, long &Len){
+
+  while (Pos < End && isspace((unsigned char) *Pos)){Pos += 1;};
+  if (Pos == End){return false;};
+
+  Field = Pos;
+  while (Pos < End && !isspace((unsigned char) *Pos)){Pos += 1;};
+  Len = Pos - Field;
+  return true;
+
+};
+
+
+
+
+PcalHeader PcalReader::readHeader(){
+
+  PcalHeader Head = {0.0, 0.0, 0, 0, 0};
+  const char *Field;
+  char Buff[MAXTOKEN], *Stop;
+  double *Dbl[2] = {&Head.T, &Head.inT};
+  int *Int[3] = {&Head.I1, &Head.I2, &Head.I3};
+  long Len;
+  int i;
+
+// Station name:
+  if (!readField(Field, Len)){return Head;};
+
+// Numbers (a failed conversion leaves nothing else to read):
+  for (i=0; i<5; i++){
+    if (!readField(Field, Len)){return Head;};
+    if (Len >= MAXTOKEN){Len = MAXTOKEN-1;};
+    memcpy(Buff, Field, Len); Buff[Len] = '\0';
+    if (i<2){*Dbl[i] = strtod(Buff, &Stop);} else {*Int[i-2] = (int) strtol(Buff, &Stop, 10);};
+    if (Stop == Buff){Pos = End; return Head;};
+    Pos = Field + (Stop - Buff);
+  };
+
+  return Head;
+
+};
+
+
+
+
+bool PcalReader::nextToken(){
+
+  while (Pos < End && *Pos == ' '){Pos += 1;};
+  if (Pos == End){return false;};
+
+  Tok = Pos;
+  while (Pos < End && *Pos != ' '){Pos += 1;};
+  TokLen = Pos - Tok;
+  return true;
+
+};
+
+
+
+
+double PcalReader::value(){
+
+  char Buff[MAXTOKEN];
+  long Len = (TokLen < MAXTOKEN) ? TokLen : MAXTOKEN-1;
+
+  memcpy(Buff, Tok, Len); Buff[Len] = '\0';
+  return strtod(Buff, nullptr);
+
+};
+
+
+
+char PcalReader::first(){return Tok[0];};
+
+
+
+
+PcalSegment PcalReader::rest(){
+
+  PcalSegment Seg;
+  Seg.Begin = Pos; Seg.End = End;
+  return Seg;
+
+};
+
+
+
+void PcalReader::setSegment(PcalSegment Seg){
+
+  Pos = Seg.Begin; End = Seg.End;
+
+};
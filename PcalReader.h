@@ -0,0 +1,98 @@
+/* PCALREADER - fast scanner of DiFX phasecal files for XPCal and XPCalMF
+
+             Copyright (C) 2018-2022  Ivan Marti-Vidal
+             Centro Astronomico de Yebes (Spain)
+             University of Valencia (Spain)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <string>
+
+#ifndef __PCALREADER_H__
+#define __PCALREADER_H__
+
+
+// A piece of a line of the file (e.g., the tones of a line, to be
+// read again later):
+typedef struct {
+  const char *Begin;
+  const char *End;
+} PcalSegment;
+
+
+// The first fields of a line (after the station name): time (MJD),
+// integration time and three integers (i.e., DATASTREAM, NTONES and
+// tones per IF, or the like):
+typedef struct {
+  double T;
+  double inT;
+  int I1, I2, I3;
+} PcalHeader;
+
+
+/* Class to scan the lines of a DiFX pcal file:
+
+   STATION  MJD  INTTIME  I1  I2  I3  FREQ POL RE IM  FREQ POL RE IM ...
+
+   The file is memory-mapped (or read at once, if it can not be mapped),
+   and the tokens are parsed in place (the numbers with strtod, so they
+   are the same as with atof), without any string allocations. The
+   tokens of the tone list are separated by blanks (' '), as when they
+   were read with getline(...,' '). */
+class PcalReader {
+  public:
+    PcalReader(std::string pcalFile);
+    ~PcalReader();
+
+    bool isOpen();
+
+// Go to the next data line (i.e., longer than 10 characters and not a
+// comment). Returns false at the end of the file:
+    bool nextLine();
+
+// Read the first six (whitespace-separated) fields of the line
+// (the missing ones are set to zero):
+    PcalHeader readHeader();
+
+// Next (non-empty) token of the current line or segment:
+    bool nextToken();
+
+// Value of the current token (as atof) and its first character:
+    double value();
+    char first();
+
+// The rest of the current line (from the last token read) and how to
+// read the tokens of such a segment:
+    PcalSegment rest();
+    void setSegment(PcalSegment Seg);
+
+  private:
+    static const int MAXTOKEN = 64;
+
+    bool readField(const char *&Tok, long &Len);
+
+    char *Data;
+    long Size;
+    bool isMapped;
+    const char *Next, *Pos, *End, *Tok;
+    long TokLen;
+};
+
+#endif
@@ -0,0 +1,86 @@
+/* SWINFORMAT - layout of the records of the SWIN (DiFX) visibility files
+
+             Copyright (C) 2013-2022  Ivan Marti-Vidal
+             Nordic Node of EU ALMA Regional Center (Onsala, Sweden)
+             Max-Planck-Institut fuer Radioastronomie (Bonn, Germany)
+             University of Valencia (Spain)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+#include <string.h>
+
+#ifndef __SWINFORMAT_H__
+#define __SWINFORMAT_H__
+
+
+/* A SWIN record is the sync word, the header version (1), the binary
+   header and the spectrum (Nchan single-precision complex numbers, where
+   Nchan is given by the frequency index in the DiFX input file). This is
+   the only decoder of the headers, used by DataIOSWIN (PolConvert) and
+   by the _SWINReader module. The offsets are counted from the sync word: */
+static const unsigned int SWINSYNC = 0xFF00FF00;
+static const int SWINVERSION = 1;
+
+static const long SWINBASELINE = 8;
+static const long SWINMJD = 12;
+static const long SWINSECONDS = 16;
+static const long SWINCONFIG = 24;
+static const long SWINSOURCE = 28;
+static const long SWINFREQ = 32;
+static const long SWINPOL = 36;
+static const long SWINBIN = 38;
+static const long SWINWEIGHT = 42;
+static const long SWINUVW = 50;
+static const long SWINHEADSIZE = 74;   // Up to the spectrum.
+
+
+// Contents of a record header:
+typedef struct {
+  int Baseline, MJD, Config, Source, Freq, Bin;
+  double Seconds, Weight, UVW[3];
+  char Pol[2];
+} SWINRecordHeader;
+
+
+// Decodes the header in buff (SWINHEADSIZE bytes, from the sync word).
+// Returns false if there is no sync word (or an unknown version):
+static inline bool parseSWINHeader(const char *buff, SWINRecordHeader &H){
+
+  unsigned int sync;
+  int version;
+
+  memcpy(&sync, buff, sizeof(int));
+  memcpy(&version, buff + sizeof(int), sizeof(int));
+  if (sync != SWINSYNC || version != SWINVERSION){return false;};
+
+  memcpy(&H.Baseline, buff + SWINBASELINE, sizeof(int));
+  memcpy(&H.MJD, buff + SWINMJD, sizeof(int));
+  memcpy(&H.Seconds, buff + SWINSECONDS, sizeof(double));
+  memcpy(&H.Config, buff + SWINCONFIG, sizeof(int));
+  memcpy(&H.Source, buff + SWINSOURCE, sizeof(int));
+  memcpy(&H.Freq, buff + SWINFREQ, sizeof(int));
+  memcpy(H.Pol, buff + SWINPOL, 2*sizeof(char));
+  memcpy(&H.Bin, buff + SWINBIN, sizeof(int));
+  memcpy(&H.Weight, buff + SWINWEIGHT, sizeof(double));
+  memcpy(H.UVW, buff + SWINUVW, 3*sizeof(double));
+  return true;
+
+};
+
+
+#endif
@@ -0,0 +1,116 @@
+/* SLIDINGMEDIAN - running order statistic over a sliding window
+
+             Copyright (C) 2013-2022  Ivan Marti-Vidal
+             Nordic Node of EU ALMA Regional Center (Onsala, Sweden)
+             Max-Planck-Institut fuer Radioastronomie (Bonn, Germany)
+             University of Valencia (Spain)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+#include <sys/types.h>
+#include <cmath>
+#include "./SlidingMedian.h"
+
+
+
+SlidingMedian::SlidingMedian(int nLow) {
+  NLow = nLow;
+};
+
+
+SlidingMedian::~SlidingMedian() {};
+
+
+void SlidingMedian::reset(int nLow) {
+  NLow = nLow;
+  Low.clear();
+  High.clear();
+};
+
+
+long SlidingMedian::size() {
+  return (long) (Low.size() + High.size());
+};
+
+
+
+// Move values across the halves until Low has (up to) NLow elements:
+void SlidingMedian::balance() {
+
+  std::multiset<double,MedianLess>::iterator it;
+
+  while ((long) Low.size() > NLow) {
+    it = Low.end(); it--;
+    High.insert(*it);
+    Low.erase(it);
+  };
+
+  while ((long) Low.size() < NLow && !High.empty()) {
+    it = High.begin();
+    Low.insert(*it);
+    High.erase(it);
+  };
+
+};
+
+
+
+void SlidingMedian::add(double value) {
+
+  MedianLess isLess;
+
+  if (!Low.empty() && !isLess(*Low.rbegin(),value)) {
+    Low.insert(value);
+  } else {
+    High.insert(value);
+  };
+
+  balance();
+
+};
+
+
+
+void SlidingMedian::remove(double value) {
+
+  MedianLess isLess;
+  std::multiset<double,MedianLess>::iterator it;
+
+// Equal values may be in both halves. Any copy will do:
+  if (!Low.empty() && !isLess(*Low.rbegin(),value)) {
+    it = Low.find(value);
+    if (it != Low.end()) {Low.erase(it); balance(); return;};
+  };
+
+  it = High.find(value);
+  if (it != High.end()) {High.erase(it);};
+
+  balance();
+
+};
+
+
+
+double SlidingMedian::lower() {
+  return *Low.rbegin();
+};
+
+
+double SlidingMedian::upper() {
+  return *High.begin();
+};
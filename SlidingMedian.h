@@ -0,0 +1,73 @@
+/* SLIDINGMEDIAN - running order statistic over a sliding window
+
+             Copyright (C) 2013-2022  Ivan Marti-Vidal
+             Nordic Node of EU ALMA Regional Center (Onsala, Sweden)
+             Max-Planck-Institut fuer Radioastronomie (Bonn, Germany)
+             University of Valencia (Spain)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+#include <sys/types.h>
+#include <cmath>
+#include <set>
+
+#ifndef __SLIDINGMEDIAN_H__
+#define __SLIDINGMEDIAN_H__
+
+
+/* NaNs are sorted after all the numbers (the plain "<" is not a
+   strict ordering if there are NaNs in the window). */
+struct MedianLess {
+  bool operator()(double a, double b) const {
+    return !std::isnan(a) && (std::isnan(b) || a < b);
+  };
+};
+
+
+/* Class to keep the NLow-th and (NLow+1)-th smallest values of a window
+   of samples that are added and removed one by one. The window is split
+   into two sorted halves ("Low" keeps the NLow smallest values), so each
+   add/remove costs O(log W). */
+class SlidingMedian {
+  public:
+    SlidingMedian(int nLow);
+    ~SlidingMedian();
+
+// Empty the window and set the size of the lower half:
+    void reset(int nLow);
+
+    void add(double value);
+
+// Remove one sample with this value (it must be in the window):
+    void remove(double value);
+
+// Largest value of the lower half (i.e., the NLow-th smallest):
+    double lower();
+
+// Smallest value of the upper half (i.e., the (NLow+1)-th smallest):
+    double upper();
+
+    long size();
+
+  private:
+    void balance();
+    int NLow;
+    std::multiset<double,MedianLess> Low, High;
+};
+
+#endif
@@ -1373,14 +1373,16 @@ def polconvert(IDI, OUTPUTIDI, DiFXinput, DiFXcalc, doIF, linAntIdx,
 
 #######
 # WARNING! UNCOMMENT THIS IF NOT DEBUGGING!
+# The copies keep the timestamps of IDI, so that the header indices
+# of previous runs (in POLCONVERT.INDEX) remain valid:
   if os.path.exists(OUTPUTIDI) and IDI != OUTPUTIDI:
     printMsg('Will REMOVE the existing OUTPUT file (or directory)!\n')
     printMsg('Copying IDI to OUTPUTIDI!\n')
     os.system('rm -rf %s'%OUTPUTIDI)
-    os.system('cp -rf %s %s'%(IDI,OUTPUTIDI))
+    os.system('cp -rp %s %s'%(IDI,OUTPUTIDI))
   elif not os.path.exists(OUTPUTIDI):
     printMsg('Copying IDI to OUTPUTIDI!\n')
-    os.system('cp -rf %s %s'%(IDI,OUTPUTIDI))
+    os.system('cp -rp %s %s'%(IDI,OUTPUTIDI))
 #     
 #######
 
@@ -0,0 +1,109 @@
+/* TIMING - per-stage timers and counters of a PolConvert run
+
+             Copyright (C) 2013-2022  Ivan Marti-Vidal
+             Nordic Node of EU ALMA Regional Center (Onsala, Sweden)
+             Max-Planck-Institut fuer Radioastronomie (Bonn, Germany)
+             University of Valencia (Spain)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <iostream>
+#include "./Timing.h"
+
+
+static const char *STAGENAMES[Timing::NSTAGES] = {"header", "autocorr",
+      "caltables", "interpolate", "kmatrix", "read", "apply", "plot", "write"};
+
+static const char *COUNTERNAMES[Timing::NCOUNTERS] = {"records",
+      "visibilities", "kbuilds", "plotrecords", "bytesread", "byteswritten"};
+
+
+
+Timing::Timing(bool enable){
+
+  int i;
+  isEnabled = enable;
+  Begin = Clock::now();
+  for (i=0; i<NSTAGES; i++){Elapsed[i] = Clock::duration::zero(); Calls[i] = 0;};
+  for (i=0; i<NCOUNTERS; i++){Counts[i] = 0;};
+
+};
+
+
+bool Timing::enabled(){return isEnabled;};
+
+double Timing::total(){
+  return std::chrono::duration<double>(Clock::now() - Begin).count();
+};
+
+double Timing::seconds(int stage){
+  return std::chrono::duration<double>(Elapsed[stage]).count();
+};
+
+long Timing::calls(int stage){return Calls[stage];};
+
+long Timing::counts(int counter){return Counts[counter];};
+
+const char *Timing::stageName(int stage){return STAGENAMES[stage];};
+
+const char *Timing::counterName(int counter){return COUNTERNAMES[counter];};
+
+
+void Timing::merge(Timing &other){
+
+  int i;
+  if (!isEnabled || !other.isEnabled){return;};
+  for (i=0; i<NSTAGES; i++){Elapsed[i] += other.Elapsed[i]; Calls[i] += other.Calls[i];};
+  for (i=0; i<NCOUNTERS; i++){Counts[i] += other.Counts[i];};
+
+};
+
+
+
+
+void Timing::summary(FILE *logFile){
+
+  char message[512];
+  int i;
+  double Ttot = total(), Tstages = 0.0;
+
+  if (!isEnabled){return;};
+
+  sprintf(message,"\n TIMING SUMMARY (%.3f s in total):\n",Ttot);
+  fprintf(logFile,"%s",message); std::cout<<message;
+
+  for (i=0; i<NSTAGES; i++){
+    Tstages += seconds(i);
+    sprintf(message,"   %-12s %10.3f s  %5.1f%%  (%li calls)\n",STAGENAMES[i],
+        seconds(i), Ttot>0.0 ? 100.*seconds(i)/Ttot : 0.0, Calls[i]);
+    fprintf(logFile,"%s",message); std::cout<<message;
+  };
+
+  sprintf(message,"   %-12s %10.3f s\n","(other)",Ttot-Tstages);
+  fprintf(logFile,"%s",message); std::cout<<message;
+
+  for (i=0; i<NCOUNTERS; i++){
+    sprintf(message,"   %-12s %12li\n",COUNTERNAMES[i],Counts[i]);
+    fprintf(logFile,"%s",message); std::cout<<message;
+  };
+
+  fflush(logFile);
+
+};
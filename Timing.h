@@ -0,0 +1,89 @@
+/* TIMING - per-stage timers and counters of a PolConvert run
+
+             Copyright (C) 2013-2022  Ivan Marti-Vidal
+             Nordic Node of EU ALMA Regional Center (Onsala, Sweden)
+             Max-Planck-Institut fuer Radioastronomie (Bonn, Germany)
+             University of Valencia (Spain)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <chrono>
+
+#ifndef __TIMING_H__
+#define __TIMING_H__
+
+
+/* Accumulated (monotonic) time spent in each stage of the conversion,
+   plus some counters. Stages must not be nested with themselves, and
+   they are only timed from one thread. If the object is not enabled,
+   start, stop and count do nothing (besides checking the flag). */
+class Timing {
+  public:
+
+    enum Stage {HEADER, AUTOCORR, CALTABLES, INTERPOLATE, KMATRIX,
+                READ, APPLY, PLOT, WRITE, NSTAGES};
+
+    enum Counter {RECORDS, VISIBILITIES, KBUILDS, PLOTRECORDS,
+                  BYTESREAD, BYTESWRITTEN, NCOUNTERS};
+
+    Timing(bool enable);
+
+    inline void start(int stage){
+      if (isEnabled){Start[stage] = Clock::now();};
+    };
+
+    inline void stop(int stage){
+      if (isEnabled){Elapsed[stage] += Clock::now() - Start[stage]; Calls[stage] += 1;};
+    };
+
+    inline void count(int counter, long n){
+      if (isEnabled){Counts[counter] += n;};
+    };
+
+    bool enabled();
+
+// Total time since the object was created:
+    double total();
+
+    double seconds(int stage);
+    long calls(int stage);
+    long counts(int counter);
+
+    static const char *stageName(int stage);
+    static const char *counterName(int counter);
+
+// Adds the stages and counters of another object (e.g., of a conversion
+// thread). The times of parallel threads add up, so the sum of the 
+// stages may be larger than the total time:
+    void merge(Timing &other);
+
+// Write a table of the stages and counters (to the log and stdout):
+    void summary(FILE *logFile);
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    bool isEnabled;
+    Clock::time_point Begin, Start[NSTAGES];
+    Clock::duration Elapsed[NSTAGES];
+    long Calls[NSTAGES], Counts[NCOUNTERS];
+};
+
+#endif
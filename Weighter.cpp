@@ -27,16 +27,42 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include <iostream>  
 #include <fstream>
 #include <cstring>
+#include <algorithm>
 #include <complex.h>
 #include "./Weighter.h"
 
 
-Weighter::~Weighter(){};
+Weighter::~Weighter(){
+
+// A copy does not own the timeline:
+  if(nants<0 || isClone){return;};
+
+  delete[] antIdx;
+  delete[] Breaks;
+  delete[] maskAt;
+  delete[] maskAfter;
+  delete[] refAt;
+  delete[] refAfter;
+  delete[] badAt;
+  delete[] badAfter;
+
+};
 
 
 Weighter::Weighter(FILE *logF) {
  logFile = logF;
  nants = -1;
+ isClone = false;
+};
+
+
+Weighter::Weighter(Weighter &parent, FILE *logF) {
+ *this = parent;
+ logFile = logF;
+ isClone = true;
+ currSeg = 0;
+ currTime = 0.0;
+ currRefAnt = 0;
 };
 
 
@@ -44,6 +70,7 @@ Weighter::Weighter(int nPhase, long *nASDMtimes, long nASDMentries, int *ASDMant
 
 
  logFile = logF;
+ isClone = false;
 
  nants = nPhase;
  nASDMEntries = nASDMentries; 
@@ -58,23 +85,152 @@ Weighter::Weighter(int nPhase, long *nASDMtimes, long nASDMentries, int *ASDMant
  badTimes = BadTimes;
  NbadTimes = NBadTimes;
 
+ buildTimeline();
+
+};
+
+
+
+/* Merges all the time intervals into the timeline of breakpoints */
+void Weighter::buildTimeline(){
+
+  long i, k, s, s0, s1, nmax;
+  int j;
+
+// Antenna ids -> index in ants (the first one, if repeated):
+  minAnt = 0; nAntIdx = 0;
+  if(nants>0){
+    minAnt = ants[0];
+    int maxAnt = ants[0];
+    for (j=1; j<nants; j++){
+      if(ants[j]<minAnt){minAnt=ants[j];};
+      if(ants[j]>maxAnt){maxAnt=ants[j];};
+    };
+    nAntIdx = maxAnt - minAnt + 1;
+  };
+  antIdx = new int[nAntIdx+1];
+  for (j=0; j<nAntIdx; j++){antIdx[j] = -1;};
+  for (j=nants-1; j>=0; j--){antIdx[ants[j]-minAnt] = j;};
+
+// Collect (and sort) all the interval edges:
+  nmax = 2*nASDMEntries + 2*NbadTimes;
+  for (j=0; j<nants; j++){nmax += 2*ntimes[j];};
+  Breaks = new double[nmax+1];
+
+  nBreaks = 0;
+  for (j=0; j<nants; j++){
+    for (i=0; i<2*ntimes[j]; i++){Breaks[nBreaks] = JDtimes[j][i]; nBreaks += 1;};
+  };
+  for (i=0; i<nASDMEntries; i++){
+    Breaks[nBreaks] = Time0[i]; Breaks[nBreaks+1] = Time1[i]; nBreaks += 2;
+  };
+  for (i=0; i<2*NbadTimes; i++){Breaks[nBreaks] = badTimes[i]; nBreaks += 1;};
+
+  std::sort(Breaks, Breaks+nBreaks);
+  nBreaks = std::unique(Breaks, Breaks+nBreaks) - Breaks;
+
+// States at (and after) each breakpoint:
+  nWords = nants/64 + 1;
+  maskAt = new unsigned long long[nBreaks*nWords+1];
+  maskAfter = new unsigned long long[nBreaks*nWords+1];
+  refAt = new int[nBreaks+1];
+  refAfter = new int[nBreaks+1];
+  badAt = new int[nBreaks+1];
+  badAfter = new int[nBreaks+1];
+
+  for (s=0; s<nBreaks*nWords; s++){maskAt[s] = 0; maskAfter[s] = 0;};
+  for (s=0; s<nBreaks; s++){
+    refAt[s] = -1; refAfter[s] = -1;
+    badAt[s] = -1; badAfter[s] = -1;
+  };
+
+// Antennas in the phased sum:
+  for (j=0; j<nants; j++){
+    for (i=0; i<ntimes[j]; i++){
+      if (JDtimes[j][2*i] > JDtimes[j][2*i+1]){continue;};
+      s0 = std::lower_bound(Breaks, Breaks+nBreaks, JDtimes[j][2*i]) - Breaks;
+      s1 = std::lower_bound(Breaks, Breaks+nBreaks, JDtimes[j][2*i+1]) - Breaks;
+      for (s=s0; s<=s1; s++){
+        maskAt[s*nWords + j/64] |= 1ULL << (j%64);
+        if (s<s1){maskAfter[s*nWords + j/64] |= 1ULL << (j%64);};
+      };
+    };
+  };
+
+// Reference antennas and bad times (the first entry that covers the time 
+// is the one used, so we paint them in reverse order):
+  for (i=nASDMEntries-1; i>=0; i--){
+    if (Time0[i] > Time1[i]){continue;};
+    s0 = std::lower_bound(Breaks, Breaks+nBreaks, Time0[i]) - Breaks;
+    s1 = std::lower_bound(Breaks, Breaks+nBreaks, Time1[i]) - Breaks;
+    for (s=s0; s<=s1; s++){
+      refAt[s] = (int) i;
+      if (s<s1){refAfter[s] = (int) i;};
+    };
+  };
+
+  for (k=NbadTimes-1; k>=0; k--){
+    if (badTimes[2*k] > badTimes[2*k+1]){continue;};
+    s0 = std::lower_bound(Breaks, Breaks+nBreaks, badTimes[2*k]) - Breaks;
+    s1 = std::lower_bound(Breaks, Breaks+nBreaks, badTimes[2*k+1]) - Breaks;
+    for (s=s0; s<=s1; s++){
+      badAt[s] = (int) k;
+      if (s<s1){badAfter[s] = (int) k;};
+    };
+  };
+
+  currSeg = 0;
+
+  sprintf(message,"Weighter: %li breakpoints in the phasing timeline\n",nBreaks);
+  fprintf(logFile,"%s",message); fflush(logFile);
+
 };
 
 
+
+/* Returns the timeline segment (i.e., the last breakpoint <= JDtime),
+   or -1 if JDtime is before the first breakpoint. */
+long Weighter::findSegment(double JDtime, bool *isAt){
+
+  *isAt = false;
+  if (nBreaks==0 || JDtime < Breaks[0]){return -1;};
+
+// Try the current segment and the next one:
+  if (Breaks[currSeg] > JDtime || (currSeg<nBreaks-1 && Breaks[currSeg+1] <= JDtime)){
+    if (currSeg<nBreaks-2 && Breaks[currSeg+1] <= JDtime && Breaks[currSeg+2] > JDtime){
+      currSeg += 1;
+    } else {
+      currSeg = (std::upper_bound(Breaks, Breaks+nBreaks, JDtime) - Breaks) - 1;
+    };
+  };
+
+  *isAt = (Breaks[currSeg] == JDtime);
+  return currSeg;
+
+};
+
+
+
 /* Returns whether ALMA was effectively phased at this time */
-bool Weighter::isPhased(double JDTime){
+bool Weighter::isPhased(double JDTime, bool doLog){
 
   int i;
+  long s;
   bool Phased = true;
+  bool isAt;
 
   if(nants<0){return Phased;};
 
-  for (i=0; i<NbadTimes; i++){
-    if(JDTime>=badTimes[2*i] && JDTime<=badTimes[2*i+1]){
+  s = findSegment(JDTime, &isAt);
+  if (s<0){return Phased;};
+
+  i = isAt ? badAt[s] : badAfter[s];
+  if (i>=0){
+    if (doLog){
       sprintf(message,"Bad time %i: %.8f |  %.8f %.8f!\n",i,JDTime,badTimes[2*i],badTimes[2*i+1]);
       fprintf(logFile,"%s",message);  std::cout<<message; fflush(logFile);
-      Phased=false;break;
     };
+    Phased=false;
   };
 
   return Phased;
@@ -85,31 +241,23 @@ bool Weighter::isPhased(double JDTime){
 /* Returns whether the antenna is in the phased sum (true) or not (false) */
 bool Weighter::getWeight(int iant, double JDtime){
 
-  long i;
   int j;
+  long s;
+  bool isAt;
+  unsigned long long *mask;
 
-  bool inside;
-  inside=true;
-  if(nants<0){return inside;};
+  if(nants<0){return true;};
 
-  for (j=0; j<nants; j++){
-    if (ants[j] == iant){break;};
-  };
+  if (iant<minAnt || iant>=minAnt+nAntIdx){return false;};
+  j = antIdx[iant-minAnt];
+  if (j<0){return false;};
 
-  inside = false;
+  s = findSegment(JDtime, &isAt);
+  if (s<0){return false;};
 
-  if(j<nants){
-    for (i=0; i<ntimes[j]; i++){
-      if (JDtimes[j][2*i]<=JDtime && JDtimes[j][2*i+1]>=JDtime){inside = true; break;};   
-    };
-  };
-
-//  if(!inside){
-//    sprintf(message,"T: %.5f ; ANT: %i ; %i\n",JDtime,iant,inside);
-//    fprintf(logFile,"%s",message);fflush(logFile);
-//  };
+  mask = isAt ? &maskAt[s*nWords] : &maskAfter[s*nWords];
 
-  return inside;
+  return (mask[j/64] >> (j%64)) & 1ULL;
 
 };
 
@@ -119,17 +267,21 @@ bool Weighter::getWeight(int iant, double JDtime){
 // Returns -1 if no valid time range is used.
 int Weighter::getRefAnt(double JDtime){
 
-  long i;
+  long s;
+  int i;
+  bool isAt;
 
   if(nants<0){return 0;};
 
   if (JDtime == currTime){return currRefAnt;};
 
-  for (i=0; i<nASDMEntries; i++){
-    if (Time0[i]<=JDtime && Time1[i]>=JDtime){
+  s = findSegment(JDtime, &isAt);
+  if (s>=0){
+    i = isAt ? refAt[s] : refAfter[s];
+    if (i>=0){
       currTime = JDtime; currRefAnt = refAnts[i];
       return currRefAnt;
-    };   
+    };
   };
 
 // If no refant is found, no X-Y offset will be applied:
@@ -31,14 +31,34 @@ class Weighter {
   public:
     Weighter(int nPhase, long *nASDMtimes, long nASDMEntries, int *ASDMant, double **ASDMtimes, int *refants, double *time0, double *time1, double *BadTimes, int NBadTimes, FILE *logF);
     Weighter(FILE *logF);
+
+// Copy that shares the timeline, but has its own cursor (e.g., for 
+// another conversion thread). It logs to logF:
+    Weighter(Weighter &parent, FILE *logF);
     ~Weighter();
 
-    bool isPhased(double JDtime);
+// Whether the array was phased (doLog = false does not log the bad times):
+    bool isPhased(double JDtime, bool doLog=true);
     bool getWeight(int iant, double JDtime);
     int getRefAnt(double JDtime);
 
   private:
 
+/* The phasing, weight and refant intervals are merged into a timeline 
+   of sorted breakpoints. For each breakpoint, we store the state AT the 
+   breakpoint (intervals are closed) and the state AFTER it (i.e., up 
+   to the next breakpoint). Queries use a cursor (times are usually 
+   monotonic), with a binary search as fallback. */
+    void buildTimeline();
+    long findSegment(double JDtime, bool *isAt);
+    long nBreaks, currSeg;
+    bool isClone;
+    int nWords, minAnt, nAntIdx;
+    int *antIdx;
+    double *Breaks;
+    unsigned long long *maskAt, *maskAfter;
+    int *refAt, *refAfter, *badAt, *badAfter;
+
     FILE *logFile;
     char message[512];
     int nants;
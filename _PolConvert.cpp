@@ -88,7 +88,15 @@
 #include "./DataIOSWIN.h"
 #include "./CalTable.h"
 #include "./Weighter.h"
+#include "./KMatrix.h"
+#include "./KTimeline.h"
+#include "./Timing.h"
 #include <sstream> 
+#include <vector>
+#include <thread>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
 
 
 
@@ -125,24 +133,38 @@ static char PolConvert_docstring[] =
     "Converts mixed-polarization visibilities into pure circular-polarization basis";
 static char setPCMode_docstring[] =
     "Sets the running mode to either ALMA (true; the default) or non-ALMA (false).";
+static char setTiming_docstring[] =
+    "Turns on (true) or off (false; the default) the timing of the conversion stages. If on, PolConvert returns (status, dict of timings and counters).";
+static char setKTimeline_docstring[] =
+    "Sets the K-matrix timeline mode and file: 0 (the default) does not use it, 1 writes the conversion matrices of the next PolConvert calls to the file, and 2 reads them from it (and does not use the calibration tables).";
 
 
 
 /* Available functions */
 static PyObject *PolConvert(PyObject *self, PyObject *args);
 static PyObject *setPCMode(PyObject *self, PyObject *args);
+static PyObject *setTiming(PyObject *self, PyObject *args);
+static PyObject *setKTimeline(PyObject *self, PyObject *args);
 
 
 /* Module specification */
 static PyMethodDef module_methods[] = {
     {"PolConvert", PolConvert, METH_VARARGS, PolConvert_docstring},
     {"setPCMode", setPCMode, METH_VARARGS, setPCMode_docstring},
+    {"setTiming", setTiming, METH_VARARGS, setTiming_docstring},
+    {"setKTimeline", setKTimeline, METH_VARARGS, setKTimeline_docstring},
     {NULL, NULL, 0, NULL}   /* terminated by list of NULLs, apparently */
 };
 
 
 
 bool PCMode;
+bool PCTiming;
+
+// Use of the K-matrix timeline (see setKTimeline):
+enum {KTL_OFF = 0, KTL_WRITE = 1, KTL_READ = 2};
+int PCKMode;
+std::string PCKFile;
 
 /* Initialize the module */
 #if PY_MAJOR_VERSION >= 3
@@ -158,6 +180,8 @@ static struct PyModuleDef pc_module_def = {
 PyMODINIT_FUNC PyInit__PolConvert(void)
 {
     PCMode = true;
+    PCTiming = false;
+    PCKMode = KTL_OFF;
     PyObject *m = PyModule_Create(&pc_module_def);
     return(m);
 }
@@ -166,61 +190,972 @@ PyMODINIT_FUNC PyInit__PolConvert(void)
 #else
 
 
-PyMODINIT_FUNC init_PolConvert(void)
-{
-    PCMode = true;
-    PyObject *m = Py_InitModule3("_PolConvert", module_methods, module_docstring);
-    if (m == NULL)
-        return;
+PyMODINIT_FUNC init_PolConvert(void)
+{
+    PCMode = true;
+    PCTiming = false;
+    PCKMode = KTL_OFF;
+    PyObject *m = Py_InitModule3("_PolConvert", module_methods, module_docstring);
+    if (m == NULL)
+        return;
+
+}
+#endif
+
+
+
+// Set the mode to non-ALMA, if the argument is 0 (false).
+static PyObject *setPCMode(PyObject *self, PyObject *args){
+  PyObject *ret;
+  int whichMode;
+  if (!PyArg_ParseTuple(args, "i",&whichMode)){      
+      printf("FAILED PolConvert! Unable to parse arguments!\n");
+      fflush(stdout);
+      ret = Py_BuildValue("i",-1);
+      return ret;
+  };
+
+  if(whichMode==0){
+    PCMode=false;
+    printf("PolConvert interface will change to non-ALMA.\n");
+    fflush(stdout);
+  } else {
+/* PCMode=true */
+    printf("PolConvert interface remains in ALMA mode.\n");
+    fflush(stdout);
+  };
+  ret = Py_BuildValue("i",0);
+  return ret;
+
+
+};
+
+
+
+// Turn on (or off) the timing of the conversion stages:
+static PyObject *setTiming(PyObject *self, PyObject *args){
+  PyObject *ret;
+  int doTiming;
+  if (!PyArg_ParseTuple(args, "i",&doTiming)){      
+      printf("FAILED PolConvert! Unable to parse arguments!\n");
+      fflush(stdout);
+      ret = Py_BuildValue("i",-1);
+      return ret;
+  };
+
+  PCTiming = (doTiming!=0);
+  printf("PolConvert stage timing is %s.\n", PCTiming ? "on" : "off");
+  fflush(stdout);
+  ret = Py_BuildValue("i",0);
+  return ret;
+
+};
+
+
+
+// Write (mode 1) or read (mode 2) the conversion matrices to/from a file:
+static PyObject *setKTimeline(PyObject *self, PyObject *args){
+  PyObject *ret;
+  int whichMode;
+  char *fileName;
+  if (!PyArg_ParseTuple(args, "is",&whichMode,&fileName)){
+      printf("FAILED PolConvert! Unable to parse arguments!\n");
+      fflush(stdout);
+      ret = Py_BuildValue("i",-1);
+      return ret;
+  };
+
+  if (whichMode<KTL_OFF || whichMode>KTL_READ){
+      printf("Unknown K-matrix timeline mode %i\n",whichMode);
+      fflush(stdout);
+      ret = Py_BuildValue("i",-1);
+      return ret;
+  };
+
+  PCKMode = whichMode;
+  PCKFile = fileName;
+  if (PCKMode==KTL_OFF){
+    printf("PolConvert will not use a K-matrix timeline.\n");
+  } else {
+    printf("PolConvert will %s the K-matrix timeline %s.\n",
+           (PCKMode==KTL_WRITE) ? "write" : "read", PCKFile.c_str());
+  };
+  fflush(stdout);
+  ret = Py_BuildValue("i",0);
+  return ret;
+
+};
+
+
+
+// Dictionary with the timers and counters of a conversion:
+static PyObject *timingDict(Timing &Timer){
+  PyObject *stats = PyDict_New();
+  PyObject *secs = PyDict_New(), *calls = PyDict_New(), *counts = PyDict_New();
+  PyObject *item;
+  int i;
+
+  for (i=0; i<Timing::NSTAGES; i++){
+    item = PyFloat_FromDouble(Timer.seconds(i));
+    PyDict_SetItemString(secs,Timing::stageName(i),item); Py_DECREF(item);
+    item = PyLong_FromLong(Timer.calls(i));
+    PyDict_SetItemString(calls,Timing::stageName(i),item); Py_DECREF(item);
+  };
+  for (i=0; i<Timing::NCOUNTERS; i++){
+    item = PyLong_FromLong(Timer.counts(i));
+    PyDict_SetItemString(counts,Timing::counterName(i),item); Py_DECREF(item);
+  };
+
+  item = PyFloat_FromDouble(Timer.total());
+  PyDict_SetItemString(stats,"total",item); Py_DECREF(item);
+  PyDict_SetItemString(stats,"seconds",secs); Py_DECREF(secs);
+  PyDict_SetItemString(stats,"calls",calls); Py_DECREF(calls);
+  PyDict_SetItemString(stats,"counts",counts); Py_DECREF(counts);
+  return stats;
+};
+
+
+
+
+
+
+//////////////////////////////////
+// MAIN FUNCTION: 
+// Data of a numpy array, as a C-contiguous and aligned buffer of the given
+// type. Arrays that are not (slices, transposes, other dtypes) are copied.
+// The returned reference is kept in Keep, and must be released (with the
+// GIL) once the buffer is no longer used:
+static void *contiguousData(PyObject *arr, int typenum, std::vector<PyObject*> &Keep){
+  PyObject *carr = PyArray_FROMANY(arr, typenum, 0, 0, NPY_ARRAY_IN_ARRAY);
+  if (carr == NULL){  // Not convertible. Use the buffer as it is:
+    PyErr_Clear();
+    return PyArray_DATA((PyArrayObject *) arr);
+  };
+  Keep.push_back(carr);
+  return PyArray_DATA((PyArrayObject *) carr);
+};
+
+
+static void releaseData(std::vector<PyObject*> &Keep){
+  size_t i;
+  for (i=0; i<Keep.size(); i++){Py_DECREF(Keep[i]);};
+  Keep.clear();
+};
+
+
+
+// Maximum number of time blocks (i.e., threads) of the conversion of an
+// IF. The IFs of SWIN files are split in blocks if the POLCONVERT_BLOCKS 
+// environment variable is larger than 1 (see DataIOSWIN::splitIF). If
+// POLCONVERT_SHARDS is larger than 1, the IFs are split in that number
+// of blocks, converted in forked processes (shards) instead of threads:
+static const int MAXCONVTHREADS = 64;
+
+
+// Setup of the conversion (read-only while the visibilities are converted,
+// so it is shared by the threads of the parallel conversion):
+typedef struct {
+  int nALMA, *almanums, *nsumArr, *ngainTabs, *nchans, maxnchan;
+  int KMode, calField, verbose;
+  bool PCMode, doTest, doNorm, *XYSWAP;
+  std::complex<float> H[2][2], HSw[2][2];
+  cplx32f ****PrioriGains;
+  double *plRange, *doRange;
+  FILE **plotFile;
+  DataIO *DifXData;
+  DataIOSWIN *SWINData;  // NULL for FITS-IDI.
+  KTimeline *KTL;
+} ConvSetup;
+
+
+/* State of a conversion thread: its own copies of the calibration tables 
+   (for the interpolation cursors), gains, weights and matrices, and the 
+   files where it writes (the log, stdout, the gains and the plots). The 
+   first thread uses the original tables and files; the others write to 
+   memory streams (or temporary files, if they run in another process), 
+   that are appended to the files in the order of the time blocks. The
+   other threads start with the matrices that the serial conversion has
+   at the start of their block (see seedMatrices). */
+typedef struct {
+  CalTable ***allgains, **alldterms;
+  Weighter *ALMAWeight;
+  KMatrix *KBuilder;
+  std::complex<float> ****AnG, ****AnDt, *(*Ktotal)[2][2], *gainRatio, auxD;
+  bool **Weight, *KBuilt, failed, inProcess;
+  float NormFac[2];
+  double lastTFailed;
+  Timing *Timer;
+  VisState *S;   // NULL in the serial conversion.
+  FILE *log, *out, *gains, *plot;
+  char *Buffers[4];
+  size_t Sizes[4];
+} ConvThread;
+
+
+
+
+// Gains, weights and matrices of a conversion thread:
+static void allocConvThread(ConvThread &T, ConvSetup &C){
+
+  int ij, ii, ik, auxI;
+
+  T.AnG = new std::complex<float> ***[C.nALMA];
+  T.AnDt = new std::complex<float> ***[C.nALMA];
+  T.Weight = new bool *[C.nALMA];
+  T.Ktotal = new std::complex<float> *[C.nALMA][2][2];
+  T.KBuilt = new bool[C.nALMA];
+  T.gainRatio = new std::complex<float>[C.maxnchan];
+  T.KBuilder = new KMatrix(C.maxnchan);
+  T.auxD = 0.0;
+  T.lastTFailed = 0.0;
+  T.failed = false;
+
+  for (ij=0; ij<C.nALMA; ij++) {
+    auxI = C.nsumArr[ij];
+
+    T.AnG[ij] =  new std::complex<float> **[auxI];
+    T.AnDt[ij] =  new std::complex<float> **[auxI];
+    T.Weight[ij] =  new bool [auxI];
+    T.KBuilt[ij] = true;
+
+    for (ii=0; ii<auxI; ii++) {
+      T.AnG[ij][ii] =  new std::complex<float> *[2];
+      T.AnG[ij][ii][0] = new std::complex<float>[C.maxnchan];
+      T.AnG[ij][ii][1] = new std::complex<float>[C.maxnchan];
+      T.AnDt[ij][ii] =  new std::complex<float> *[2];
+      T.AnDt[ij][ii][0] = new std::complex<float>[C.maxnchan];
+      T.AnDt[ij][ii][1] = new std::complex<float>[C.maxnchan];
+    };
+
+// Ktotal matrix:
+    for (ii=0; ii<2; ii++) {
+      for (ik=0; ik<2; ik++) {
+        T.Ktotal[ij][ii][ik] = new std::complex<float>[C.maxnchan];
+      };
+    };
+
+  };
+
+};
+
+
+static void freeConvThread(ConvThread &T, ConvSetup &C){
+
+  int ij, ii, ik, auxI;
+
+  for (ij=0; ij<C.nALMA; ij++) {
+    auxI = C.nsumArr[ij];
+    for (ii=0; ii<auxI; ii++) {
+      delete[] T.AnG[ij][ii][0];
+      delete[] T.AnG[ij][ii][1];
+      delete[] T.AnDt[ij][ii][0];
+      delete[] T.AnDt[ij][ii][1];
+      delete[] T.AnG[ij][ii];
+      delete[] T.AnDt[ij][ii];
+    };
+    delete[] T.AnG[ij];
+    delete[] T.AnDt[ij];
+    delete[] T.Weight[ij];
+
+    for (ii=0; ii<2; ii++) {
+      for (ik=0; ik<2; ik++) {
+        delete[] T.Ktotal[ij][ii][ik];
+      };
+    };
+  };
+
+  delete[] T.AnG;
+  delete[] T.AnDt;
+  delete[] T.Weight;
+  delete[] T.Ktotal;
+  delete[] T.KBuilt;
+  delete[] T.gainRatio;
+  delete T.KBuilder;
+
+};
+
+
+
+
+// Another conversion thread, for the current IF (i.e., after setMapping
+// of the tables of the first thread). If inProcess, it will run in a 
+// forked process (and write to temporary files). Returns false if the 
+// streams cannot be created:
+static bool copyConvThread(ConvThread &T, ConvThread &First, ConvSetup &C, bool inProcess){
+
+  int ij, ik;
+
+  T.Buffers[0] = NULL; T.Buffers[1] = NULL; T.Buffers[2] = NULL; T.Buffers[3] = NULL;
+  T.inProcess = inProcess;
+  if (inProcess){
+    T.log = tmpfile(); T.out = tmpfile(); T.gains = tmpfile(); T.plot = tmpfile();
+  } else {
+    T.log = open_memstream(&T.Buffers[0], &T.Sizes[0]);
+    T.out = open_memstream(&T.Buffers[1], &T.Sizes[1]);
+    T.gains = open_memstream(&T.Buffers[2], &T.Sizes[2]);
+    T.plot = open_memstream(&T.Buffers[3], &T.Sizes[3]);
+  };
+
+  if (T.log==NULL || T.out==NULL || T.gains==NULL || T.plot==NULL){
+    if (T.log!=NULL){fclose(T.log);};
+    if (T.out!=NULL){fclose(T.out);};
+    if (T.gains!=NULL){fclose(T.gains);};
+    if (T.plot!=NULL){fclose(T.plot);};
+    for (ij=0; ij<4; ij++){free(T.Buffers[ij]);};
+    return false;
+  };
+
+  allocConvThread(T, C);
+
+// No matrices from the previous times:
+  for (ij=0; ij<C.nALMA; ij++){T.KBuilt[ij] = false;};
+
+  T.allgains = new CalTable**[C.nALMA];
+  T.alldterms = new CalTable*[C.nALMA];
+  for (ij=0; ij<C.nALMA; ij++){
+    T.alldterms[ij] = new CalTable(*First.alldterms[ij], T.log);
+    T.allgains[ij] = new CalTable*[C.ngainTabs[ij]];
+    for (ik=0; ik<C.ngainTabs[ij]; ik++){
+      T.allgains[ij][ik] = new CalTable(*First.allgains[ij][ik], T.log);
+    };
+  };
+  T.ALMAWeight = new Weighter(*First.ALMAWeight, T.log);
+
+  T.Timer = new Timing(First.Timer->enabled());
+  T.S = C.SWINData->newState(T.Timer);
+
+  return true;
+
+};
+
+
+// Appends the outputs of a thread to the files (and merges its timing): 
+static void dropConvThread(ConvThread &T, ConvThread &First, ConvSetup &C, FILE *plotFile){
+
+  int ij, ik;
+  size_t n;
+  char chunk[65536];
+  FILE *Streams[4] = {T.log, T.out, T.gains, T.plot};
+  FILE *Files[4] = {First.log, First.out, First.gains, plotFile};
+
+  for (ij=0; ij<4; ij++){
+    if (T.inProcess){
+      rewind(Streams[ij]);
+      while ((n = fread(chunk, 1, sizeof(chunk), Streams[ij])) > 0){
+        if (Files[ij] != NULL){fwrite(chunk, 1, n, Files[ij]);};
+      };
+      fclose(Streams[ij]);
+    } else {
+      fclose(Streams[ij]);
+      if (Files[ij] != NULL){fwrite(T.Buffers[ij], 1, T.Sizes[ij], Files[ij]);};
+      free(T.Buffers[ij]);
+    };
+  };
+  fflush(First.log); fflush(First.out);
+
+  for (ij=0; ij<C.nALMA; ij++){
+    for (ik=0; ik<C.ngainTabs[ij]; ik++){delete T.allgains[ij][ik];};
+    delete[] T.allgains[ij];
+    delete T.alldterms[ij];
+  };
+  delete[] T.allgains;
+  delete[] T.alldterms;
+  delete T.ALMAWeight;
+
+  C.SWINData->freeState(T.S);
+  First.Timer->merge(*T.Timer);
+  delete T.Timer;
+
+  freeConvThread(T, C);
+
+};
+
+
+
+
+/* Computes the matrix of antenna currAnt (index currAntIdx in the list 
+   of linear-pol antennas) at time currT, from the calibration tables (it 
+   is only rebuilt if they changed, or set to the unconverted matrix if 
+   there are no valid weights). Phased tells whether the array was phased.
+   If seed, nothing is written (see seedMatrices). Returns false if there
+   is an error (and the conversion must stop): */
+static bool computeK(ConvSetup &C, ConvThread &T, int im, int ii, double currT, int currAnt,
+                     int currAntIdx, int currFile, long countNvis, bool seed, bool &Phased){
+
+  static const std::complex<float> oneOverSqrt2 = 0.7071067811;
+
+  char message[2048];
+  int ij, ik, j, currNant, ALMARefAnt;
+  bool gchanged = true, dtchanged = true, allflagged, auxB1, newK;
+  float AntTab;
+  std::complex<float> gainXY[2];
+
+  CalTable ***allgains = T.allgains;
+  CalTable **alldterms = T.alldterms;
+  std::complex<float> ****AnG = T.AnG, ****AnDt = T.AnDt, *gainRatio = T.gainRatio;
+  std::complex<float> *(*Ktotal)[2][2] = T.Ktotal;
+  bool **Weight = T.Weight;
+  float *NormFac = T.NormFac;
+  int *nchans = C.nchans;
+
+
+//////////////////////////////////////////////////////
+// Set the interpolation time and compute gains:
+             currNant = C.nsumArr[currAntIdx] ;
+
+// Find the ALMA antennas involved in the phasing:
+
+             if(C.verbose && !seed){fprintf(T.out," Doing vis %li  -  %.3f  -  %i\n",
+               countNvis, currT, currNant);fflush(T.out);
+             };
+             allflagged = true;
+
+             if (currNant>1 && C.PCMode){
+               Phased = T.ALMAWeight->isPhased(currT, !seed);
+               if (Phased){
+                 for (ij=0; ij<currNant; ij++) {
+                   Weight[currAntIdx][ij] = T.ALMAWeight->getWeight(ij,currT);
+                   if (Weight[currAntIdx][ij]){allflagged = false;};
+                 };
+               };
+             } else {
+               Phased=true; Weight[currAntIdx][0] = true; allflagged = false;
+             };
+
+// get ALMA refant used in the Phasing (to correct for X-Y phase offset):
+             ALMARefAnt = T.ALMAWeight->getRefAnt(currT);
+    
+ 
+             for (ij=0; ij<nchans[ii]; ij++){
+               gainRatio[ij] = C.PrioriGains[currFile][currAntIdx][im][ij]; 
+             };
+
+             if(C.PCMode && allflagged && !seed && currT != T.lastTFailed){
+               double dayFrac = (currT/86400. - C.DifXData->getDay0()+2400000.5);
+               int day = (int) dayFrac ;
+               int hour = (int) (dayFrac*24.);
+               int min = (int) ((dayFrac*24. - ((double) hour))*60.);
+               int sec = (int) ((dayFrac*24. - ((double) hour) - ((double) min)/60.)*3600.);
+               if (Phased){
+                 sprintf(message,
+                    "WARNING: NO VALID ALMA ANTENNAS ON %i-%i:%i:%i ?!?!\n WILL CONVERT ON THIS TIME *WITHOUT* CALIBRATION\n",
+                    day,hour,min,sec);
+               } else {
+                 sprintf(message,
+                    "WARNING: ARRAY WAS UNPHASED AT TIME %i-%i:%i:%i ?!?!\n WILL SET THE WEIGHTS TO ZERO\n",
+                    day,hour,min,sec);
+               };
+               fprintf(T.log,"%s",message); fflush(T.log);
+               T.lastTFailed = currT ;
+             };
+
+
+             //indent level within time range
+             if (C.PCMode && !allflagged){
+
+               T.Timer->start(Timing::INTERPOLATE);
+
+               if(C.verbose){fprintf(T.out," Computing gains\n");fflush(T.out);};
+
+/////////
+// GAIN:
+      // FIRST GAIN IN NORMAL MODE, 0:
+
+               gchanged = allgains[currAntIdx][0]->setInterpolationTime(currT);
+               for (ij=0; ij<currNant; ij++) {
+                 if (Weight[currAntIdx][ij]) {
+                 allgains[currAntIdx][0]->applyInterpolation(ij,0,AnG[currAntIdx][ij]); };
+               };
+               if(C.verbose){fprintf(T.out," Normal Mode 0\n");fflush(T.out);};
+
+// FURTHER GAIN, IN PRODUCT MODE, 2:
+               for (ik=1; ik<C.ngainTabs[currAntIdx]; ik++) {
+                 auxB1 = allgains[currAntIdx][ik]->setInterpolationTime(currT) ;
+                 gchanged = gchanged || auxB1;
+                 for (ij=0; ij<currNant; ij++) {
+                   if (Weight[currAntIdx][ij]) {
+                     allgains[currAntIdx][ik]->applyInterpolation(
+                         ij,2,AnG[currAntIdx][ij]);  
+                   };
+                 };
+               };
+               if(C.verbose){fprintf(T.out," Product Mode 2\n");fflush(T.out);};
+
+// CROSS-PHASE GAIN AT THE ALMA REFERENCE ANTENNA:
+               cplx32f AuxRatio; 
+               for (ik=0; ik<C.ngainTabs[currAntIdx]; ik++) {
+                 if (ALMARefAnt>=0 && !(allgains[currAntIdx][ik]->isBandpass())){
+                   if (allgains[currAntIdx][ik]->getInterpolation(
+                       ALMARefAnt,0,gainXY)){
+                         for (ij=0; ij<nchans[ii]; ij++){
+                            if (std::abs(gainXY[1])>0.0 && std::abs(gainXY[0])>0.0){
+                               AuxRatio = gainXY[0]/gainXY[1];
+                               gainRatio[ij] *= AuxRatio/std::abs(AuxRatio); };
+                         };
+                   } else {
+                      sprintf(message,
+                          "ERROR with ALMA Ref. Ant. in gain table!\n");
+                      fprintf(T.log,"%s",message); fflush(T.log);
+                      return false;
+                   };
+                 }; 
+               };
+               if(C.verbose){fprintf(T.out," Cross Phases Mode\n");fflush(T.out);};
+
+
+/////////
+// DTERM:
+               dtchanged = alldterms[currAntIdx]->setInterpolationTime(currT);
+               for (ij=0; ij<currNant; ij++) {
+                 if (Weight[currAntIdx][ij]) {
+                   alldterms[currAntIdx]->applyInterpolation(
+                       ij,0,AnDt[currAntIdx][ij]);  
+                 };
+               };
+               if(C.verbose){fprintf(T.out," D-terms Mode\n");fflush(T.out);};
+
+               T.Timer->stop(Timing::INTERPOLATE);
+
+
+//////////////////////////////////
+
+             };   // Comes from if(!allflagged)
+
+
+
+             T.Timer->start(Timing::KMATRIX);
+
+// FORCE RE-COMPUTATION (TO SET UNITY MATRIX) IF ALL ANTENNAS ARE FLAGGED
+             if (allflagged || !C.PCMode){
+               gchanged=false; dtchanged=false;
+               for (j=0; j<nchans[ii]; j++) {
+                 if(C.XYSWAP[currAntIdx]){
+                   Ktotal[currAntIdx][0][0][j] = C.HSw[0][0]*oneOverSqrt2; //*gainRatio[j];
+                   Ktotal[currAntIdx][0][1][j] = C.HSw[0][1]*oneOverSqrt2/gainRatio[j];
+                   Ktotal[currAntIdx][1][0][j] = C.HSw[1][0]*oneOverSqrt2; //*gainRatio[j];
+                   Ktotal[currAntIdx][1][1][j] = C.HSw[1][1]*oneOverSqrt2/gainRatio[j];} 
+                 else {
+                   Ktotal[currAntIdx][0][0][j] = C.H[0][0]*oneOverSqrt2; //*gainRatio[j];
+                   Ktotal[currAntIdx][0][1][j] = C.H[0][1]*oneOverSqrt2/gainRatio[j];
+                   Ktotal[currAntIdx][1][0][j] = C.H[1][0]*oneOverSqrt2; //*gainRatio[j];
+                   Ktotal[currAntIdx][1][1][j] = C.H[1][1]*oneOverSqrt2/gainRatio[j];
+                 };
+               //  Ktotal[currAntIdx][0][1][j] *= gainRatio[j];
+               //  Ktotal[currAntIdx][1][1][j] *= gainRatio[j];
+               };
+             };
+
+
+////////////
+// Compute the elements of the K matrix (only those that changed, or the
+// first one of a thread whose earlier times had no valid weights, see 
+// seedMatrices):
+             newK = C.PCMode && !allflagged && !T.KBuilt[currAntIdx];
+
+     //indent level within time range
+             if (C.PCMode && (dtchanged || gchanged || newK) && !allflagged) {
+               //indent level if dt or g changed   
+
+               T.Timer->count(Timing::KBUILDS,1);
+
+// AVERAGE THE GAINS OF THE PHASED ANTENNAS, INVERT AND CONVERT
+// (all channels at once, see KMatrix.h):
+               T.auxD = T.KBuilder->build(AnG[currAntIdx], AnDt[currAntIdx],
+                    Weight[currAntIdx], currNant, nchans[ii], gainRatio,
+                    C.XYSWAP[currAntIdx] ? C.HSw : C.H, Ktotal[currAntIdx],
+                    C.doNorm, NormFac, C.verbose);
+               T.KBuilt[currAntIdx] = true;
+
+
+
+             //indent level within time range
+             } else {
+               //indent level if dt or g changed
+               NormFac[0]=((float) nchans[ii]); 
+               NormFac[1]=((float) nchans[ii]);
+
+
+             }; // Comes from the else of "if(dtchanged||gchanged)"
+
+
+             //indent level within time range
+
+   // Norm. factor will be the geometrical average of gains.
+             if(C.doNorm && (dtchanged||gchanged||newK)){
+               AntTab = std::sqrt(NormFac[0]*NormFac[1])/((float) nchans[ii]);
+               if (!seed){
+                 fprintf(T.gains, "%i  %i  %.10e  %.5e \n",
+                      ii+1, currAnt, currT/86400.,AntTab*AntTab/std::abs(T.auxD));
+               };
+               for(j=0; j<nchans[ii]; j++){
+                 Ktotal[currAntIdx][0][0][j] /= AntTab;
+                 Ktotal[currAntIdx][0][1][j] /= AntTab;
+                 Ktotal[currAntIdx][1][0][j] /= AntTab;
+                 Ktotal[currAntIdx][1][1][j] /= AntTab;
+               };
+             };
+             //indent level within time range
+
+
+    // Correct for amplitude ratios (put amplitudes back):
+             if(!C.PCMode){
+            //   printf("%.2f %i |",std::abs(gainRatio[10]),currAntIdx);fflush(stdout);
+               for(j=0; j<nchans[ii]; j++){
+                //  AntTab = std::abs(gainRatio[j]); 
+                  AntTab = 1./std::abs(Ktotal[currAntIdx][0][0][j]*Ktotal[currAntIdx][1][1][j] - Ktotal[currAntIdx][0][1][j]*Ktotal[currAntIdx][1][0][j]);
+               //   if(j==0 && currAntIdx==2){printf("%.2e ",AntTab);fflush(stdout);};
+                  Ktotal[currAntIdx][0][0][j] *= AntTab;
+                  Ktotal[currAntIdx][0][1][j] *= AntTab;
+                  Ktotal[currAntIdx][1][0][j] *= AntTab;
+                  Ktotal[currAntIdx][1][1][j] *= AntTab;
+               };
+             };
+
+             T.Timer->stop(Timing::KMATRIX);
+
+  return true;
+
+};
+
+
+
+
+
+/* Sets the matrices of a thread that starts at a later time block (block)
+   as they are at that time in the serial conversion. If the tables depend
+   on time, every new time rebuilds the matrix, so only the tables that do
+   not depend on time matter: the serial conversion builds the matrix of an
+   antenna at its first time with valid phasing weights and keeps it, but
+   at the times without valid weights it sets the unconverted matrix (that
+   it then keeps). So the matrices are computed at those times of the 
+   earlier blocks (the first valid one and the last invalid one after it) 
+   and the results do not depend on the number of blocks. Returns false 
+   if there is an error: */
+static bool seedMatrices(ConvSetup &C, ConvThread &T, int block, int im, int ii){
+
+  std::vector<double> Times;
+  std::vector<int> Files;
+  size_t k, first, last;
+  int ij, ik, currNant;
+  bool valid, Phased;
+
+  if (!C.PCMode || C.KMode==KTL_READ){return true;};
+
+  for (ij=0; ij<C.nALMA; ij++){
+
+    C.SWINData->getTimesBefore(block, C.almanums[ij], Times, Files);
+    currNant = C.nsumArr[ij];
+    first = Times.size(); last = Times.size();
+
+// Same weights as in computeK:
+    for (k=0; k<Times.size(); k++){
+      if (Times[k]<C.doRange[0] || Times[k]>C.doRange[1]){continue;};
+      valid = currNant<=1;
+      if (!valid && T.ALMAWeight->isPhased(Times[k], false)){
+        for (ik=0; ik<currNant && !valid; ik++){valid = T.ALMAWeight->getWeight(ik, Times[k]);};
+      };
+      if (valid && first==Times.size()){first = k;};
+      if (!valid && first<Times.size()){last = k;};
+    };
+
+    if (first<Times.size()){
+      if (!computeK(C, T, im, ii, Times[first], C.almanums[ij], ij, Files[first], 0, true, Phased)){
+        return false;
+      };
+      if (last<Times.size() &&
+          !computeK(C, T, im, ii, Times[last], C.almanums[ij], ij, Files[last], 0, true, Phased)){
+        return false;
+      };
+    };
+
+  };
+
+  return true;
+
+};
+
+
+
+
+/* Computes the matrix of a visibility (from the calibration or from the
+   K-matrix timeline), converts it and writes it. ii is the DiFX IF (im 
+   its index in the list of IFs to convert) and IFplot its index in the 
+   plot files (-1 if it is not plotted). Returns false if there is an
+   error (and the conversion must stop): */
+static bool convertVis(ConvSetup &C, ConvThread &T, int im, int ii, int IFplot,
+                       double currT, int currAnt, int currF, int currFile, long countNvis){
+
+  char message[2048];
+  int ij, currAntIdx = 0;
+  bool notinlist, auxB2, Phased = true;
+  FILE *plotFile;
+
+  std::complex<float> *(*Ktotal)[2][2] = T.Ktotal;
+  int *nchans = C.nchans;
+
+
+// Sanity check (if antenna is in the list of linear-pol antennas):
+           notinlist = true;
+           for (ij=0; ij<C.nALMA; ij++) {
+             if (currAnt == C.almanums[ij]){
+               currAntIdx = ij; notinlist=false; break;
+             };
+           };
+
+           if (notinlist){
+             sprintf(message,
+               "ERROR: Found linear-pol data for antenna number %i.\n",currAnt);
+             fprintf(T.log,"%s",message); fprintf(T.out,"%s",message); fflush(T.log);
+             sprintf(message,
+               "This antenna is not in the list of linear-pol antennas!\n");
+             fprintf(T.log,"%s",message); fprintf(T.out,"%s",message); fflush(T.log);
+             return false;
+           };
+
+
+
+
+
+           if (C.KMode==KTL_READ){
+
+// MATRIX FROM THE K-MATRIX TIMELINE (no calibration tables):
+             T.Timer->count(Timing::VISIBILITIES,1);
+             T.Timer->start(Timing::KMATRIX);
+             if (!C.KTL->get(currFile, ii, currAnt, currT, nchans[ii], Ktotal[currAntIdx], Phased)){
+               sprintf(message,
+                 "ERROR: No K matrix for antenna %i, IF %i, file %i at time %.8f in the timeline!\n",
+                 currAnt, ii+1, currFile, currT);
+               fprintf(T.log,"%s",message); fprintf(T.out,"%s",message); fflush(T.log);
+               return false;
+             };
+             T.Timer->stop(Timing::KMATRIX);
+
+           } else {
+
+             T.Timer->count(Timing::VISIBILITIES,1);
+             if (!computeK(C, T, im, ii, currT, currAnt, currAntIdx, currFile, countNvis, false, Phased)){
+               return false;
+             };
+
+// Save the final matrix (only written if it changed):
+             if (C.KMode==KTL_WRITE){
+               T.Timer->start(Timing::KMATRIX);
+               C.KTL->add(currFile, ii, currAnt, currT, Phased, nchans[ii], Ktotal[currAntIdx]);
+               T.Timer->stop(Timing::KMATRIX);
+             };
+
+           };  // Comes from the else of "if (KMode==KTL_READ)"
+
+
+// Calibrate and convert to circular:
+
+// Shall we write in plot file?
+           auxB2 = (currT>=C.plRange[0] && currT<=C.plRange[1] && (C.calField<0 || currF==C.calField));
+
+           if (IFplot < 0) { auxB2 = false; };
+
+// NOTE: These files are used to plot in the ALMA case; but are also used
+// when solving for the cross-polarization gains!
+// So they are not only "plot" files.
+           plotFile = (T.plot != NULL || IFplot < 0) ? T.plot : C.plotFile[IFplot];
+
+// Convert:
+           if(Phased){
+             // note that if IFplot < 0, plotFile is
+             // NULL; but auxB2 (just set) prevents its use
+             if (T.S != NULL){
+               C.SWINData->applyMatrix(*T.S,
+                 Ktotal[currAntIdx],C.XYSWAP[currAntIdx],auxB2,
+                 currAntIdx,plotFile);
+             } else {
+               C.DifXData->applyMatrix(
+                 Ktotal[currAntIdx],C.XYSWAP[currAntIdx],auxB2,
+                 currAntIdx,plotFile);
+             };
+           } else {
+             sprintf(message,"WARNING! Zero-ing weights at time %.8f!\n",currT);
+             fprintf(T.log,"%s",message); fprintf(T.out,"%s",message); fflush(T.log);
+             if (T.S != NULL){C.SWINData->zeroWeight(*T.S);} else {C.DifXData->zeroWeight();};
+           };
+
+// Write:
+           if (!C.doTest){
+             if (T.S != NULL){C.SWINData->setCurrentMixedVis(*T.S);} else {C.DifXData->setCurrentMixedVis();};
+           };
+
+  return true;
+
+};
+
+
+
+
+// Converts the visibilities of a time block of the current IF (for the 
+// parallel conversion of the SWIN files):
+static void convertBlock(ConvSetup &C, ConvThread &T, int im, int ii, int IFplot){
+
+  double currT;
+  int currAnt, otherAnt, currF, currFile;
+  bool toconj;
+  long countNvis = 0;
+
+  while (C.SWINData->getNextMixedVis(*T.S, currT, currAnt, otherAnt, toconj, currF)){
+    countNvis += 1;
+    currFile = C.SWINData->getFileNumber(*T.S);
+    if (currT>=C.doRange[0] && currT<=C.doRange[1]){
+      if (!convertVis(C, T, im, ii, IFplot, currT, currAnt, currF, currFile, countNvis)){
+        T.failed = true;
+        return;
+      };
+    };
+  };
+
+};
+
+
+
+
+// Converts a block in a forked process (a shard), that writes its timing
+// in Timer (shared memory) and exits with 0 (OK), 1 (conversion error) or 
+// 2 (I/O error). The shard never returns (nor touches Python):
+static void convertShard(ConvSetup &C, ConvThread &T, int block, int im, int ii, int IFplot,
+                         Timing *Timer){
+
+  C.SWINData->setBlock(*T.S, block);
+  if (seedMatrices(C, T, block, im, ii)){convertBlock(C, T, im, ii, IFplot);} else {T.failed = true;};
+  memcpy((void *) Timer, (void *) T.Timer, sizeof(Timing));
+  fflush(T.log); fflush(T.out); fflush(T.gains); fflush(T.plot);
+  _exit(T.failed ? 1 : (C.SWINData->ioFailed() ? 2 : 0));
+
+};
+
+
+
+
+// Converts the current IF in nBlocks time blocks (as split by splitIF),
+// each one in a thread (or in a forked process, if inProcesses). The 
+// first block is converted by First (in this thread). Returns false if 
+// there was an error:
+static bool convertBlocks(ConvSetup &C, ConvThread &First, int nBlocks, int im, int ii, int IFplot,
+                          bool inProcesses){
+
+  std::vector<ConvThread*> T(nBlocks, (ConvThread*) NULL);
+  std::vector<std::thread> Threads;
+  std::vector<pid_t> Shards(nBlocks, -1);
+  Timing *ShardTimers = NULL;
+  int b, k, n, status;
+  bool ok = true;
+  char message[512];
+  FILE *plotFile = (IFplot >= 0) ? C.plotFile[IFplot] : NULL;
+
+// The shards get a copy-on-write image of this process (so the tables
+// are shared while they are only read). Only their timing comes back 
+// through shared memory (the rest, through the temporary files):
+  if (inProcesses){
+    ShardTimers = (Timing *) mmap(NULL, nBlocks*sizeof(Timing), PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ShardTimers == (Timing *) MAP_FAILED){
+      ShardTimers = NULL;
+      inProcesses = false;
+    };
+  };
+
+  T[0] = &First;
+  First.S = C.SWINData->newState(First.Timer);
+  for (n=1; n<nBlocks; n++){
+    T[n] = new ConvThread;
+    if (!copyConvThread(*T[n], First, C, inProcesses)){delete T[n]; T[n] = NULL; break;};
+  };
+
+  sprintf(message,"Converting in %i time blocks (%i %s)\n",nBlocks,n,
+          inProcesses ? "processes" : "threads");
+  fprintf(First.log,"%s",message); fflush(First.log);
+
+  if (inProcesses){
+
+// Nothing buffered must be written twice (i.e., also by the shards):
+    fflush(NULL); std::cout.flush();
+    for (b=1; b<n; b++){
+      Shards[b] = fork();
+      if (Shards[b] == 0){convertShard(C, *T[b], b, im, ii, IFplot, &ShardTimers[b]);};
+      if (Shards[b] < 0){
+        sprintf(message,"WARNING: could not fork shard %i. Its blocks are converted here.\n",b);
+        fprintf(First.log,"%s",message); fflush(First.log);
+        for (k=b; k<n; k++){dropConvThread(*T[k], First, C, plotFile); delete T[k];};
+        n = b;
+      };
+    };
+
+  } else {
+
+    for (b=1; b<n; b++){
+      Threads.push_back(std::thread([&C, &T, b, im, ii, IFplot](){
+        C.SWINData->setBlock(*T[b]->S, b);
+        if (seedMatrices(C, *T[b], b, im, ii)){
+          convertBlock(C, *T[b], im, ii, IFplot);
+        } else {
+          T[b]->failed = true;
+        };
+      }));
+    };
+
+  };
+
+  C.SWINData->setBlock(*First.S, 0);
+  convertBlock(C, First, im, ii, IFplot);
 
-}
-#endif
+  for (b=0; b<(int) Threads.size(); b++){Threads[b].join();};
 
+  for (b=1; b<n; b++){
+    if (Shards[b] <= 0){continue;};
+    if (waitpid(Shards[b], &status, 0) != Shards[b] || !WIFEXITED(status) 
+        || WEXITSTATUS(status) > 2){
+      sprintf(message,"\nERROR! SHARD %i DID NOT FINISH!\n",b);
+      fprintf(First.log,"%s",message); std::cout<<message; fflush(First.log);
+      T[b]->failed = true;
+    } else {
+      memcpy((void *) T[b]->Timer, (void *) &ShardTimers[b], sizeof(Timing));
+      if (WEXITSTATUS(status) == 1){T[b]->failed = true;};
+      if (WEXITSTATUS(status) == 2){C.SWINData->setIOFailed();};
+    };
+  };
 
+  if (ShardTimers != NULL){munmap(ShardTimers, nBlocks*sizeof(Timing));};
 
-// Set the mode to non-ALMA, if the argument is 0 (false).
-static PyObject *setPCMode(PyObject *self, PyObject *args){
-  PyObject *ret;
-  int whichMode;
-  if (!PyArg_ParseTuple(args, "i",&whichMode)){      
-      printf("FAILED PolConvert! Unable to parse arguments!\n");
-      fflush(stdout);
-      ret = Py_BuildValue("i",-1);
-      return ret;
+  for (b=1; b<n; b++){
+    ok = ok && !T[b]->failed;
+    dropConvThread(*T[b], First, C, plotFile);
+    delete T[b];
   };
 
-  if(whichMode==0){
-    PCMode=false;
-    printf("PolConvert interface will change to non-ALMA.\n");
-    fflush(stdout);
-  } else {
-/* PCMode=true */
-    printf("PolConvert interface remains in ALMA mode.\n");
-    fflush(stdout);
+// Blocks without a thread (if the streams could not be created, or the
+// shard could not be forked):
+  for (b=n; b<nBlocks && ok && !First.failed; b++){
+    C.SWINData->setBlock(*First.S, b);
+    convertBlock(C, First, im, ii, IFplot);
   };
-  ret = Py_BuildValue("i",0);
-  return ret;
-
 
-};
+  ok = ok && !First.failed;
+  C.SWINData->freeState(First.S);
+  First.S = NULL;
 
+  return C.SWINData->endBlocks() && ok;
 
+};
 
 
 
 
-//////////////////////////////////
-// MAIN FUNCTION: 
 static PyObject *PolConvert(PyObject *self, PyObject *args)
 {
 
 
-  static const std::complex<float> oneOverSqrt2 = 0.7071067811;
   static const cplx32f Im = cplx32f(0.,1.);
 
-  long i,j,k,auxI;
-  int ii, ij, ik, il, im;
+  long i,j,k;
+  int ii, ij, ik, im;
   int IFoffset;
+  int status;  // Returned value (built once the GIL is taken back).
 
   // initialization warnings:
   PyObject *ngain = nullptr, *nsum = nullptr, *gains = nullptr; 
@@ -238,6 +1173,16 @@ static PyObject *PolConvert(PyObject *self, PyObject *args)
   bool isSWIN, doParang; 
   int AutoCorrMedianWindow;   
 
+// Mode of this call (setPCMode may be called while it runs):
+  bool PCMode = ::PCMode;
+
+// Stage timers (they do nothing, unless setTiming was called):
+  Timing Timer(::PCTiming);
+
+// K-matrix timeline (opened with the log file):
+  int KMode = ::PCKMode;
+  KTimeline *KTL = NULL;
+
   printf("Parsing arguments\n");
  
 
@@ -283,7 +1228,7 @@ static PyObject *PolConvert(PyObject *self, PyObject *args)
 
  
 // default return value set now in case there is an error:
-  ret = Py_BuildValue("i",1);
+  status = 1;
 
 
 
@@ -299,6 +1244,17 @@ static PyObject *PolConvert(PyObject *self, PyObject *args)
   std::string logName = PyString_AsString(logNameObj);
   FILE *logFile = fopen(logName.c_str(),"a");
 
+  if (KMode != KTL_OFF){
+    KTL = new KTimeline(::PCKFile, KMode==KTL_WRITE, logFile);
+    if (!KTL->succeed()){
+      sprintf(message,"\nERROR: K-matrix timeline %s is not usable!\n",::PCKFile.c_str());
+      std::cout<<message; fflush(stdout);
+      delete KTL;
+      fclose(logFile);
+      return Py_BuildValue("i",status);
+    };
+  };
+
 // Echo some calibration information:
   if(calField>=0){
     sprintf(message,"\nWill use field %i as calibrator/plot\n",calField);
@@ -372,7 +1328,7 @@ static PyObject *PolConvert(PyObject *self, PyObject *args)
 
 
 // return value if there is an error:
-  ret = Py_BuildValue("i",1);
+  status = 1;
 
 
 
@@ -481,8 +1437,8 @@ static PyObject *PolConvert(PyObject *self, PyObject *args)
 
 ////////////////////////////////////////////////
 /////////////////////////////////
-/// SPECIFIC FOR ALMA:
-  if(PCMode){
+/// SPECIFIC FOR ALMA (not needed if the matrices are read):
+  if(PCMode && KMode!=KTL_READ){
     time0 = (double *)PyArray_DATA(PyList_GetItem(asdmTimes,0));
     time1 = (double *)PyArray_DATA(PyList_GetItem(asdmTimes,1));
     nASDMEntries = ((long *) PyArray_DIMS(PyList_GetItem(asdmTimes,0)))[0];  
@@ -578,12 +1534,15 @@ static PyObject *PolConvert(PyObject *self, PyObject *args)
 
 //////////////////////////////////////////////
 // READ CALIBRATION TABLES (ALMA CASE):
+// (the gain arrays are wrapped by the CalTables, so they are kept until
+// the end of the conversion)
+  std::vector<PyObject*> CalArrays;
 
 if(PCMode){
 
   for (i=0;i<nALMA;i++){
     nchanDt[i] = PyArray_DIM(PyList_GetItem(PyList_GetItem(dterms,i),0),0);
-    dtfreqsArr[i] = (double *)PyArray_DATA(PyList_GetItem(PyList_GetItem(dterms,i),0));
+    dtfreqsArr[i] = (double *)contiguousData(PyList_GetItem(PyList_GetItem(dterms,i),0), NPY_DOUBLE, CalArrays);
     dttimesArr[i] = new double*[nsumArr[i]];
     ndttimeArr[i] = new long[nsumArr[i]];
     dtflag[i] = new bool*[nsumArr[i]];
@@ -595,23 +1554,23 @@ if(PCMode){
       dttimesArr[i][j] = new double[1];
       dttimesArr[i][j][0] = 0.0;
       ndttimeArr[i][j] = 1;
-      dtermsArrR1[i][j] = (double *)PyArray_DATA(
-              PyList_GetItem(PyList_GetItem(PyList_GetItem(dterms,i),j+1),0));
-      dtermsArrI1[i][j] = (double *)PyArray_DATA(
-              PyList_GetItem(PyList_GetItem(PyList_GetItem(dterms,i),j+1),1));
-      dtermsArrR2[i][j] = (double *)PyArray_DATA(
-              PyList_GetItem(PyList_GetItem(PyList_GetItem(dterms,i),j+1),2));
-      dtermsArrI2[i][j] = (double *)PyArray_DATA(
-              PyList_GetItem(PyList_GetItem(PyList_GetItem(dterms,i),j+1),3));
-      dtflag[i][j] = (bool *)PyArray_DATA(
-              PyList_GetItem(PyList_GetItem(PyList_GetItem(dterms,i),j+1),4));
+      dtermsArrR1[i][j] = (double *)contiguousData(
+              PyList_GetItem(PyList_GetItem(PyList_GetItem(dterms,i),j+1),0), NPY_DOUBLE, CalArrays);
+      dtermsArrI1[i][j] = (double *)contiguousData(
+              PyList_GetItem(PyList_GetItem(PyList_GetItem(dterms,i),j+1),1), NPY_DOUBLE, CalArrays);
+      dtermsArrR2[i][j] = (double *)contiguousData(
+              PyList_GetItem(PyList_GetItem(PyList_GetItem(dterms,i),j+1),2), NPY_DOUBLE, CalArrays);
+      dtermsArrI2[i][j] = (double *)contiguousData(
+              PyList_GetItem(PyList_GetItem(PyList_GetItem(dterms,i),j+1),3), NPY_DOUBLE, CalArrays);
+      dtflag[i][j] = (bool *)contiguousData(
+              PyList_GetItem(PyList_GetItem(PyList_GetItem(dterms,i),j+1),4), NPY_BOOL, CalArrays);
     };
 
     for (j=0; j<ngainTabs[i]; j++){
       tempPy = PyList_GetItem(PyList_GetItem(gains,i),j);
       kind[i][j] = (int)PyInt_AsLong(PyList_GetItem(PyList_GetItem(ikind,i),j));
       nchanArr[i][j] = PyArray_DIM(PyList_GetItem(tempPy,0),0);
-      freqsArr[i][j] = (double *)PyArray_DATA(PyList_GetItem(tempPy,0));
+      freqsArr[i][j] = (double *)contiguousData(PyList_GetItem(tempPy,0), NPY_DOUBLE, CalArrays);
       ntimeArr[i][j] = new long[nsumArr[i]];
       timesArr[i][j] = new double*[nsumArr[i]];
       gainsArrR1[i][j] = new double*[nsumArr[i]];
@@ -622,18 +1581,18 @@ if(PCMode){
 
       for (k=0; k<nsumArr[i]; k++){
         ntimeArr[i][j][k] = PyArray_DIM(PyList_GetItem(PyList_GetItem(tempPy,k+1),0),0);
-        timesArr[i][j][k] = (double *)PyArray_DATA(
-              PyList_GetItem(PyList_GetItem(tempPy,k+1),0));
-        gainsArrR1[i][j][k] = (double *)PyArray_DATA(
-              PyList_GetItem(PyList_GetItem(tempPy,k+1),1));
-        gainsArrI1[i][j][k] = (double *)PyArray_DATA(
-              PyList_GetItem(PyList_GetItem(tempPy,k+1),2));
-        gainsArrR2[i][j][k] = (double *)PyArray_DATA(
-              PyList_GetItem(PyList_GetItem(tempPy,k+1),3));
-        gainsArrI2[i][j][k] = (double *)PyArray_DATA(
-              PyList_GetItem(PyList_GetItem(tempPy,k+1),4));
-        gainflag[i][j][k] = (bool *)PyArray_DATA(
-              PyList_GetItem(PyList_GetItem(tempPy,k+1),5));
+        timesArr[i][j][k] = (double *)contiguousData(
+              PyList_GetItem(PyList_GetItem(tempPy,k+1),0), NPY_DOUBLE, CalArrays);
+        gainsArrR1[i][j][k] = (double *)contiguousData(
+              PyList_GetItem(PyList_GetItem(tempPy,k+1),1), NPY_DOUBLE, CalArrays);
+        gainsArrI1[i][j][k] = (double *)contiguousData(
+              PyList_GetItem(PyList_GetItem(tempPy,k+1),2), NPY_DOUBLE, CalArrays);
+        gainsArrR2[i][j][k] = (double *)contiguousData(
+              PyList_GetItem(PyList_GetItem(tempPy,k+1),3), NPY_DOUBLE, CalArrays);
+        gainsArrI2[i][j][k] = (double *)contiguousData(
+              PyList_GetItem(PyList_GetItem(tempPy,k+1),4), NPY_DOUBLE, CalArrays);
+        gainflag[i][j][k] = (bool *)contiguousData(
+              PyList_GetItem(PyList_GetItem(tempPy,k+1),5), NPY_BOOL, CalArrays);
       };
     };
   };
@@ -649,16 +1608,17 @@ if(PCMode){
 
 // CREATE CALIBRATION INSTANCES:  
 
+  Timer.start(Timing::CALTABLES);
  
   for (i=0; i<nALMA; i++){
     allgains[i] = new CalTable*[ngainTabs[i]];
 
  // ALMA CASE: ACTUAL CALIBRATION INFORMATION OF THE PHASED ARRAY:        
-    if(PCMode){
+    if(PCMode && KMode!=KTL_READ){
        alldterms[i] = new CalTable(2,dtermsArrR1[i],dtermsArrI1[i],
            dtermsArrR2[i],dtermsArrI2[i],dtfreqsArr[i],dttimesArr[i],
            nsumArr[i],ndttimeArr[i], nchanDt[i],dtflag[i],true,logFile,
-	   false); // verbose);
+	   false, true); // verbose, wrap);
 
        for (j=0; j<ngainTabs[i];j++){
 /*
@@ -678,17 +1638,21 @@ if(PCMode){
            gainsArrI1[i][j],gainsArrR2[i][j],gainsArrI2[i][j],freqsArr[i][j],
            timesArr[i][j],nsumArr[i],ntimeArr[i][j], nchanArr[i][j],
            gainflag[i][j],isLinear[i][j],logFile,
-	   false); // verbose);
+	   false, true); // verbose, wrap);
        };
 
-     // NON-ALMA CASE: DUMMY GAINS.
+     // NON-ALMA CASE (OR MATRICES FROM THE TIMELINE): DUMMY GAINS.
     } else {
       alldterms[i] = new CalTable(2,logFile);
-      allgains[i][0] = new CalTable(0,logFile);
+      for (j=0; j<ngainTabs[i];j++){
+        allgains[i][j] = new CalTable(0,logFile);
+      };
     };
 
   };
 
+  Timer.stop(Timing::CALTABLES);
+
 
   fflush(logFile);
 
@@ -728,6 +1692,12 @@ if(PCMode){
   bool iDoSolve = doSolve >= 0.0;
 
 
+// All the Python objects have been read, so the conversion runs without 
+// the GIL. The numpy arrays are used in place (they are kept alive by the 
+// arguments of this call, which must not be modified while it runs):
+  PyThreadState *pyState = PyEval_SaveThread();
+
+
 
 
   if (isSWIN) {
@@ -735,17 +1705,19 @@ if(PCMode){
     fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
     DifXData = new DataIOSWIN(nSWINFiles, SWINFiles, nALMA, 
            almanums, doRange, SWINnIF, SWINnchan, nIFconv, IFs2Conv, IFoffset, AutoCorrMedianWindow, ACorrs, SWINFreqs, 
-           OverWrite, doTest, iDoSolve, calField, jd0, Geometry, doParang, logFile);
+           OverWrite, doTest, iDoSolve, calField, jd0, Geometry, doParang, logFile, &Timer);
   } else {
     sprintf(message,"\n\n Opening FITS-IDI file and reading header.\n");
     fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
     DifXData = new DataIOFITS(outputfits, nALMA, almanums, 
-          doRange, OverWrite, doConj, iDoSolve, calField, Geometry, doParang, logFile);
+          doRange, OverWrite, doConj, iDoSolve, calField, Geometry, doParang, logFile, &Timer);
   };
 
   if(!DifXData->succeed()){
      sprintf(message,"\nERROR WITH DATA FILE(S)!\n");
      fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
+     PyEval_RestoreThread(pyState);
+     releaseData(CalArrays);
      ret = Py_BuildValue("i",-1);
      return ret;
   };
@@ -757,7 +1729,6 @@ if(PCMode){
 
 
   int nnu = DifXData->getNfreqs();
-  int ALMARefAnt = -1; // If no calAPP is used, do not look for any extra X-Y phase offset.
 
   int nchans[nnu]; 
   int maxnchan=0;
@@ -781,87 +1752,46 @@ if(PCMode){
 
 
 
-// Gains:
-  std::complex<float> ***AnG[nALMA], ***AnDt[nALMA];
-  bool *Weight[nALMA];
-
-// K matrix (beware: 3rd dimension of the matrix elements is now real/imag; not X/Y!):
-  std::complex<float> **K[nALMA][2][2];
-
-// part of K matrix that is unlikely to change much with time (i.e., BP, D-terms, X/Y delay):
-  std::complex<float> **Kfrozen[nALMA][2][2]; 
-
-// Ktotal will be the calibration+conversion matrix (i.e., just multiply V by it, to get final V):
-  std::complex<float> *Ktotal[nALMA][2][2];
-
-
+// Gains, weights and matrices of the (first) conversion thread (see
+// ConvThread):
+  ConvSetup C;
+  ConvThread First;
 
-  for (ij=0; ij<nALMA; ij++) {
-    auxI = nsumArr[ij];
-
-    AnG[ij] =  new std::complex<float> **[auxI];
-    AnDt[ij] =  new std::complex<float> **[auxI];
-    Weight[ij] =  new bool [auxI];
-
-    for (ii=0; ii<auxI; ii++) {
-      AnG[ij][ii] =  new std::complex<float> *[2];
-      AnG[ij][ii][0] = new std::complex<float>[maxnchan];
-      AnG[ij][ii][1] = new std::complex<float>[maxnchan];
-      AnDt[ij][ii] =  new std::complex<float> *[2];
-      AnDt[ij][ii][0] = new std::complex<float>[maxnchan];
-      AnDt[ij][ii][1] = new std::complex<float>[maxnchan];
-    };
-
-// K matrix:
-    for (ii=0; ii<2; ii++) {
-      for (ik=0; ik<2; ik++) {
-        K[ij][ii][ik] =  new std::complex<float> *[auxI];
-        Kfrozen[ij][ii][ik] =  new std::complex<float> *[auxI];
-        Ktotal[ij][ii][ik] = new std::complex<float>[maxnchan];
-  
-        for (il=0; il<auxI; il++) {
-          K[ij][ii][ik][il] =  new std::complex<float>[maxnchan];
-          Kfrozen[ij][ii][ik][il] =  new std::complex<float>[maxnchan];
-       };
-      };
-    };
+  C.nALMA = nALMA; C.almanums = almanums; C.nsumArr = nsumArr;
+  C.ngainTabs = ngainTabs; C.nchans = nchans; C.maxnchan = maxnchan;
+  allocConvThread(First, C);
 
-  };
+  First.allgains = allgains; First.alldterms = alldterms;
+  First.ALMAWeight = ALMAWeight; First.Timer = &Timer; First.S = NULL;
+  First.log = logFile; First.out = stdout; First.gains = NULL; First.plot = NULL;
 
 
 
 
 // Some extra auxiliary variables:
 
-  double currT, lastTFailed;
-  int currAnt, currAntIdx, currNant, otherAnt,currF; 
-  bool notinlist, gchanged=true, dtchanged=true, toconj;
-
-  lastTFailed = 0.0;
+  double currT;
+  int currAnt, currAntIdx, otherAnt,currF; 
+  bool toconj;
 
   long countNvis;
 
-  std::complex<float> AD, BC, auxD;
-  auxD = 0.0;
-  float NormFac[2];
-  float AntTab;
-  std::complex<float> DetInv;
-  std::complex<float> Kinv[2][2];
-  std::complex<float> H[2][2]; 
-  std::complex<float> HSw[2][2]; 
-
-  H[0][0] = 1.; H[0][1] = Im;
-  H[1][0] = 1.; H[1][1] = -Im;
+// Parallel conversion of the IFs (in time blocks):
+  int nBlocks = 1, nThr;
+  bool inShards = false;
+  char *blocksEnv = getenv("POLCONVERT_BLOCKS");
+  char *shardsEnv = getenv("POLCONVERT_SHARDS");
+  if (blocksEnv != NULL){nBlocks = atoi(blocksEnv);};
+  if (shardsEnv != NULL && atoi(shardsEnv) > 1){nBlocks = atoi(shardsEnv); inShards = true;};
+  if (nBlocks > MAXCONVTHREADS){nBlocks = MAXCONVTHREADS;};
+  if (!isSWIN || KMode==KTL_WRITE){nBlocks = 1;};
 
-  HSw[0][0] = Im; HSw[0][1] = 1.;
-  HSw[1][0] = -Im; HSw[1][1] = 1.;
+  C.H[0][0] = 1.; C.H[0][1] = Im;
+  C.H[1][0] = 1.; C.H[1][1] = -Im;
 
+  C.HSw[0][0] = Im; C.HSw[0][1] = 1.;
+  C.HSw[1][0] = -Im; C.HSw[1][1] = 1.;
 
-  std::complex<float> gainXY[2]; 
-  std::complex<float> gainRatio[maxnchan];
-  std::complex<float> absGainRatio;
-
-  bool allflagged, auxB1, auxB2, Phased ;
 
   sprintf(message,"\n Will modify %li visibilities (lin-lin counted twice).\n\n",
        DifXData->getMixedNvis());
@@ -938,6 +1868,10 @@ if(PCMode){
     sprintf(message,"POLCONVERT.GAINS opened for writing");
     fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
     gainsFile = fopen("POLCONVERT.GAINS","wb");
+    if (KMode==KTL_READ){
+      sprintf(message,"\n (it will be empty, since the matrices are read from the timeline)\n");
+      fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
+    };
   };
 
   sprintf(message,"\n POLCONVERTING THE DATA.\n\n");
@@ -947,6 +1881,8 @@ if(PCMode){
 /////////////////////////////////////
 // APPLY AUTO-CORRELATIONS CORRECTION:
 
+  Timer.start(Timing::AUTOCORR);
+
   for (currAntIdx=0; currAntIdx<nALMA; currAntIdx++) {
 
     for (k=0;k<nSWINFiles;k++){
@@ -962,9 +1898,23 @@ if(PCMode){
 
   };
 
+  Timer.stop(Timing::AUTOCORR);
+
+
+
+
 
 
 
+// Setup of the conversion:
+  C.KMode = KMode; C.calField = calField; C.verbose = verbose;
+  C.PCMode = PCMode; C.doTest = doTest != 0; C.doNorm = doNorm != 0;
+  C.XYSWAP = XYSWAP; C.PrioriGains = PrioriGains;
+  C.plRange = plRange; C.doRange = doRange; C.plotFile = plotFile;
+  C.DifXData = DifXData; C.KTL = KTL;
+  C.SWINData = isSWIN ? (DataIOSWIN *) DifXData : NULL;
+  First.gains = gainsFile;
+
 
 
 
@@ -1019,6 +1969,20 @@ if(PCMode){
       };
 
 
+// Parallel conversion (in time blocks):
+      nThr = (nBlocks > 1) ? ((DataIOSWIN *) DifXData)->splitIF(nBlocks) : 0;
+
+      if (nThr > 0){
+
+        if (!convertBlocks(C, First, nThr, im, ii, IFplot, inShards)){
+          DifXData->finish();
+          PyEval_RestoreThread(pyState);
+          releaseData(CalArrays);
+          return Py_BuildValue("i",status);
+        };
+
+      } else {
+
 // Get the next visibility to correct:
       countNvis = 0;
 
@@ -1036,7 +2000,9 @@ if(PCMode){
          if (!DifXData->succeed()){
            fclose(gainsFile);
            DifXData->finish();
-           return ret;
+           PyEval_RestoreThread(pyState);
+           releaseData(CalArrays);
+           return Py_BuildValue("i",status);
          };
 
 // Do we have to correct this visibility?
@@ -1045,416 +2011,20 @@ if(PCMode){
          if(currT>=doRange[0] && currT<=doRange[1]) {  // vis in time range?
            //indent level within time range
 
-// Sanity check (if antenna is in the list of linear-pol antennas):
-           notinlist = true;
-           for (ij=0; ij<nALMA; ij++) {
-             if (currAnt == almanums[ij]){
-               currAntIdx = ij; notinlist=false; break;
-             };
-           };
-
-           if (notinlist){
-             sprintf(message,
-               "ERROR: Found linear-pol data for antenna number %i.\n",currAnt);
-             fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
-             sprintf(message,
-               "This antenna is not in the list of linear-pol antennas!\n");
-             fprintf(logFile,"%s",message);  std::cout<<message; fflush(logFile);
+           if (!convertVis(C, First, im, ii, IFplot, currT, currAnt, currF, currFile, countNvis)){
              DifXData->finish(); 
-             return ret;
-           };
-
-
-
-
-
-//////////////////////////////////////////////////////
-// Set the interpolation time and compute gains:
-           currNant = nsumArr[currAntIdx] ;
-
-// Find the ALMA antennas involved in the phasing:
-
-           if(verbose){printf(" Doing vis %li  -  %.3f  -  %i\n",
-             countNvis, currT, currNant);fflush(stdout);
-           };
-           allflagged = true;
-
-           if (currNant>1 && PCMode){
-             Phased = ALMAWeight->isPhased(currT);
-             if (Phased){
-               for (ij=0; ij<currNant; ij++) {
-                 Weight[currAntIdx][ij] = ALMAWeight->getWeight(ij,currT);
-                 if (Weight[currAntIdx][ij]){allflagged = false;};
-               };
-             };
-           } else {
-             Phased=true; Weight[currAntIdx][0] = true; allflagged = false;
-           };
-
-// get ALMA refant used in the Phasing (to correct for X-Y phase offset):
-           ALMARefAnt = ALMAWeight->getRefAnt(currT);
-    
- 
-           for (ij=0; ij<nchans[ii]; ij++){
-             gainRatio[ij] = PrioriGains[currFile][currAntIdx][im][ij]; 
-           };
-
-           if(PCMode && allflagged && currT != lastTFailed){
-             double dayFrac = (currT/86400. - DifXData->getDay0()+2400000.5);
-             int day = (int) dayFrac ;
-             int hour = (int) (dayFrac*24.);
-             int min = (int) ((dayFrac*24. - ((double) hour))*60.);
-             int sec = (int) ((dayFrac*24. - ((double) hour) - ((double) min)/60.)*3600.);
-             if (Phased){
-               sprintf(message,
-                  "WARNING: NO VALID ALMA ANTENNAS ON %i-%i:%i:%i ?!?!\n WILL CONVERT ON THIS TIME *WITHOUT* CALIBRATION\n",
-                  day,hour,min,sec);
-             } else {
-               sprintf(message,
-                  "WARNING: ARRAY WAS UNPHASED AT TIME %i-%i:%i:%i ?!?!\n WILL SET THE WEIGHTS TO ZERO\n",
-                  day,hour,min,sec);
-             };
-             fprintf(logFile,"%s",message); fflush(logFile);
-             lastTFailed = currT ;
-           };
-
-
-           //indent level within time range
-           if (PCMode && !allflagged){
-
-             if(verbose){printf(" Computing gains\n");fflush(stdout);};
-
-/////////
-// GAIN:
-    // FIRST GAIN IN NORMAL MODE, 0:
-
-             gchanged = allgains[currAntIdx][0]->setInterpolationTime(currT);
-             for (ij=0; ij<currNant; ij++) {
-               if (Weight[currAntIdx][ij]) {
-               allgains[currAntIdx][0]->applyInterpolation(ij,0,AnG[currAntIdx][ij]); };
-             };
-             if(verbose){printf(" Normal Mode 0\n");fflush(stdout);};
-
-// FURTHER GAIN, IN PRODUCT MODE, 2:
-             for (ik=1; ik<ngainTabs[currAntIdx]; ik++) {
-               auxB1 = allgains[currAntIdx][ik]->setInterpolationTime(currT) ;
-               gchanged = gchanged || auxB1;
-               for (ij=0; ij<currNant; ij++) {
-                 if (Weight[currAntIdx][ij]) {
-                   allgains[currAntIdx][ik]->applyInterpolation(
-                       ij,2,AnG[currAntIdx][ij]);  
-                 };
-               };
-             };
-             if(verbose){printf(" Product Mode 2\n");fflush(stdout);};
-
-// CROSS-PHASE GAIN AT THE ALMA REFERENCE ANTENNA:
-             cplx32f AuxRatio; 
-             for (ik=0; ik<ngainTabs[currAntIdx]; ik++) {
-               if (ALMARefAnt>=0 && !(allgains[currAntIdx][ik]->isBandpass())){
-                 if (allgains[currAntIdx][ik]->getInterpolation(
-                     ALMARefAnt,0,gainXY)){
-                       for (ij=0; ij<nchans[ii]; ij++){
-                          if (std::abs(gainXY[1])>0.0 && std::abs(gainXY[0])>0.0){
-                             AuxRatio = gainXY[0]/gainXY[1];
-                             gainRatio[ij] *= AuxRatio/std::abs(AuxRatio); };
-                       };
-                 } else {
-                    sprintf(message,
-                        "ERROR with ALMA Ref. Ant. in gain table!\n");
-                    fprintf(logFile,"%s",message); fflush(logFile);
-                    DifXData->finish(); 
-                    return ret;
-                 };
-               }; 
-             };
-             if(verbose){printf(" Cross Phases Mode\n");fflush(stdout);};
-
-
-/////////
-// DTERM:
-             dtchanged = alldterms[currAntIdx]->setInterpolationTime(currT);
-             for (ij=0; ij<currNant; ij++) {
-               if (Weight[currAntIdx][ij]) {
-                 alldterms[currAntIdx]->applyInterpolation(
-                     ij,0,AnDt[currAntIdx][ij]);  
-               };
-             };
-             if(verbose){printf(" D-terms Mode\n");fflush(stdout);};
-
-
-//////////////////////////////////
-
-           };   // Comes from if(!allflagged)
-
-
-
-// FORCE RE-COMPUTATION (TO SET UNITY MATRIX) IF ALL ANTENNAS ARE FLAGGED
-           if (allflagged || !PCMode){
-             gchanged=false; dtchanged=false;
-             for (j=0; j<nchans[ii]; j++) {
-               if(XYSWAP[currAntIdx]){
-                 Ktotal[currAntIdx][0][0][j] = HSw[0][0]*oneOverSqrt2; //*gainRatio[j];
-                 Ktotal[currAntIdx][0][1][j] = HSw[0][1]*oneOverSqrt2/gainRatio[j];
-                 Ktotal[currAntIdx][1][0][j] = HSw[1][0]*oneOverSqrt2; //*gainRatio[j];
-                 Ktotal[currAntIdx][1][1][j] = HSw[1][1]*oneOverSqrt2/gainRatio[j];} 
-               else {
-                 Ktotal[currAntIdx][0][0][j] = H[0][0]*oneOverSqrt2; //*gainRatio[j];
-                 Ktotal[currAntIdx][0][1][j] = H[0][1]*oneOverSqrt2/gainRatio[j];
-                 Ktotal[currAntIdx][1][0][j] = H[1][0]*oneOverSqrt2; //*gainRatio[j];
-                 Ktotal[currAntIdx][1][1][j] = H[1][1]*oneOverSqrt2/gainRatio[j];
-               };
-             //  Ktotal[currAntIdx][0][1][j] *= gainRatio[j];
-             //  Ktotal[currAntIdx][1][1][j] *= gainRatio[j];
-             };
-           };
-
-
-////////////
-// Compute the elements of the K matrix (only those that changed):
-
-   //indent level within time range
-           if (PCMode && (dtchanged || gchanged) && !allflagged) {
-             //indent level if dt or g changed   
-
-// INITIATE K MATRIX:
-             auxD = 0.0;
-             for (ij=0; ij<2; ij++) {
-               for (ik=0; ik<2; ik++) {
-                 for (j=0; j<nchans[ii]; j++) {
-                   Ktotal[currAntIdx][ij][ik][j] = 0.0; 
-                 };
-               };
-             };
-
-// ADD-UP ALL GAINS:
-
-             //indent level if dt or g changed
-             for (ij=0; ij<currNant; ij++) {
-
-     // BUT ONLY IF ANTENNA WAS USED IN THE PHASING
-     //indent level if ANTENNA WAS USED IN THE PHASING
-               if (Weight[currAntIdx][ij]) {
-
-     // Total weight:
-                 auxD += 1.0;
-
-    // Kfrozen is unlikely to change much with time:
-                 if (dtchanged) {
-                   for (j=0; j<nchans[ii]; j++) {
-                     gainXY[0] = 1.0 ; 
-                     gainXY[1] = 1.0 ;
-                     Kfrozen[currAntIdx][0][1][ij][j] = 
-                         gainXY[0]*AnDt[currAntIdx][ij][0][j];
-                     Kfrozen[currAntIdx][1][0][ij][j] = 
-                         gainXY[1]*AnDt[currAntIdx][ij][1][j];
-                     Kfrozen[currAntIdx][0][0][ij][j] = gainXY[0];
-                     Kfrozen[currAntIdx][1][1][ij][j] = gainXY[1];
-                   };
-                 };
-
-                 for (j=0; j<nchans[ii]; j++) {
-                   K[currAntIdx][0][0][ij][j] = 
-                       Kfrozen[currAntIdx][0][0][ij][j]*AnG[currAntIdx][ij][0][j];
-                   K[currAntIdx][1][1][ij][j] = 
-                       Kfrozen[currAntIdx][1][1][ij][j]*AnG[currAntIdx][ij][1][j];
-                   K[currAntIdx][0][1][ij][j] = 
-                       Kfrozen[currAntIdx][0][1][ij][j]*AnG[currAntIdx][ij][0][j];
-                   K[currAntIdx][1][0][ij][j] = 
-                       Kfrozen[currAntIdx][1][0][ij][j]*AnG[currAntIdx][ij][1][j];
-                 };
-                 // indent within if ANTENNA WAS USED IN THE PHASING
-
-// Add-up all elements:
-                 for (il=0; il<2; il++) {
-                   for (ik=0; ik<2; ik++) {
-                     for (j=0; j<nchans[ii]; j++) {
-                       Ktotal[currAntIdx][il][ik][j] += K[currAntIdx][il][ik][ij][j];
-                     };
-                   };
-                 };
-
-
-
-               }; // Comes from if(Weight....)
-             };//indent level if dt or g changed
-
-
-
-             NormFac[0] = 0.0; NormFac[1] = 0.0; 
-
-
-// Get the antenna-wise gain average:
-
-//indent level if dt or g changed
-             for (j=0; j<nchans[ii]; j++) {
-
-//indent level within getting average loop
-               for (ij=0; ij<2; ij++) {
-                 for (ik=0; ik<2; ik++) {
-                   Ktotal[currAntIdx][ij][ik][j] /= auxD;
-                 };
-               };
-//indent level within getting average loop
-
-// Correct the phase offset at the reference antenna:
-               Ktotal[currAntIdx][0][1][j] *= gainRatio[j];
-               Ktotal[currAntIdx][1][1][j] *= gainRatio[j];
-
-////////////
-               //indent level within getting average loop
-               if(verbose && j==0){
-                 printf("gainRatio (j=0): %.3e %.3e\n",
-                      gainRatio[j].real(), gainRatio[j].imag());
-                 printf("Ktot00: %.3e %.3e\n",
-                      Ktotal[currAntIdx][0][0][j].real(), Ktotal[currAntIdx][0][0][j].imag());
-                 printf("Ktot01: %.3e %.3e\n",
-                      Ktotal[currAntIdx][0][1][j].real(), Ktotal[currAntIdx][0][1][j].imag());
-                 printf("Ktot10: %.3e %.3e\n",
-                      Ktotal[currAntIdx][1][0][j].real(), Ktotal[currAntIdx][1][0][j].imag());
-                 printf("Ktot11: %.3e %.3e\n",
-                      Ktotal[currAntIdx][1][1][j].real(), Ktotal[currAntIdx][1][1][j].imag()); 
-                 if (allflagged) {printf("All flagged\n"); }
-                 else {printf("Not flagged\n"); };		 
-               };
-
-
-
-///////////////////////////
-// THIS CODE IS INDEPENDENT OF HOW THE AVERAGE FOR K MATRIX IS IMPLEMENTED
-
-               //indent level within getting average loop
-               AD = Ktotal[currAntIdx][0][0][j]*Ktotal[currAntIdx][1][1][j];
-               BC = Ktotal[currAntIdx][0][1][j]*Ktotal[currAntIdx][1][0][j];
-   // Determinant:
-               DetInv = (AD - BC); // 
-
-   // Inverse of K matrix:
-               if (allflagged) {
-                 Kinv[0][0] = 1.0; 
-                 Kinv[0][1] = 0.0;
-                 Kinv[1][0] = 0.0;
-                 Kinv[1][1] = 1.0;} 
-               else {
-                 Kinv[0][0] = Ktotal[currAntIdx][1][1][j]/DetInv;
-                 Kinv[1][1] = Ktotal[currAntIdx][0][0][j]/DetInv;
-// BEWARE THAT THIS MUST BE IN ACCORDANCE TO THE DEFINITION OF Dx AND Dy!!!
-                 Kinv[0][1] = -Ktotal[currAntIdx][0][1][j]/DetInv;
-                 Kinv[1][0] = -Ktotal[currAntIdx][1][0][j]/DetInv;
-               };
-
-              //indent level within getting average loop
-               if(doNorm){ 
-                 NormFac[0] += std::abs(Kinv[0][0]); 
-                 NormFac[1] += std::abs(Kinv[1][1]);
-               };
-
-   // Multiply by conversion (hybrid) matrix and save
-   // result in the "Ktotal" matrix:
-               //indent level within getting average looop
-               if(XYSWAP[currAntIdx]){
-                 Ktotal[currAntIdx][0][0][j] = 
-                    (Kinv[0][0]*HSw[0][0]+Kinv[1][0]*HSw[0][1])*oneOverSqrt2;
-                 Ktotal[currAntIdx][0][1][j] = 
-                    (Kinv[0][1]*HSw[0][0]+Kinv[1][1]*HSw[0][1])*oneOverSqrt2;
-                 Ktotal[currAntIdx][1][0][j] = 
-                    (Kinv[0][0]*HSw[1][0]+Kinv[1][0]*HSw[1][1])*oneOverSqrt2;
-                 Ktotal[currAntIdx][1][1][j] = 
-                    (Kinv[0][1]*HSw[1][0]+Kinv[1][1]*HSw[1][1])*oneOverSqrt2;} 
-               else {
-                 Ktotal[currAntIdx][0][0][j] = 
-                    (Kinv[0][0]*H[0][0]+Kinv[1][0]*H[0][1])*oneOverSqrt2;
-                 Ktotal[currAntIdx][0][1][j] = 
-                    (Kinv[0][1]*H[0][0]+Kinv[1][1]*H[0][1])*oneOverSqrt2;
-                 Ktotal[currAntIdx][1][0][j] = 
-                    (Kinv[0][0]*H[1][0]+Kinv[1][0]*H[1][1])*oneOverSqrt2;
-                 Ktotal[currAntIdx][1][1][j] = 
-                    (Kinv[0][1]*H[1][0]+Kinv[1][1]*H[1][1])*oneOverSqrt2;
-               };
-               //indent level within getting average looop
-
-////////////////////////////////////
-////////////////////
-
-             };   // Comes from: for(j=0; j<nchans[ii]; j++) 
-             //indent level if dt or g changed
-
-
-           //indent level within time range
-           } else {
-             //indent level if dt or g changed
-             NormFac[0]=((float) nchans[ii]); 
-             NormFac[1]=((float) nchans[ii]);
-
-
-           }; // Comes from the else of "if(dtchanged||gchanged)"
-
-
-           //indent level within time range
-
- // Norm. factor will be the geometrical average of gains.
-           if(doNorm && (dtchanged||gchanged)){
-             AntTab = std::sqrt(NormFac[0]*NormFac[1])/((float) nchans[ii]);
-             fprintf(gainsFile, "%i  %i  %.10e  %.5e \n",
-                  ii+1, currAnt, currT/86400.,AntTab*AntTab/std::abs(auxD));
-             for(j=0; j<nchans[ii]; j++){
-               Ktotal[currAntIdx][0][0][j] /= AntTab;
-               Ktotal[currAntIdx][0][1][j] /= AntTab;
-               Ktotal[currAntIdx][1][0][j] /= AntTab;
-               Ktotal[currAntIdx][1][1][j] /= AntTab;
-             };
-           };
-           //indent level within time range
-
-
-  // Correct for amplitude ratios (put amplitudes back):
-           if(!PCMode){
-          //   printf("%.2f %i |",std::abs(gainRatio[10]),currAntIdx);fflush(stdout);
-             for(j=0; j<nchans[ii]; j++){
-              //  AntTab = std::abs(gainRatio[j]); 
-                AntTab = 1./std::abs(Ktotal[currAntIdx][0][0][j]*Ktotal[currAntIdx][1][1][j] - Ktotal[currAntIdx][0][1][j]*Ktotal[currAntIdx][1][0][j]);
-             //   if(j==0 && currAntIdx==2){printf("%.2e ",AntTab);fflush(stdout);};
-                Ktotal[currAntIdx][0][0][j] *= AntTab;
-                Ktotal[currAntIdx][0][1][j] *= AntTab;
-                Ktotal[currAntIdx][1][0][j] *= AntTab;
-                Ktotal[currAntIdx][1][1][j] *= AntTab;
-             };
-           };
-
-// Calibrate and convert to circular:
-
-// Shall we write in plot file?
-           auxB2 = (currT>=plRange[0] && currT<=plRange[1] && (calField<0 || currF==calField));
-
-           if (IFplot < 0) { auxB2 = false; };
-
-// NOTE: These files are used to plot in the ALMA case; but are also used
-// when solving for the cross-polarization gains!
-// So they are not only "plot" files.
-
-// Convert:
-           if(Phased){
-             // note that if IFplot < 0, plotFile[IFplot] is
-             // garbage; but auxB2 (just set) prevents its use
-             DifXData->applyMatrix(
-                 Ktotal[currAntIdx],XYSWAP[currAntIdx],auxB2,
-                 currAntIdx,plotFile[IFplot]);
-           } else {
-             sprintf(message,"WARNING! Zero-ing weights at time %.8f!\n",currT);
-             fprintf(logFile,"%s",message);  std::cout<<message; fflush(logFile);
-             DifXData->zeroWeight();
+             PyEval_RestoreThread(pyState);
+             releaseData(CalArrays);
+             return Py_BuildValue("i",status);
            };
 
-// Write:
-           if (!doTest){DifXData->setCurrentMixedVis();};
-
-
-
          };// All this is done only if currT is within doRange.
          //indent level for time range
  
        };  // Go to next mixed-vis in this IF.
        // next mixed-vis indent level
+
+      };  // Comes from the else of "if (nThr > 0)"
   
      }; // Comes from the check of IF.
 
@@ -1486,6 +2056,11 @@ if(plRange[0]<=doRange[1] && plRange[1]>=doRange[0]){
 
   if(doNorm){fclose(gainsFile);};
 
+  if (KTL != NULL){
+    if (KMode==KTL_WRITE){KTL->close();};
+    delete KTL;
+  };
+
   sprintf(message,"\nDONE WITH plot and gain files!\n");
   fprintf(logFile,"%s",message); std::cout << message; fflush(logFile);
 
@@ -1495,6 +2070,8 @@ if(plRange[0]<=doRange[1] && plRange[1]>=doRange[0]){
   sprintf(message,"\nFinishing DifXData!\n");
   fprintf(logFile,"%s",message); std::cout << message; fflush(logFile);
 
+  Timer.summary(logFile);
+
 // (almost) END OF PROGRAM.
   std::cout << "\n";
   sprintf(message,"\nDONE WITH POLCONVERT!\n");
@@ -1502,7 +2079,7 @@ if(plRange[0]<=doRange[1] && plRange[1]>=doRange[0]){
 
 
 // finished with no errors:
-  ret = Py_BuildValue("i",0);
+  status = 0;
 
 
 
@@ -1510,32 +2087,7 @@ if(plRange[0]<=doRange[1] && plRange[1]>=doRange[0]){
 // Free memory:
 
 
-  for (ij=0; ij<nALMA; ij++) {
-    auxI = nsumArr[ij];
-    for (ii=0; ii<auxI; ii++) {
-      delete[] AnG[ij][ii][0];
-      delete[] AnG[ij][ii][1];
-      delete[] AnDt[ij][ii][0];
-      delete[] AnDt[ij][ii][1];
-      delete[] AnG[ij][ii];
-      delete[] AnDt[ij][ii];
-    };
-    delete[] AnG[ij];
-    delete[] AnDt[ij];
-    delete[] Weight[ij];
-
-    for (ii=0; ii<2; ii++) {
-      for (ik=0; ik<2; ik++) {
-        for (il=0; il<auxI; il++) {
-          delete[] K[ij][ii][ik][il];
-          delete[] Kfrozen[ij][ii][ik][il];
-        };
-        delete[] K[ij][ii][ik];
-        delete[] Kfrozen[ij][ii][ik];
-        delete[] Ktotal[ij][ii][ik];
-      };
-    };
-  };
+  freeConvThread(First, C);
 
   for (i=0;i<nALMA;i++){
 
@@ -1629,8 +2181,15 @@ if(plRange[0]<=doRange[1] && plRange[1]>=doRange[0]){
   fprintf(logFile,"%s",message); std::cout << message; fflush(logFile);
   fclose(logFile);
  
+  PyEval_RestoreThread(pyState);
+  releaseData(CalArrays);
+
 //finished with no errors:
-  ret = PyLong_FromLong(0L);
+  if (Timer.enabled()){
+    ret = Py_BuildValue("(iN)",status,timingDict(Timer));
+  } else {
+    ret = PyLong_FromLong((long) status);
+  };
 
 // avoid some lower-level exception that is still set?
   std::cout << "Clearing internal errors" << std::endl;
@@ -39,6 +39,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include <string.h>
 #include <math.h>
 #include <complex>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include <mutex>
 #include <dirent.h>
 #include <fftw3.h>
 //#include <gsl/gsl_errno.h>
@@ -81,6 +86,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 typedef std::complex<double> cplx64f;
 typedef std::complex<float> cplx32f;
 
+// Time block of CompressData (antennas, scan and block number):
+typedef std::tuple<int, int, int, long> BlockKey;
+
 /* Docstrings */
 static char module_docstring[] =
     "This module provides the cross-polarization gain-solver engine.";
@@ -104,40 +112,10 @@ static char SetFit_docstring[] =
     "Allocates memory for the GCPFF.";
 static char GetNchan_docstring[] =
     "Returns the number of channels for the given IF.";
-
-
-
-/* Available functions */
-static PyObject *PolGainSolve(PyObject *self, PyObject *args);
-static PyObject *ReadData(PyObject *self, PyObject *args);
-static PyObject *GetChi2(PyObject *self, PyObject *args);
-static PyObject *GetIFs(PyObject *self, PyObject *args);
-static PyObject *GetNchan(PyObject *self, PyObject *args);
-static PyObject *DoGFF(PyObject *self, PyObject *args);
-static PyObject *SetFringeRates(PyObject *self, PyObject *args);
-static PyObject *GetNScan(PyObject *self, PyObject *args);
-static PyObject *FreeData(PyObject *self, PyObject *args);
-static PyObject *SetFit(PyObject *self, PyObject *args);
-
-bool solveSystem(int Neq, double *Hessian, double *Residuals, double *Solution, double *Errors);
-
-
-/* Module specification */
-static PyMethodDef module_methods[] = {
-    {"PolGainSolve", PolGainSolve, METH_VARARGS, PolGainSolve_docstring},
-    {"ReadData", ReadData, METH_VARARGS, ReadData_docstring},
-    {"GetChi2", GetChi2, METH_VARARGS, GetChi2_docstring},
-    {"GetIFs", GetIFs, METH_VARARGS, GetIFs_docstring},
-    {"DoGFF", DoGFF, METH_VARARGS, DoGFF_docstring},
-    {"SetFringeRates", SetFringeRates, METH_VARARGS, SetFringeRates_docstring},
-    {"GetNScan",GetNScan, METH_VARARGS, GetNScan_docstring},
-    {"GetNchan",GetNchan, METH_VARARGS, GetNchan_docstring},
-    {"FreeData", FreeData, METH_VARARGS, FreeData_docstring},
-    {"SetFit", SetFit, METH_VARARGS, SetFit_docstring},
-    {NULL, NULL, 0, NULL} /* terminated by list of NULLs, apparently */
-};
-
-
+static char CompressData_docstring[] =
+    "Pre-averages the data (all IFs) in time blocks, optionally removing the GFF fringe rates.";
+static char FringeMaps_docstring[] =
+    "Delay-rate fringe maps (and peaks) of a baseline, from a POLCONVERT.FRINGE file";
 
 
 
@@ -153,49 +131,50 @@ static PyMethodDef module_methods[] = {
 //    fflush(stdout); std::cout << std::flush;
 //    gsl_death_by = gsl_errno;
 //}
- 
-static long chisqcount = 0;
-//static long twincounter = 0;
 
 
 
+///////////////////////
 
 
-/* Initialize the module */
-#if PY_MAJOR_VERSION >= 3
-static struct PyModuleDef pc_module_def = {
-    PyModuleDef_HEAD_INIT,
-    "_PolGainSolve",         /* m_name */
-    module_docstring,       /* m_doc */
-    -1,                     /* m_size */
-    module_methods,         /* m_methods */
-    NULL,NULL,NULL,NULL     /* m_reload, m_traverse, m_clear, m_free */
-};
-PyMODINIT_FUNC PyInit__PolGainSolve(void)
-{
-    PyObject *m = PyModule_Create(&pc_module_def);
-  //  import_array();
-  //  (void)gsl_set_error_handler(gsl_death);
-    return(m);
-}
-#else
-PyMODINIT_FUNC init_PolGainSolve(void)
-{
-    PyObject *m = Py_InitModule3("_PolGainSolve", module_methods, module_docstring);import_array();
-  //  (void)gsl_set_error_handler(gsl_death);
-    if (m == NULL)
-        return;
+static const double TWOPI = 6.283185307179586;
 
-}
-#endif
-///////////////////////
+// The FFTW planner is not thread-safe (only fftw_execute is), so all the
+// plans of all the solvers are created and destroyed under this lock:
+static std::mutex FFTWPlanMutex;
 
 
+
+/* All the state of the solver (data, fit setup and workspace). The module
+   functions use a default instance, whereas each GainSolver Python object 
+   owns its own instance (so several solves can be run at once). The 
+   instances are value-initialized (i.e., "new GainSolver()"), so all their
+   state starts zeroed. */
+class GainSolver {
+  public:
+
+   ~GainSolver();
+
    char message[512];
 
    bool doParang;
 
-   static double TWOPI = 6.283185307179586;
+   long chisqcount = 0;
+
+// Every call runs with the solver locked (see MODULE_FUNCTION and SOLVER_METHOD).
+// ReadData, DoGFF and GetChi2 keep the lock while they release the GIL:
+   std::mutex SolverMutex;
+
+// Locks the solver. If another thread owns it, waits without the GIL:
+   std::unique_lock<std::mutex> lockSolver(){
+     std::unique_lock<std::mutex> lock(SolverMutex, std::try_to_lock);
+     if (!lock.owns_lock()){
+       Py_BEGIN_ALLOW_THREADS
+       lock.lock();
+       Py_END_ALLOW_THREADS
+     };
+     return lock;
+   };
 
    int MaxChan = 1;
    int MAXIF = 8; // Will reallocate if needed.
@@ -205,10 +184,11 @@ PyMODINIT_FUNC init_PolGainSolve(void)
    int *Twins[2], Ntwin;
    int solveAmp, useCov, solveQU;
    int *LinBasNum, NLinBas;
-   int NIF, NIFComp;
+   int NIF = 0, NIFComp = 0;
    int NBas, NantFit, Npar=-1;
    int npix = 0;
-   double **Frequencies, ***Rates[5], ***Delays[5];
+   double **Frequencies, **ChanFreq, ***Rates[5], ***Delays[5];
+   bool *RateFixed; // Fringe rates already removed from the (compressed) data
    double *Tm = nullptr;
    double *BasWgt;
    int *doIF, *antFit; 
@@ -221,13 +201,17 @@ PyMODINIT_FUNC init_PolGainSolve(void)
    double TAvg = 1.0;
    double RelWeight = 1.0;
    double T0, T1, DT;
+   double RateT0 = 0.0; // Reference epoch of the fringe rates (1st time of the 1st IF, as read).
    int **Ant1, **Ant2, **BasNum, **Scan;
    double **Times, **ScanDur, **Weights, *CovMat, *IndVec, *SolVec;
    double **UVGauss;
    cplx64f **PA1, **PA2, **auxC00, **auxC01, **auxC10, **auxC11;
    cplx64f **auxC00Flp, **auxC11Flp; // To better check Parangle Flip.
-   cplx64f ***RR, ***RL, ***LR, ***LL, **CrossSpec00, **CrossSpec11;
-   double *UVWeights;
+   cplx64f **CrossSpec00, **CrossSpec11;
+// Visibilities, stored in single precision as one block per IF, 
+// ordered as [vis][chan][RR,RL,LR,LL]:
+   cplx32f **VisData;
+   double *UVWeights = nullptr;
    double SNR_CUTOFF;
    double Lambda;
    bool doCov;
@@ -255,215 +239,133 @@ PyMODINIT_FUNC init_PolGainSolve(void)
 
 
 
-bool solveSystem(int Neq, double *HessianOrig, double *ResidualsOrig, double *Solution, double *Errors){
+// Workspace for solveSystem (allocated in SetFit, grown on demand):
+   int SolveDim = 0;
+   double *SolveL = nullptr, *SolveD = nullptr, *SolveY = nullptr;
+   bool *SolveMask = nullptr;
 
 
+// (Re)allocates the solveSystem workspace, if it is smaller than Neq:
+void setSolveWorkspace(int Neq){
 
+  if (Neq <= SolveDim){return;};
 
+  delete[] SolveL;
+  delete[] SolveD;
+  delete[] SolveY;
+  delete[] SolveMask;
 
+  SolveDim = Neq;
+  SolveL = new double[Neq*Neq];
+  SolveD = new double[Neq];
+  SolveY = new double[Neq];
+  SolveMask = new bool[Neq];
 
-    bool isSingular;
-    int i,j,k;
-    double *buffer = new double[Neq+1];
-    double f;
-
-    double *Hessian = new double[Neq*Neq];
-    double *Residuals = new double[Neq];
-    memcpy((void *)Hessian, (void *)HessianOrig, sizeof(double)*Neq*Neq);
-    memcpy((void *)Residuals, (void *)ResidualsOrig, sizeof(double)*Neq);
-
-    int Nmissing = 0;
-    int *missing = new int[Neq];
-
-    double *L = new double[Neq*Neq];
-    double *U = new double[Neq*Neq];
-
-    for(i=0;i<Neq;i++){Solution[i]=0.0;};
-    for(i=0;i<Neq*Neq;i++){L[i]=0.0;U[i]=0.0;};
-    for(i=0;i<Neq;i++){L[i*Neq+i]=1.0;};
-
-// Getting null rows out of the computation:
-    for(i=0;i<Neq;i++){
-      isSingular=true;
-      for(j=0;j<Neq;j++){
-        if(HessianOrig[i*Neq+j]!=0.0){isSingular=false;break;};
-      };
-      if(isSingular){
-        missing[Nmissing]=i;Nmissing+=1;
-   //     printf("Antenna %i does not seem to have valid data.\n",i);
-      };
-    };  
+};
 
-     /* performing Gaussian elimination */
-    for(i=0;i<Neq-1;i++){
-// PIVOTING:
 
-    isSingular = false;
-    for(k=0;k<Nmissing;k++){
-      if(i==missing[k]){isSingular=true;break;};
-    };   
 
-    if(!isSingular){
+// Solves the (symmetric, positive semi-definite) normal equations 
+// Hessian*Solution = Residuals with an LDL^T factorization. 
+// Null rows (and rows that become singular during the factorization)
+// are masked out: their solution is set to zero and their error to -1.
+// The errors are the sqrt of the diagonal of the inverse Hessian, which 
+// are computed column by column from L^-1 (the full inverse is never formed).
+// Returns true if any row has been masked.
+bool solveSystem(int Neq, double *Hessian, double *Residuals, double *Solution, double *Errors){
 
-      for(j=i+1;j<Neq;j++){
+  int i,j,k;
+  int Nmissing = 0;
+  double f, Dmax, Tol;
 
-       isSingular = false;
-       for(k=0;k<Nmissing;k++){
-         if(j==missing[k]){isSingular=true;break;};
-       };    
+  setSolveWorkspace(Neq);
 
-       if(!isSingular){
+  double *L = SolveL;
+  double *D = SolveD;
+  double *y = SolveY;
+  bool *missing = SolveMask;
 
-        if(abs(Hessian[i*Neq + i]) < abs(Hessian[j*Neq + i])){
-          for(k=0;k<Neq;k++){
-            buffer[k] = Hessian[i*Neq + k];
-            Hessian[i*Neq + k] = Hessian[j*Neq + k];
-            Hessian[j*Neq + k] = buffer[k];
-          };
-          buffer[Neq] = Residuals[i]; 
-          Residuals[i] = Residuals[j]; 
-          Residuals[j] = buffer[Neq]; 
-        };
-      };
-    };
 
-      if(Hessian[i*Neq + i]==0.0){  //isSingular=true; return isSingular;
-        missing[Nmissing] = i;
-        Nmissing += 1;
-   //     printf("Antenna %i does not seem to have valid data EITHER.\n",i);
-      } else {
-      for(j=i+1;j<Neq;j++){
-
-       isSingular = false;
-       for(k=0;k<Nmissing;k++){
-         if(j==missing[k]){isSingular=true;break;};
-       };      
-
-       if(!isSingular){
-        f=Hessian[j*Neq + i]/Hessian[i*Neq + i];
-        L[j*Neq+i] = f;
-        for(k=0;k<Neq;k++){
-          Hessian[j*Neq + k]=Hessian[j*Neq + k]-f*Hessian[i*Neq + k];
-        };
-        Residuals[j] = Residuals[j]-f*Residuals[i];
-      } else {L[j*Neq+i]=0.0;};
-
-    };
+// Getting null rows out of the computation:
+  Dmax = 0.0;
+  for(i=0;i<Neq;i++){
+    missing[i]=true;
+    for(j=0;j<Neq;j++){
+      if(Hessian[i*Neq+j]!=0.0){missing[i]=false;break;};
     };
-   };
-
+    if(missing[i]){Nmissing += 1;} 
+    else if(std::abs(Hessian[i*Neq+i])>Dmax){Dmax=std::abs(Hessian[i*Neq+i]);};
   };
 
-  // if(Hessian[Neq*Neq-1]==0.0){
-  //   missing[Nmissing]=Neq-1;Nmissing+=1;
-  //   printf("Antenna %i does not seem to have valid data EITHER.\n",i);
-  // };
+// Relative threshold for a pivot to be considered null:
+  Tol = Dmax*1.e-12;
 
-   for(i=0;i<Neq*Neq;i++){U[i]=Hessian[i];};
 
+// LDL^T factorization (lower triangle of L, unit diagonal):
+  for(j=0;j<Neq;j++){
+    D[j] = 0.0;
+    if(missing[j]){continue;};
 
-    /* Backward substitution for discovering values of unknowns */
-    for(i=Neq-1;i>=0;i--){   
-      isSingular=false;                  
-      for(j=0; j<Nmissing; j++){
-        if(missing[j]==i){isSingular=true;Solution[i]=0.0;break;};
-      };
-      if(!isSingular){
-        Solution[i]=Residuals[i];
-        for(j=i+1;j<Neq;j++){
-          if(i!=j){
-            Solution[i]=Solution[i]-Hessian[i*Neq + j]*Solution[j];
-          };          
-        };
-        Solution[i]=Solution[i]/Hessian[i*Neq + i];  
-      };
+    f = Hessian[j*Neq+j];
+    for(k=0;k<j;k++){
+      if(!missing[k]){f -= L[j*Neq+k]*L[j*Neq+k]*D[k];};
     };
-    
-
-
-  int Nfree;
-  Nfree = Neq - Nmissing;
-  double *invL = new double[Nfree*Nfree];
-  double *invU = new double[Nfree*Nfree];
-  double *Ufree = new double[Nfree*Nfree];
 
-  int ifree, jfree;
-  ifree=0; jfree=0;
+    if(f<=Tol){missing[j]=true; Nmissing += 1; continue;};
+    D[j] = f;
 
- // printf("Nfree: %i %i %i\n",Neq,Nmissing,Nfree);
-
-
-  for(i=0;i<Neq;i++){
-    isSingular=false;
-    for(k=0;k<Nmissing;k++){
-      if(i==missing[k]){isSingular=true;break;};
-    };
-    if(!isSingular){
-      jfree=0;
-      for(j=0;j<Neq;j++){
-        isSingular = false;
-        for(k=0;k<Nmissing;k++){
-          if(j==missing[k]){isSingular=true;break;};
-        };
-        if(!isSingular){
-          invL[ifree*Nfree+jfree]=L[i*Neq+j]; Ufree[ifree*Nfree+jfree]=U[i*Neq+j]; 
-          jfree+=1;
-        };
+    for(i=j+1;i<Neq;i++){
+      if(missing[i]){continue;};
+      f = Hessian[i*Neq+j];
+      for(k=0;k<j;k++){
+        if(!missing[k]){f -= L[i*Neq+k]*L[j*Neq+k]*D[k];};
       };
-      ifree += 1;
+      L[i*Neq+j] = f/D[j];
     };
-  };  
-
-
+  };
 
 
-// Now, invert the smaller (nonSingular) matrices L and U:
-  double *ident = new double[Nfree];
+// Forward substitution (L*y = Residuals):
+  for(i=0;i<Neq;i++){
+    if(missing[i]){y[i]=0.0; continue;};
+    f = Residuals[i];
+    for(k=0;k<i;k++){
+      if(!missing[k]){f -= L[i*Neq+k]*y[k];};
+    };
+    y[i] = f;
+  };
 
-  for(k=0;k<Nfree;k++){
-    for(j=0;j<Nfree;j++){ident[j]=0.0;};
-      ident[k]=1.0;
-      for(i=Nfree-1;i>=0;i--){                   
-        invU[i*Nfree + k]=ident[i];
-        for(j=i+1;j<Nfree;j++){
-          if(i!=j){
-            invU[i*Nfree+k]=invU[i*Nfree+k]-Ufree[i*Nfree + j]*invU[j*Nfree+k];
-          };          
-        };
-        invU[i*Nfree+k]=invU[i*Nfree+k]/Ufree[i*Nfree + i];  
+// Backward substitution (D*L^T*Solution = y):
+  for(i=Neq-1;i>=0;i--){
+    if(missing[i]){Solution[i]=0.0; continue;};
+    f = y[i]/D[i];
+    for(k=i+1;k<Neq;k++){
+      if(!missing[k]){f -= L[k*Neq+i]*Solution[k];};
     };
+    Solution[i] = f;
   };
 
 
-// The parameter errors are just the (sqrt of) the diagonal cov. matrix:
-  ifree = 0;
+// The parameter errors are just the (sqrt of) the diagonal cov. matrix.
+// (H^-1)_ii = sum_k (L^-1)_ki^2 / D_k, with L^-1 e_i computed in place:
   for(i=0;i<Neq;i++){
-    isSingular=false;
-    Errors[i]=0.0;
-    for(k=0;k<Nmissing;k++){
-      if(missing[k]==i){isSingular=true;Errors[i]=-1.0; break;};
-    };
-    if(!isSingular){
-      for(j=0;j<Nfree;j++){
-        Errors[i] += invU[ifree*Nfree+j]*invL[j*Nfree+ifree];
+    if(missing[i]){Errors[i]=-1.0; continue;};
+    Errors[i] = 1.0/D[i];
+    y[i] = 1.0;
+    for(j=i+1;j<Neq;j++){
+      if(missing[j]){continue;};
+      f = 0.0;
+      for(k=i;k<j;k++){
+        if(!missing[k]){f -= L[j*Neq+k]*y[k];};
       };
-      ifree += 1;
-      Errors[i] = std::sqrt(Errors[i]);
+      y[j] = f;
+      Errors[i] += f*f/D[j];
     };
+    Errors[i] = std::sqrt(Errors[i]);
   };
 
 
-
-  delete Hessian;
-  delete Residuals;
-  delete invU;
-  delete Ufree; 
-  delete invL;
-  delete ident;
-
-  isSingular = Nmissing>0;
-  return isSingular;
-
+  return Nmissing>0;
 
 };
 
@@ -471,7 +373,7 @@ bool solveSystem(int Neq, double *HessianOrig, double *ResidualsOrig, double *So
 
 
 
-static PyObject *GetNchan(PyObject *self, PyObject *args){
+PyObject *GetNchan(PyObject *self, PyObject *args){
   int cIF, k, j;
   PyObject *ret;
 
@@ -509,7 +411,7 @@ static PyObject *GetNchan(PyObject *self, PyObject *args){
 
 
 
-static PyObject *GetNScan(PyObject *self, PyObject *args){
+PyObject *GetNScan(PyObject *self, PyObject *args){
   int cIF, k, j;
   PyObject *ret;
 
@@ -549,7 +451,7 @@ static PyObject *GetNScan(PyObject *self, PyObject *args){
 
 
 
-static PyObject *PolGainSolve(PyObject *self, PyObject *args){
+PyObject *PolGainSolve(PyObject *self, PyObject *args){
 
   PyObject *calant, *linant, *solints, *flagBas, *logNameObj;
 
@@ -701,6 +603,8 @@ static PyObject *PolGainSolve(PyObject *self, PyObject *args){
   NLVis = (int *) malloc(MAXIF*sizeof(int));
   Nchan = (int *) malloc(MAXIF*sizeof(int));
   Frequencies = (double **) malloc(MAXIF*sizeof(double*));
+  ChanFreq = (double **) malloc(MAXIF*sizeof(double*));
+  RateFixed = (bool *) malloc(MAXIF*sizeof(bool));
   Ant1 = (int**) malloc(MAXIF*sizeof(int*));
   Ant2 = (int**) malloc(MAXIF*sizeof(int*));
   Scan = (int**) malloc(MAXIF*sizeof(int*));
@@ -712,10 +616,7 @@ static PyObject *PolGainSolve(PyObject *self, PyObject *args){
   PA1 = (cplx64f**) malloc(MAXIF*sizeof(cplx64f*));
   PA2 = (cplx64f**) malloc(MAXIF*sizeof(cplx64f*));
   UVGauss = (double**) malloc(MAXIF*sizeof(double*));
-  RR = (cplx64f***) malloc(MAXIF*sizeof(cplx64f**));
-  LR = (cplx64f***) malloc(MAXIF*sizeof(cplx64f**));
-  RL = (cplx64f***) malloc(MAXIF*sizeof(cplx64f**));
-  LL = (cplx64f***) malloc(MAXIF*sizeof(cplx64f**));
+  VisData = (cplx32f**) malloc(MAXIF*sizeof(cplx32f*));
  // Rates = (double ***) malloc(MAXIF*sizeof(double**));
   for(i=0;i<5;i++){
     Rates[i] = (double ***) malloc(MAXIF*sizeof(double**));
@@ -733,9 +634,9 @@ static PyObject *PolGainSolve(PyObject *self, PyObject *args){
 
 
 
-static PyObject *FreeData(PyObject *self, PyObject *args) {
+PyObject *FreeData(PyObject *self, PyObject *args) {
 
-  int i,j; 
+  int i; 
 
   if (!logFile) logFile = fopen("PolConvert.GainSolve.log","a");
   sprintf(message,"Freeing Data NIF = %d\n", NIF);
@@ -743,14 +644,12 @@ static PyObject *FreeData(PyObject *self, PyObject *args) {
 
 
   for(i=0;i<NIF;i++){
-    for(j=0;j<NVis[i]+1;j++){
-      free(RR[i][j]);free(RL[i][j]);
-      free(LR[i][j]);free(LL[i][j]);
-    };
+    free(VisData[i]);
     free(Ant1[i]);free(Ant2[i]);free(Scan[i]);free(Times[i]);
-    free(PA1[i]);free(PA2[i]);free(RR[i]);free(RL[i]);free(UVGauss[i]);
-    free(LR[i]);free(LL[i]);free(ScanDur[i]);free(Weights[i]);
+    free(PA1[i]);free(PA2[i]);free(UVGauss[i]);
+    free(ScanDur[i]);free(Weights[i]);
     delete Frequencies[i];
+    delete[] ChanFreq[i];
   };
 
   delete(UVWeights);
@@ -758,7 +657,7 @@ static PyObject *FreeData(PyObject *self, PyObject *args) {
   if(NIF>0){
     free(NScan);free(Nchan);free(NVis);
     free(NCVis);free(NLVis);free(IFNum);
-    free(Frequencies); free(Scan);
+    free(Frequencies); free(ChanFreq); free(RateFixed); free(Scan);
     NIF = -1;
     PyObject *ret = Py_BuildValue("i",0);
     return ret;
@@ -778,27 +677,12 @@ static PyObject *FreeData(PyObject *self, PyObject *args) {
 // In addition, arrange the data in scans.
 // MaxDT is the maximum allowed time separation between 
 // neighboring entries of the same scan (in seconds).
-static PyObject *ReadData(PyObject *self, PyObject *args) {
+// ChanAvg (optional) is the number of channels to add together
+// as the data are read (the last bin may have fewer channels).
+int readData(int IFN, const char *file1, const char *file2, double MaxDT, int ChanAvg) {
 
-  int IFN;
-  const char *file1, *file2;
+  int NchanFile;
   std::ifstream CPfile, MPfile;
-  double MaxDT;
-
-  if (!logFile) logFile = fopen("PolConvert.GainSolve.log","a");
-  fprintf(logFile,"ReadData entered...\n"); fflush(logFile);
-
-
-  if (!PyArg_ParseTuple(args, "issd", &IFN,&file1, &file2,&MaxDT)){
-     sprintf(message,"Failed ReadData! Check inputs! (return -1)\n"); 
-     fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
-     fclose(logFile);
-     PyObject *ret = Py_BuildValue("i",-1);
-     return ret;
-  };
-
-  fprintf(logFile,"ReadData parsed...\n"); fflush(logFile);
-
 
   int i, j, k;
   double AuxT, AuxPA1, AuxPA2, AuxUV;
@@ -819,15 +703,17 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
     MAXIF *= 2;
     Nchan = (int*) realloc(Nchan,MAXIF*sizeof(int));
     Frequencies = (double**) realloc(Frequencies,MAXIF*sizeof(double*));
+    ChanFreq = (double**) realloc(ChanFreq,MAXIF*sizeof(double*));
+    RateFixed = (bool*) realloc(RateFixed,MAXIF*sizeof(bool));
     NVis = (int*) realloc(NVis,MAXIF*sizeof(int));
     NCVis = (int*) realloc(NCVis,MAXIF*sizeof(int));
     NLVis = (int*) realloc(NLVis,MAXIF*sizeof(int));
     IFNum = (int*) realloc(IFNum,MAXIF*sizeof(int));
-    if(!Nchan || !Frequencies || !NVis || !NCVis || !NLVis || !IFNum){
-      Nchan=nullptr; Frequencies=nullptr; NVis=nullptr; NCVis=nullptr; NLVis=nullptr; IFNum=nullptr;
+    if(!Nchan || !Frequencies || !ChanFreq || !RateFixed || !NVis || !NCVis || !NLVis || !IFNum){
+      Nchan=nullptr; Frequencies=nullptr; ChanFreq=nullptr; RateFixed=nullptr; 
+      NVis=nullptr; NCVis=nullptr; NLVis=nullptr; IFNum=nullptr;
       fprintf(logFile,"(return -2)"); fflush(logFile);
-      PyObject *ret = Py_BuildValue("i",-2);
-      return ret;
+      return -2;
     };
 
 // Set memory for the visibilities and metadata:
@@ -841,27 +727,22 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
     PA1 = (cplx64f**) realloc(PA1,MAXIF*sizeof(cplx64f*));
     PA2 = (cplx64f**) realloc(PA2,MAXIF*sizeof(cplx64f*));
     UVGauss = (double**) realloc(UVGauss,MAXIF*sizeof(double*));
-    RR = (cplx64f***) realloc(RR,MAXIF*sizeof(cplx64f**));
-    LR = (cplx64f***) realloc(LR,MAXIF*sizeof(cplx64f**));
-    RL = (cplx64f***) realloc(RL,MAXIF*sizeof(cplx64f**));
-    LL = (cplx64f***) realloc(LL,MAXIF*sizeof(cplx64f**));
+    VisData = (cplx32f**) realloc(VisData,MAXIF*sizeof(cplx32f*));
    // Rates = (double ***) realloc(Rates,MAXIF*sizeof(double**));
     for(i=0;i<5;i++){
       Delays[i] = (double ***) realloc(Delays[i],MAXIF*sizeof(double**));
       Rates[i] = (double ***) realloc(Rates[i],MAXIF*sizeof(double**));
     };
-    if(!Ant1 || !Ant2 || !Times || !Weights || !PA1 || !PA2 || !RR || !LR || !RL || !LL){
+    if(!Ant1 || !Ant2 || !Times || !Weights || !PA1 || !PA2 || !VisData){
       Ant1=nullptr; Ant2=nullptr; Times=nullptr; PA1=nullptr; PA2=nullptr; UVGauss=nullptr;
-      RR=nullptr; LR=nullptr; RL=nullptr; LL=nullptr; ScanDur=nullptr; Weights=nullptr;
+      VisData=nullptr; ScanDur=nullptr; Weights=nullptr;
       fprintf(logFile,"(return -3)"); fflush(logFile);
-      PyObject *ret = Py_BuildValue("i",-3);
-      return ret;
+      return -3;
     };
     if(!Rates[0] || !Delays[0] || !Delays[1] || !Delays[2] || !Delays[3]){
       for(i=0;i<5;i++){Rates[i] = nullptr; Delays[i]=nullptr;};
       fprintf(logFile,"(return -4)"); fflush(logFile);
-      PyObject *ret = Py_BuildValue("i",-4);
-      return ret;
+      return -4;
     };
   };
 //////////
@@ -869,11 +750,19 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
 
 // IF NUMBER:
   IFNum[NIF-1] = IFN;
-
-// Number of channels for this IF:
-  CPfile.read(reinterpret_cast<char*>(&Nchan[NIF-1]), sizeof(int));
-  fprintf(logFile, "IF%d has %i channels\n",IFN,Nchan[NIF-1]); fflush(logFile);
-  printf("IF%d (%i) has %i channels\n",IFN,NIF,Nchan[NIF-1]); fflush(stdout);
+  RateFixed[NIF-1] = false;
+
+// Number of channels for this IF (in the file and after channel averaging):
+  CPfile.read(reinterpret_cast<char*>(&NchanFile), sizeof(int));
+  if (ChanAvg < 1){ChanAvg = 1;};
+  if (ChanAvg > NchanFile){ChanAvg = NchanFile;};
+  Nchan[NIF-1] = (NchanFile + ChanAvg - 1)/ChanAvg;
+  fprintf(logFile, "IF%d has %i channels\n",IFN,NchanFile); fflush(logFile);
+  printf("IF%d (%i) has %i channels\n",IFN,NIF,NchanFile); fflush(stdout);
+  if (ChanAvg > 1){
+    sprintf(message,"IF%d will be averaged into %i channels (%i per bin)\n",IFN,Nchan[NIF-1],ChanAvg);
+    fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
+  };
 
 // Maximum number of channels:
   if (Nchan[NIF-1] > MaxChan){
@@ -884,8 +773,7 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
       if(!CrossSpec00[i] || !CrossSpec11[i]){
         CrossSpec00[i]=nullptr; CrossSpec11[i]=nullptr;
         fprintf(logFile,"(return -5)"); fflush(logFile);
-        PyObject *ret = Py_BuildValue("i",-5);
-        return ret;
+        return -5;
       };
     };
   };
@@ -898,9 +786,22 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
   MPfile.read(reinterpret_cast<char*>(&doParang), sizeof(bool));
 
 
-// Get frequencies for this IF:
+// Get frequencies for this IF (averaged within each channel bin).
+// ChanFreq is the bin position (in units of file channels) w.r.t. the IF center:
+  double *FileFreqs = new double[NchanFile];
+  CPfile.read(reinterpret_cast<char*>(FileFreqs), NchanFile*sizeof(double));
   Frequencies[NIF-1] = new double[Nchan[NIF-1]];
-  CPfile.read(reinterpret_cast<char*>(Frequencies[NIF-1]), Nchan[NIF-1]*sizeof(double));
+  ChanFreq[NIF-1] = new double[Nchan[NIF-1]];
+  for (j=0; j<Nchan[NIF-1]; j++){
+    Frequencies[NIF-1][j] = 0.0; ChanFreq[NIF-1][j] = 0.0;
+    for (k=j*ChanAvg; k<(j+1)*ChanAvg && k<NchanFile; k++){
+      Frequencies[NIF-1][j] += FileFreqs[k];
+      ChanFreq[NIF-1][j] += (double) (k-NchanFile/2);
+    };
+    Frequencies[NIF-1][j] /= (double) (k-j*ChanAvg);
+    ChanFreq[NIF-1][j] /= (double) (k-j*ChanAvg);
+  };
+  delete[] FileFreqs;
 
   fprintf(logFile,"Freqs. %.8e  %.8e\n",
       Frequencies[NIF-1][0],Frequencies[NIF-1][Nchan[NIF-1]-1]);
@@ -937,7 +838,7 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
       NCVis[NIF-1] += 1;
     };
 // here we are ignoring all the visibility data
-  CPfile.ignore(3*sizeof(double)+4*Nchan[NIF-1]*sizeof(cplx32f)); 
+  CPfile.ignore(3*sizeof(double)+4*NchanFile*sizeof(cplx32f)); 
   };
   fprintf(logFile,"Finished CPfile...\n"); fflush(logFile);
 
@@ -961,7 +862,7 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
     if(is1 && is2 && AuxA1 != AuxA2){
       NLVis[NIF-1] += 1;
     };
-    MPfile.ignore(3*sizeof(double)+12*Nchan[NIF-1]*sizeof(cplx32f)); 
+    MPfile.ignore(3*sizeof(double)+12*NchanFile*sizeof(cplx32f)); 
   };
 
   fprintf(logFile,"Finished MPfile...\n"); fflush(logFile);
@@ -982,20 +883,23 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
   PA1[NIF-1] = (cplx64f*) malloc(j*sizeof(cplx64f)); 
   PA2[NIF-1] = (cplx64f*) malloc(j*sizeof(cplx64f)); 
   UVGauss[NIF-1] = (double*) malloc(j*sizeof(double));
-  RR[NIF-1] = (cplx64f**) malloc(j*sizeof(cplx64f*)); 
-  LR[NIF-1] = (cplx64f**) malloc(j*sizeof(cplx64f*));
-  RL[NIF-1] = (cplx64f**) malloc(j*sizeof(cplx64f*)); 
-  LL[NIF-1] = (cplx64f**) malloc(j*sizeof(cplx64f*)); 
-  for (i=0;i<j;i++){
-    RR[NIF-1][i] = (cplx64f*) malloc(Nchan[NIF-1]*sizeof(cplx64f)); 
-    LR[NIF-1][i] = (cplx64f*) malloc(Nchan[NIF-1]*sizeof(cplx64f)); 
-    RL[NIF-1][i] = (cplx64f*) malloc(Nchan[NIF-1]*sizeof(cplx64f)); 
-    LL[NIF-1][i] = (cplx64f*) malloc(Nchan[NIF-1]*sizeof(cplx64f)); 
+  VisData[NIF-1] = (cplx32f*) calloc(((size_t) j)*Nchan[NIF-1]*4,sizeof(cplx32f));
+  if(!Ant1[NIF-1] || !Ant2[NIF-1] || !Scan[NIF-1] || !Times[NIF-1] || !Weights[NIF-1] ||
+     !PA1[NIF-1] || !PA2[NIF-1] || !UVGauss[NIF-1] || !VisData[NIF-1]){
+// Release everything allocated for this IF and drop it, so that
+// FreeData does not see a half-built entry:
+    free(Ant1[NIF-1]); free(Ant2[NIF-1]); free(Scan[NIF-1]); free(Times[NIF-1]);
+    free(Weights[NIF-1]); free(PA1[NIF-1]); free(PA2[NIF-1]); free(UVGauss[NIF-1]);
+    free(VisData[NIF-1]); free(DiffTimes);
+    delete[] Frequencies[NIF-1]; delete[] ChanFreq[NIF-1];
+    NIF -= 1;
+    fprintf(logFile,"(return -6)"); fflush(logFile);
+    return -6;
   };
 
 // Rewind files:
   CPfile.clear();
-  CPfile.seekg(sizeof(int)+Nchan[NIF-1]*sizeof(double),CPfile.beg);
+  CPfile.seekg(sizeof(int)+NchanFile*sizeof(double),CPfile.beg);
 
   MPfile.clear();
   MPfile.seekg(sizeof(int)+sizeof(bool),MPfile.beg);
@@ -1006,7 +910,8 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
   int currI = 0;
   bool isGood, isFlipped;
   cplx64f Exp1, Exp2;
-  cplx32f AuxRR, AuxRL, AuxLR, AuxLL;
+  cplx32f AuxRR, AuxRL, AuxLR, AuxLL, AuxC;
+  cplx32f *currVis;
 
   i=0;
   while(!MPfile.eof() && MPfile.peek() >= 0){
@@ -1033,7 +938,7 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
       Exp1 = std::polar(1.0,AuxPA1);
       Exp2 = std::polar(1.0,AuxPA2);
       Times[NIF-1][currI] = AuxT;
-      UVGauss[NIF-1][currI] = std::exp(-AuxUV/UVTAPER);
+      UVGauss[NIF-1][currI] = std::exp(-AuxUV/UVTAPER)*ChanAvg;
       isTime=false;
      for(j=0;j<NDiffTimes;j++){
         if(DiffTimes[j]==AuxT){isTime=true;break;};
@@ -1058,7 +963,8 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
        PA2[NIF-1][currI] = Exp2;
      };
 
-     for (k=0;k<Nchan[NIF-1];k++){
+     for (k=0;k<NchanFile;k++){
+       currVis = &VisData[NIF-1][(((size_t) currI)*Nchan[NIF-1]+k/ChanAvg)*4];
 // Jump Uncal Data:
        MPfile.ignore(4*sizeof(cplx32f));
 // Read Cal Data:
@@ -1070,30 +976,31 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
        MPfile.ignore(4*sizeof(cplx32f));
 // Apply ParAng to antennas with Circ Pol:
        if (isFlipped){
-         RR[NIF-1][currI][k] = conj((cplx64f) AuxRR);
-         RL[NIF-1][currI][k] = conj((cplx64f) AuxLR);
-         LR[NIF-1][currI][k] = conj((cplx64f) AuxRL);
-         LL[NIF-1][currI][k] = conj((cplx64f) AuxLL);
-       } else {
-         RR[NIF-1][currI][k] = (cplx64f) AuxRR;
-         RL[NIF-1][currI][k] = (cplx64f) AuxRL;
-         LR[NIF-1][currI][k] = (cplx64f) AuxLR;
-         LL[NIF-1][currI][k] = (cplx64f) AuxLL;
+         AuxC = AuxRL;
+         AuxRR = conj(AuxRR);
+         AuxRL = conj(AuxLR);
+         AuxLR = conj(AuxC);
+         AuxLL = conj(AuxLL);
        };
 
   if(doParang){
-         RR[NIF-1][currI][k] *= PA2[NIF-1][currI]/PA1[NIF-1][currI];
-         RL[NIF-1][currI][k] /= PA2[NIF-1][currI]*PA1[NIF-1][currI];
-         LR[NIF-1][currI][k] *= PA2[NIF-1][currI]*PA1[NIF-1][currI];
-         LL[NIF-1][currI][k] *= PA1[NIF-1][currI]/PA2[NIF-1][currI];
+         AuxRR = (cplx32f) (((cplx64f) AuxRR)*PA2[NIF-1][currI]/PA1[NIF-1][currI]);
+         AuxRL = (cplx32f) (((cplx64f) AuxRL)/(PA2[NIF-1][currI]*PA1[NIF-1][currI]));
+         AuxLR = (cplx32f) (((cplx64f) AuxLR)*PA2[NIF-1][currI]*PA1[NIF-1][currI]);
+         AuxLL = (cplx32f) (((cplx64f) AuxLL)*PA1[NIF-1][currI]/PA2[NIF-1][currI]);
   };
 
+       currVis[0] += AuxRR;
+       currVis[1] += AuxRL;
+       currVis[2] += AuxLR;
+       currVis[3] += AuxLL;
+
 
      };
      currI += 1; isGood = true;
    };
    if(!isGood){
-     MPfile.ignore(12*Nchan[NIF-1]*sizeof(cplx32f));
+     MPfile.ignore(12*NchanFile*sizeof(cplx32f));
    };
 
   };
@@ -1139,7 +1046,7 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
 
 
     Times[NIF-1][currI] = AuxT;
-    UVGauss[NIF-1][currI] = std::exp(-AuxUV/UVTAPER);
+    UVGauss[NIF-1][currI] = std::exp(-AuxUV/UVTAPER)*ChanAvg;
     isTime=false;
 
 
@@ -1172,9 +1079,9 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
     };
 
 
-    for (k=0;k<Nchan[NIF-1];k++){
-
+    for (k=0;k<NchanFile;k++){
 
+      currVis = &VisData[NIF-1][(((size_t) currI)*Nchan[NIF-1]+k/ChanAvg)*4];
       CPfile.read(reinterpret_cast<char*>(&AuxRR), sizeof(cplx32f));
       CPfile.read(reinterpret_cast<char*>(&AuxRL), sizeof(cplx32f));
       CPfile.read(reinterpret_cast<char*>(&AuxLR), sizeof(cplx32f));
@@ -1182,15 +1089,15 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
 
 
       if (isFlipped){
-        RR[NIF-1][currI][k] = conj((cplx64f) AuxRR);
-        RL[NIF-1][currI][k] = conj((cplx64f) AuxLR);
-        LR[NIF-1][currI][k] = conj((cplx64f) AuxRL);
-        LL[NIF-1][currI][k] = conj((cplx64f) AuxLL);
+        currVis[0] += conj(AuxRR);
+        currVis[1] += conj(AuxLR);
+        currVis[2] += conj(AuxRL);
+        currVis[3] += conj(AuxLL);
       } else {
-        RR[NIF-1][currI][k] = (cplx64f) AuxRR;
-        RL[NIF-1][currI][k] = (cplx64f) AuxRL;
-        LR[NIF-1][currI][k] = (cplx64f) AuxLR;
-        LL[NIF-1][currI][k] = (cplx64f) AuxLL;
+        currVis[0] += AuxRR;
+        currVis[1] += AuxRL;
+        currVis[2] += AuxLR;
+        currVis[3] += AuxLL;
       };
     };
     currI += 1; isGood = true;
@@ -1198,7 +1105,7 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
 
 
   if(!isGood){
-    CPfile.ignore(4*Nchan[NIF-1]*sizeof(cplx32f));
+    CPfile.ignore(4*NchanFile*sizeof(cplx32f));
   };
 
 
@@ -1305,8 +1212,41 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
 
   free(DiffTimes);
 
+// Reference epoch of the fringe rates (kept when the data are compressed):
+  if (NIF==1 && NVis[0]>0){RateT0 = Times[0][0];};
 
-  PyObject *ret = Py_BuildValue("i",0);
+  return 0;
+};
+
+
+
+PyObject *ReadData(PyObject *self, PyObject *args) {
+
+  int IFN, result;
+  int ChanAvg = 1;
+  const char *file1, *file2;
+  double MaxDT;
+
+  if (!logFile) logFile = fopen("PolConvert.GainSolve.log","a");
+  fprintf(logFile,"ReadData entered...\n"); fflush(logFile);
+
+
+  if (!PyArg_ParseTuple(args, "issd|i", &IFN,&file1, &file2,&MaxDT,&ChanAvg)){
+     sprintf(message,"Failed ReadData! Check inputs! (return -1)\n"); 
+     fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
+     fclose(logFile); logFile = nullptr;
+     PyObject *ret = Py_BuildValue("i",-1);
+     return ret;
+  };
+
+  fprintf(logFile,"ReadData parsed...\n"); fflush(logFile);
+
+// Read the data without the GIL:
+  Py_BEGIN_ALLOW_THREADS
+  result = readData(IFN, file1, file2, MaxDT, ChanAvg);
+  Py_END_ALLOW_THREADS
+
+  PyObject *ret = Py_BuildValue("i",result);
   return ret;
 };
 
@@ -1320,7 +1260,7 @@ static PyObject *ReadData(PyObject *self, PyObject *args) {
 #if 0
 /// GetIFs(ifNr) for invocation from Python like
 ///    AllFreqs = []; ifsofIF = PS.GetIFs(pli); AllFreqs.append(ifsofIF)
-static PyObject *GetIFs(PyObject *self, PyObject *args) {
+PyObject *GetIFs(PyObject *self, PyObject *args) {
 int i,j,k;
 
   PyObject *FreqsObj = PyList_New(0);
@@ -1330,7 +1270,7 @@ int i,j,k;
   if (!PyArg_ParseTuple(args, "i", &i)){
      sprintf(message,"Failed GetIFs! Check inputs!\n");
      fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
-     fclose(logFile);
+     fclose(logFile); logFile = nullptr;
     PyObject *ret = Py_BuildValue("i",-1);
     return ret;
   };
@@ -1362,7 +1302,7 @@ int i,j,k;
 #else
 /// GetIFs(ifNr) for invocation from Python like
 ///    AllFreqs = [];  AllFreqs.append(np.zeros(PS.GetNchan(pli), order="C", dtype=np.float)); rc = PS.GetIFs(pli, AllFreqs[-1])
-static PyObject *GetIFs(PyObject *self, PyObject *args) {  
+PyObject *GetIFs(PyObject *self, PyObject *args) {  
 int i,j,k;
 
   PyObject *FreqsObj;
@@ -1372,7 +1312,7 @@ int i,j,k;
   if (!PyArg_ParseTuple(args, "iO", &i,&FreqsObj)){
      sprintf(message,"Failed GetIFs! Check inputs!\n"); 
      fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
-     fclose(logFile);
+     fclose(logFile); logFile = nullptr;
     PyObject *ret = Py_BuildValue("i",-1);
     return ret;
   };
@@ -1446,7 +1386,7 @@ double QuinnEstimate(cplx64f *FFTVec){
 
 
 
-static PyObject *SetFringeRates(PyObject *self, PyObject *args) {
+PyObject *SetFringeRates(PyObject *self, PyObject *args) {
 
 
   int i,j,k,NantFix,cIF,cScan;
@@ -1459,7 +1399,7 @@ static PyObject *SetFringeRates(PyObject *self, PyObject *args) {
   if (!PyArg_ParseTuple(args, "iiOO", &cIF, &cScan, &ratesArr, &antList)){
      sprintf(message,"Failed SetFringeRates! Check inputs!\n"); 
      fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
-     fclose(logFile);
+     fclose(logFile); logFile = nullptr;
      PyObject *ret = Py_BuildValue("i",-1);
      return ret;
   };
@@ -1487,13 +1427,154 @@ static PyObject *SetFringeRates(PyObject *self, PyObject *args) {
 
 
 
-static PyObject *DoGFF(PyObject *self, PyObject *args) {
+// Pre-average the data of all IFs in time blocks of TBlock seconds 
+// (per baseline and scan), so that the cost of GetChi2 scales with the
+// number of blocks instead of the number of integrations.
+// The visibilities (and UV weights) are added, not averaged, so that 
+// the Chi2 keeps the same normalization as with the raw data.
+// If useRates is set, the GFF fringe rates (i.e., the ones used by
+// GetChi2) are removed from each integration before adding it, and 
+// GetChi2 will not apply them again. Must be called after DoGFF 
+// (and before SetFit). Returns the total number of (compressed) visibilities.
+PyObject *CompressData(PyObject *self, PyObject *args) {
+
+  int i, j, k, l, a1, a2, ac1, ac2, currScan, NOut, NTot;
+  int useRates;
+  double TBlock, Tmin, Phase;
+  BlockKey key;
+  cplx64f Rot;
+  cplx32f *inVis, *outVis;
+
+  if (!logFile) logFile = fopen("PolConvert.GainSolve.log","a");
+
+  if (!PyArg_ParseTuple(args, "di", &TBlock, &useRates) || TBlock <= 0.0){
+     sprintf(message,"Failed CompressData! Check inputs!\n"); 
+     fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
+     PyObject *ret = Py_BuildValue("i",-1);
+     return ret;
+  };
+
+  NTot = 0;
+
+  for (i=0; i<NIF; i++){
+
+    if (NVis[i]==0){continue;};
+
+// Assign each visibility to its block:
+    std::map<BlockKey, int> Blocks;
+    std::map<BlockKey, int>::iterator it;
+    int *OutIdx = new int[NVis[i]];
+
+    Tmin = Times[i][0];
+    for (k=1; k<NVis[i]; k++){
+      if (Times[i][k]<Tmin){Tmin = Times[i][k];};
+    };
+
+    NOut = 0;
+    for (k=0; k<NVis[i]; k++){
+      key = BlockKey(Ant1[i][k], Ant2[i][k], Scan[i][k], (long) ((Times[i][k]-Tmin)/TBlock));
+      it = Blocks.find(key);
+      if (it == Blocks.end()){
+        Blocks[key] = NOut; OutIdx[k] = NOut; NOut += 1;
+      } else {
+        OutIdx[k] = it->second;
+      };
+    };
+
+// Memory for the compressed data:
+    j = NOut+1;
+    int *NewAnt1 = (int*) malloc(j*sizeof(int));
+    int *NewAnt2 = (int*) malloc(j*sizeof(int));
+    int *NewScan = (int*) malloc(j*sizeof(int));
+    int *NInBlock = (int*) calloc(j,sizeof(int));
+    double *NewTimes = (double*) calloc(j,sizeof(double));
+    double *NewWeights = (double*) calloc(j,sizeof(double));
+    double *NewUVGauss = (double*) calloc(j,sizeof(double));
+    cplx64f *NewPA1 = (cplx64f*) calloc(j,sizeof(cplx64f));
+    cplx64f *NewPA2 = (cplx64f*) calloc(j,sizeof(cplx64f));
+    cplx32f *NewVis = (cplx32f*) calloc(((size_t) j)*Nchan[i]*4,sizeof(cplx32f));
+    if (!NewAnt1 || !NewAnt2 || !NewScan || !NInBlock || !NewTimes || !NewWeights
+        || !NewUVGauss || !NewPA1 || !NewPA2 || !NewVis){
+      free(NewAnt1); free(NewAnt2); free(NewScan); free(NInBlock); free(NewTimes);
+      free(NewWeights); free(NewUVGauss); free(NewPA1); free(NewPA2); free(NewVis);
+      delete[] OutIdx;
+      sprintf(message,"CompressData: not enough memory!\n"); 
+      fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
+      PyObject *ret = Py_BuildValue("i",-2);
+      return ret;
+    };
+
+// Add the integrations (derotating the fringe rates, if requested):
+    for (k=0; k<NVis[i]; k++){
+      l = OutIdx[k];
+      a1 = Ant1[i][k]; a2 = Ant2[i][k]; currScan = Scan[i][k];
+      NewAnt1[l] = a1; NewAnt2[l] = a2; NewScan[l] = currScan;
+      NInBlock[l] += 1;
+      NewTimes[l] += Times[i][k];
+      NewWeights[l] += Weights[i][k];
+      NewUVGauss[l] += UVGauss[i][k];
+      NewPA1[l] += PA1[i][k];
+      NewPA2[l] += PA2[i][k];
+
+      Phase = 0.0;
+      if (useRates){
+        ac1 = -1; ac2 = -1;
+        for(j=0; j<NCalAnt; j++) {
+          if (a1==CalAnts[j]){ac1 = j;};
+          if (a2==CalAnts[j]){ac2 = j;};
+        };
+        if (ac1>=0){Phase += TWOPI*Rates[4][0][ac1][currScan]*(Times[i][k]-RateT0);};
+        if (ac2>=0){Phase -= TWOPI*Rates[4][0][ac2][currScan]*(Times[i][k]-RateT0);};
+      };
+      Rot = std::polar(1.0, Phase);
+
+      inVis = &VisData[i][((size_t) k)*Nchan[i]*4];
+      outVis = &NewVis[((size_t) l)*Nchan[i]*4];
+      for (j=0; j<4*Nchan[i]; j++){
+        outVis[j] += (cplx32f) (Rot*((cplx64f) inVis[j]));
+      };
+    };
+
+    for (l=0; l<NOut; l++){
+      NewTimes[l] /= (double) NInBlock[l];
+      NewWeights[l] /= (double) NInBlock[l];
+      if (std::abs(NewPA1[l])>0.0){NewPA1[l] /= std::abs(NewPA1[l]);};
+      if (std::abs(NewPA2[l])>0.0){NewPA2[l] /= std::abs(NewPA2[l]);};
+    };
+
+    sprintf(message,"IF %i: %i visibilities compressed into %i\n",IFNum[i],NVis[i],NOut); 
+    fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
+
+// Replace the data:
+    free(VisData[i]); free(Ant1[i]); free(Ant2[i]); free(Scan[i]); free(Times[i]);
+    free(Weights[i]); free(UVGauss[i]); free(PA1[i]); free(PA2[i]);
+    VisData[i] = NewVis; Ant1[i] = NewAnt1; Ant2[i] = NewAnt2; Scan[i] = NewScan;
+    Times[i] = NewTimes; Weights[i] = NewWeights; UVGauss[i] = NewUVGauss;
+    PA1[i] = NewPA1; PA2[i] = NewPA2;
+    NVis[i] = NOut;
+    RateFixed[i] = RateFixed[i] || useRates;
+    NTot += NOut;
+
+    free(NInBlock);
+    delete[] OutIdx;
+
+  };
+
+
+  PyObject *ret = Py_BuildValue("i",NTot);
+  return ret;
+};
+
+
+
+
+
+int doGFF(int *ants, int nAnts, int nPix, int applyRate, int cScan, double snrCutoff) {
 
-  int i,j,k,l,m, a1,a2, af1, af2, BNum,cScan;
+  int i,j,k,l,m, a1,a2, af1, af2, BNum;
   double *T0 = new double[NBas];  
   double *T1 = new double[NBas];
   bool isFirst = true;
-  int applyRate;
   bool showMe, gotAnts;
   cplx64f **aroundPeak = new cplx64f *[4]; 
 
@@ -1502,16 +1583,8 @@ static PyObject *DoGFF(PyObject *self, PyObject *args) {
     aroundPeak[i] = new cplx64f[3];
   };
 
-  PyObject *antList;
-
-  if (!logFile) logFile = fopen("PolConvert.GainSolve.log","a");
-  if (!PyArg_ParseTuple(args, "Oiiid", &antList,&npix, &applyRate,&cScan,&SNR_CUTOFF)){
-     sprintf(message,"Failed DoGFF! Check inputs!\n"); 
-     fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
-     fclose(logFile);
-     PyObject *ret = Py_BuildValue("i",-1);
-     return ret;
-  };
+  npix = nPix;
+  SNR_CUTOFF = snrCutoff;
 
 
   if (applyRate==0){
@@ -1523,13 +1596,9 @@ static PyObject *DoGFF(PyObject *self, PyObject *args) {
   };
 
 
-  NantFit = (int) PyList_Size(antList);
+  NantFit = nAnts;
   delete[] antFit;
-  antFit = new int[NantFit];
-
-  for (i=0; i<NantFit; i++){
-    antFit[i] = (int) PyInt_AsLong(PyList_GetItem(antList,i));
-  };
+  antFit = ants;
 
 // One element per polarization product:
   double ***BLRates = new double **[4];
@@ -1566,10 +1635,13 @@ static PyObject *DoGFF(PyObject *self, PyObject *args) {
     out[2] = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * MaxDim);
     out[3] = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * MaxDim);
     fftw_plan *pFT = new fftw_plan[4];
-    pFT[0] = fftw_plan_dft_2d(prevNvis, Nchan[0], BufferVis[0], out[0], FFTW_FORWARD, FFTW_MEASURE);
-    pFT[1] = fftw_plan_dft_2d(prevNvis, Nchan[0], BufferVis[1], out[1], FFTW_FORWARD, FFTW_MEASURE);
-    pFT[2] = fftw_plan_dft_2d(prevNvis, Nchan[0], BufferVis[2], out[2], FFTW_FORWARD, FFTW_MEASURE);
-    pFT[3] = fftw_plan_dft_2d(prevNvis, Nchan[0], BufferVis[3], out[3], FFTW_FORWARD, FFTW_MEASURE);
+    {
+      std::lock_guard<std::mutex> planLock(FFTWPlanMutex);
+      pFT[0] = fftw_plan_dft_2d(prevNvis, Nchan[0], BufferVis[0], out[0], FFTW_FORWARD, FFTW_MEASURE);
+      pFT[1] = fftw_plan_dft_2d(prevNvis, Nchan[0], BufferVis[1], out[1], FFTW_FORWARD, FFTW_MEASURE);
+      pFT[2] = fftw_plan_dft_2d(prevNvis, Nchan[0], BufferVis[2], out[2], FFTW_FORWARD, FFTW_MEASURE);
+      pFT[3] = fftw_plan_dft_2d(prevNvis, Nchan[0], BufferVis[3], out[3], FFTW_FORWARD, FFTW_MEASURE);
+    };
 
     cplx64f *Temp[4];
     cplx64f *BufferC[4];
@@ -1579,6 +1651,7 @@ static PyObject *DoGFF(PyObject *self, PyObject *args) {
     };
 
     int *inMatrix, NinMatrix;
+    cplx32f *currVis;
     double Peak[4] = {0.,0.,0.,0.};
     double rmsFringe[4] = {0.,0.,0.,0.}; 
     double avgFringe[4] = {0.,0.,0.,0.}; 
@@ -1643,10 +1716,13 @@ static PyObject *DoGFF(PyObject *self, PyObject *args) {
             if (T0[j] > Times[i][k]){
               T0[j] = Times[i][k];
             };
-            memcpy(&BufferC[0][NcurrVis*Nchan[i]],&RR[i][k][0],Nchan[i]*sizeof(cplx64f));
-            memcpy(&BufferC[1][NcurrVis*Nchan[i]],&LL[i][k][0],Nchan[i]*sizeof(cplx64f));
-            memcpy(&BufferC[2][NcurrVis*Nchan[i]],&RL[i][k][0],Nchan[i]*sizeof(cplx64f));
-            memcpy(&BufferC[3][NcurrVis*Nchan[i]],&LR[i][k][0],Nchan[i]*sizeof(cplx64f));
+            currVis = &VisData[i][((size_t) k)*Nchan[i]*4];
+            for(l=0;l<Nchan[i];l++){
+              BufferC[0][NcurrVis*Nchan[i]+l] = (cplx64f) currVis[4*l];
+              BufferC[1][NcurrVis*Nchan[i]+l] = (cplx64f) currVis[4*l+3];
+              BufferC[2][NcurrVis*Nchan[i]+l] = (cplx64f) currVis[4*l+1];
+              BufferC[3][NcurrVis*Nchan[i]+l] = (cplx64f) currVis[4*l+2];
+            };
 
 // Apply parangle correction:
          //   for(l=0;l<Nchan[i];l++){
@@ -1687,8 +1763,11 @@ static PyObject *DoGFF(PyObject *self, PyObject *args) {
 
             for(k=0;k<4;k++){
               memcpy(&AUX[0],&BufferVis[k][0],NcurrVis*Nchan[i]*sizeof(fftw_complex));
-              fftw_destroy_plan(pFT[k]);  
-              pFT[k] = fftw_plan_dft_2d(NcurrVis, Nchan[i], BufferVis[k], out[k], FFTW_FORWARD, FFTW_MEASURE);
+              {
+                std::lock_guard<std::mutex> planLock(FFTWPlanMutex);
+                fftw_destroy_plan(pFT[k]);  
+                pFT[k] = fftw_plan_dft_2d(NcurrVis, Nchan[i], BufferVis[k], out[k], FFTW_FORWARD, FFTW_MEASURE);
+              };
               memcpy(&BufferVis[k][0],&AUX[0],NcurrVis*Nchan[i]*sizeof(fftw_complex));
             };
           };
@@ -1931,6 +2010,7 @@ static PyObject *DoGFF(PyObject *self, PyObject *args) {
     for(m=0;m<4;m++){DelResVec[m] = new double[NantFit];RateResVec[m] = new double[NantFit];};
     delete[] CovMat;
     CovMat = new double[NantFit*NantFit];
+    setSolveWorkspace(NantFit);
     for (i=0;i<NantFit*NantFit;i++){
     //  Hessian[i] = 0.0;
       for(m=0;m<4;m++){HessianDel[m][i]=0.0;}
@@ -2169,6 +2249,12 @@ static PyObject *DoGFF(PyObject *self, PyObject *args) {
 
 // Release memory:
 
+  {
+    std::lock_guard<std::mutex> planLock(FFTWPlanMutex);
+    for(m=0;m<4;m++){fftw_destroy_plan(pFT[m]);};
+  };
+  delete[] pFT;
+
   for(m=0;m<4;m++){
     fftw_free(BufferVis[m]); fftw_free(out[m]);
   };
@@ -2200,7 +2286,308 @@ static PyObject *DoGFF(PyObject *self, PyObject *args) {
 
 
 // Return success:
-  PyObject *ret = Py_BuildValue("i",0);
+  return 0;
+
+};
+
+
+
+PyObject *DoGFF(PyObject *self, PyObject *args) {
+
+  int i, nPix, applyRate, cScan, nAnts, result;
+  int *ants;
+  double snrCutoff;
+  PyObject *antList;
+
+  if (!logFile) logFile = fopen("PolConvert.GainSolve.log","a");
+  if (!PyArg_ParseTuple(args, "Oiiid", &antList,&nPix, &applyRate,&cScan,&snrCutoff)){
+     sprintf(message,"Failed DoGFF! Check inputs!\n"); 
+     fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
+     fclose(logFile); logFile = nullptr;
+     PyObject *ret = Py_BuildValue("i",-1);
+     return ret;
+  };
+
+  nAnts = (int) PyList_Size(antList);
+  ants = new int[nAnts];
+  for (i=0; i<nAnts; i++){
+    ants[i] = (int) PyInt_AsLong(PyList_GetItem(antList,i));
+  };
+
+// Fit the fringes without the GIL:
+  Py_BEGIN_ALLOW_THREADS
+  result = doGFF(ants, nAnts, nPix, applyRate, cScan, snrCutoff);
+  Py_END_ALLOW_THREADS
+
+  PyObject *ret = Py_BuildValue("i",result);
+  return ret;
+
+};
+
+
+
+
+///////////////////////////////
+// Delay-rate fringes of a POLCONVERT.FRINGE file (for the plots):
+
+// Size of the header of each record of the file (file number, time, 
+// antennas, parallactic angles and UV distance, written without padding)
+// and number of complex (single-precision) values per channel that follow 
+// it (the 8 products of the mixed and converted visibilities and the 4
+// elements of the matrix). The file starts with nchan (int) and isParang
+// (char):
+static const int FRINGEHEAD = 44;
+static const int FRINGENVIS = 12;
+
+
+// Finds the records of baseline ant1-ant2 (in any order) of the first
+// SWIN file where it appears. Only the headers are read. The offsets 
+// are those of the matrices of each record:
+bool indexFringes(FILE *frFile, int ant1, int ant2, int &nchan, int &fileNum, 
+                  long &nTotal, std::vector<off_t> &Offsets){
+
+  char head[FRINGEHEAD];
+  char isParang;
+  int recFile, recAnt1, recAnt2;
+  off_t fileSize, offset, recSize;
+  std::map<int, std::vector<off_t> > Entries;
+
+  nTotal = 0; fileNum = -1; Offsets.clear();
+  if (fread(&nchan,sizeof(int),1,frFile)!=1 || fread(&isParang,sizeof(char),1,frFile)!=1
+      || nchan<0){return false;};
+
+  recSize = FRINGENVIS*((off_t) nchan)*sizeof(cplx32f);
+  fseeko(frFile,0,SEEK_END); fileSize = ftello(frFile);
+  offset = sizeof(int) + sizeof(char);
+
+// A truncated record at the end is ignored (as numpy.fromfile does):
+  while (offset + FRINGEHEAD + recSize <= fileSize){
+    if (fseeko(frFile,offset,SEEK_SET)!=0 || fread(head,1,FRINGEHEAD,frFile)!=FRINGEHEAD){
+      return false;
+    };
+    memcpy(&recFile,&head[0],sizeof(int));
+    memcpy(&recAnt1,&head[12],sizeof(int));
+    memcpy(&recAnt2,&head[16],sizeof(int));
+    if ((recAnt1==ant1 && recAnt2==ant2) || (recAnt1==ant2 && recAnt2==ant1)){
+      Entries[recFile].push_back(offset + FRINGEHEAD);
+    };
+    offset += FRINGEHEAD + recSize;
+    nTotal += 1;
+  };
+
+  if (!Entries.empty()){
+    fileNum = Entries.begin()->first;
+    Offsets.swap(Entries.begin()->second);
+  };
+
+  return true;
+
+};
+
+
+
+
+// Peak of a map over its rms, without its nchan highest pixels:
+static double fringeSNR(double *Map, long npix, int nchan){
+
+  std::vector<double> Sorted(Map, Map + npix);
+  long nrest = npix - nchan, i;
+  double peak, avg = 0.0, rms = 0.0;
+
+  if (nrest<1){return 0.0;};
+  peak = *std::max_element(Sorted.begin(), Sorted.end());
+  std::nth_element(Sorted.begin(), Sorted.begin() + nrest, Sorted.end());
+  for (i=0; i<nrest; i++){avg += Sorted[i]; rms += Sorted[i]*Sorted[i];};
+  avg /= (double) nrest; rms = rms/((double) nrest) - avg*avg;
+
+  return (rms > 0.0) ? peak/sqrt(rms) : 0.0;
+
+};
+
+
+
+
+/* Reads the records of the given offsets and fills (Maps) the fftshifted
+   delay-rate amplitudes of the 4 mixed (0-3) and the 4 converted (4-7) 
+   products (each one [record][channel]) and (Kmat) the conversion 
+   matrices. MixPeak and CalPeak are the fringes of the 4 products at the
+   peak of the sum of the 4 mixed amplitudes (of RR+LL, for the converted
+   ones), MixMax is the peak of each mixed amplitude and SNR the one of 
+   each map. The 4 products of each group share the FFTW plans, as in 
+   doGFF: */
+bool fringeMaps(FILE *frFile, int nchan, std::vector<off_t> &Offsets, double *Maps,
+                cplx32f *Kmat, cplx64f *MixPeak, cplx64f *CalPeak, double *MixMax, double *SNR){
+
+  long nrec = Offsets.size(), npix = nrec*nchan, r, k, pix, peakPix;
+  int g, m, rowShift = nrec/2, chanShift = nchan/2;
+  double best, sum;
+  bool isOK = true;
+  std::vector<cplx32f> Record(FRINGENVIS*nchan);
+  std::vector<cplx32f> Products(8*npix);
+
+  for (r=0; r<nrec && isOK; r++){
+    isOK = fseeko(frFile,Offsets[r],SEEK_SET)==0 
+           && fread(&Record[0],sizeof(cplx32f),FRINGENVIS*nchan,frFile)==FRINGENVIS*((size_t) nchan);
+    for (k=0; k<nchan; k++){
+      for (m=0; m<8; m++){Products[m*npix + r*nchan + k] = Record[FRINGENVIS*k + m];};
+      for (m=0; m<4; m++){Kmat[m*npix + r*nchan + k] = Record[FRINGENVIS*k + 8 + m];};
+    };
+  };
+  if (!isOK){return false;};
+
+  fftw_complex *BufferVis[4];
+  fftw_plan pFT[4];
+  cplx64f *Temp[4];
+  for (m=0; m<4; m++){
+    BufferVis[m] = (fftw_complex *) fftw_malloc(sizeof(fftw_complex) * npix);
+    {
+      std::lock_guard<std::mutex> planLock(FFTWPlanMutex);
+      pFT[m] = fftw_plan_dft_2d(nrec, nchan, BufferVis[m], BufferVis[m], FFTW_FORWARD, FFTW_ESTIMATE);
+    };
+    Temp[m] = reinterpret_cast<std::complex<double> *>(BufferVis[m]);
+  };
+
+  for (g=0; g<2; g++){
+
+    for (m=0; m<4; m++){
+      for (pix=0; pix<npix; pix++){Temp[m][pix] = (cplx64f) Products[(4*g + m)*npix + pix];};
+      fftw_execute(pFT[m]);
+    };
+
+// Amplitudes (with the zero delay and rate at the center of the map):
+    for (m=0; m<4; m++){
+      for (r=0; r<nrec; r++){
+        for (k=0; k<nchan; k++){
+          Maps[(4*g + m)*npix + ((r + rowShift)%nrec)*nchan + (k + chanShift)%nchan] =
+            std::abs(Temp[m][r*nchan + k]);
+        };
+      };
+      SNR[4*g + m] = fringeSNR(&Maps[(4*g + m)*npix], npix, nchan);
+    };
+
+// Peak of the group (first one, in the order of the map):
+    best = -1.0; peakPix = 0;
+    for (pix=0; pix<npix; pix++){
+      if (g==0){
+        sum = Maps[pix] + Maps[npix + pix] + Maps[2*npix + pix] + Maps[3*npix + pix];
+      } else {
+        sum = Maps[4*npix + pix] + Maps[7*npix + pix];
+      };
+      if (sum > best){best = sum; peakPix = pix;};
+    };
+    r = (peakPix/nchan + nrec - rowShift)%nrec;
+    k = (peakPix%nchan + nchan - chanShift)%nchan;
+    for (m=0; m<4; m++){
+      if (g==0){
+        MixPeak[m] = Temp[m][r*nchan + k];
+        MixMax[m] = *std::max_element(&Maps[m*npix], &Maps[(m+1)*npix]);
+      } else {
+        CalPeak[m] = Temp[m][r*nchan + k];
+      };
+    };
+
+  };
+
+  for (m=0; m<4; m++){
+    {
+      std::lock_guard<std::mutex> planLock(FFTWPlanMutex);
+      fftw_destroy_plan(pFT[m]);
+    };
+    fftw_free(BufferVis[m]);
+  };
+
+  return true;
+
+};
+
+
+
+
+PyObject *FringeMaps(PyObject *self, PyObject *args) {
+
+  const char *fileName;
+  int ant1, ant2, nchan, fileNum, m;
+  long nTotal;
+  bool isOK;
+  double MixMax[4], SNR[8];
+  cplx64f MixPeak[4], CalPeak[4];
+  std::vector<off_t> Offsets;
+  npy_intp dims[3];
+  FILE *frFile;
+  PyObject *MapsArr, *KmatArr, *PeakList[4];
+
+  if (!logFile) logFile = fopen("PolConvert.GainSolve.log","a");
+  if (!PyArg_ParseTuple(args, "sii", &fileName, &ant1, &ant2)){
+     sprintf(message,"Failed FringeMaps! Check inputs!\n"); 
+     fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
+     fclose(logFile); logFile = nullptr;
+     PyObject *ret = Py_BuildValue("i",-1);
+     return ret;
+  };
+
+  frFile = fopen(fileName,"rb");
+  if (frFile == NULL){
+    sprintf(message,"FringeMaps: cannot open %s\n",fileName);
+    fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
+    PyObject *ret = Py_BuildValue("i",-1);
+    return ret;
+  };
+
+// Index the file without the GIL:
+  Py_BEGIN_ALLOW_THREADS
+  isOK = indexFringes(frFile, ant1, ant2, nchan, fileNum, nTotal, Offsets);
+  Py_END_ALLOW_THREADS
+
+  if (!isOK || Offsets.empty()){
+    fclose(frFile);
+    sprintf(message,"FringeMaps: %s for baseline %i-%i in %s\n", 
+            isOK ? "no data" : "cannot read the records", ant1, ant2, fileName);
+    fprintf(logFile,"%s",message); fflush(logFile);
+    PyObject *ret = Py_BuildValue("i",isOK ? 0 : -1);
+    return ret;
+  };
+
+  dims[0] = 8; dims[1] = Offsets.size(); dims[2] = nchan;
+  MapsArr = PyArray_SimpleNew(3, dims, NPY_FLOAT64);
+  dims[0] = 4;
+  KmatArr = PyArray_SimpleNew(3, dims, NPY_COMPLEX64);
+  if (MapsArr == NULL || KmatArr == NULL){
+    fclose(frFile);
+    Py_XDECREF(MapsArr); Py_XDECREF(KmatArr);
+    return NULL;
+  };
+
+// Read the records and compute the fringes without the GIL:
+  Py_BEGIN_ALLOW_THREADS
+  isOK = fringeMaps(frFile, nchan, Offsets, (double *) PyArray_DATA((PyArrayObject *) MapsArr),
+                    (cplx32f *) PyArray_DATA((PyArrayObject *) KmatArr), MixPeak, CalPeak, MixMax, SNR);
+  Py_END_ALLOW_THREADS
+
+  fclose(frFile);
+
+  if (!isOK){
+    sprintf(message,"FringeMaps: cannot read the records of %s\n",fileName);
+    fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);
+    Py_DECREF(MapsArr); Py_DECREF(KmatArr);
+    PyObject *ret = Py_BuildValue("i",-1);
+    return ret;
+  };
+
+  sprintf(message,"FringeMaps: %li records of baseline %i-%i (SWIN file %i) in %s\n",
+          (long) Offsets.size(), ant1, ant2, fileNum, fileName);
+  fprintf(logFile,"%s",message); fflush(logFile);
+
+  PeakList[0] = PyList_New(4); PeakList[1] = PyList_New(4);
+  PeakList[2] = PyList_New(4); PeakList[3] = PyList_New(8);
+  for (m=0; m<4; m++){
+    PyList_SetItem(PeakList[0], m, PyComplex_FromDoubles(MixPeak[m].real(), MixPeak[m].imag()));
+    PyList_SetItem(PeakList[1], m, PyComplex_FromDoubles(CalPeak[m].real(), CalPeak[m].imag()));
+    PyList_SetItem(PeakList[2], m, PyFloat_FromDouble(MixMax[m]));
+  };
+  for (m=0; m<8; m++){PyList_SetItem(PeakList[3], m, PyFloat_FromDouble(SNR[m]));};
+
+  PyObject *ret = Py_BuildValue("iiNNNNNN", fileNum, (int) nTotal, MapsArr, KmatArr,
+                                PeakList[0], PeakList[1], PeakList[2], PeakList[3]);
   return ret;
 
 };
@@ -2240,7 +2627,7 @@ static PyObject *DoGFF(PyObject *self, PyObject *args) {
 
 
 
-static PyObject *SetFit(PyObject *self, PyObject *args) {
+PyObject *SetFit(PyObject *self, PyObject *args) {
 
   int i, j, k, oldNpar = Npar;
   bool foundit;
@@ -2255,7 +2642,7 @@ static PyObject *SetFit(PyObject *self, PyObject *args) {
      &Npar, &IFlist, &antList, &solveAmp, &solveQU, &calstokes, &useCov, &feedPy)){
         sprintf(message,"Failed SetFit! Check inputs!\n"); 
         fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
-        fclose(logFile);
+        fclose(logFile); logFile = nullptr;
         ret = Py_BuildValue("i",-1);
       return ret;
   };
@@ -2287,7 +2674,7 @@ static PyObject *SetFit(PyObject *self, PyObject *args) {
 
   Tm = new double[NBas];
 
-  T0 = Times[0][0];
+  T0 = RateT0;
   T1 = Times[0][NVis[0]-1];
   DT = TAvg;
 
@@ -2318,7 +2705,7 @@ static PyObject *SetFit(PyObject *self, PyObject *args) {
     if (!foundit){
       sprintf(message,"BAD IF NUMBER: %i\n",j); 
       fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
-      fclose(logFile);
+      fclose(logFile); logFile = nullptr;
       ret = Py_BuildValue("i",-1);
       return ret;
     };
@@ -2327,6 +2714,7 @@ static PyObject *SetFit(PyObject *self, PyObject *args) {
   CovMat = new double[Npar*Npar];
   IndVec = new double[Npar];
   SolVec = new double[Npar];
+  setSolveWorkspace(Npar>NantFit?Npar:NantFit);
 //  m = gsl_matrix_view_array (CovMat, Npar, Npar);
 //  v = gsl_vector_view_array (IndVec, Npar);
 //  x = gsl_vector_view_array (SolVec, Npar);
@@ -2379,28 +2767,17 @@ static PyObject *SetFit(PyObject *self, PyObject *args) {
 
 
 
-static PyObject *GetChi2(PyObject *self, PyObject *args) { 
+// The gain ratios (CrossG) are also updated. Returns false if the 
+// channel range is wrong:
+bool getChi2(double *CrossG, double lambda, int Ch0, int Ch1, int end, bool useRates, double &result) { 
 
-  int Ch0, Ch1;
-  int i, k,l, end;
+  int i, k,l;
   int j= -1;
-  double *CrossG;
 //  double dx = 1.0e-8;
   double Drate1, Drate2, Ddelay1R, Ddelay2R, Ddelay1L, Ddelay2L;
 //  double *DerAux1, *DerAux2;
 //  DerAux1 = new double[2];
 //  DerAux2 = new double[2];
-  PyObject *pars, *ret,*LPy;
-  bool useRates;
-
-  if (!logFile) logFile = fopen("PolConvert.GainSolve.log","a");
-  if (!PyArg_ParseTuple(args, "OOiiib", &pars, &LPy, &Ch0, &Ch1,&end,&useRates)){
-     sprintf(message,"Failed GetChi2! Check inputs!\n"); 
-     fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
-     fclose(logFile);
-    ret = Py_BuildValue("i",-1);
-    return ret;
-  };
 
 
   bool useDelay = false;
@@ -2411,7 +2788,7 @@ static PyObject *GetChi2(PyObject *self, PyObject *args) {
 //  if (chisqcount==1){auxFile = fopen("PolConvert.GainSolve.Calls","a");};
 
 
-  Lambda = PyFloat_AsDouble(LPy);
+  Lambda = lambda;
   doCov = Lambda >= 0.0;
 
 
@@ -2422,9 +2799,8 @@ static PyObject *GetChi2(PyObject *self, PyObject *args) {
     if (Ch1 > Nchan[doIF[i]]){
       sprintf(message,"IF %i ONLY HAS %i CHANNELS. CHANNEL %i DOES NOT EXIST! \n",j,Nchan[doIF[i]], Ch1); 
       fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
-      fclose(logFile);
-      ret = Py_BuildValue("i",-1);
-      return ret;
+      fclose(logFile); logFile = nullptr;
+      return false;
     };
   };
 
@@ -2433,9 +2809,8 @@ static PyObject *GetChi2(PyObject *self, PyObject *args) {
   if (Ch0<0 || Ch0>Ch1){
     sprintf(message,"BAD CHANNEL RANGE: %i TO %i. SHOULD ALL BE POSITIVE AND Ch0 < Ch1\n",Ch0,Ch1); 
     fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
-    fclose(logFile);
-    ret = Py_BuildValue("i",-1);
-    return ret;
+    fclose(logFile); logFile = nullptr;
+    return false;
   };
 
 
@@ -2443,8 +2818,6 @@ static PyObject *GetChi2(PyObject *self, PyObject *args) {
 // Reference frequency for the MBD:
   double RefNu = Frequencies[doIF[0]][0];
 
-// Memory to store the current gain ratios:
-  CrossG = (double *) PyArray_DATA(pars);
 
 
 
@@ -2469,6 +2842,8 @@ static PyObject *GetChi2(PyObject *self, PyObject *args) {
   cplx64f oneC, RateFactor, FeedFactor1, FeedFactor2, RRRate, RLRate, LRRate, LLRate; 
 
   cplx64f RM1, RP1; 
+  cplx64f VisRR, VisRL, VisLR, VisLL;
+  cplx32f *currVis;
   cplx64f RM2, RP2; 
   cplx64f auxC1, auxC2, auxC3;
 //  cplx64f *AvPA1 = new cplx64f[NBas]; 
@@ -2514,10 +2889,7 @@ static PyObject *GetChi2(PyObject *self, PyObject *args) {
 /// Loop over IFs:
   for (i=0; i<NIFComp; i++){
 
-    chanFreq = new double[Nchan[doIF[i]]];
-    for (j=0;j<Nchan[doIF[i]];j++){
-      chanFreq[j] = (double) (j-Nchan[doIF[i]]/2);
-    };
+    chanFreq = ChanFreq[doIF[i]];
 
 
 
@@ -2751,7 +3123,7 @@ static PyObject *GetChi2(PyObject *self, PyObject *args) {
     if(ac1>=0){ // and !is1){
             Ddelay1R = TWOPI*((Delays[0][0][ac1][currScan])*(Frequencies[currIF][j]-RefNu));
             Ddelay1L = TWOPI*((Delays[1][0][ac1][currScan])*(Frequencies[currIF][j]-RefNu));
-	    if(useRates){
+	    if(useRates && !RateFixed[currIF]){
               Drate1 =  TWOPI*((Rates[4][0][ac1][currScan])*(Times[currIF][k]-T0));
             } else {Drate2=0.0;};
             
@@ -2760,7 +3132,7 @@ static PyObject *GetChi2(PyObject *self, PyObject *args) {
     if(ac2>=0){ // and !is2){
             Ddelay2R = TWOPI*((Delays[0][0][ac2][currScan])*(Frequencies[currIF][j]-RefNu));
             Ddelay2L = TWOPI*((Delays[1][0][ac2][currScan])*(Frequencies[currIF][j]-RefNu));
-            if(useRates){
+            if(useRates && !RateFixed[currIF]){
 	      Drate2 =  TWOPI*((Rates[4][0][ac2][currScan])*(Times[currIF][k]-T0));
             } else { Drate2=0.0;};
     };
@@ -2806,25 +3178,28 @@ static PyObject *GetChi2(PyObject *self, PyObject *args) {
       RM1 = (oneC - G1nu[currDer]); RM2 = (oneC - G2nu[currDer]); 
       RP1 = (oneC + G1nu[currDer]); RP2 = (oneC + G2nu[currDer]); 
 
-
+// Promote the (single-precision) visibilities to double for the accumulation:
+      currVis = &VisData[currIF][(((size_t) k)*Nchan[currIF]+j)*4];
+      VisRR = (cplx64f) currVis[0]; VisRL = (cplx64f) currVis[1];
+      VisLR = (cplx64f) currVis[2]; VisLL = (cplx64f) currVis[3];
       
 // USE MINIMIZATION OF THE CROSS-HAND CORRELATIONS:
      if(AddCrossHand){
        if (is1 && is2){
       //   printf("Cis12\n");fflush(stdout);
-         auxC01[BNum][currDer] += (RP1*RP2*RL[currIF][k][j] + RM1*RP2*LL[currIF][k][j] + RP1*RM2*RR[currIF][k][j] + RM1*RM2*LR[currIF][k][j])*RLRate;
-         auxC10[BNum][currDer] += (RP1*RP2*LR[currIF][k][j] + RM1*RP2*RR[currIF][k][j] + RP1*RM2*LL[currIF][k][j] + RM1*RM2*RL[currIF][k][j])*LRRate;
+         auxC01[BNum][currDer] += (RP1*RP2*VisRL + RM1*RP2*VisLL + RP1*RM2*VisRR + RM1*RM2*VisLR)*RLRate;
+         auxC10[BNum][currDer] += (RP1*RP2*VisLR + RM1*RP2*VisRR + RP1*RM2*VisLL + RM1*RM2*VisRL)*LRRate;
        } else if (is1){
       //   printf("Cis1\n");fflush(stdout);
-         auxC01[BNum][currDer] += (RP1*RL[currIF][k][j] + RM1*LL[currIF][k][j])*G2nu[currDer]*RLRate;
-         auxC10[BNum][currDer] += (RP1*LR[currIF][k][j] + RM1*RR[currIF][k][j])*LRRate;
+         auxC01[BNum][currDer] += (RP1*VisRL + RM1*VisLL)*G2nu[currDer]*RLRate;
+         auxC10[BNum][currDer] += (RP1*VisLR + RM1*VisRR)*LRRate;
        } else if (is2){
       //   printf("Cis2\n");fflush(stdout);
-         auxC01[BNum][currDer] += (RP2*RL[currIF][k][j] + RM2*RR[currIF][k][j])*RLRate;
-         auxC10[BNum][currDer] += (RP2*LR[currIF][k][j] + RM2*LL[currIF][k][j])*G1nu[currDer]*LRRate;
+         auxC01[BNum][currDer] += (RP2*VisRL + RM2*VisRR)*RLRate;
+         auxC10[BNum][currDer] += (RP2*VisLR + RM2*VisLL)*G1nu[currDer]*LRRate;
        } else {
-         auxC01[BNum][currDer] += (RL[currIF][k][j])*G2nu[currDer]*RLRate;
-         auxC10[BNum][currDer] += (LR[currIF][k][j])*G1nu[currDer]*LRRate;
+         auxC01[BNum][currDer] += (VisRL)*G2nu[currDer]*RLRate;
+         auxC10[BNum][currDer] += (VisLR)*G1nu[currDer]*LRRate;
        };
      };
 
@@ -2832,25 +3207,25 @@ static PyObject *GetChi2(PyObject *self, PyObject *args) {
   //   if(AddParHand){
        if (is1 && is2){
       //   printf("Pis12\n");fflush(stdout);
-         auxC1 = (RP1*RP2*RR[currIF][k][j] + RP2*RM1*LR[currIF][k][j] + RM2*RP1*RL[currIF][k][j] + RM1*RM2*LL[currIF][k][j])*RRRate;
-         auxC2 = (RP1*RP2*LL[currIF][k][j] + RP2*RM1*RL[currIF][k][j] + RM2*RP1*LR[currIF][k][j] + RM1*RM2*RR[currIF][k][j])*LLRate;
+         auxC1 = (RP1*RP2*VisRR + RP2*RM1*VisLR + RM2*RP1*VisRL + RM1*RM2*VisLL)*RRRate;
+         auxC2 = (RP1*RP2*VisLL + RP2*RM1*VisRL + RM2*RP1*VisLR + RM1*RM2*VisRR)*LLRate;
          auxC00[BNum][currDer] += auxC1;
          auxC11[BNum][currDer] += auxC2;
        } else if (is1){
       //   printf("Pis1\n");fflush(stdout);
-         auxC1 = (RP1*RR[currIF][k][j] + RM1*LR[currIF][k][j])*RRRate;
-         auxC2 = (RP1*LL[currIF][k][j] + RM1*RL[currIF][k][j])*G2nu[currDer]*LLRate;
+         auxC1 = (RP1*VisRR + RM1*VisLR)*RRRate;
+         auxC2 = (RP1*VisLL + RM1*VisRL)*G2nu[currDer]*LLRate;
          auxC00[BNum][currDer] += auxC1;
          auxC11[BNum][currDer] += auxC2;
        } else if (is2){
       //   printf("Pis2\n");fflush(stdout);
-         auxC1 = (RP2*RR[currIF][k][j] + RM2*RL[currIF][k][j])*RRRate;
-         auxC2 = (RP2*LL[currIF][k][j] + RM2*LR[currIF][k][j])*G1nu[currDer]*LLRate;
+         auxC1 = (RP2*VisRR + RM2*VisRL)*RRRate;
+         auxC2 = (RP2*VisLL + RM2*VisLR)*G1nu[currDer]*LLRate;
          auxC00[BNum][currDer] += auxC1;
          auxC11[BNum][currDer] += auxC2;
        } else {
-         auxC1 = RR[currIF][k][j]*RRRate;
-         auxC2 = LL[currIF][k][j]*G2nu[currDer]*G1nu[currDer]*LLRate;
+         auxC1 = VisRR*RRRate;
+         auxC2 = VisLL*G2nu[currDer]*G1nu[currDer]*LLRate;
          auxC00[BNum][currDer] += auxC1;
          auxC11[BNum][currDer] += auxC2;
        };
@@ -3049,8 +3424,6 @@ static PyObject *GetChi2(PyObject *self, PyObject *args) {
 
   };  // Comes from loop over visibilities
 
-  delete[] chanFreq;
-
 };  // Comes from loop over NIFComp
 
 
@@ -3124,7 +3497,7 @@ if (chisqcount==0){
 
     if (end==1){Chi2 = (Nflipped>0)?1.0:-1.0;};
 
-    ret = Py_BuildValue("d",Chi2);
+    result = Chi2;
 
 
 //  delete[] AvPA1;
@@ -3132,19 +3505,254 @@ if (chisqcount==0){
 
 
 
+  return true;
+
+};
+
+
+
+PyObject *GetChi2(PyObject *self, PyObject *args) { 
+
+  int Ch0, Ch1, end;
+  double *CrossG, lambda, result;
+  PyObject *pars, *ret,*LPy;
+  bool useRates, isOK;
+
+  if (!logFile) logFile = fopen("PolConvert.GainSolve.log","a");
+  if (!PyArg_ParseTuple(args, "OOiiib", &pars, &LPy, &Ch0, &Ch1,&end,&useRates)){
+     sprintf(message,"Failed GetChi2! Check inputs!\n"); 
+     fprintf(logFile,"%s",message); std::cout<<message; fflush(logFile);  
+     fclose(logFile); logFile = nullptr;
+    ret = Py_BuildValue("i",-1);
+    return ret;
+  };
+
+  lambda = PyFloat_AsDouble(LPy);
+
+// Memory to store the current gain ratios:
+  CrossG = (double *) PyArray_DATA(pars);
+
+// Compute the Chi2 without the GIL:
+  Py_BEGIN_ALLOW_THREADS
+  isOK = getChi2(CrossG, lambda, Ch0, Ch1, end, useRates, result);
+  Py_END_ALLOW_THREADS
+
+  if (isOK){
+    ret = Py_BuildValue("d",result);
+  } else {
+    ret = Py_BuildValue("i",-1);
+  };
   return ret;
 
 };
 
 
-// eof
+};  // End of class GainSolver
+
+
+
+// Releases the data (as FreeData) and the workspace of the solver:
+GainSolver::~GainSolver(){
+
+  int i;
+
+  if (NIF>0){
+    for(i=0;i<NIF;i++){
+      free(VisData[i]);
+      free(Ant1[i]);free(Ant2[i]);free(Scan[i]);free(Times[i]);
+      free(PA1[i]);free(PA2[i]);free(UVGauss[i]);
+      free(ScanDur[i]);free(Weights[i]);
+      delete Frequencies[i];
+      delete[] ChanFreq[i];
+    };
+    delete(UVWeights);
+    free(NScan);free(Nchan);free(NVis);
+    free(NCVis);free(NLVis);free(IFNum);
+    free(Frequencies); free(ChanFreq); free(RateFixed); free(Scan);
+  };
+
+  delete[] SolveL;
+  delete[] SolveD;
+  delete[] SolveY;
+  delete[] SolveMask;
+
+  if (logFile){fclose(logFile);};
+
+};
+
+
+
+
+
+
+///////////////////////
+// Module functions (they act on the default solver):
+
+static GainSolver *DefaultSolver = nullptr;
+
+#define MODULE_FUNCTION(name) \
+static PyObject *name(PyObject *self, PyObject *args){ \
+  std::unique_lock<std::mutex> lock = DefaultSolver->lockSolver(); \
+  return DefaultSolver->name(self, args);};
+
+MODULE_FUNCTION(PolGainSolve)
+MODULE_FUNCTION(ReadData)
+MODULE_FUNCTION(GetChi2)
+MODULE_FUNCTION(GetIFs)
+MODULE_FUNCTION(DoGFF)
+MODULE_FUNCTION(SetFringeRates)
+MODULE_FUNCTION(GetNScan)
+MODULE_FUNCTION(GetNchan)
+MODULE_FUNCTION(FreeData)
+MODULE_FUNCTION(SetFit)
+MODULE_FUNCTION(CompressData)
+MODULE_FUNCTION(FringeMaps)
+
+
+
+/* Module specification */
+static PyMethodDef module_methods[] = {
+    {"PolGainSolve", PolGainSolve, METH_VARARGS, PolGainSolve_docstring},
+    {"ReadData", ReadData, METH_VARARGS, ReadData_docstring},
+    {"GetChi2", GetChi2, METH_VARARGS, GetChi2_docstring},
+    {"GetIFs", GetIFs, METH_VARARGS, GetIFs_docstring},
+    {"DoGFF", DoGFF, METH_VARARGS, DoGFF_docstring},
+    {"SetFringeRates", SetFringeRates, METH_VARARGS, SetFringeRates_docstring},
+    {"GetNScan",GetNScan, METH_VARARGS, GetNScan_docstring},
+    {"GetNchan",GetNchan, METH_VARARGS, GetNchan_docstring},
+    {"FreeData", FreeData, METH_VARARGS, FreeData_docstring},
+    {"SetFit", SetFit, METH_VARARGS, SetFit_docstring},
+    {"CompressData", CompressData, METH_VARARGS, CompressData_docstring},
+    {"FringeMaps", FringeMaps, METH_VARARGS, FringeMaps_docstring},
+    {NULL, NULL, 0, NULL} /* terminated by list of NULLs, apparently */
+};
 
 
 
+///////////////////////
+// GainSolver Python type (each object owns its own solver):
+
+static char GainSolver_docstring[] =
+    "Cross-polarization gain solver with its own data and fit setup. Its methods are the same as the module functions.";
 
+typedef struct {
+    PyObject_HEAD
+    GainSolver *Solver;
+} GainSolverObject;
 
 
+static PyObject *GainSolverObject_new(PyTypeObject *type, PyObject *args, PyObject *kwds){
+  GainSolverObject *self = (GainSolverObject *) type->tp_alloc(type, 0);
+  if (self != NULL){self->Solver = new GainSolver();};
+  return (PyObject *) self;
+};
 
 
+static void GainSolverObject_dealloc(GainSolverObject *self){
+  delete self->Solver;
+  Py_TYPE(self)->tp_free((PyObject *) self);
+};
+
+
+#define SOLVER_METHOD(name) \
+static PyObject *GainSolverObject_##name(PyObject *self, PyObject *args){ \
+  GainSolver *solver = ((GainSolverObject *) self)->Solver; \
+  std::unique_lock<std::mutex> lock = solver->lockSolver(); \
+  return solver->name(self, args);};
+
+SOLVER_METHOD(PolGainSolve)
+SOLVER_METHOD(ReadData)
+SOLVER_METHOD(GetChi2)
+SOLVER_METHOD(GetIFs)
+SOLVER_METHOD(DoGFF)
+SOLVER_METHOD(SetFringeRates)
+SOLVER_METHOD(GetNScan)
+SOLVER_METHOD(GetNchan)
+SOLVER_METHOD(FreeData)
+SOLVER_METHOD(SetFit)
+SOLVER_METHOD(CompressData)
+SOLVER_METHOD(FringeMaps)
+
+
+static PyMethodDef GainSolver_methods[] = {
+    {"PolGainSolve", GainSolverObject_PolGainSolve, METH_VARARGS, PolGainSolve_docstring},
+    {"ReadData", GainSolverObject_ReadData, METH_VARARGS, ReadData_docstring},
+    {"GetChi2", GainSolverObject_GetChi2, METH_VARARGS, GetChi2_docstring},
+    {"GetIFs", GainSolverObject_GetIFs, METH_VARARGS, GetIFs_docstring},
+    {"DoGFF", GainSolverObject_DoGFF, METH_VARARGS, DoGFF_docstring},
+    {"SetFringeRates", GainSolverObject_SetFringeRates, METH_VARARGS, SetFringeRates_docstring},
+    {"GetNScan", GainSolverObject_GetNScan, METH_VARARGS, GetNScan_docstring},
+    {"GetNchan", GainSolverObject_GetNchan, METH_VARARGS, GetNchan_docstring},
+    {"FreeData", GainSolverObject_FreeData, METH_VARARGS, FreeData_docstring},
+    {"SetFit", GainSolverObject_SetFit, METH_VARARGS, SetFit_docstring},
+    {"CompressData", GainSolverObject_CompressData, METH_VARARGS, CompressData_docstring},
+    {"FringeMaps", GainSolverObject_FringeMaps, METH_VARARGS, FringeMaps_docstring},
+    {NULL, NULL, 0, NULL}
+};
 
 
+static PyTypeObject GainSolverType = {PyVarObject_HEAD_INIT(NULL, 0)};
+
+
+// Sets up the type and the default solver (returns false on failure):
+static bool initSolvers(PyObject *m){
+
+  GainSolverType.tp_name = "_PolGainSolve.GainSolver";
+  GainSolverType.tp_basicsize = sizeof(GainSolverObject);
+  GainSolverType.tp_flags = Py_TPFLAGS_DEFAULT;
+  GainSolverType.tp_doc = GainSolver_docstring;
+  GainSolverType.tp_new = GainSolverObject_new;
+  GainSolverType.tp_dealloc = (destructor) GainSolverObject_dealloc;
+  GainSolverType.tp_methods = GainSolver_methods;
+  if (PyType_Ready(&GainSolverType) < 0){return false;};
+
+  Py_INCREF(&GainSolverType);
+  PyModule_AddObject(m, "GainSolver", (PyObject *) &GainSolverType);
+
+// Record layout of the POLCONVERT.FRINGE files (e.g., for BENCH/pcbench.py):
+  PyModule_AddIntConstant(m, "FRINGEHEAD", GainSolver::FRINGEHEAD);
+  PyModule_AddIntConstant(m, "FRINGENVIS", GainSolver::FRINGENVIS);
+
+  if (DefaultSolver == nullptr){DefaultSolver = new GainSolver();};
+  return true;
+
+};
+
+
+
+
+
+/* Initialize the module */
+#if PY_MAJOR_VERSION >= 3
+static struct PyModuleDef pc_module_def = {
+    PyModuleDef_HEAD_INIT,
+    "_PolGainSolve",         /* m_name */
+    module_docstring,       /* m_doc */
+    -1,                     /* m_size */
+    module_methods,         /* m_methods */
+    NULL,NULL,NULL,NULL     /* m_reload, m_traverse, m_clear, m_free */
+};
+PyMODINIT_FUNC PyInit__PolGainSolve(void)
+{
+    PyObject *m = PyModule_Create(&pc_module_def);
+    if (m == NULL || !initSolvers(m))
+        return NULL;
+// For the arrays of FringeMaps:
+    import_array();
+  //  (void)gsl_set_error_handler(gsl_death);
+    return(m);
+}
+#else
+PyMODINIT_FUNC init_PolGainSolve(void)
+{
+    PyObject *m = Py_InitModule3("_PolGainSolve", module_methods, module_docstring);import_array();
+  //  (void)gsl_set_error_handler(gsl_death);
+    if (m == NULL || !initSolvers(m))
+        return;
+
+}
+#endif
+
+
+
+// eof
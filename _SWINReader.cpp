@@ -0,0 +1,780 @@
+/* SWINREADER - Fast (memory-mapped) reader of DiFX SWIN files for Python
+
+             Copyright (C) 2013-2022  Ivan Marti-Vidal
+             Nordic Node of EU ALMA Regional Center (Onsala, Sweden)
+             Max-Planck-Institut fuer Radioastronomie (Bonn, Germany)
+             University of Valencia (Spain)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>
+
+*/
+
+
+#include <Python.h>
+// compiler warning that we use a deprecated NumPy API
+// #define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+// #define NO_IMPORT_ARRAY
+#if PY_MAJOR_VERSION >= 3
+#define NPY_NO_DEPRECATED_API 0x0
+#endif
+#include <numpy/npy_common.h>
+#include <numpy/arrayobject.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "SWINFormat.h"
+
+
+// cribbed from SWIG machinery
+#if PY_MAJOR_VERSION >= 3
+#define PyString_AsString(obj) PyUnicode_AsUTF8(obj)
+#endif
+
+
+
+/* Docstrings */
+static char module_docstring[] =
+    "Memory-mapped reader of DiFX SWIN files (headers and spectra, and renumbering of ids).";
+static char ReadHeaders_docstring[] =
+    "Maps a SWIN file and returns (Mapped, Headers): the file as a read-only array and the (filtered) record headers as a structured array";
+static char GetSpectra_docstring[] =
+    "Returns the spectra of the given headers, as views (no copy) of the mapped file";
+static char GetMatrix_docstring[] =
+    "Returns the spectra of the given headers (all with the same NCHAN) as one complex64 array";
+static char Renumber_docstring[] =
+    "Copies a SWIN file with new antenna and source ids (e.g., to concatenate scans)";
+
+/* Available functions */
+static PyObject *ReadHeaders(PyObject *self, PyObject *args);
+static PyObject *GetSpectra(PyObject *self, PyObject *args);
+static PyObject *GetMatrix(PyObject *self, PyObject *args);
+static PyObject *Renumber(PyObject *self, PyObject *args);
+
+
+/* Module specification */
+static PyMethodDef module_methods[] = {
+    {"ReadHeaders", ReadHeaders, METH_VARARGS, ReadHeaders_docstring},
+    {"GetSpectra", GetSpectra, METH_VARARGS, GetSpectra_docstring},
+    {"GetMatrix", GetMatrix, METH_VARARGS, GetMatrix_docstring},
+    {"Renumber", Renumber, METH_VARARGS, Renumber_docstring},
+    {NULL, NULL, 0, NULL}   /* terminated by list of NULLs, apparently */
+};
+
+
+/* Initialize the module */
+
+#if PY_MAJOR_VERSION >= 3
+static struct PyModuleDef pc_module_def = {
+    PyModuleDef_HEAD_INIT,
+    "_SWINReader",          /* m_name */
+    module_docstring,       /* m_doc */
+    -1,                     /* m_size */
+    module_methods,         /* m_methods */
+    NULL,NULL,NULL,NULL     /* m_reload, m_traverse, m_clear, m_free */
+};
+PyMODINIT_FUNC PyInit__SWINReader(void)
+{
+    PyObject *m = PyModule_Create(&pc_module_def);
+    import_array();
+    return(m);
+}
+#else
+
+PyMODINIT_FUNC init_SWINReader(void)
+{
+    PyObject *m = Py_InitModule3("_SWINReader", module_methods, module_docstring);import_array();
+    if (m == NULL)
+        return;
+
+}
+
+#endif
+
+///////////////////////
+
+
+
+// Size of the output blocks of Renumber:
+static const size_t RENUMBUFFER = 32*1024*1024;
+
+
+// One row of the Headers array (see headerType). Offset is the byte
+// offset of the spectrum in the file:
+typedef struct {
+  long long Offset;
+  double Seconds, Weight, UVW[3];
+  int Baseline, Ant1, Ant2, MJD, Config, Source, Freq, Bin, Nchan;
+  char Pol[2];
+} SWINHeader;
+
+
+// The mapped file (freed with the last array that uses it):
+typedef struct {
+  void *Data;
+  size_t Size;
+} SWINMap;
+
+
+
+
+static void freeMap(PyObject *capsule){
+  SWINMap *Map = (SWINMap *) PyCapsule_GetPointer(capsule, "SWINMap");
+  if (Map != NULL){munmap(Map->Data, Map->Size); delete Map;};
+};
+
+
+
+// Numpy type of the Headers (with the layout of SWINHeader):
+static PyArray_Descr *headerType(){
+
+  PyArray_Descr *descr = NULL;
+  PyObject *spec = Py_BuildValue("{s:[ssssssssssssss],s:[ssssssssssssss],s:[nnnnnnnnnnnnnn],s:n}",
+    "names", "OFFSET", "SECONDS", "WEIGHT", "UVW", "BASELINE", "ANT1", "ANT2",
+             "MJD", "CONFIG", "SOURCE", "FREQ", "BIN", "NCHAN", "POL",
+    "formats", "i8", "f8", "f8", "3f8", "i4", "i4", "i4",
+               "i4", "i4", "i4", "i4", "i4", "i4", "S2",
+    "offsets", (Py_ssize_t) offsetof(SWINHeader, Offset), (Py_ssize_t) offsetof(SWINHeader, Seconds),
+               (Py_ssize_t) offsetof(SWINHeader, Weight), (Py_ssize_t) offsetof(SWINHeader, UVW),
+               (Py_ssize_t) offsetof(SWINHeader, Baseline), (Py_ssize_t) offsetof(SWINHeader, Ant1),
+               (Py_ssize_t) offsetof(SWINHeader, Ant2), (Py_ssize_t) offsetof(SWINHeader, MJD),
+               (Py_ssize_t) offsetof(SWINHeader, Config), (Py_ssize_t) offsetof(SWINHeader, Source),
+               (Py_ssize_t) offsetof(SWINHeader, Freq), (Py_ssize_t) offsetof(SWINHeader, Bin),
+               (Py_ssize_t) offsetof(SWINHeader, Nchan), (Py_ssize_t) offsetof(SWINHeader, Pol),
+    "itemsize", (Py_ssize_t) sizeof(SWINHeader));
+
+  if (spec == NULL){return NULL;};
+  if (!PyArray_DescrConverter(spec, &descr)){descr = NULL;};
+  Py_DECREF(spec);
+  return descr;
+
+};
+
+
+
+
+// Reads an optional list of integers (an empty list, or None, selects all):
+static bool readSelection(PyObject *list, std::vector<long> &Sel){
+
+  Py_ssize_t i, n;
+
+  Sel.clear();
+  if (list == NULL || list == Py_None){return true;};
+  if (!PySequence_Check(list)){return false;};
+  n = PySequence_Size(list);
+  for (i=0; i<n; i++){
+    PyObject *item = PySequence_GetItem(list, i);
+    if (item == NULL){return false;};
+    Sel.push_back(PyLong_AsLong(item));
+    Py_DECREF(item);
+  };
+  return !PyErr_Occurred();
+
+};
+
+
+static bool isSelected(std::vector<long> &Sel, long value){
+  size_t i;
+  if (Sel.empty()){return true;};
+  for (i=0; i<Sel.size(); i++){if (Sel[i]==value){return true;};};
+  return false;
+};
+
+
+
+
+/* Reads the header of the record at byte pos of the mapped file (with
+   the decoder of SWINFormat.h, as DataIOSWIN). Nchan is the number of 
+   channels of each frequency index, from the DiFX input file. Callers 
+   that do not read the input file (e.g., Renumber from SWIN_CONCAT) can
+   give <=0 (or no value); it is then found from the distance to the next
+   sync word, and kept in FoundNchan for the other records of that frequency.
+   Returns 1 if a full record was read, 0 if there is no full record
+   left (a truncated record at the end is ignored) and -1 if there is
+   no sync word at pos: */
+static int readRecord(SWINMap &Map, size_t pos, std::vector<int> &Nchan,
+                      std::map<int, int> &FoundNchan, SWINHeader &H){
+
+  const char *data = (const char *) Map.Data;
+  size_t next;
+  unsigned int sync;
+  int nchan;
+  SWINRecordHeader R;
+
+  if (pos + SWINHEADSIZE > Map.Size){return 0;};
+  if (!parseSWINHeader(data + pos, R)){return -1;};
+
+  H.Baseline = R.Baseline; H.MJD = R.MJD; H.Seconds = R.Seconds;
+  H.Config = R.Config; H.Source = R.Source; H.Freq = R.Freq;
+  H.Pol[0] = R.Pol[0]; H.Pol[1] = R.Pol[1]; H.Bin = R.Bin;
+  H.Weight = R.Weight; memcpy(H.UVW, R.UVW, 3*sizeof(double));
+  H.Ant1 = H.Baseline / 256;
+  H.Ant2 = H.Baseline % 256;
+  H.Offset = pos + SWINHEADSIZE;
+
+// Number of channels (from the list, or from the next sync word):
+  nchan = (H.Freq >= 0 && H.Freq < (int) Nchan.size()) ? Nchan[H.Freq] : 0;
+  if (nchan <= 0 && FoundNchan.count(H.Freq) > 0){nchan = FoundNchan[H.Freq];};
+  if (nchan <= 0){
+    for (next = H.Offset; next + sizeof(int) <= Map.Size; next += 8){
+      memcpy(&sync, data + next, sizeof(int));
+      if (sync == SWINSYNC){break;};
+    };
+    nchan = (next - H.Offset)/8;
+    FoundNchan[H.Freq] = nchan;
+  };
+  H.Nchan = nchan;
+
+  if (H.Offset + 8*((size_t) nchan) > Map.Size){return 0;};
+  return 1;
+
+};
+
+
+
+
+/* Scans the records of the mapped file (see readRecord). Pols are the
+   selected products (e.g. "RR", "XL"), as 2-char codes. Returns false
+   (and message) if the file is not a valid SWIN file: */
+static bool scanRecords(SWINMap &Map, std::vector<int> &Nchan, std::vector<long> &Bases,
+                        std::vector<long> &IFs, std::vector<long> &Pols, double *timeRange,
+                        std::vector<SWINHeader> &Headers, char *message){
+
+  size_t pos = 0;
+  int found;
+  SWINHeader H;
+  double mjd;
+  std::map<int, int> FoundNchan;
+
+  Headers.clear();
+  memset(&H, 0, sizeof(SWINHeader));
+
+  while ((found = readRecord(Map, pos, Nchan, FoundNchan, H)) == 1){
+
+    pos = H.Offset + 8*((size_t) H.Nchan);
+
+    mjd = ((double) H.MJD) + H.Seconds/86400.;
+    if (!isSelected(Bases, H.Baseline) || !isSelected(IFs, H.Freq)){continue;};
+    if (!isSelected(Pols, 256*((unsigned char) H.Pol[0]) + (unsigned char) H.Pol[1])){continue;};
+    if (timeRange != NULL && (mjd < timeRange[0] || mjd > timeRange[1])){continue;};
+
+    Headers.push_back(H);
+
+  };
+
+  if (found < 0){
+    sprintf(message,"ERROR: no SWIN sync word at byte %li\n",(long) pos);
+    return false;
+  };
+
+// Not even one full record:
+  if (pos == 0 && Map.Size > 0){
+    sprintf(message,"ERROR: file too short for a SWIN record\n");
+    return false;
+  };
+
+  return true;
+
+};
+
+
+
+
+/* Copies the records of the mapped file to out, with the antennas and
+   sources renumbered with AntMap and SouMap (ids that are not in a map
+   are an error, but an empty map keeps all the ids). The records are
+   gathered in a large buffer, so that the output is written in big
+   sequential blocks. A truncated record at the end is copied as is.
+   If keepHeaders, Headers are those of the new records: */
+static bool renumberRecords(SWINMap &Map, FILE *out, std::vector<int> &Nchan,
+                            std::map<int, int> &AntMap, std::map<int, int> &SouMap,
+                            bool keepHeaders, std::vector<SWINHeader> &Headers,
+                            long &nrec, int &errCode, char *message){
+
+  const char *data = (const char *) Map.Data;
+  std::vector<char> Buffer(std::min(RENUMBUFFER, Map.Size));
+  std::map<int, int> FoundNchan;
+  std::map<int, int>::iterator it1, it2;
+  size_t pos = 0, used = 0, recSize;
+  int found;
+  SWINHeader H;
+
+  Headers.clear();
+  memset(&H, 0, sizeof(SWINHeader));
+  nrec = 0; errCode = 0;
+
+  while ((found = readRecord(Map, pos, Nchan, FoundNchan, H)) == 1){
+
+    recSize = H.Offset + 8*((size_t) H.Nchan) - pos;
+
+    if (!AntMap.empty()){
+      it1 = AntMap.find(H.Ant1);
+      it2 = AntMap.find(H.Ant2);
+      if (it1 == AntMap.end() || it2 == AntMap.end()){
+        sprintf(message,"ERROR: antennas of baseline %i (record %li) are not in the map\n",
+                H.Baseline, nrec);
+        errCode = -3; return false;
+      };
+      H.Ant1 = it1->second; H.Ant2 = it2->second;
+      H.Baseline = 256*H.Ant1 + H.Ant2;
+    };
+    if (!SouMap.empty()){
+      it1 = SouMap.find(H.Source);
+      if (it1 == SouMap.end()){
+        sprintf(message,"ERROR: source %i (record %li) is not in the map\n",H.Source, nrec);
+        errCode = -3; return false;
+      };
+      H.Source = it1->second;
+    };
+
+    if (used + recSize > Buffer.size()){
+      if (used > 0 && fwrite(&Buffer[0], 1, used, out) != used){
+        sprintf(message,"ERROR: cannot write the output\n");
+        errCode = -1; return false;
+      };
+      used = 0;
+      if (recSize > Buffer.size()){Buffer.resize(recSize);};
+    };
+
+    memcpy(&Buffer[used], data + pos, recSize);
+    memcpy(&Buffer[used + SWINBASELINE], &H.Baseline, sizeof(int));
+    memcpy(&Buffer[used + SWINSOURCE], &H.Source, sizeof(int));
+    used += recSize;
+    pos += recSize;
+    nrec += 1;
+
+    if (keepHeaders){Headers.push_back(H);};
+
+  };
+
+  if (found < 0){
+    sprintf(message,"ERROR: no SWIN sync word at byte %li\n",(long) pos);
+    errCode = -2; return false;
+  };
+
+  if (pos == 0 && Map.Size > 0){
+    sprintf(message,"ERROR: file too short for a SWIN record\n");
+    errCode = -2; return false;
+  };
+
+  if (used > 0 && fwrite(&Buffer[0], 1, used, out) != used){
+    sprintf(message,"ERROR: cannot write the output\n");
+    errCode = -1; return false;
+  };
+  if (pos < Map.Size && fwrite(data + pos, 1, Map.Size - pos, out) != Map.Size - pos){
+    sprintf(message,"ERROR: cannot write the output\n");
+    errCode = -1; return false;
+  };
+
+  return true;
+
+};
+
+
+
+
+// Maps a file read-only (NULL if it cannot be mapped):
+static SWINMap *mapFile(const char *fileName){
+
+  struct stat st;
+  int fd;
+  SWINMap *Map;
+
+  fd = open(fileName, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0){
+    if (fd >= 0){close(fd);};
+    return NULL;
+  };
+  Map = new SWINMap;
+  Map->Size = st.st_size;
+  Map->Data = mmap(NULL, Map->Size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (Map->Data == MAP_FAILED){delete Map; return NULL;};
+  madvise(Map->Data, Map->Size, MADV_SEQUENTIAL);
+  return Map;
+
+};
+
+
+
+
+// Structured array with a copy of the Headers:
+static PyObject *headerArray(std::vector<SWINHeader> &Headers){
+
+  PyArray_Descr *descr;
+  PyObject *HeadArr;
+  npy_intp dims[1];
+
+  descr = headerType();
+  if (descr == NULL){return NULL;};
+  dims[0] = Headers.size();
+  HeadArr = PyArray_NewFromDescr(&PyArray_Type, descr, 1, dims, NULL, NULL, 0, NULL);
+  if (HeadArr == NULL){return NULL;};
+  if (!Headers.empty()){
+    memcpy(PyArray_DATA((PyArrayObject *) HeadArr), &Headers[0], Headers.size()*sizeof(SWINHeader));
+  };
+  return HeadArr;
+
+};
+
+
+
+
+// Reads a dictionary of integer ids (None for an empty map):
+static bool readIdMap(PyObject *dict, std::map<int, int> &Ids){
+
+  PyObject *key, *value;
+  Py_ssize_t pos = 0;
+
+  Ids.clear();
+  if (dict == NULL || dict == Py_None){return true;};
+  if (!PyDict_Check(dict)){return false;};
+  while (PyDict_Next(dict, &pos, &key, &value)){
+    Ids[(int) PyLong_AsLong(key)] = (int) PyLong_AsLong(value);
+  };
+  return !PyErr_Occurred();
+
+};
+
+
+
+
+/* ReadHeaders(fileName, nchan, baselines, ifs, pols, timeRange)
+   nchan is the list of channels of each frequency index (an empty list,
+   or zeros, to find them from the file). baselines (DiFX numbers, i.e.
+   256*ant1 + ant2), ifs (frequency indices) and pols (e.g. ["RR","XL"])
+   select the records (an empty list selects all). timeRange is [MJD0,MJD1]
+   (in days, empty for all). Returns -1 if the file cannot be mapped and
+   -2 if it is not a SWIN file: */
+static PyObject *ReadHeaders(PyObject *self, PyObject *args){
+
+  const char *fileName;
+  char message[512];
+  PyObject *nchanObj, *basObj, *ifObj, *polObj, *rangeObj, *item;
+  PyObject *Mapped, *Capsule, *HeadArr;
+  std::vector<long> Nchan, Bases, IFs, Pols;
+  std::vector<int> NchanInt;
+  std::vector<SWINHeader> Headers;
+  double timeRange[2], *useRange = NULL;
+  Py_ssize_t i;
+  npy_intp dims[1];
+  bool isOK;
+  SWINMap *Map;
+
+  if (!PyArg_ParseTuple(args, "sOOOOO", &fileName, &nchanObj, &basObj, &ifObj, &polObj, &rangeObj)){
+    printf("Failed ReadHeaders! Check inputs!\n");
+    return Py_BuildValue("i",-1);
+  };
+
+  if (!readSelection(nchanObj, Nchan) || !readSelection(basObj, Bases)
+      || !readSelection(ifObj, IFs)){
+    PyErr_Clear();
+    printf("Failed ReadHeaders! Check inputs!\n");
+    return Py_BuildValue("i",-1);
+  };
+  for (i=0; i<(Py_ssize_t) Nchan.size(); i++){NchanInt.push_back((int) Nchan[i]);};
+
+// The products are coded as 256*pol1 + pol2:
+  if (polObj != Py_None){
+    for (i=0; i<PySequence_Size(polObj); i++){
+      item = PySequence_GetItem(polObj, i);
+      if (item == NULL){break;};
+      const char *pol = PyString_AsString(item);
+      if (pol != NULL && strlen(pol)==2){
+        Pols.push_back(256*((unsigned char) pol[0]) + (unsigned char) pol[1]);
+      };
+      Py_DECREF(item);
+    };
+    PyErr_Clear();
+  };
+
+  if (rangeObj != Py_None && PySequence_Check(rangeObj) && PySequence_Size(rangeObj)==2){
+    for (i=0; i<2; i++){
+      item = PySequence_GetItem(rangeObj, i);
+      timeRange[i] = PyFloat_AsDouble(item);
+      Py_XDECREF(item);
+    };
+    useRange = timeRange;
+  };
+
+// Map the file:
+  Map = mapFile(fileName);
+  if (Map == NULL){
+    printf("ERROR: cannot map %s\n",fileName);
+    return Py_BuildValue("i",-1);
+  };
+
+// Scan without the GIL:
+  Py_BEGIN_ALLOW_THREADS
+  isOK = scanRecords(*Map, NchanInt, Bases, IFs, Pols, useRange, Headers, message);
+  Py_END_ALLOW_THREADS
+
+  if (!isOK){
+    munmap(Map->Data, Map->Size); delete Map;
+    printf("%s in %s\n",message,fileName);
+    return Py_BuildValue("i",-2);
+  };
+
+// The array of the mapped file owns the mapping (through the capsule):
+  dims[0] = Map->Size;
+  Mapped = PyArray_SimpleNewFromData(1, dims, NPY_UINT8, Map->Data);
+  Capsule = PyCapsule_New(Map, "SWINMap", freeMap);
+  if (Mapped == NULL || Capsule == NULL){
+    Py_XDECREF(Mapped);
+    if (Capsule == NULL){munmap(Map->Data, Map->Size); delete Map;} else {Py_DECREF(Capsule);};
+    return NULL;
+  };
+  PyArray_SetBaseObject((PyArrayObject *) Mapped, Capsule);
+  PyArray_CLEARFLAGS((PyArrayObject *) Mapped, NPY_ARRAY_WRITEABLE);
+
+  HeadArr = headerArray(Headers);
+  if (HeadArr == NULL){Py_DECREF(Mapped); return NULL;};
+
+  return Py_BuildValue("NN", Mapped, HeadArr);
+
+};
+
+
+
+
+// Parses the (Mapped, Headers) arguments of GetSpectra and GetMatrix. 
+// The spectra are found by their byte offsets, so Mapped must be the 
+// (C-contiguous) array of ReadHeaders, not a slice of it. Also checks 
+// that all the spectra are in the file:
+static bool spectraArgs(PyObject *args, const char *name, PyObject *&Mapped,
+                        PyArrayObject *&HeadArr){
+
+  PyObject *HeadObj;
+  PyArray_Descr *descr;
+  SWINHeader *H;
+  npy_intp i, size;
+  bool isHeader;
+
+  if (!PyArg_ParseTuple(args, "OO", &Mapped, &HeadObj) || !PyArray_Check(Mapped)
+      || !PyArray_Check(HeadObj) || PyArray_TYPE((PyArrayObject *) Mapped) != NPY_UINT8
+      || !PyArray_IS_C_CONTIGUOUS((PyArrayObject *) Mapped)
+      || PyArray_NDIM((PyArrayObject *) HeadObj) != 1){
+    PyErr_Clear();
+    printf("Failed %s! Check inputs (Mapped must be the array of ReadHeaders)!\n",name);
+    return false;
+  };
+
+  HeadArr = (PyArrayObject *) HeadObj;
+  descr = headerType();
+  if (descr == NULL){PyErr_Clear(); return false;};
+  isHeader = PyArray_EquivTypes(PyArray_DESCR(HeadArr), descr);
+  Py_DECREF(descr);
+  if (!isHeader){
+    printf("Failed %s! Headers must come from ReadHeaders\n",name);
+    return false;
+  };
+
+  size = PyArray_SIZE((PyArrayObject *) Mapped);
+  for (i=0; i<PyArray_DIM(HeadArr, 0); i++){
+    H = (SWINHeader *) PyArray_GETPTR1(HeadArr, i);
+    if (H->Offset < 0 || H->Nchan < 0 || H->Offset + 8*((npy_intp) H->Nchan) > size){
+      printf("Failed %s! Record %li is out of the file\n",name,(long) i);
+      return false;
+    };
+  };
+
+  return true;
+
+};
+
+
+
+
+/* GetSpectra(Mapped, Headers)
+   Returns a list with the spectrum (complex64 array of NCHAN channels)
+   of each row of Headers (as returned by ReadHeaders, or a selection of
+   them). The spectra are read-only views of Mapped (so they keep the
+   file mapped). Returns -1 if the inputs are not valid: */
+static PyObject *GetSpectra(PyObject *self, PyObject *args){
+
+  PyObject *Mapped, *Spectra, *View;
+  PyArrayObject *HeadArr;
+  SWINHeader *H;
+  npy_intp i, n, dims[1];
+  char *data;
+
+  if (!spectraArgs(args, "GetSpectra", Mapped, HeadArr)){
+    return Py_BuildValue("i",-1);
+  };
+
+  data = (char *) PyArray_DATA((PyArrayObject *) Mapped);
+  n = PyArray_DIM(HeadArr, 0);
+  Spectra = PyList_New(n);
+  if (Spectra == NULL){return NULL;};
+
+  for (i=0; i<n; i++){
+    H = (SWINHeader *) PyArray_GETPTR1(HeadArr, i);
+    dims[0] = H->Nchan;
+    View = PyArray_New(&PyArray_Type, 1, dims, NPY_COMPLEX64, NULL,
+                       data + H->Offset, 0, 0, NULL);
+    if (View == NULL){Py_DECREF(Spectra); return NULL;};
+    Py_INCREF(Mapped);
+    PyArray_SetBaseObject((PyArrayObject *) View, Mapped);
+    PyList_SET_ITEM(Spectra, i, View);
+  };
+
+  return Spectra;
+
+};
+
+
+
+
+/* GetMatrix(Mapped, Headers)
+   As GetSpectra, but returns the spectra as one complex64 array, with 
+   a row per header (e.g., the visibilities of one IF). It is a copy of 
+   the data, so all the headers must have the same NCHAN. Returns -1 if 
+   the inputs are not valid: */
+static PyObject *GetMatrix(PyObject *self, PyObject *args){
+
+  PyObject *Mapped, *Matrix;
+  PyArrayObject *HeadArr;
+  SWINHeader *H;
+  npy_intp i, n, dims[2];
+  char *data, *out;
+  size_t rowSize;
+
+  if (!spectraArgs(args, "GetMatrix", Mapped, HeadArr)){
+    return Py_BuildValue("i",-1);
+  };
+
+  n = PyArray_DIM(HeadArr, 0);
+  dims[0] = n; dims[1] = 0;
+  if (n > 0){dims[1] = ((SWINHeader *) PyArray_GETPTR1(HeadArr, 0))->Nchan;};
+  for (i=0; i<n; i++){
+    if (((SWINHeader *) PyArray_GETPTR1(HeadArr, i))->Nchan != dims[1]){
+      printf("Failed GetMatrix! The records have different numbers of channels\n");
+      return Py_BuildValue("i",-1);
+    };
+  };
+
+  Matrix = PyArray_SimpleNew(2, dims, NPY_COMPLEX64);
+  if (Matrix == NULL){return NULL;};
+
+  data = (char *) PyArray_DATA((PyArrayObject *) Mapped);
+  out = (char *) PyArray_DATA((PyArrayObject *) Matrix);
+  rowSize = 8*((size_t) dims[1]);
+  for (i=0; i<n; i++){
+    H = (SWINHeader *) PyArray_GETPTR1(HeadArr, i);
+    memcpy(out + i*rowSize, data + H->Offset, rowSize);
+  };
+
+  return Matrix;
+
+};
+
+
+
+
+/* Renumber(inFile, outFile, nchan, antennas, sources, getHeaders)
+   Copies inFile to outFile (which must be a different file), changing the
+   antenna and source ids of all the records. antennas and sources are
+   dictionaries {old id: new id} (antennas are the 1-based DiFX numbers,
+   as in the baselines); an empty dictionary (or None) keeps the ids. nchan
+   is as in ReadHeaders. Returns the number of records or, if getHeaders,
+   (number of records, Headers of outFile). Returns -1 if the files cannot
+   be used, -2 if inFile is not a SWIN file and -3 if an id is not in the
+   dictionaries (outFile is then removed): */
+static PyObject *Renumber(PyObject *self, PyObject *args){
+
+  const char *inFile, *outFile;
+  char message[512];
+  PyObject *nchanObj, *antObj, *souObj, *HeadArr;
+  std::vector<long> Nchan;
+  std::vector<int> NchanInt;
+  std::map<int, int> AntMap, SouMap;
+  std::vector<SWINHeader> Headers;
+  struct stat stIn, stOut;
+  int getHeaders, errCode;
+  long nrec;
+  size_t i;
+  bool isOK;
+  SWINMap *Map;
+  FILE *out;
+
+  if (!PyArg_ParseTuple(args, "ssOOOi", &inFile, &outFile, &nchanObj, &antObj, &souObj, &getHeaders)
+      || !readSelection(nchanObj, Nchan) || !readIdMap(antObj, AntMap) || !readIdMap(souObj, SouMap)){
+    PyErr_Clear();
+    printf("Failed Renumber! Check inputs!\n");
+    return Py_BuildValue("i",-1);
+  };
+  for (i=0; i<Nchan.size(); i++){NchanInt.push_back((int) Nchan[i]);};
+
+// The new baselines must fit in the 256*ant1 + ant2 coding:
+  for (std::map<int, int>::iterator it = AntMap.begin(); it != AntMap.end(); it++){
+    if (it->second < 0 || it->second > 255){
+      printf("Failed Renumber! Bad antenna id %i\n",it->second);
+      return Py_BuildValue("i",-1);
+    };
+  };
+
+  if (stat(inFile, &stIn) == 0 && stat(outFile, &stOut) == 0
+      && stIn.st_dev == stOut.st_dev && stIn.st_ino == stOut.st_ino){
+    printf("ERROR: %s cannot be renumbered in place\n",inFile);
+    return Py_BuildValue("i",-1);
+  };
+
+  Map = mapFile(inFile);
+  if (Map == NULL){
+    printf("ERROR: cannot map %s\n",inFile);
+    return Py_BuildValue("i",-1);
+  };
+
+  out = fopen(outFile, "wb");
+  if (out == NULL){
+    munmap(Map->Data, Map->Size); delete Map;
+    printf("ERROR: cannot create %s\n",outFile);
+    return Py_BuildValue("i",-1);
+  };
+  setvbuf(out, NULL, _IONBF, 0);  // The records are written in big blocks.
+
+  Py_BEGIN_ALLOW_THREADS
+  isOK = renumberRecords(*Map, out, NchanInt, AntMap, SouMap, getHeaders != 0,
+                         Headers, nrec, errCode, message);
+  isOK = (fclose(out) == 0) && isOK;
+  Py_END_ALLOW_THREADS
+
+  munmap(Map->Data, Map->Size); delete Map;
+
+  if (!isOK){
+    if (errCode == 0){errCode = -1; sprintf(message,"ERROR: cannot write the output\n");};
+    remove(outFile);
+    printf("%s in %s\n",message,inFile);
+    return Py_BuildValue("i",errCode);
+  };
+
+  if (!getHeaders){return Py_BuildValue("l",nrec);};
+
+  HeadArr = headerArray(Headers);
+  if (HeadArr == NULL){return NULL;};
+  return Py_BuildValue("lN", nrec, HeadArr);
+
+};
+
+
+// eof
@@ -47,6 +47,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include <complex>
 #include <sstream> 
 #include <iomanip>
+#include <vector>
+#include "./PcalReader.h"
 
 #define EPSILON 0.00001
 
@@ -167,22 +169,26 @@ static PyObject *XPCal(PyObject *self, PyObject *args)
   
 // OPEN PHASECAL FILE:
   std::string PcalFile = PyString_AsString(pFName);
-  std::ifstream PcalF;
-  PcalF.open(PcalFile.c_str(), std::ios::in);
+
+// Read and fit the phasecals without the GIL:
+  PyThreadState *pyState = PyEval_SaveThread();
+
+  PcalReader Pcal(PcalFile);
+  if (!Pcal.isOpen()){PyEval_RestoreThread(pyState); printf("ERROR! Could not open %s\n",PcalFile.c_str()); fflush(stdout); return ret;};
 
 
   
-  double T, inT, Tini, Tbuf; 
+  double T=0.0, Tini, Tbuf; 
   double Re=0.0, Im=0.0, nui=0.0;
   double NEntry, *NWrap;
   NWrap = nullptr;
 
   int Aux = 0; int Aux2 = 0;
-  int auxNTone, NTone, NToneHf=0, TPI, i,j,l;
+  int auxNTone, NTone=0, NToneHf=0, TPI, i,j,l;
   long k;
   char Pol;
-  std::string TelName, line, auxStr;
-  std::istringstream tempStr, auxTempStr;
+  PcalSegment Current;
+  std::vector<PcalSegment> FirstInt; // Lines of the first integration time
 
   cplx64d *PCalsX=nullptr, *PCalsY=nullptr, PCalTemp, *PCalsD=nullptr; 
   double *PCalsAX=nullptr, *PCalsAY= nullptr; 
@@ -205,11 +211,7 @@ static PyObject *XPCal(PyObject *self, PyObject *args)
 // Read line by line. The frequencies of all tones will be read from the first line 
 // (i.e., when start = false).  
 
-  while (!PcalF.eof()){
-    std::getline(PcalF,line);
-    if (line.length() > 10 && line[0] != '#'){  // good line
-       tempStr.str(line);
-       tempStr.clear();
+  while (Pcal.nextLine()){  // good line
        if(start == 2){
        	 // After this line, 'Aux' is the number of tones with
        	 // successful detections.
@@ -221,22 +223,17 @@ static PyObject *XPCal(PyObject *self, PyObject *args)
        
          // Now, we read the phase values:
 
-         tempStr >> TelName;
-         tempStr >> Tbuf;
-         tempStr >> inT;
-         tempStr >> Aux2;
-         tempStr >> NTone;
-         tempStr >> TPI;
+         PcalHeader Head = Pcal.readHeader();
+         Tbuf = Head.T; Aux2 = Head.I1; NTone = Head.I2; TPI = Head.I3;
        
          i=0; j=0;
-         while(std::getline(tempStr,auxStr,' ')){
-           if (auxStr.length() > 0){
+         while(Pcal.nextToken()){
              switch(i){
 
 	       // Remember the format: 'FREQ POL RE IM':
 	       // (i.e., case 0, 1, 2, 3).
 
-               case 0: nui = atof(auxStr.c_str());
+               case 0: nui = Pcal.value();
                  RepNu = false; // Is this tone NEW (i.e., not found in the previous times??)
                  if (nui<0.0){j=-1;} else {
 	  	 for(j=0;j<Aux;j++){
@@ -249,11 +246,11 @@ static PyObject *XPCal(PyObject *self, PyObject *args)
                  if (!RepNu && nui >0.0){PCalNus[Aux]=nui; j=Aux; Aux+=1; printf("NEW %.3f, %.3f\n, aux es %i",nui,nui,Aux);}; 
                  i+= 1; break;
 
-               case 1: Pol = auxStr.c_str()[0]; i += 1; break;
+               case 1: Pol = Pcal.first(); i += 1; break;
 
-               case 2: Re = atof(auxStr.c_str()); i += 1; break;
+               case 2: Re = Pcal.value(); i += 1; break;
 
-               case 3: Im = atof(auxStr.c_str()); i=0; k+=1;
+               case 3: Im = Pcal.value(); i=0; k+=1;
                 if(j>=0){
                  if (Pol == 'X' || Pol == 'R'){PCalsX[j] = cplx64d(Re,Im); goodX[j]=true;}; 
                  if (Pol == 'Y' || Pol == 'L'){PCalsY[j] = cplx64d(Re,Im); goodY[j]=true;};  
@@ -261,7 +258,6 @@ static PyObject *XPCal(PyObject *self, PyObject *args)
                  break;
 		
              };
-           };
          };
        		
 	// Time in seconds, referred to the first integration: 
@@ -351,15 +347,11 @@ static PyObject *XPCal(PyObject *self, PyObject *args)
 	 };
 	}else if(start == 1){
         // Check if we are still in the same integration time (multi-file case)
-	 tempStr >> TelName;
-         tempStr >> Tbuf;
-         tempStr >> inT;
-         tempStr >> Aux;
-         tempStr >> auxNTone;
-         tempStr >> TPI; // Tone per IF
+	 PcalHeader Head = Pcal.readHeader();
+	 Tbuf = Head.T; Aux = Head.I1; auxNTone = Head.I2;
+	 TPI = Head.I3; // Tone per IF
 	 if (areSame(Tbuf, T)){
-		std::getline(tempStr,auxStr);
-		auxTempStr.str(auxTempStr.str()+' '+auxStr);
+		FirstInt.push_back(Pcal.rest());
 		NTone += auxNTone;
 	 }else{
 	 	//printf("T is %.7f and Tbuf is %.7f\n",T,Tbuf);
@@ -442,81 +434,33 @@ static PyObject *XPCal(PyObject *self, PyObject *args)
 		 // we are only interested in FREQ:
 
 		 // First the initial integration time
-		 auxTempStr >> TelName;
-         	 auxTempStr >> T;
-         	 auxTempStr >> inT;
-        	 auxTempStr >> Aux;
-        	 auxTempStr >> auxNTone;
-	         auxTempStr >> TPI; // Tone per IF
+		 Current = Pcal.rest();
+		 Pcal.setSegment(FirstInt[0]);
+		 Head = Pcal.readHeader();
+		 T = Head.T; Aux = Head.I1; auxNTone = Head.I2;
+		 TPI = Head.I3; // Tone per IF
         	 j = 0; i = 0; Aux = 0;
 		 
-	// 	 std::cout << auxTempStr.str() << '\n';
-		 while(std::getline(auxTempStr,auxStr,' ')){
-		   if (auxStr.length() > 0){
-		     switch(i){
-		       case 0: nui = atof(auxStr.c_str()); i+= 1;
-			 RepNu = false; // Is this frequency repeated???
+		 for (l=0; l<(int) FirstInt.size(); l++){
+		   if (l>0){Pcal.setSegment(FirstInt[l]);};
+		   while(Pcal.nextToken()){
+			     switch(i){
+			       case 0: nui = Pcal.value(); i+= 1;
+				 RepNu = false; // Is this frequency repeated???
                          for (j=0;j<Aux;j++){
                            if (PCalNus[j]==nui){RepNu=true;break;};
                          }; // Add to the list if it is not repeated:
                          if(!RepNu && nui>0.0){PCalNus[Aux]=nui;Aux+=1;};
                          break;
-		       case 1: i+= 1; break;
+			       case 1: i+= 1; break;
                        case 2: i+= 1; break;
                        case 3: i=0; break;
                      };
                    };
                  };
-		auxTempStr.clear();
 
-		// Now, we read the phase values:
+		// Only the tone frequencies are taken from the first integration time.
 		// Aux must keep total number of tones
-
-         	auxTempStr >> TelName;
-         	auxTempStr >> T;
-         	auxTempStr >> inT;
-         	auxTempStr >> Aux2;
-         	auxTempStr >> NTone;
-         	auxTempStr >> TPI;
-
-  		// Time in seconds, referred to the first integration:
-       		T -= Tini; T *= 86400. ; 
-
-         	i=0; j=0;
-         	while(std::getline(auxTempStr,auxStr,' ')){
-           		if (auxStr.length() > 0){
-             			switch(i){
-
-              			 // Remember the format: 'FREQ POL RE IM':
-               			// (i.e., case 0, 1, 2, 3).
-
-               				case 0: nui = atof(auxStr.c_str());
-                 				RepNu = false; // Is this tone NEW (i.e., not found in the previous times??)
-                 				if (nui<0.0){j=-1;} else {
-                 					for(j=0;j<Aux;j++){
-                     						if(nui==PCalNus[j]){
-                       							RepNu = true;
-                       							break;
-                     						};
-                   					};
-                 				}; // In case of a new tone, add it to the data (and update 'Aux'):
-                 				if (!RepNu && nui >0.0){PCalNus[Aux]=nui; j=Aux; Aux+=1; printf("NEW %.3f\n",nui);};
-                 				i+= 1; break;
-
-               				case 1: Pol = auxStr.c_str()[0]; i += 1; break;
-
-               				case 2: Re = atof(auxStr.c_str()); i += 1; break;
-
-               				case 3: Im = atof(auxStr.c_str()); i=0; k+=1;
-                				if(j>=0){
-                 					if (Pol == 'X' || Pol == 'R'){PCalsX[j] = cplx64d(Re,Im); goodX[j]=true;};
-                 					if (Pol == 'Y' || Pol == 'L'){PCalsY[j] = cplx64d(Re,Im); goodY[j]=true;};
-                				};
-                 				break;
-
-             			};
-           		};
-         	};
 	    	NEntry += 1.0;   
 
 		// Now, partial second integration time already read
@@ -524,14 +468,14 @@ static PyObject *XPCal(PyObject *self, PyObject *args)
 		// Time in seconds, referred to the first integration:
                 T -= Tini; T *= 86400. ;
 		i=0; j=0; 
-                while(std::getline(tempStr,auxStr,' ')){
-                        if (auxStr.length() > 0){
+		Pcal.setSegment(Current);
+                while(Pcal.nextToken()){
                                 switch(i){
 
                                  // Remember the format: 'FREQ POL RE IM':
                                 // (i.e., case 0, 1, 2, 3).
 
-                                        case 0: nui = atof(auxStr.c_str());
+                                        case 0: nui = Pcal.value();
                                                 Pol = 'R';
                                                 RepNu = false; // Is this tone NEW (i.e., not found in the previous times??)
                                                 if (nui<0.0){j=-1;} else {
@@ -545,11 +489,11 @@ static PyObject *XPCal(PyObject *self, PyObject *args)
                                                 if (!RepNu && nui >0.0){PCalNus[Aux]=nui; j=Aux; Aux+=1; printf("NEW %.3f\n",nui);};
                                                 i+= 1; break;
 
-                                        case 1: Pol = auxStr.c_str()[0]; i += 1; break;
+                                        case 1: Pol = Pcal.first(); i += 1; break;
 
-                                        case 2: Re = atof(auxStr.c_str()); i += 1; break;
+                                        case 2: Re = Pcal.value(); i += 1; break;
 
-                                        case 3: Im = atof(auxStr.c_str()); i=0; k+=1;
+                                        case 3: Im = Pcal.value(); i=0; k+=1;
                                                 if(j>=0){
                                                         if (Pol == 'X' || Pol == 'R'){PCalsX[j] = cplx64d(Re,Im); goodX[j]=true;};
                                                         if (Pol == 'Y' || Pol == 'L'){PCalsY[j] = cplx64d(Re,Im); goodY[j]=true;};
@@ -557,27 +501,20 @@ static PyObject *XPCal(PyObject *self, PyObject *args)
                                                 break;
 
                                 };
-                        };
                 };
 
-         auxTempStr.clear();
-         tempStr.clear();
 	};
 	}else{
 	// Case for first data line in file
 	// First elements in line:       
-         tempStr >> TelName;
-         tempStr >> T;
-         tempStr >> inT;
-         tempStr >> Aux;
-         tempStr >> NTone;
-         tempStr >> TPI; // Tone per IF
+	 FirstInt.push_back(Pcal.rest());
+         PcalHeader Head = Pcal.readHeader();
+         T = Head.T; Aux = Head.I1; NTone = Head.I2;
+         TPI = Head.I3; // Tone per IF
          Tini = T;
-	 auxTempStr.str(tempStr.str());
          start = 1;
 	 printf("\n");
     	};
-  };
 };
 
 
@@ -744,6 +681,8 @@ for(j=0;j<Aux;j++){
   delete[] goodY;
   delete[] NWrap;
 
+  PyEval_RestoreThread(pyState);
+
 
   // Arrange data for output to Python:
   long dims[1];
@@ -47,6 +47,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>
 #include <complex>
 #include <sstream> 
 #include <iomanip>
+#include "./PcalReader.h"
 
 #define EPSILON 0.00001
 
@@ -207,7 +208,8 @@ static PyObject *XPCalMF(PyObject *self, PyObject *args)
 // OPEN PHASECAL FILE:
   std::string PcalFile = PyString_AsString(pFName);
   std::ifstream PcalF;
-  PcalF.open(PcalFile.c_str(), std::ios::in);
+  PcalReader *Pcal = new PcalReader(PcalFile);
+  if (!Pcal->isOpen()){printf("ERROR! Could not open %s\n",PcalFile.c_str()); fflush(stdout); delete Pcal; return ret;};
   
 
 
@@ -231,11 +233,12 @@ static PyObject *XPCalMF(PyObject *self, PyObject *args)
     IFend[i] = (int)PyFloat_AsDouble( PyList_GetItem(PyList_GetItem(pZero,i),1) );
   };
 
+// Read and fit the phasecals without the GIL:
+  PyThreadState *pyState = PyEval_SaveThread();
+
 
 
   char Pol;
-  std::string TelName, line, auxStr;
-  std::istringstream tempStr, auxTempStr;
 
   cplx64d **PCalsX= new cplx64d*[BUFF];
   cplx64d **PCalsY= new cplx64d*[BUFF]; 
@@ -257,28 +260,19 @@ static PyObject *XPCalMF(PyObject *self, PyObject *args)
 
 // Read line by line. Update frequency list on the fly:
 
-  while (!PcalF.eof()){
-    std::getline(PcalF,line);
-    if (line.length() > 10 && line[0] != '#'){  // good line
-       tempStr.str(line);
-       tempStr.clear();
+  while (Pcal->nextLine()){  // good line
 
-         tempStr >> TelName;
-         tempStr >> Tbuf;
-         tempStr >> inT;
-         tempStr >> Aux;
-         tempStr >> Aux2;
-         tempStr >> Aux3;
+         PcalHeader Head = Pcal->readHeader();
+         Tbuf = Head.T; inT = Head.inT; Aux = Head.I1; Aux2 = Head.I2; Aux3 = Head.I3;
 
          i=0; j=0; l=0; Pol = 'R';
        
-         while(std::getline(tempStr,auxStr,' ')){
-           if (auxStr.length() > 0){
+         while(Pcal->nextToken()){
              switch(i){
 
 	       // Remember the format: 'FREQ POL RE IM':
 	       // (i.e., case 0, 1, 2, 3).
-               case 0: nui = atof(auxStr.c_str());
+               case 0: nui = Pcal->value();
 
                  j=0; l=-1;
 
@@ -296,7 +290,7 @@ static PyObject *XPCalMF(PyObject *self, PyObject *args)
                 // In case of a new tone, add it to the data:
                  if (!RepNu && nui >0.0){
 
-                  // printf(" NEW TONE at %s (%i): %.3f MHz.\n",TelName.c_str(),NTone,nui);
+                  // printf(" NEW TONE (%i): %.3f MHz.\n",NTone,nui);
 
                    if(NTone+1>BUFF*NuOver){
                     // printf("Resizing Tones\n");fflush(stdout);
@@ -357,9 +351,9 @@ static PyObject *XPCalMF(PyObject *self, PyObject *args)
 
              i+= 1; break;
 
-             case 1: Pol = auxStr.c_str()[0]; i += 1; break;
-             case 2: Re = atof(auxStr.c_str()); i += 1; break;
-             case 3: Im = atof(auxStr.c_str()); i=0;
+             case 1: Pol = Pcal->first(); i += 1; break;
+             case 2: Re = Pcal->value(); i += 1; break;
+             case 3: Im = Pcal->value(); i=0;
                if(j>=0 && l >=0){
                  if (Pol == 'X' || Pol == 'R'){PCalsX[j][l] = cplx64d(Re,Im); goodX[j][l]=true;}; 
                  if (Pol == 'Y' || Pol == 'L'){PCalsY[j][l] = cplx64d(Re,Im); goodY[j][l]=true;};  
@@ -367,15 +361,13 @@ static PyObject *XPCalMF(PyObject *self, PyObject *args)
                break;
 		
              };
-           };
          };
        	
-    };
   };
 
 
 
-  PcalF.close();
+  delete Pcal;
 
  // printf("NTONE: %i\n",NTone);fflush(stdout);
 
@@ -584,6 +576,7 @@ static PyObject *XPCalMF(PyObject *self, PyObject *args)
 
   if(overWrite!=0){
     //printf("Overwrite\n");fflush(stdout);
+    PyEval_RestoreThread(pyState);
     ret = Py_BuildValue("i",0);
     return ret;
 
@@ -780,6 +773,7 @@ static PyObject *XPCalMF(PyObject *self, PyObject *args)
 
   //printf("Xcross %i\n",NTone);fflush(stdout);
   
+  PyEval_RestoreThread(pyState);
   ret = Py_BuildValue("s",outname.c_str());
   return ret;
 
@@ -116,6 +116,62 @@ import sys
 import pickle as pk
 
 
+def fringeMaps(frName, ant1, ant2):
+    """Delay-rate fringes of baseline ant1-ant2 in a POLCONVERT.FRINGE file,
+    for the first SWIN file where the baseline is found. Returns None if
+    there are no data, or (fileNum, nRecords, Maps, Kmat, MixPeak, CalPeak,
+    MixMax, SNR), as FringeMaps of _PolGainSolve (which only reads the
+    records of the baseline). Falls back to numpy if the library is not
+    available."""
+
+    try:
+        import _PolGainSolve as PS
+
+        FM = PS.FringeMaps(frName, ant1, ant2)
+        return FM if isinstance(FM, tuple) else None
+    except (ImportError, AttributeError):
+        pass
+
+    frfile = open(frName, "rb")
+    nchPlot, isParang = stk.unpack("ib", frfile.read(5))
+    dtype = np.dtype(
+        [
+            ("FILE", np.int32),
+            ("JDT", np.float64),
+            ("ANT1", np.int32),
+            ("ANT2", np.int32),
+            ("PANG1", np.float64),
+            ("PANG2", np.float64),
+            ("UVDIST", np.float64),
+            ("MATRICES", np.complex64, 12 * nchPlot),
+        ]
+    )
+    fringe = np.fromfile(frfile, dtype=dtype)
+    frfile.close()
+
+    AntennasIn = np.logical_or(
+        np.logical_and(fringe["ANT1"] == ant1, fringe["ANT2"] == ant2),
+        np.logical_and(fringe["ANT2"] == ant1, fringe["ANT1"] == ant2),
+    )
+    if np.sum(AntennasIn) == 0:
+        return None
+
+    NBF = np.min(fringe["FILE"][AntennasIn])
+    MATRICES = fringe[np.logical_and(AntennasIn, fringe["FILE"] == NBF)]["MATRICES"]
+    FFTs = [np.fft.fftshift(np.fft.fft2(MATRICES[:, i::12])) for i in range(8)]
+    Maps = np.abs(np.array(FFTs))
+    Kmat = np.array([MATRICES[:, i::12] for i in range(8, 12)])
+
+    RMAXu = np.unravel_index(np.argmax(Maps[0] + Maps[1] + Maps[2] + Maps[3]), np.shape(Maps[0]))
+    RMAX = np.unravel_index(np.argmax(Maps[4] + Maps[7]), np.shape(Maps[0]))
+    MixPeak = [FFTs[i][RMAXu] for i in range(4)]
+    CalPeak = [FFTs[i][RMAX] for i in range(4, 8)]
+    MixMax = [np.max(Maps[i]) for i in range(4)]
+    SNR = [np.max(M) / np.std(np.sort(M.flatten())[:-nchPlot]) for M in Maps]
+
+    return (NBF, len(fringe), Maps, Kmat, MixPeak, CalPeak, MixMax, SNR)
+
+
 def polconvert(
     IDI="",
     OUTPUTIDI="",
@@ -876,14 +932,16 @@ def polconvert(
 
     #######
     # WARNING! UNCOMMENT THIS IF NOT DEBUGGING!
+    # The copies keep the timestamps of IDI, so that the header indices
+    # of previous runs (in POLCONVERT.INDEX) remain valid:
     if os.path.exists(OUTPUTIDI) and IDI != OUTPUTIDI:
         printMsg("Will REMOVE the existing OUTPUT file (or directory)!\n")
         printMsg("Copying IDI to OUTPUTIDI!\n")
         os.system("rm -rf %s" % OUTPUTIDI)
-        os.system("cp -r %s %s" % (IDI, OUTPUTIDI))
+        os.system("cp -rp %s %s" % (IDI, OUTPUTIDI))
     elif not os.path.exists(OUTPUTIDI):
         printMsg("Copying IDI to OUTPUTIDI!\n")
-        os.system("cp -r %s %s" % (IDI, OUTPUTIDI))
+        os.system("cp -rp %s %s" % (IDI, OUTPUTIDI))
     #
     #######
 
@@ -2169,36 +2227,9 @@ def polconvert(
             print("\n\n")
             printMsg("Plotting selected fringe for IF #%i" % pli)
 
-            frfile = open("POLCONVERT.FRINGE/POLCONVERT.FRINGE_IF%i" % pli, "rb")
-
-            alldats = frfile.read(5)
-            nchPlot, isParang = stk.unpack("ib", alldats)
-            dtype = np.dtype(
-                [
-                    ("FILE", np.int32),
-                    ("JDT", np.float64),
-                    ("ANT1", np.int32),
-                    ("ANT2", np.int32),
-                    ("PANG1", np.float64),
-                    ("PANG2", np.float64),
-                    ("UVDIST", np.float64),
-                    ("MATRICES", np.complex64, 12 * nchPlot),
-                ]
-            )
-
-            # There is a silly bug in Python 2.7, which generates
-            # an "integer is required" error in the first try to read:
-            try:
-                fringe = np.fromfile(frfile, dtype=dtype)
-                printMsg("Read fringe data from file POLCONVERT.FRINGE_IF%i" % pli)
-            except:
-                fringe = np.fromfile(frfile, dtype=dtype)
-                printMsg("Exceptional Read of fringe data POLCONVERT.FRINGE_IF%i" % pli)
-                printMsg("len(fringe) = %d" % len(fringe))
-            frfile.close()
+            frName = "POLCONVERT.FRINGE/POLCONVERT.FRINGE_IF%i" % pli
 
             # start of for ant1 in linAntIdx
-            NBinFringes = np.max(fringe["FILE"]) + 1
             for ant1 in linAntIdxTrue:
                 if pli == GoodIFs[0]:
                     MixedCalib[ant1] = {}
@@ -2209,47 +2240,23 @@ def polconvert(
                 # start of fringe loop on ant1-ant2 baseline
                 for ant2 in [plotAnt]:
 
-                    AntEntry1 = np.logical_and(
-                        fringe[:]["ANT1"] == ant1, fringe[:]["ANT2"] == ant2
-                    )
-                    AntEntry2 = np.logical_and(
-                        fringe[:]["ANT2"] == ant1, fringe[:]["ANT1"] == ant2
-                    )
-                    AntennasIn = np.logical_or(AntEntry1, AntEntry2)
-                    for NBF in range(NBinFringes):
-                        AntEntry = np.logical_and(
-                            fringe[:]["FILE"] == NBF,
-                            np.logical_or(AntEntry1, AntEntry2),
-                        )
-                        if np.sum(AntEntry) > 0:
-                            break
-                    printMsg("np.sum(AntEntry) > 0: '" + str(np.sum(AntEntry)) + "'")
+                    # Fringes of the baseline, for the first SWIN file where it is found:
+                    FM = fringeMaps(frName, ant1, ant2)
 
-                    # start of np.sum(AntEntry)
-                    if np.sum(AntEntry) > 0:
+                    # start of FM
+                    if FM is not None:
                         printMsg("Something to plot, apparently")
+                        NBF, nFringe, Maps, Kmat, MixPeak, CalPeak, MAXmix, DynRange = FM
 
                         if pli == GoodIFs[0]:
                             MixedCalib[ant1][ant2] = []
 
                         # This is to store all fringes with linear-feeds involved:
 
-                        if nchPlot > 0 and len(fringe) > 0:
-
-                            uncal = [
-                                (fringe[AntEntry]["MATRICES"])[:, i::12]
-                                for i in range(4)
-                            ]
-                            cal = [
-                                (fringe[AntEntry]["MATRICES"])[:, i::12]
-                                for i in range(4, 8)
-                            ]
-                            Kmat = [
-                                (fringe[AntEntry]["MATRICES"])[:, i::12]
-                                for i in range(8, 12)
-                            ]
+                        nchPlot = np.shape(Maps)[2]
+                        if nchPlot > 0 and nFringe > 0:
 
-                            rchan = np.shape(uncal[0])[0]
+                            rchan = np.shape(Maps)[1]
 
                             # Zoom for the image plots: a square centered on nchPlot and rchan:
                             if npix > 0:
@@ -2265,63 +2272,23 @@ def polconvert(
                                 Ch0 = 0
                                 Ch1 = -1
 
-                            # Fringes in delay-rate space:
+                            # Fringes in delay-rate space (mixed products):
                             if ant2 == plotAnt or ant1 == plotAnt:
-                                FRRu = np.fft.fftshift(np.fft.fft2(uncal[0]))
-                                FRLu = np.fft.fftshift(np.fft.fft2(uncal[1]))
-                                FLRu = np.fft.fftshift(np.fft.fft2(uncal[2]))
-                                FLLu = np.fft.fftshift(np.fft.fft2(uncal[3]))
-
-                                RRu = np.abs(FRRu)
-                                RLu = np.abs(FRLu)
-                                LRu = np.abs(FLRu)
-                                LLu = np.abs(FLLu)
+                                RRu, RLu, LRu, LLu = Maps[0], Maps[1], Maps[2], Maps[3]
 
                                 # Calibration matrix (in frequency-time space)
 
-                                MAXK = max(list(map(np.max, list(map(np.abs, Kmat)))))
-                                MINK = min(list(map(np.min, list(map(np.abs, Kmat)))))
+                                MAXK = np.max(np.abs(Kmat))
+                                MINK = np.min(np.abs(Kmat))
 
-                                # Peaks to scale plots:
+                                # Peak to scale plots:
 
-                                RMAXu = np.unravel_index(
-                                    np.argmax(RRu + RLu + LRu + LLu), np.shape(RRu)
-                                )
-                                MAXu = max(
-                                    [RRu[RMAXu], RLu[RMAXu], LRu[RMAXu], LLu[RMAXu]]
-                                )
-                                MAXmix = [
-                                    np.max(RRu),
-                                    np.max(RLu),
-                                    np.max(LRu),
-                                    np.max(LLu),
-                                ]
-                                PEAK = np.unravel_index(
-                                    np.argmax(RRu + LLu), np.shape(RRu)
-                                )
+                                MAXu = max(np.abs(MixPeak))
 
-                            RRVis = np.fft.fftshift(np.fft.fft2(cal[0]))
-                            RLVis = np.fft.fftshift(np.fft.fft2(cal[1]))
-                            LRVis = np.fft.fftshift(np.fft.fft2(cal[2]))
-                            LLVis = np.fft.fftshift(np.fft.fft2(cal[3]))
-
-                            RR = np.abs(RRVis)
-                            RL = np.abs(RLVis)
-                            LR = np.abs(LRVis)
-                            LL = np.abs(LLVis)
+                            RR, RL, LR, LL = Maps[4], Maps[5], Maps[6], Maps[7]
 
                             # Peaks of converted fringes:
-                            if DEBUG:
-                                print("fringe maximum debugging:")
-                            RMAX = np.unravel_index(np.argmax(RR + LL), np.shape(RRVis))
-                            if DEBUG:
-                                print(" unravel_index:", RMAX)
-                            MAXVis = [
-                                RRVis[RMAX],
-                                RLVis[RMAX],
-                                LRVis[RMAX],
-                                LLVis[RMAX],
-                            ]
+                            MAXVis = CalPeak
                             if DEBUG:
                                 print(" MAXVis:", MAXVis)
                             try:
@@ -2331,7 +2298,7 @@ def polconvert(
                             except Exception as ex:
                                 print("  MixedCalib np exception", str(ex))
 
-                            MAXl = [RR[RMAX], RL[RMAX], LR[RMAX], LL[RMAX]]
+                            MAXl = [np.abs(MM) for MM in MAXVis]
                             if DEBUG:
                                 print(" MAXl:", MAXl)
                             MAX = max(MAXl)
@@ -2618,32 +2585,9 @@ def polconvert(
                                     % (pli, ant1)
                                 )
 
-                                # Estimate the Dynamic range:
-                                DLL = np.max(LL) / np.std(
-                                    np.sort(LL.flatten())[:-nchPlot]
-                                )
-                                DRR = np.max(RR) / np.std(
-                                    np.sort(RR.flatten())[:-nchPlot]
-                                )
-                                DRL = np.max(RL) / np.std(
-                                    np.sort(RL.flatten())[:-nchPlot]
-                                )
-                                DLR = np.max(LR) / np.std(
-                                    np.sort(LR.flatten())[:-nchPlot]
-                                )
-
-                                DLLu = np.max(LLu) / np.std(
-                                    np.sort(LLu.flatten())[:-nchPlot]
-                                )
-                                DRRu = np.max(RRu) / np.std(
-                                    np.sort(RRu.flatten())[:-nchPlot]
-                                )
-                                DRLu = np.max(RLu) / np.std(
-                                    np.sort(RLu.flatten())[:-nchPlot]
-                                )
-                                DLRu = np.max(LRu) / np.std(
-                                    np.sort(LRu.flatten())[:-nchPlot]
-                                )
+                                # Dynamic range (peak over rms, without the nchPlot highest pixels):
+                                DRRu, DRLu, DLRu, DLLu = DynRange[0:4]
+                                DRR, DRL, DLR, DLL = DynRange[4:8]
 
                                 RLRatio = (MAXl[0] / MAXl[3]) / (MAXl[2] / MAXl[1])
 
@@ -2660,7 +2604,7 @@ def polconvert(
                                     DRL,
                                     MAXl[2] / MAX,
                                     DLR,
-                                    MAX / len(fringe),
+                                    MAX / nFringe,
                                     RLRatio,
                                 ]
                                 fringeAmps[ant1].append(
@@ -2718,16 +2662,16 @@ def polconvert(
                                 printMsg(pmsg % tuple(toprint))
                                 pfile.write(pmsg % tuple(toprint))
 
-                                NUM = np.angle(FRRu[RMAXu] * np.average(Kmat[2]))
-                                DEN = np.angle(FLRu[RMAXu] * np.average(Kmat[3]))
+                                NUM = np.angle(MixPeak[0] * np.average(Kmat[2]))
+                                DEN = np.angle(MixPeak[2] * np.average(Kmat[3]))
                                 optph = (180.0 / np.pi * ((NUM - DEN) - np.pi)) % 360.0
                                 if optph > 180.0:
                                     optph -= 360.0
                                 pmsg = "\n\nFor RL: optimum X/Y phase is %.1f deg." % (
                                     optph
                                 )
-                                NUM = np.angle(FRLu[RMAXu] * np.average(Kmat[0]))
-                                DEN = np.angle(FLLu[RMAXu] * np.average(Kmat[1]))
+                                NUM = np.angle(MixPeak[1] * np.average(Kmat[0]))
+                                DEN = np.angle(MixPeak[3] * np.average(Kmat[1]))
                                 optph = (180.0 / np.pi * ((NUM - DEN) - np.pi)) % 360.0
                                 if optph > 180.0:
                                     optph -= 360.0
@@ -2742,11 +2686,11 @@ def polconvert(
                                     "wrote FRINGE.PEAKS_IF%i-ANT%i.dat" % (pli, ant1)
                                 )
                             # end of if for this baseline to be plotted
-                        # end of if len(fringe)>0
+                        # end of if nFringe>0
                         else:
                             printMsg("Fringe length was zero")
 
-                    # end of np.sum(AntEntry)
+                    # end of FM
                     else:
                         printMsg("Nothing to plot, apparently")
             # start of for ant1 in linAntIdx
@@ -2754,21 +2698,17 @@ def polconvert(
             # end of fringe loop on ant1-ant2 baseline
 
             try:
-                del uncal[3], uncal[2], uncal[1], uncal[0], uncal
-                del cal[3], cal[2], cal[1], cal[0], cal
-                del RRVis, RLVis, LRVis, LLVis, RR, LL, RL, LR
+                del RR, LL, RL, LR
             except:
                 pass
 
             if ant2 == plotAnt or ant1 == plotAnt:
                 try:
-                    del FRRu, FRLu, FLRu, FLLu
                     del RRu, RLu, LRu, LLu
-                    del Kmat[3], Kmat[2], Kmat[1], Kmat[0], Kmat
                 except:
                     pass
             try:
-                del fringe
+                del FM, Maps, Kmat
             except:
                 pass
             gc.collect()
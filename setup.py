@@ -26,21 +26,25 @@ cfitsio='/usr/include/cfitsio'
 
 
 sourcefiles1 = ['CalTable.cpp', 'DataIO.cpp', 'DataIOFITS.cpp',
-                'DataIOSWIN.cpp', 'Weighter.cpp', '_PolConvert.cpp']
+                'DataIOSWIN.cpp', 'Weighter.cpp', 'SlidingMedian.cpp',
+                'IndexCache.cpp', 'Timing.cpp', 'KMatrix.cpp', 'KTimeline.cpp',
+                '_PolConvert.cpp']
 
 sourcefiles2 = ['_PolGainSolve.cpp']
 
 sourcefiles3 = ['_getAntInfo.cpp']
 
-sourcefiles4 = ['_XPCal.cpp']
+sourcefiles4 = ['PcalReader.cpp', '_XPCal.cpp']
 
-sourcefiles5 = ['_XPCalMF.cpp']
+sourcefiles5 = ['PcalReader.cpp', '_XPCalMF.cpp']
+
+sourcefiles6 = ['_SWINReader.cpp']
 
 c_ext1 = Extension("_PolConvert", sources=sourcefiles1,
-                  extra_compile_args=["-Wno-deprecated","-O3","-std=c++11"],
+                  extra_compile_args=["-Wno-deprecated","-O3","-std=c++11","-pthread"],
                   libraries=['cfitsio'],
                   include_dirs=[np.get_include()],
-                  extra_link_args=["-Xlinker", "-export-dynamic"])
+                  extra_link_args=["-Xlinker", "-export-dynamic", "-pthread"])
 
 c_ext3 = Extension("_getAntInfo", sources=sourcefiles3,
                   extra_compile_args=["-Wno-deprecated","-O3","-std=c++11"],
@@ -58,12 +62,17 @@ c_ext5 = Extension("_XPCalMF",sources=sourcefiles5,
                   include_dirs=[np.get_include()],
                   extra_link_args=["-Xlinker","-export-dynamic"])
 
+c_ext6 = Extension("_SWINReader",sources=sourcefiles6,
+                  extra_compile_args=["-Wno-deprecated","-O3","-std=c++11"],
+                  include_dirs=[np.get_include()],
+                  extra_link_args=["-Xlinker","-export-dynamic"])
+
 if DO_SOLVE:
   c_ext2 = Extension("_PolGainSolve", sources=sourcefiles2,
                   libraries=['fftw3'],
                   include_dirs=[np.get_include()],
-                  extra_compile_args=["-Wno-deprecated","-O3","-std=c++11"],
-                  extra_link_args=["-Xlinker", "-export-dynamic"])
+                  extra_compile_args=["-Wno-deprecated","-O3","-std=c++11","-pthread"],
+                  extra_link_args=["-Xlinker", "-export-dynamic", "-pthread"])
 
 setup(
     ext_modules=[c_ext1], include_dirs=[cfitsio,'./'],
@@ -83,6 +92,10 @@ setup(
     ext_modules=[c_ext5],include_dirs=['./'],
 )
 
+setup(
+    ext_modules=[c_ext6],include_dirs=['./'],
+)
+
 
 if DO_SOLVE:
   setup(